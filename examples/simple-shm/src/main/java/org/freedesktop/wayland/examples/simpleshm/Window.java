@@ -24,7 +24,6 @@
 package org.freedesktop.wayland.examples.simpleshm;
 
 import org.freedesktop.wayland.client.*;
-import org.freedesktop.wayland.ShmPool;
 import org.freedesktop.wayland.protocol.*;
 
 import java.io.IOException;
@@ -34,46 +33,6 @@ import java.nio.IntBuffer;
 
 public class Window
 {
-    public class Buffer
-    {
-        boolean busy;
-        private wl_buffer.Proxy buffer;
-        private ShmPool shm_pool;
-
-        public Buffer()
-        {
-            try {
-                shm_pool = new ShmPool(width * height * 4);
-            } catch (IOException e) {
-                throw new RuntimeException(e);
-            }
-        }
-
-        public ByteBuffer getByteBuffer()
-        {
-            return shm_pool.asByteBuffer();
-        }
-
-        public wl_buffer.Proxy getProxy()
-        {
-            if (buffer == null) {
-                wl_shm_pool.Proxy pool = display.shm.createPool(
-                        shm_pool.getFileDescriptor(), width * height * 4);
-                buffer = pool.createBuffer(0, width, height, width * 4,
-                        wl_shm.FORMAT_XRGB8888);
-                buffer.addListener(new wl_buffer.Events() {
-                    public void release(wl_buffer.Proxy proxy)
-                    {
-                        busy = false;
-                    }
-                }, null);
-                pool.destroy();
-            }
-
-            return buffer;
-        }
-    }
-
     public final Display display;
 
     public final int width;
@@ -82,8 +41,12 @@ public class Window
     public wl_surface.Proxy surface;
     public wl_shell_surface.Proxy shell_surface;
     public wl_callback.Proxy callback;
-    Buffer buffers[];
-    Buffer prev_buffer;
+    ShmBufferAllocator allocator;
+    ShmSwapchain swapchain;
+    ParallelPainter painter;
+    /* Set while a frame waits for the compositor to release a buffer */
+    boolean waitingForRelease;
+    int pendingTime;
 
     public Window(Display display, int width, int height)
     {
@@ -91,9 +54,20 @@ public class Window
         this.width = width;
         this.height = height;
 
-        buffers = new Buffer[2];
-        buffers[0] = new Buffer();
-        buffers[1] = new Buffer();
+        allocator = new ShmBufferAllocator(display.shm);
+        swapchain = new ShmSwapchain(allocator, 2, width, height,
+                wl_shm.FORMAT_XRGB8888);
+        swapchain.setReleaseListener(new ShmBufferAllocator.ReleaseListener() {
+            @Override
+            public void released(ShmBufferAllocator.Buffer buffer)
+            {
+                if (waitingForRelease) {
+                    waitingForRelease = false;
+                    redraw(pendingTime);
+                }
+            }
+        });
+        painter = new ParallelPainter();
 
         surface = display.compositor.createSurface();
         surface.damage(0, 0, width, height);
@@ -127,78 +101,97 @@ public class Window
 
         shell_surface.destroy();
         surface.destroy();
-    }
 
-    public Buffer nextBuffer()
-    {
-        if (!buffers[0].busy)
-            return buffers[0];
-        else if (!buffers[1].busy)
-            return buffers[1];
-        else
-            return null;
+        swapchain.destroy();
+        allocator.destroy();
+        painter.destroy();
     }
 
-    private int abs(int i)
+    private static int abs(int i)
     {
         return i < 0 ? -i : i;
     }
 
-    private void paintPixels(ByteBuffer buffer, int padding, int time)
+    private void paintPixels(ShmBufferAllocator.Buffer buffer,
+            final int padding, final int time)
     {
         final int halfh = padding + (height - padding * 2) / 2;
         final int halfw = padding + (width  - padding * 2) / 2;
-        int ir;
-        int or;
-        IntBuffer image = buffer.asIntBuffer();
-        image.clear();
-        for (int i = 0; i < width * height; ++i)
-            image.put(0xffffffff);
-        image.clear();
 
         /* squared radii thresholds */
-        or = (halfw < halfh ? halfw : halfh) - 8;
-        ir = or - 32;
-        or = or * or;
-        ir = ir * ir;
+        final int outer = (halfw < halfh ? halfw : halfh) - 8;
+        final int inner = outer - 32;
+        final int or = outer * outer;
+        final int ir = inner * inner;
+
+        painter.paint(buffer, new ParallelPainter.Painter() {
+            @Override
+            public void paintTile(ByteBuffer tile, int tx, int ty, int tw,
+                    int th, int stride)
+            {
+                IntBuffer image = tile.asIntBuffer();
 
-        image.position(padding * width);
-        for (int y = padding; y < height - padding; y++) {
-            int y2 = (y - halfh) * (y - halfh);
+                for (int y = ty; y < ty + th; y++) {
+                    int y2 = (y - halfh) * (y - halfh);
 
-            image.position(image.position() + padding);
-            for (int x = padding; x < width - padding; x++) {
-                int v;
+                    image.position((y - ty) * (stride / 4));
+                    for (int x = tx; x < tx + tw; x++) {
+                        int v;
 
-                int r2 = (x - halfw) * (x - halfw) + y2;
+                        if (y < padding || y >= height - padding
+                                || x < padding || x >= width - padding) {
+                            image.put(0xffffffff);
+                            continue;
+                        }
 
-                if (r2 < ir)
-                    v = (r2 / 32 + time / 64) * 0x0080401;
-                else if (r2 < or)
-                    v = (y + time / 32) * 0x0080401;
-                else
-                    v = (x + time / 16) * 0x0080401;
-                v &= 0x00ffffff;
+                        int r2 = (x - halfw) * (x - halfw) + y2;
 
-                if (abs(x - y) > 6 && abs(x + y - height) > 6)
-                    v |= 0xff000000;
+                        if (r2 < ir)
+                            v = (r2 / 32 + time / 64) * 0x0080401;
+                        else if (r2 < or)
+                            v = (y + time / 32) * 0x0080401;
+                        else
+                            v = (x + time / 16) * 0x0080401;
+                        v &= 0x00ffffff;
 
-                image.put(v);
+                        if (abs(x - y) > 6 && abs(x + y - height) > 6)
+                            v |= 0xff000000;
+
+                        image.put(v);
+                    }
+                }
             }
-            image.position(image.position() + padding);
-        }
+        });
     }
 
-    public void redraw(int time)
+    public void redraw(final int time)
     {
-        Buffer buffer = nextBuffer();
-        
-        paintPixels(buffer.getByteBuffer(), 20, time);
-        surface.attach(buffer.getProxy(), 0, 0);
-        surface.damage(20, 20, height - 40, height - 40);
+        final ShmBufferAllocator.Buffer buffer;
+        try {
+            buffer = swapchain.acquire();
+        } catch (IOException e) {
+            throw new RuntimeException(e);
+        }
 
-        if (callback != null)
+        if (callback != null) {
             callback.destroy();
+            callback = null;
+        }
+
+        /*
+         * If the compositor is holding both buffers, skip this frame
+         * without committing and draw it once one of them is released.
+         */
+        if (buffer == null) {
+            waitingForRelease = true;
+            pendingTime = time;
+            return;
+        }
+
+        paintPixels(buffer, 20, time);
+        swapchain.attach(surface, 0, 0);
+        surface.damage(20, 20, height - 40, height - 40);
+
         callback = surface.frame();
         callback.addListener(new wl_callback.Events() {
             @Override
@@ -207,7 +200,6 @@ public class Window
                 redraw(serial);
             }
         }, null);
-        buffer.busy = true;
         surface.commit();
     }
 }
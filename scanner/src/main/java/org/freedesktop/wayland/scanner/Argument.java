@@ -171,7 +171,7 @@ class Argument
         }
     }
 
-    public String getJavaPrototype()
+    public String getJavaPrototype(String objectPrototype)
     {
         switch (type) {
         case INT:
@@ -183,11 +183,11 @@ class Argument
         case STRING:
             return "Ljava/lang/String;";
         case OBJECT:
-            return "Lorg/freedesktop/wayland/server/Resource;";
+            return objectPrototype;
         case NEW_ID:
             return "I";
         case ARRAY:
-            return "[B";
+            return "Ljava/nio/ByteBuffer;";
         case FD:
             return "I";
         default:
@@ -35,6 +35,22 @@ class Event extends Message
         super(iface, id, xmlElem);
     }
 
+    @Override
+    public String getJNISignature()
+    {
+        StringBuilder signature = new StringBuilder();
+        signature.append("(L" + iface.getJNIName() + "$Proxy;");
+        for (Argument arg : args) {
+            if (arg.type == Argument.Type.NEW_ID)
+                signature.append("Lorg/freedesktop/wayland/client/Proxy;");
+            else
+                signature.append(arg.getJavaPrototype(
+                        "Lorg/freedesktop/wayland/client/Proxy;"));
+        }
+        signature.append(")V");
+        return signature.toString();
+    }
+
     @Override
     public void writeInterfaceMethod(Writer writer) throws IOException
     {
@@ -62,10 +78,58 @@ class Event extends Message
         writer.write(");\n");
     }
 
+    /* Highest arity of the Resource.postEventN() variants */
+    private static final int MAX_PRIMITIVE_ARGS = 6;
+
+    /*
+     * Events whose arguments all fit in a jint are posted through
+     * Resource.postEventN() instead of the boxing varargs postEvent().
+     */
+    private boolean isPrimitive()
+    {
+        if (args.size() > MAX_PRIMITIVE_ARGS)
+            return false;
+
+        for (Argument arg : args) {
+            switch (arg.type) {
+            case INT:
+            case UINT:
+            case FIXED:
+            case FD:
+                break;
+            default:
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    private boolean hasFixedArguments()
+    {
+        for (Argument arg : args)
+            if (arg.type == Argument.Type.FIXED)
+                return true;
+
+        return false;
+    }
+
     @Override
     public void writePostMethod(Writer writer) throws IOException
     {
-        if (description != null)
+        writePostMethod(writer, false);
+
+        /* Lets callers pass coordinates without allocating Fixed objects */
+        if (isPrimitive() && hasFixedArguments()) {
+            writer.write("\n");
+            writePostMethod(writer, true);
+        }
+    }
+
+    private void writePostMethod(Writer writer, boolean floatFixed)
+            throws IOException
+    {
+        if (description != null && !floatFixed)
             description.writeJavaDoc(writer, "\t\t");
         writer.write("\t\tpublic void ");
         writer.write(StringUtil.toLowerCamelCase(name) + "(");
@@ -80,6 +144,9 @@ class Event extends Message
             case OBJECT:
                 writer.write("org.freedesktop.wayland.server.Resource");
                 break;
+            case FIXED:
+                writer.write(floatFixed ? "float" : arg.getJavaType(null));
+                break;
             default:
                 writer.write(arg.getJavaType(null));
             }
@@ -89,11 +156,64 @@ class Event extends Message
 
         writer.write(")\n");
         writer.write("\t\t{\n");
-        writer.write("\t\t\tpostEvent(" + id);
-        for (Argument arg : args)
-            writer.write(", " + arg.name);
+        if (isPrimitive()) {
+            writer.write("\t\t\tpostEvent" + args.size() + "(" + id);
+            for (Argument arg : args) {
+                writer.write(", ");
+                if (arg.type != Argument.Type.FIXED)
+                    writer.write(arg.name);
+                else if (floatFixed)
+                    writer.write("Fixed.toRaw(" + arg.name + ")");
+                else
+                    writer.write(arg.name + ".asRaw()");
+            }
+        } else {
+            writer.write("\t\t\tpostEvent(" + id);
+            for (Argument arg : args)
+                writer.write(", " + arg.name);
+        }
         writer.write(");\n");
         writer.write("\t\t}\n");
     }
-}
 
+    /*
+     * Writes static broadcastFoo() methods posting the event to an array or
+     * collection of resources at once.  Events creating objects are left
+     * out as each target would need its own.
+     */
+    public void writeBroadcastMethods(Writer writer) throws IOException
+    {
+        for (Argument arg : args)
+            if (arg.type == Argument.Type.NEW_ID)
+                return;
+
+        String[] targetTypes = {
+            "Resource[]",
+            "java.util.Collection<? extends Resource>"
+        };
+
+        for (String targetType : targetTypes) {
+            writer.write("\n");
+            writer.write("\t\tpublic static void broadcast");
+            writer.write(StringUtil.toUpperCamelCase(name) + "(");
+            writer.write(targetType + " targets");
+
+            for (Argument arg : args) {
+                writer.write(", ");
+                if (arg.type == Argument.Type.OBJECT)
+                    writer.write("org.freedesktop.wayland.server.Resource");
+                else
+                    writer.write(arg.getJavaType(null));
+                writer.write(" " + arg.name);
+            }
+
+            writer.write(")\n");
+            writer.write("\t\t{\n");
+            writer.write("\t\t\tbroadcast(targets, " + id);
+            for (Argument arg : args)
+                writer.write(", " + arg.name);
+            writer.write(");\n");
+            writer.write("\t\t}\n");
+        }
+    }
+}
@@ -21,6 +21,7 @@
  */
 package org.freedesktop.wayland.scanner;
 
+import java.util.Set;
 import java.util.List;
 import java.util.Iterator;
 import java.util.ArrayList;
@@ -51,6 +52,25 @@ class Interface
     {
         return name;
     }
+
+    /* Binary name of the generated class, as used in JNI signatures */
+    public String getJNIName()
+    {
+        if (scanner.javaPackage == null)
+            return toClassName(name);
+        else
+            return scanner.javaPackage.replace('.', '/') + "/"
+                    + toClassName(name);
+    }
+
+    /*
+     * Name of the generated C wl_interface.  It is suffixed so it does not
+     * collide with the tables exported by libwayland itself.
+     */
+    public static String getNativeName(String ifaceName)
+    {
+        return ifaceName + "_jni_interface";
+    }
     
     public Interface(Scanner scanner, Element xmlElem)
     {
@@ -196,6 +216,15 @@ class Interface
         writer.write("\t\tResource.class\n");
         writer.write("\t);\n");
 
+        if (scanner.nativeLibrary != null) {
+            // The library registers the prebuilt tables for WAYLAND_INTERFACE
+            writer.write("\n");
+            writer.write("\tstatic {\n");
+            writer.write("\t\torg.freedesktop.wayland.arch.Native.loadLibrary(\"");
+            writer.write(scanner.nativeLibrary + "\");\n");
+            writer.write("\t}\n");
+        }
+
         for (Enum enm : enums) {
             writer.write("\n");
             enm.writeJavaDeclaration(writer);
@@ -253,11 +282,94 @@ class Interface
         for (Message event : events) {
             writer.write("\n");
             event.writePostMethod(writer);
+            ((Event)event).writeBroadcastMethods(writer);
         }
 
         writer.write("\t}\n");
 
         writer.write("}\n");
     }
-}
 
+    public void addReferencedInterfaces(Set<String> ifaceNames)
+    {
+        ifaceNames.add(wl_name);
+        for (Message request : requests)
+            request.addReferencedInterfaces(ifaceNames);
+        for (Message event : events)
+            event.addReferencedInterfaces(ifaceNames);
+    }
+
+    private void writeNativeMessages(Writer writer, List<Message> messages,
+            String suffix, int typesOffset) throws IOException
+    {
+        if (messages.isEmpty())
+            return;
+
+        writer.write("\n");
+        writer.write("static const struct wl_message ");
+        writer.write(wl_name + "_" + suffix + "[] = {\n");
+        for (Message msg : messages) {
+            int count = msg.getNativeTypeCount();
+            msg.writeNativeMessage(writer, count == 0 ? 0 : typesOffset);
+            typesOffset += count;
+        }
+        writer.write("};\n");
+    }
+
+    private void writeNativeMethods(Writer writer, List<Message> messages,
+            String suffix) throws IOException
+    {
+        if (messages.isEmpty())
+            return;
+
+        writer.write("\n");
+        writer.write("static const struct wl_jni_method ");
+        writer.write(wl_name + "_" + suffix + "[] = {\n");
+        for (Message msg : messages)
+            msg.writeNativeMethod(writer);
+        writer.write("};\n");
+    }
+
+    private String nativeArrayName(List<Message> messages, String suffix)
+    {
+        return messages.isEmpty() ? "NULL" : wl_name + "_" + suffix;
+    }
+
+    public void writeNative(Writer writer) throws IOException
+    {
+        // Index 0 is shared by every message without arguments
+        writer.write("static const struct wl_interface *");
+        writer.write(wl_name + "_types[] = {\n");
+        writer.write("    NULL,\n");
+        int requestTypes = 1;
+        for (Message request : requests) {
+            request.writeNativeTypes(writer);
+            requestTypes += request.getNativeTypeCount();
+        }
+        for (Message event : events)
+            event.writeNativeTypes(writer);
+        writer.write("};\n");
+
+        writeNativeMessages(writer, requests, "requests", 1);
+        writeNativeMessages(writer, events, "events", requestTypes);
+        writeNativeMethods(writer, requests, "request_methods");
+        writeNativeMethods(writer, events, "event_methods");
+
+        writer.write("\n");
+        writer.write("const struct wl_interface " + getNativeName(wl_name));
+        writer.write(" = {\n");
+        writer.write("    \"" + wl_name + "\", " + version + ",\n");
+        writer.write("    " + requests.size() + ", ");
+        writer.write(nativeArrayName(requests, "requests") + ",\n");
+        writer.write("    " + events.size() + ", ");
+        writer.write(nativeArrayName(events, "events") + ",\n");
+        writer.write("};\n");
+    }
+
+    public void writeNativeTableEntry(Writer writer) throws IOException
+    {
+        writer.write("    { &" + getNativeName(wl_name) + ", ");
+        writer.write(nativeArrayName(requests, "request_methods") + ", ");
+        writer.write(nativeArrayName(events, "event_methods") + " },\n");
+    }
+}
@@ -21,6 +21,7 @@
  */
 package org.freedesktop.wayland.scanner;
 
+import java.util.Set;
 import java.util.ArrayList;
 
 import java.io.Writer;
@@ -67,18 +68,24 @@ abstract class Message
         }
     }
 
-    public void writeMessageInfo(Writer writer) throws IOException
+    public String getWLSignature()
     {
-        writer.write("\t\t\tnew Interface.Message(\"");
-        writer.write(StringUtil.toLowerCamelCase(name) + "\", ");
-        writer.write("\"");
+        StringBuilder signature = new StringBuilder();
         if (since != 1)
-            writer.write(String.valueOf(since));
+            signature.append(since);
         for (Argument arg : args) {
             if (arg.type == Argument.Type.NEW_ID && arg.ifaceName == null)
-                writer.write("su");
-            writer.write(arg.getWLPrototype());
+                signature.append("su");
+            signature.append(arg.getWLPrototype());
         }
+        return signature.toString();
+    }
+
+    public void writeMessageInfo(Writer writer) throws IOException
+    {
+        writer.write("\t\t\tnew Interface.Message(\"");
+        writer.write(StringUtil.toLowerCamelCase(name) + "\", ");
+        writer.write("\"" + getWLSignature());
         writer.write("\", new Interface[]{\n");
         for (Argument arg : args) {
             if (arg.type == Argument.Type.OBJECT && arg.ifaceName != null) {
@@ -93,6 +100,59 @@ abstract class Message
         writer.write("\t\t\t}),\n");
     }
 
+    /* Number of wl_message types entries, one per signature argument */
+    public int getNativeTypeCount()
+    {
+        int count = 0;
+        for (Argument arg : args) {
+            if (arg.type == Argument.Type.NEW_ID && arg.ifaceName == null)
+                count += 2;
+            count++;
+        }
+        return count;
+    }
+
+    public void addReferencedInterfaces(Set<String> ifaceNames)
+    {
+        for (Argument arg : args)
+            if ((arg.type == Argument.Type.OBJECT
+                    || arg.type == Argument.Type.NEW_ID)
+                    && arg.ifaceName != null)
+                ifaceNames.add(arg.ifaceName);
+    }
+
+    public void writeNativeTypes(Writer writer) throws IOException
+    {
+        for (Argument arg : args) {
+            if (arg.type == Argument.Type.NEW_ID && arg.ifaceName == null)
+                writer.write("    NULL,\n    NULL,\n");
+
+            if ((arg.type == Argument.Type.OBJECT
+                    || arg.type == Argument.Type.NEW_ID)
+                    && arg.ifaceName != null) {
+                writer.write("    &" + Interface.getNativeName(arg.ifaceName)
+                        + ",\n");
+            } else {
+                writer.write("    NULL,\n");
+            }
+        }
+    }
+
+    public void writeNativeMessage(Writer writer, int typesOffset)
+            throws IOException
+    {
+        writer.write("    { \"" + name + "\", \"" + getWLSignature() + "\", ");
+        writer.write(iface.wl_name + "_types + " + typesOffset + " },\n");
+    }
+
+    public void writeNativeMethod(Writer writer) throws IOException
+    {
+        writer.write("    { \"" + StringUtil.toLowerCamelCase(name) + "\", ");
+        writer.write("\"" + getJNISignature() + "\" },\n");
+    }
+
+    /* JNI signature of the listener method that handles this message */
+    public abstract String getJNISignature();
     public abstract void writeInterfaceMethod(Writer writer) throws IOException;
     public abstract void writePostMethod(Writer writer) throws IOException;
 }
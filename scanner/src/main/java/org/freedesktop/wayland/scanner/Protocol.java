@@ -21,6 +21,8 @@
  */
 package org.freedesktop.wayland.scanner;
 
+import java.util.Set;
+import java.util.TreeSet;
 import java.util.ArrayList;
 
 import java.io.File;
@@ -107,5 +109,57 @@ public class Protocol
             }
         }
     }
-}
 
+    public void writeNative(File dest)
+    {
+        if (interfaces.isEmpty())
+            return;
+
+        if (! dest.exists())
+            dest.mkdirs();
+
+        File destFile = new File(dest, name + "-protocol.c");
+
+        Set<String> referenced = new TreeSet<String>();
+        for (Interface iFace : interfaces)
+            iFace.addReferencedInterfaces(referenced);
+
+        try {
+            scanner.log("Generating " + destFile);
+            Writer writer = new FileWriter(destFile);
+            writeCopyright(writer);
+            writer.write("\n#include \"wayland-jni.h\"\n\n");
+
+            // Interfaces from other protocols come from their libraries
+            for (String iface : referenced) {
+                writer.write("extern const struct wl_interface ");
+                writer.write(Interface.getNativeName(iface) + ";\n");
+            }
+
+            for (Interface iFace : interfaces) {
+                writer.write("\n");
+                iFace.writeNative(writer);
+            }
+
+            writer.write("\n");
+            writer.write("static const struct wl_jni_protocol_interface ");
+            writer.write("interfaces[] = {\n");
+            for (Interface iFace : interfaces)
+                iFace.writeNativeTableEntry(writer);
+            writer.write("};\n\n");
+
+            writer.write("static const struct wl_jni_protocol protocol = {\n");
+            writer.write("    \"" + name + "\", " + interfaces.size());
+            writer.write(", interfaces\n};\n\n");
+
+            writer.write("static void __attribute__((constructor))\n");
+            writer.write("register_protocol(void)\n");
+            writer.write("{\n");
+            writer.write("    wl_jni_protocol_register(&protocol);\n");
+            writer.write("}\n");
+            writer.close();
+        } catch (IOException e) {
+            throw new BuildException(e.getMessage());
+        }
+    }
+}
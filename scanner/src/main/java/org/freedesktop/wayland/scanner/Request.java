@@ -37,6 +37,21 @@ class Request extends Message
         super(iface, id, xmlElem);
     }
 
+    @Override
+    public String getJNISignature()
+    {
+        StringBuilder signature = new StringBuilder();
+        signature.append("(L" + iface.getJNIName() + "$Resource;");
+        for (Argument arg : args) {
+            if (arg.type == Argument.Type.NEW_ID && arg.ifaceName == null)
+                signature.append("Ljava/lang/String;I");
+            signature.append(arg.getJavaPrototype(
+                    "Lorg/freedesktop/wayland/server/Resource;"));
+        }
+        signature.append(")V");
+        return signature.toString();
+    }
+
     @Override
     public void writeInterfaceMethod(Writer writer) throws IOException
     {
@@ -53,6 +53,21 @@ public class Scanner extends Task
         this.dest = dest;
     }
 
+    private File nativeDest;
+    public void setNativedest(File nativeDest)
+    {
+        this.nativeDest = nativeDest;
+    }
+
+    String nativeLibrary;
+    public void setNativelibrary(String nativeLibrary)
+    {
+        if (nativeLibrary == null || nativeLibrary.isEmpty())
+            this.nativeLibrary = null;
+        else
+            this.nativeLibrary = nativeLibrary;
+    }
+
     String javaPackage;
     public void setJavapackage(String javaPackage)
     {
@@ -127,6 +142,8 @@ public class Scanner extends Task
         Protocol protocol = new Protocol(this, xmlElem);
 
         protocol.writeJava(dest);
+        if (nativeDest != null)
+            protocol.writeNative(nativeDest);
     }
 }
 
@@ -39,7 +39,16 @@ public final class Fixed
 
     public Fixed(float value)
     {
-        this.data = (int)(value * 256 + 0.5);
+        this.data = toRaw(value);
+    }
+
+    /**
+     * Converts a float to the 24.8 fixed-point representation used on the
+     * wire without allocating a Fixed.
+     */
+    public static int toRaw(float value)
+    {
+        return (int)(value * 256 + 0.5);
     }
 
     public int asInt()
@@ -52,6 +61,12 @@ public final class Fixed
         return (float)this.data / 256.0f;
     }
 
+    /** Returns the raw 24.8 fixed-point value */
+    public int asRaw()
+    {
+        return this.data;
+    }
+
     static {
         Native.loadLibrary("wayland-java-util");
     }
@@ -71,6 +71,12 @@ public class Interface
 
     private native void destroyNative();
 
+    /*
+     * Whether the native interface came from a scanner-generated table
+     * rather than being built from the message descriptions.  For tests.
+     */
+    native boolean isPrebuilt();
+
     public String getName()
     {
         return name;
@@ -0,0 +1,187 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland;
+
+import java.nio.ByteBuffer;
+import java.nio.ReadOnlyBufferException;
+
+import org.freedesktop.wayland.arch.Native;
+
+/**
+ * Native pixel kernels for 32-bit shm buffers.
+ *
+ * Every operation works on a rectangle of a direct ByteBuffer, such as one
+ * returned by ShmPool.asByteBuffer(), given as a byte offset of pixel
+ * (0, 0) from the start of the buffer, a stride in bytes and a rectangle in
+ * pixels.  The buffer's position and limit are ignored.  Colors are ints in
+ * the native 0xAARRGGBB layout.  On x86 the kernels use SSE2 or AVX2 where
+ * the CPU has it; results are identical either way.  Destination buffers
+ * must be writable; a read-only one, such as a view of a client's pool,
+ * makes an operation throw ReadOnlyBufferException.
+ */
+public final class PixelOps
+{
+    /* Same values as wl_shm.FORMAT_* */
+    public static final int FORMAT_ARGB8888 = 0;
+    public static final int FORMAT_XRGB8888 = 1;
+    public static final int FORMAT_ABGR8888 = 0x34324241;
+    public static final int FORMAT_XBGR8888 = 0x34324258;
+
+    /* Kernel levels for setKernelLevel() */
+    static final int KERNELS_SCALAR = 0;
+    static final int KERNELS_SSE2 = 1;
+    static final int KERNELS_AVX2 = 2;
+
+    private PixelOps()
+    { }
+
+    public static void fillRect(ByteBuffer dst, int offset, int stride,
+            int x, int y, int width, int height, int color)
+    {
+        checkWritable(dst);
+        fillRectNative(dst, offset, stride, x, y, width, height, color);
+    }
+
+    /**
+     * Fills the rectangle with a linear gradient from color0 on its left
+     * (or top) edge to color1 on its right (or bottom) edge.
+     */
+    public static void fillGradient(ByteBuffer dst, int offset,
+            int stride, int x, int y, int width, int height, int color0,
+            int color1, boolean vertical)
+    {
+        checkWritable(dst);
+        fillGradientNative(dst, offset, stride, x, y, width, height, color0,
+                color1, vertical);
+    }
+
+    /**
+     * Copies a rectangle of pixels.  The source and destination may be the
+     * same buffer and may overlap.
+     */
+    public static void copyRect(ByteBuffer src, int srcOffset,
+            int srcStride, int srcX, int srcY, ByteBuffer dst, int dstOffset,
+            int dstStride, int dstX, int dstY, int width, int height)
+    {
+        checkWritable(dst);
+        copyRectNative(src, srcOffset, srcStride, srcX, srcY, dst, dstOffset,
+                dstStride, dstX, dstY, width, height);
+    }
+
+    /**
+     * Copies a rectangle between any two of the FORMAT_ constants, swapping
+     * the red and blue channels as needed.  Converting from a format
+     * without alpha to one with it makes the result opaque.
+     */
+    public static void convertRect(ByteBuffer src, int srcOffset,
+            int srcStride, int srcX, int srcY, int srcFormat, ByteBuffer dst,
+            int dstOffset, int dstStride, int dstX, int dstY, int dstFormat,
+            int width, int height)
+    {
+        checkWritable(dst);
+        convertRectNative(src, srcOffset, srcStride, srcX, srcY, srcFormat, dst,
+                dstOffset, dstStride, dstX, dstY, dstFormat, width, height);
+    }
+
+    public static void premultiply(ByteBuffer dst, int offset,
+            int stride, int x, int y, int width, int height)
+    {
+        checkWritable(dst);
+        premultiplyNative(dst, offset, stride, x, y, width, height);
+    }
+
+    public static void unpremultiply(ByteBuffer dst, int offset,
+            int stride, int x, int y, int width, int height)
+    {
+        checkWritable(dst);
+        unpremultiplyNative(dst, offset, stride, x, y, width, height);
+    }
+
+    /**
+     * Composites a premultiplied source rectangle over the destination
+     * with the Porter-Duff OVER operator.
+     */
+    public static void blendOver(ByteBuffer src, int srcOffset,
+            int srcStride, int srcX, int srcY, ByteBuffer dst, int dstOffset,
+            int dstStride, int dstX, int dstY, int width, int height)
+    {
+        checkWritable(dst);
+        blendOverNative(src, srcOffset, srcStride, srcX, srcY, dst, dstOffset,
+                dstStride, dstX, dstY, width, height);
+    }
+
+    /**
+     * Copies every rectangle of the region from src to dst.  Both buffers
+     * share the same stride, as the buffers of a swapchain do, so this is
+     * the way to carry the previous frame's damage forward into a reused
+     * buffer.  The whole region is bounds-checked before anything is copied.
+     */
+    public static void copyRegion(ByteBuffer src, int srcOffset,
+            ByteBuffer dst, int dstOffset, int stride, Region region)
+    {
+        checkWritable(dst);
+        copyRegionNative(src, srcOffset, dst, dstOffset, stride, region);
+    }
+
+    /**
+     * Caps the kernels used by every later operation at the given level;
+     * levels the CPU lacks are still skipped.  Only for tests comparing
+     * the vector paths with the scalar one, as it is not thread-safe.
+     */
+    static void setKernelLevel(int level)
+    {
+        setKernelLevelNative(level);
+    }
+
+    private static void checkWritable(ByteBuffer dst)
+    {
+        if (dst != null && dst.isReadOnly())
+            throw new ReadOnlyBufferException();
+    }
+
+    private static native void setKernelLevelNative(int level);
+    private static native void fillRectNative(ByteBuffer dst, int offset,
+            int stride, int x, int y, int width, int height, int color);
+    private static native void fillGradientNative(ByteBuffer dst, int offset,
+            int stride, int x, int y, int width, int height, int color0,
+            int color1, boolean vertical);
+    private static native void copyRectNative(ByteBuffer src, int srcOffset,
+            int srcStride, int srcX, int srcY, ByteBuffer dst, int dstOffset,
+            int dstStride, int dstX, int dstY, int width, int height);
+    private static native void convertRectNative(ByteBuffer src, int srcOffset,
+            int srcStride, int srcX, int srcY, int srcFormat, ByteBuffer dst,
+            int dstOffset, int dstStride, int dstX, int dstY, int dstFormat,
+            int width, int height);
+    private static native void premultiplyNative(ByteBuffer dst, int offset,
+            int stride, int x, int y, int width, int height);
+    private static native void unpremultiplyNative(ByteBuffer dst, int offset,
+            int stride, int x, int y, int width, int height);
+    private static native void blendOverNative(ByteBuffer src, int srcOffset,
+            int srcStride, int srcX, int srcY, ByteBuffer dst, int dstOffset,
+            int dstStride, int dstX, int dstY, int width, int height);
+    private static native void copyRegionNative(ByteBuffer src, int srcOffset,
+            ByteBuffer dst, int dstOffset, int stride, Region region);
+
+    static {
+        Native.loadLibrary("wayland-java-util");
+    }
+}
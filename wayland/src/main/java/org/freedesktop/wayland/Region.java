@@ -0,0 +1,185 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland;
+
+import java.nio.ByteBuffer;
+
+import org.freedesktop.wayland.arch.Native;
+
+/**
+ * A set of pixels stored as a list of non-overlapping rectangles.
+ *
+ * Regions are meant for damage and occlusion tracking: accumulate what
+ * changed in each frame, subtract what is hidden or what a buffer already
+ * has and hand the rest to PixelOps.copyRegion() or to wl_surface.damage.
+ * Rectangles with a non-positive width or height are empty and ignored.
+ *
+ * The rectangles are kept in y-x banded order, as pixman does, so the set
+ * operations are linear in the number of rectangles.  Rectangle lists go
+ * in and out as flat x, y, width, height quadruples, either in an int[] or
+ * in a direct ByteBuffer in native byte order, never as one object per
+ * rectangle.
+ */
+public final class Region
+{
+    /* Must match region_ops in region.c */
+    private static final int OP_UNION = 0;
+    private static final int OP_INTERSECT = 1;
+    private static final int OP_SUBTRACT = 2;
+
+    private long region_ptr;
+
+    public Region()
+    {
+        region_ptr = createNative();
+    }
+
+    public Region(int x, int y, int width, int height)
+    {
+        this();
+        unionRect(x, y, width, height);
+    }
+
+    public Region(Region other)
+    {
+        this();
+        set(other);
+    }
+
+    /** Makes this region a copy of other. */
+    public native void set(Region other);
+    public native void clear();
+
+    public native void union(Region other);
+    public native void unionRect(int x, int y, int width, int height);
+    public native void intersect(Region other);
+    public native void intersectRect(int x, int y, int width, int height);
+    public native void subtract(Region other);
+    public native void subtractRect(int x, int y, int width, int height);
+    public native void translate(int dx, int dy);
+
+    /*
+     * The following take count rectangles as x, y, width, height
+     * quadruples starting at rects[offset] and combine this region with
+     * their union.  The rectangles may overlap.
+     */
+    public void unionRectangles(int[] rects, int offset, int count)
+    {
+        applyRectanglesNative(OP_UNION, rects, offset, count);
+    }
+
+    public void intersectRectangles(int[] rects, int offset, int count)
+    {
+        applyRectanglesNative(OP_INTERSECT, rects, offset, count);
+    }
+
+    public void subtractRectangles(int[] rects, int offset, int count)
+    {
+        applyRectanglesNative(OP_SUBTRACT, rects, offset, count);
+    }
+
+    public void setRectangles(int[] rects, int offset, int count)
+    {
+        clear();
+        unionRectangles(rects, offset, count);
+    }
+
+    /* As above with the quadruples offset bytes into a direct buffer */
+    public void unionRectangles(ByteBuffer rects, int offset, int count)
+    {
+        applyRectanglesBufferNative(OP_UNION, rects, offset, count);
+    }
+
+    public void intersectRectangles(ByteBuffer rects, int offset, int count)
+    {
+        applyRectanglesBufferNative(OP_INTERSECT, rects, offset, count);
+    }
+
+    public void subtractRectangles(ByteBuffer rects, int offset, int count)
+    {
+        applyRectanglesBufferNative(OP_SUBTRACT, rects, offset, count);
+    }
+
+    public void setRectangles(ByteBuffer rects, int offset, int count)
+    {
+        clear();
+        unionRectangles(rects, offset, count);
+    }
+
+    public native int getRectangleCount();
+
+    /**
+     * Returns the rectangles of this region packed as x, y, width, height
+     * quadruples.
+     */
+    public native int[] getRectangles();
+
+    /**
+     * Writes the rectangles to rects starting at offset and returns how
+     * many there were.  Throws IndexOutOfBoundsException without writing
+     * anything if they don't fit; see getRectangleCount().
+     */
+    public native int getRectangles(int[] rects, int offset);
+
+    /* As above with offset in bytes into a direct buffer */
+    public native int getRectangles(ByteBuffer rects, int offset);
+
+    /* Returns the bounding box as x, y, width, height; all 0 if empty */
+    public native int[] getExtents();
+
+    public native boolean containsPoint(int x, int y);
+    public native boolean intersectsRect(int x, int y, int width, int height);
+
+    public boolean isEmpty()
+    {
+        return getRectangleCount() == 0;
+    }
+
+    public synchronized void destroy()
+    {
+        long ptr = region_ptr;
+        region_ptr = 0;
+        destroyNative(ptr);
+    }
+
+    @Override
+    protected void finalize() throws Throwable
+    {
+        destroy();
+        super.finalize();
+    }
+
+    private native void applyRectanglesNative(int op, int[] rects,
+            int offset, int count);
+    private native void applyRectanglesBufferNative(int op, ByteBuffer rects,
+            int offset, int count);
+
+    private static native long createNative();
+    private static native void destroyNative(long region_ptr);
+
+    private static native void initializeJNI();
+
+    static {
+        Native.loadLibrary("wayland-java-util");
+        initializeJNI();
+    }
+}
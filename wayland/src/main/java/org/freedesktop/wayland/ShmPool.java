@@ -27,45 +27,142 @@ import java.io.Closeable;
 import java.io.IOException;
 import java.nio.ByteBuffer;
 import java.nio.ByteOrder;
+import java.util.ArrayList;
 
 public final class ShmPool implements Closeable
 {
+    /**
+     * Seal the pool's file against shrinking, if the platform supports it.
+     * A compositor that finds this seal on a client's pool knows the
+     * mapping can never be truncated underneath it, so it does not need to
+     * guard against SIGBUS.  Check isShrinkSealed() for whether it applied.
+     */
+    public static final int SEAL_SHRINK = 0x1;
+    /**
+     * Fault in the whole pool when it is mapped, so the first paint doesn't
+     * take a page fault per page.
+     */
+    public static final int POPULATE = 0x2;
+    /**
+     * Back the pool with hugetlbfs pages if the kernel allows it.  That
+     * needs pages reserved in /proc/sys/vm/nr_hugepages and a size that is
+     * a multiple of the huge page size; otherwise the pool silently uses
+     * normal pages.  A pool that did get huge pages can only be resized to
+     * multiples of the huge page size, by either end: anything else makes
+     * resize() here, or the compositor's remap on wl_shm_pool.resize,
+     * fail.
+     */
+    public static final int HUGETLB = 0x4;
+    /**
+     * Ask for transparent huge pages on the mapping.  This needs shmem THP
+     * enabled in "advise" mode or better to have any effect.
+     */
+    public static final int HUGEPAGE = 0x8;
+
+    private static final int ADVICE_WILLNEED = 0;
+    private static final int ADVICE_DONTNEED = 1;
+
     private int fd;
     private long size;
     private boolean readOnly;
+    private int flags;
+    private int generation;
+
+    /* The whole mapping, which may extend past size in reserve mode */
+    private ByteBuffer mapping;
+    /* A view of the first size bytes of mapping */
     private ByteBuffer buffer;
+    /* Mappings replaced by a moving resize, unmapped on close */
+    private ArrayList<ByteBuffer> retired;
 
     private ShmPool(int fd, long size, boolean dupFD, boolean readOnly)
             throws IOException
     {
+        if (dupFD)
+            fd = dupNative(fd);
+
         this.fd = fd;
         this.size = size;
         this.readOnly = readOnly;
-        this.buffer = map(fd, size, dupFD, readOnly);
+        try {
+            this.mapping = mapNative(fd, size, readOnly, 0, size);
+            this.buffer = view(mapping, size);
+        } catch (IOException e) {
+            if (dupFD)
+                closeNative(fd);
+            throw e;
+        }
     }
 
-    private static ByteBuffer map(int fd, long size, boolean dupFD,
-            boolean readOnly) throws IOException
+    private static ByteBuffer view(ByteBuffer mapping, long size)
     {
-        ByteBuffer tmpBuff = mapNative(fd, size, dupFD, readOnly);
-        tmpBuff.order(ByteOrder.nativeOrder());
-        return tmpBuff;
+        if (size > Integer.MAX_VALUE)
+            throw new IllegalArgumentException("ShmPool too large to map");
+
+        ByteBuffer tmpBuff = mapping.duplicate();
+        tmpBuff.position(0).limit((int)size);
+        return tmpBuff.slice().order(ByteOrder.nativeOrder());
     }
 
     public ShmPool(long size) throws IOException
     {
-        this.fd = createTmpFileNative();
+        this(size, 0);
+    }
+
+    /**
+     * Creates a pool backed by an anonymous memfd, falling back to an
+     * unlinked file in $XDG_RUNTIME_DIR where memfd_create is unavailable.
+     */
+    public ShmPool(long size, int flags) throws IOException
+    {
+        this(size, size, flags);
+    }
+
+    /**
+     * Creates a pool that reserves address space for reserveSize bytes up
+     * front.  Growing it up to that size only extends the file, and the
+     * pool never moves, so views returned earlier stay valid.
+     */
+    public ShmPool(long size, long reserveSize, int flags) throws IOException
+    {
+        if (reserveSize < size)
+            throw new IllegalArgumentException("reserveSize smaller than size");
+
         this.size = size;
         this.readOnly = false;
+        try {
+            create(reserveSize, flags);
+        } catch (IOException e) {
+            /* No huge pages reserved, or a size that isn't a multiple */
+            if ((flags & HUGETLB) == 0)
+                throw e;
+            create(reserveSize, flags & ~HUGETLB);
+        }
+    }
+
+    private void create(long reserveSize, int flags) throws IOException
+    {
+        this.fd = createAnonymousFileNative(flags);
+        this.flags = flags;
         try {
             truncateNative(this.fd, this.size);
-            this.buffer = map(this.fd, this.size, false, false);
+            if ((flags & SEAL_SHRINK) != 0)
+                sealShrinkNative(this.fd);
+            this.mapping = mapNative(this.fd, reserveSize, false, flags,
+                    size);
+            this.buffer = view(mapping, size);
         } catch (IOException e) {
             closeNative(this.fd);
             throw e;
         }
     }
 
+    /**
+     * Maps a pool from an existing file descriptor.  With dupFD the pool
+     * works on its own duplicate and the caller keeps fd; otherwise the
+     * pool takes fd over, once it has been mapped successfully.  Either way
+     * the pool's descriptor is closed by close().
+     */
     public static ShmPool fromFileDescriptor(int fd, long size, boolean dupFD,
             boolean readOnly) throws IOException
     {
@@ -103,18 +200,79 @@ public final class ShmPool implements Closeable
         return readOnly;
     }
 
+    /**
+     * Returns a counter that changes on every resize.  Views returned by
+     * asByteBuffer() before a resize keep pointing at valid memory, but
+     * only cover the old size; compare generations to know when to fetch
+     * a new one.
+     */
+    public int getGeneration()
+    {
+        return generation;
+    }
+
+    /**
+     * Returns whether the underlying file is sealed against shrinking.
+     * This works for pools received from another process as well.
+     */
+    public boolean isShrinkSealed() throws IOException
+    {
+        return isShrinkSealedNative(fd);
+    }
+
 	public void resize(long size, boolean truncate) throws IOException
     {
         if (buffer == null)
             throw new IllegalStateException("ShmPool is closed");
 
-        unmapNative(buffer);
-
-        this.size = size;
+        /* Truncate first so a refused resize leaves the pool mapped */
         if (truncate)
             truncateNative(fd, size);
 
-        buffer = map(fd, size, false, readOnly);
+        if (size > mapping.capacity()) {
+            ByteBuffer newMapping = remapNative(mapping, size, flags);
+            if (!isSameMappingNative(mapping, newMapping)) {
+                if (retired == null)
+                    retired = new ArrayList<ByteBuffer>();
+                retired.add(mapping);
+            }
+            mapping = newMapping;
+        }
+
+        this.size = size;
+        buffer = view(mapping, size);
+        ++generation;
+    }
+
+    /**
+     * Hints that the given range will be accessed soon, starting readahead
+     * of any pages that aren't resident.
+     */
+    public void adviseWillNeed(long offset, long length) throws IOException
+    {
+        advise(offset, length, ADVICE_WILLNEED);
+    }
+
+    /**
+     * Hints that the given range won't be accessed for a while, dropping it
+     * from this process's page tables.  The contents are kept, since they
+     * are shared with the other end of the pool.  The range is widened to
+     * whole pages.
+     */
+    public void adviseDontNeed(long offset, long length) throws IOException
+    {
+        advise(offset, length, ADVICE_DONTNEED);
+    }
+
+    private void advise(long offset, long length, int advice)
+            throws IOException
+    {
+        if (buffer == null)
+            throw new IllegalStateException("ShmPool is closed");
+        if (offset < 0 || length < 0 || offset + length > size)
+            throw new IndexOutOfBoundsException();
+
+        adviseNative(buffer, offset, length, advice);
     }
 
 	public void resize(long size) throws IOException
@@ -126,10 +284,18 @@ public final class ShmPool implements Closeable
 	public void close() throws IOException
     {
         if (buffer != null) {
-            unmapNative(buffer);
+            unmapNative(mapping);
+            if (retired != null) {
+                for (ByteBuffer old : retired)
+                    unmapNative(old);
+                retired = null;
+            }
+            int oldFD = this.fd;
             this.fd = -1;
             this.size = 0;
+            this.mapping = null;
             this.buffer = null;
+            closeNative(oldFD);
         }
     }
 
@@ -139,10 +305,21 @@ public final class ShmPool implements Closeable
         close();
     }
 
-    private static native int createTmpFileNative()
+    private static native int createAnonymousFileNative(int flags)
+            throws IOException;
+    private static native boolean sealShrinkNative(int fd)
+            throws IOException;
+    private static native boolean isShrinkSealedNative(int fd)
             throws IOException;
-    private static native ByteBuffer mapNative(int fd, long size, boolean dupFD,
-            boolean readOnly) throws IOException;
+    private static native int dupNative(int fd) throws IOException;
+    private static native ByteBuffer mapNative(int fd, long size,
+            boolean readOnly, int flags, long validSize) throws IOException;
+    private static native ByteBuffer remapNative(ByteBuffer mapping, long size,
+            int flags) throws IOException;
+    private static native boolean isSameMappingNative(ByteBuffer a,
+            ByteBuffer b);
+    private static native void adviseNative(ByteBuffer buffer, long offset,
+            long length, int advice) throws IOException;
     private static native void unmapNative(ByteBuffer buffer)
             throws IOException;
     private static native void truncateNative(int fd, long size)
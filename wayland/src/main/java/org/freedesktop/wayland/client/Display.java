@@ -51,6 +51,26 @@ public class Display extends wl_display.Proxy
     public native int flush();
     public native int roundtrip();
 
+    /**
+     * Announces the intention to read from the fd returned by getFD().
+     *
+     * To drive the display from another reactor: loop calling
+     * dispatchPending() until prepareRead() returns true, flush(), then
+     * wait for the fd.  If it polls readable call readEvents() followed by
+     * dispatchPending(); if the wait is abandoned instead, cancelRead()
+     * must be called.  Returns false if events are already queued, in
+     * which case no read was prepared.
+     */
+    public native boolean prepareRead();
+    public native boolean prepareReadQueue(EventQueue queue);
+    /**
+     * Reads events from the fd and queues them without dispatching.  Must
+     * only be called after a successful prepareRead() and once the fd has
+     * polled readable.
+     */
+    public native void readEvents();
+    public native void cancelRead();
+
     static {
         Native.loadLibrary("wayland-java-util");
         Native.loadLibrary("wayland-java-client");
@@ -0,0 +1,207 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.client;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.concurrent.ForkJoinPool;
+import java.util.concurrent.RecursiveAction;
+
+/**
+ * Paints a 32-bit image in parallel.
+ *
+ * The image is split into tiles, or into full-width row bands if no tile
+ * width is given, and a Painter is run for each tile on a fork/join pool.
+ * Each call gets its own ByteBuffer slice starting at the tile's first
+ * pixel.  Tile widths are rounded up to a multiple of 16 pixels so that
+ * neighbouring tiles never write to the same cache line as long as the
+ * image itself is 64-byte aligned, which shm buffers are.
+ *
+ * paint() returns only after every tile is done, so it is safe to attach
+ * and commit the buffer right after it.  An exception thrown by a Painter
+ * is rethrown from paint().
+ */
+public class ParallelPainter
+{
+    public static final int DEFAULT_BAND_HEIGHT = 32;
+
+    public interface Painter
+    {
+        /**
+         * Paints the width x height tile whose top-left pixel is (x, y) in
+         * the image.  That pixel is at index 0 of tile and each row is
+         * stride bytes after the previous one.  Called concurrently for
+         * different tiles.
+         */
+        public void paintTile(ByteBuffer tile, int x, int y, int width,
+                int height, int stride);
+    }
+
+    private final ForkJoinPool pool;
+    private final boolean ownsPool;
+    private final int tileWidth;
+    private final int tileHeight;
+
+    /**
+     * Creates a painter with its own pool, one thread per CPU, that paints
+     * in full-width row bands.
+     */
+    public ParallelPainter()
+    {
+        this(null, 0, DEFAULT_BAND_HEIGHT);
+    }
+
+    /**
+     * Creates a painter that runs on the given pool, or on a pool of its
+     * own if pool is null.  A tileWidth of 0 paints full-width row bands.
+     */
+    public ParallelPainter(ForkJoinPool pool, int tileWidth, int tileHeight)
+    {
+        if (tileWidth < 0 || tileHeight <= 0)
+            throw new IllegalArgumentException("Invalid tile size");
+
+        if (pool == null) {
+            this.pool = new ForkJoinPool();
+            this.ownsPool = true;
+        } else {
+            this.pool = pool;
+            this.ownsPool = false;
+        }
+
+        this.tileWidth = (tileWidth + 15) & ~15;
+        this.tileHeight = tileHeight;
+    }
+
+    public int getParallelism()
+    {
+        return pool.getParallelism();
+    }
+
+    private final class PaintTask extends RecursiveAction
+    {
+        private final ByteBuffer image;
+        private final int offset;
+        private final int stride;
+        private final int width;
+        private final int height;
+        private final int tileWidth;
+        private final int tilesPerRow;
+        private final Painter painter;
+        private final int first;
+        private final int last;
+
+        PaintTask(ByteBuffer image, int offset, int stride, int width,
+                int height, int tileWidth, Painter painter, int first,
+                int last)
+        {
+            this.image = image;
+            this.offset = offset;
+            this.stride = stride;
+            this.width = width;
+            this.height = height;
+            this.tileWidth = tileWidth;
+            this.tilesPerRow = (width + tileWidth - 1) / tileWidth;
+            this.painter = painter;
+            this.first = first;
+            this.last = last;
+        }
+
+        private void paintTile(int tile)
+        {
+            int x = (tile % tilesPerRow) * tileWidth;
+            int y = (tile / tilesPerRow) * tileHeight;
+            int w = Math.min(tileWidth, width - x);
+            int h = Math.min(tileHeight, height - y);
+            int start = offset + y * stride + x * 4;
+
+            ByteBuffer slice = image.duplicate();
+            slice.clear();
+            slice.limit(start + (h - 1) * stride + w * 4);
+            slice.position(start);
+
+            painter.paintTile(slice.slice().order(ByteOrder.nativeOrder()),
+                    x, y, w, h, stride);
+        }
+
+        @Override
+        protected void compute()
+        {
+            if (last - first == 1) {
+                paintTile(first);
+            } else {
+                /* Split in half so idle workers can steal the other half */
+                int mid = (first + last) >>> 1;
+                invokeAll(new PaintTask(image, offset, stride, width, height,
+                            tileWidth, painter, first, mid),
+                        new PaintTask(image, offset, stride, width, height,
+                            tileWidth, painter, mid, last));
+            }
+        }
+    }
+
+    /**
+     * Paints the width x height image whose top-left pixel is at offset
+     * bytes into image and whose rows are stride bytes apart.
+     */
+    public void paint(ByteBuffer image, int offset, int stride, int width,
+            int height, Painter painter)
+    {
+        if (image == null || painter == null)
+            throw new NullPointerException();
+        if (width < 0 || height < 0 || offset < 0 || stride < width * 4)
+            throw new IllegalArgumentException("Invalid image layout");
+        if (width == 0 || height == 0)
+            return;
+        if (offset + (long)(height - 1) * stride + width * 4L
+                > image.capacity())
+            throw new IndexOutOfBoundsException("Image outside of buffer");
+
+        int tw = (tileWidth == 0 || tileWidth > width) ? width : tileWidth;
+        int tiles = ((width + tw - 1) / tw)
+                * ((height + tileHeight - 1) / tileHeight);
+
+        PaintTask task = new PaintTask(image, offset, stride, width, height,
+                tw, painter, 0, tiles);
+
+        /* Not worth a trip through the pool */
+        if (tiles == 1)
+            task.compute();
+        else
+            pool.invoke(task);
+    }
+
+    public void paint(ShmBufferAllocator.Buffer buffer, Painter painter)
+    {
+        paint(buffer.getByteBuffer(), 0, buffer.getStride(),
+                buffer.getWidth(), buffer.getHeight(), painter);
+    }
+
+    /**
+     * Shuts the pool down if the painter created it.  A shared pool passed
+     * to the constructor is left alone.
+     */
+    public void destroy()
+    {
+        if (ownsPool)
+            pool.shutdown();
+    }
+}
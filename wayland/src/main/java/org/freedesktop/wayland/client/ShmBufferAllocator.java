@@ -0,0 +1,378 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.client;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.ArrayList;
+import java.util.TreeSet;
+
+import org.freedesktop.wayland.ShmPool;
+import org.freedesktop.wayland.protocol.wl_buffer;
+import org.freedesktop.wayland.protocol.wl_shm;
+import org.freedesktop.wayland.protocol.wl_shm_pool;
+import org.freedesktop.wayland.protocol.wl_surface;
+
+/**
+ * Carves wl_buffers out of a small number of large shared memory pools.
+ *
+ * Each pool is managed as a binary buddy heap with page-sized minimum
+ * blocks, so a buffer occupies the next power of two above its size.  The
+ * slack costs address space only; pages that are never written are never
+ * allocated.  Pools start at initialPoolSize and double, both locally and
+ * on the server, up to maxPoolSize before another pool is created.  A pool
+ * other than the first is destroyed once all of its buffers are freed.
+ *
+ * Buffers freed while the compositor still holds them are recycled when
+ * their wl_buffer.release arrives.  Like the rest of the client API, an
+ * allocator must only be used from the thread dispatching its events.
+ */
+public class ShmBufferAllocator
+{
+    public static final int DEFAULT_INITIAL_POOL_SIZE = 4 << 20;
+    public static final int DEFAULT_MAX_POOL_SIZE = 256 << 20;
+
+    private static final int MIN_ORDER = 12;
+
+    /* Told when the compositor releases a buffer that hasn't been freed */
+    public interface ReleaseListener
+    {
+        public void released(Buffer buffer);
+    }
+
+    public final class Buffer
+    {
+        private final Pool pool;
+        private final int offset;
+        private final int order;
+        private final int width;
+        private final int height;
+        private final int stride;
+        private final int format;
+        private final wl_buffer.Proxy proxy;
+        private final ByteBuffer data;
+        private boolean busy;
+        private boolean freed;
+        private ReleaseListener releaseListener;
+
+        private Buffer(Pool pool, int offset, int order, int width,
+                int height, int stride, int format)
+        {
+            this.pool = pool;
+            this.offset = offset;
+            this.order = order;
+            this.width = width;
+            this.height = height;
+            this.stride = stride;
+            this.format = format;
+
+            ByteBuffer view = pool.shm.asByteBuffer();
+            view.position(offset).limit(offset + stride * height);
+            this.data = view.slice().order(ByteOrder.nativeOrder());
+
+            proxy = pool.proxy.createBuffer(offset, width, height, stride,
+                    format);
+            proxy.addListener(new wl_buffer.Events() {
+                public void release(wl_buffer.Proxy p)
+                {
+                    busy = false;
+                    if (freed)
+                        recycle();
+                    else if (releaseListener != null)
+                        releaseListener.released(Buffer.this);
+                }
+            }, null);
+        }
+
+        public void setReleaseListener(ReleaseListener listener)
+        {
+            releaseListener = listener;
+        }
+
+        public wl_buffer.Proxy getProxy()
+        {
+            return proxy;
+        }
+
+        /**
+         * Returns the buffer's pixels.  The view stays valid as the pool
+         * grows but must not be used once the buffer is freed.
+         */
+        public ByteBuffer getByteBuffer()
+        {
+            return data.duplicate().order(ByteOrder.nativeOrder());
+        }
+
+        public int getWidth()
+        {
+            return width;
+        }
+
+        public int getHeight()
+        {
+            return height;
+        }
+
+        public int getStride()
+        {
+            return stride;
+        }
+
+        public int getFormat()
+        {
+            return format;
+        }
+
+        /**
+         * Returns whether the compositor may still be reading the buffer,
+         * that is whether it was attached and hasn't been released since.
+         */
+        public boolean isBusy()
+        {
+            return busy;
+        }
+
+        /**
+         * Attaches the buffer to a surface and marks it busy until the
+         * compositor releases it.
+         */
+        public void attach(wl_surface.Proxy surface, int x, int y)
+        {
+            if (freed)
+                throw new IllegalStateException("Buffer already freed");
+
+            surface.attach(proxy, x, y);
+            busy = true;
+        }
+
+        /**
+         * Returns the buffer to the allocator.  If it is still busy its
+         * memory is recycled once the compositor releases it.
+         */
+        public void free()
+        {
+            if (freed)
+                return;
+
+            freed = true;
+            if (!busy)
+                recycle();
+        }
+
+        private void recycle()
+        {
+            proxy.destroy();
+            if (pool.destroyed)
+                return;
+
+            pool.free(offset, order);
+            if (pool.isEmpty() && pool != pools.get(0)) {
+                pools.remove(pool);
+                pool.destroy();
+            }
+        }
+    }
+
+    private final class Pool
+    {
+        final ShmPool shm;
+        final wl_shm_pool.Proxy proxy;
+        /* freeBlocks.get(o) holds the offsets of free blocks of size 2^o */
+        final ArrayList<TreeSet<Integer>> freeBlocks;
+        int order;
+        int allocated;
+        boolean destroyed;
+
+        Pool(int order) throws IOException
+        {
+            this.order = order;
+            this.shm = new ShmPool(1L << order, maxPoolSize, 0);
+            this.proxy = shm_proxy.createPool(shm.getFileDescriptor(),
+                    1 << order);
+
+            freeBlocks = new ArrayList<TreeSet<Integer>>();
+            for (int o = 0; o <= order; ++o)
+                freeBlocks.add(new TreeSet<Integer>());
+            freeBlocks.get(order).add(0);
+        }
+
+        int allocate(int want)
+        {
+            int o = want;
+            while (o <= order && freeBlocks.get(o).isEmpty())
+                ++o;
+            if (o > order)
+                return -1;
+
+            /* Take the lowest block and split it down to size */
+            int offset = freeBlocks.get(o).pollFirst();
+            while (o > want) {
+                --o;
+                freeBlocks.get(o).add(offset + (1 << o));
+            }
+
+            allocated += 1 << want;
+            return offset;
+        }
+
+        void free(int offset, int o)
+        {
+            allocated -= 1 << o;
+            release(offset, o);
+        }
+
+        private void release(int offset, int o)
+        {
+            while (o < order) {
+                int buddy = offset ^ (1 << o);
+                if (!freeBlocks.get(o).remove(buddy))
+                    break;
+                offset = Math.min(offset, buddy);
+                ++o;
+            }
+            freeBlocks.get(o).add(offset);
+        }
+
+        /* Doubles the pool; the new upper half is the old root's buddy */
+        boolean grow() throws IOException
+        {
+            if ((1L << (order + 1)) > maxPoolSize)
+                return false;
+
+            shm.resize(1L << (order + 1));
+            proxy.resize(1 << (order + 1));
+
+            freeBlocks.add(new TreeSet<Integer>());
+            ++order;
+            release(1 << (order - 1), order - 1);
+            return true;
+        }
+
+        boolean isEmpty()
+        {
+            return allocated == 0;
+        }
+
+        void destroy()
+        {
+            destroyed = true;
+            proxy.destroy();
+            try {
+                shm.close();
+            } catch (IOException e) {
+                throw new RuntimeException(e);
+            }
+        }
+    }
+
+    private final wl_shm.Proxy shm_proxy;
+    private final int initialOrder;
+    private final long maxPoolSize;
+    private final ArrayList<Pool> pools;
+
+    public ShmBufferAllocator(wl_shm.Proxy shm)
+    {
+        this(shm, DEFAULT_INITIAL_POOL_SIZE, DEFAULT_MAX_POOL_SIZE);
+    }
+
+    /**
+     * Both sizes are rounded up to powers of two.  maxPoolSize is also the
+     * address space reserved for each pool, which lets pools grow without
+     * moving.
+     */
+    public ShmBufferAllocator(wl_shm.Proxy shm, int initialPoolSize,
+            int maxPoolSize)
+    {
+        if (shm == null)
+            throw new NullPointerException("shm not allowed to be null");
+        if (initialPoolSize <= 0 || maxPoolSize < initialPoolSize
+                || maxPoolSize > (1 << 30))
+            throw new IllegalArgumentException("Invalid pool sizes");
+
+        this.shm_proxy = shm;
+        this.initialOrder = orderFor(initialPoolSize);
+        this.maxPoolSize = 1L << orderFor(maxPoolSize);
+        this.pools = new ArrayList<Pool>();
+    }
+
+    private static int orderFor(long size)
+    {
+        int order = MIN_ORDER;
+        while ((1L << order) < size)
+            ++order;
+        return order;
+    }
+
+    public Buffer allocate(int width, int height, int stride, int format)
+            throws IOException
+    {
+        if (width <= 0 || height <= 0 || stride < width)
+            throw new IllegalArgumentException("Invalid buffer dimensions");
+
+        long size = (long)stride * height;
+        if (size > maxPoolSize)
+            throw new IllegalArgumentException("Buffer larger than maxPoolSize");
+
+        int want = orderFor(size);
+
+        for (Pool pool : pools) {
+            int offset;
+            while ((offset = pool.allocate(want)) < 0)
+                if (!pool.grow())
+                    break;
+            if (offset >= 0)
+                return new Buffer(pool, offset, want, width, height, stride,
+                        format);
+        }
+
+        Pool pool = new Pool(Math.max(initialOrder, want));
+        pools.add(pool);
+        return new Buffer(pool, pool.allocate(want), want, width, height,
+                stride, format);
+    }
+
+    /**
+     * Allocates a buffer with a tightly packed 32-bit format.
+     */
+    public Buffer allocate(int width, int height, int format)
+            throws IOException
+    {
+        return allocate(width, height, width * 4, format);
+    }
+
+    public int getPoolCount()
+    {
+        return pools.size();
+    }
+
+    /**
+     * Destroys all pools.  Buffers allocated from them must not be used
+     * afterwards.
+     */
+    public void destroy()
+    {
+        for (Pool pool : pools)
+            pool.destroy();
+        pools.clear();
+    }
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.client;
+
+import java.io.IOException;
+
+import org.freedesktop.wayland.protocol.wl_surface;
+
+/**
+ * Cycles a surface between two to four shm buffers.
+ *
+ * Buffers are allocated lazily, so a swapchain only grows to its full depth
+ * if the compositor holds on to buffers long enough to need it.  After
+ * acquire(), getBufferAge() tells how many frames old the buffer's
+ * contents are, in the sense of EGL_EXT_buffer_age: 1 means it holds the
+ * previous frame, 2 the one before that, and 0 that the contents are
+ * undefined and everything must be repainted.
+ */
+public class ShmSwapchain
+{
+    public static final int MIN_DEPTH = 2;
+    public static final int MAX_DEPTH = 4;
+
+    private final ShmBufferAllocator allocator;
+    private final ShmBufferAllocator.Buffer[] buffers;
+    /* The frame each buffer was last attached in, or 0 if never */
+    private final long[] lastFrame;
+    private final int format;
+    private ShmBufferAllocator.ReleaseListener releaseListener;
+    private int width;
+    private int height;
+    private long frame;
+    private int current;
+
+    public ShmSwapchain(ShmBufferAllocator allocator, int depth, int width,
+            int height, int format)
+    {
+        if (allocator == null)
+            throw new NullPointerException("allocator not allowed to be null");
+        if (depth < MIN_DEPTH || depth > MAX_DEPTH)
+            throw new IllegalArgumentException("depth must be 2 to 4");
+
+        this.allocator = allocator;
+        this.buffers = new ShmBufferAllocator.Buffer[depth];
+        this.lastFrame = new long[depth];
+        this.format = format;
+        this.width = width;
+        this.height = height;
+        this.current = -1;
+    }
+
+    public int getWidth()
+    {
+        return width;
+    }
+
+    public int getHeight()
+    {
+        return height;
+    }
+
+    public int getDepth()
+    {
+        return buffers.length;
+    }
+
+    /**
+     * Returns a buffer the compositor is not using, preferring the one with
+     * the most recent contents, or null if every buffer is busy.
+     */
+    public ShmBufferAllocator.Buffer acquire() throws IOException
+    {
+        int best = -1;
+        int empty = -1;
+        for (int i = 0; i < buffers.length; ++i) {
+            if (buffers[i] == null) {
+                if (empty < 0)
+                    empty = i;
+            } else if (!buffers[i].isBusy()) {
+                if (best < 0 || lastFrame[i] > lastFrame[best])
+                    best = i;
+            }
+        }
+
+        /* Only grow the chain if every existing buffer is busy */
+        if (best < 0 && empty >= 0) {
+            buffers[empty] = allocator.allocate(width, height, format);
+            buffers[empty].setReleaseListener(releaseListener);
+            lastFrame[empty] = 0;
+            best = empty;
+        }
+
+        current = best;
+        return best < 0 ? null : buffers[best];
+    }
+
+    /**
+     * Sets a listener told whenever the compositor releases one of the
+     * chain's buffers.  A client that got null from acquire() can wait for
+     * it instead of polling with round trips.
+     */
+    public void setReleaseListener(ShmBufferAllocator.ReleaseListener listener)
+    {
+        releaseListener = listener;
+        for (ShmBufferAllocator.Buffer buffer : buffers)
+            if (buffer != null)
+                buffer.setReleaseListener(listener);
+    }
+
+    /**
+     * Returns the age of the buffer returned by the last acquire().
+     */
+    public int getBufferAge()
+    {
+        if (current < 0)
+            throw new IllegalStateException("No buffer acquired");
+
+        if (lastFrame[current] == 0)
+            return 0;
+        return (int)(frame - lastFrame[current]) + 1;
+    }
+
+    /**
+     * Attaches the acquired buffer to the surface.  The caller is still
+     * responsible for damage and commit.
+     */
+    public void attach(wl_surface.Proxy surface, int x, int y)
+    {
+        if (current < 0)
+            throw new IllegalStateException("No buffer acquired");
+
+        buffers[current].attach(surface, x, y);
+        lastFrame[current] = ++frame;
+        current = -1;
+    }
+
+    /**
+     * Changes the size of future buffers.  Existing buffers are freed, or
+     * recycled once released if the compositor still holds them.
+     */
+    public void resize(int width, int height)
+    {
+        if (width == this.width && height == this.height)
+            return;
+
+        this.width = width;
+        this.height = height;
+        freeBuffers();
+    }
+
+    public void destroy()
+    {
+        freeBuffers();
+    }
+
+    private void freeBuffers()
+    {
+        for (int i = 0; i < buffers.length; ++i) {
+            if (buffers[i] != null) {
+                buffers[i].free();
+                buffers[i] = null;
+            }
+            lastFrame[i] = 0;
+        }
+        current = -1;
+    }
+}
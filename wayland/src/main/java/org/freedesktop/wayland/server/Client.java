@@ -23,6 +23,11 @@ package org.freedesktop.wayland.server;
 
 import java.io.File;
 import java.lang.reflect.Constructor;
+import java.util.concurrent.Executor;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.RejectedExecutionException;
+import java.util.concurrent.ThreadFactory;
 
 import org.freedesktop.wayland.arch.Native;
 import org.freedesktop.wayland.Interface;
@@ -34,11 +39,20 @@ public class Client extends NativeObjectWrapper
         setNative(client_ptr);
     }
 
+    /**
+     * Creates a client on one end of a connected socket.  The client owns
+     * fd from then on; it is closed even if creating the client fails.
+     */
     public Client(Display display, int fd)
     {
         create(display, fd);
     }
 
+    /**
+     * Starts the executable as a client of the display, passing it one end
+     * of a socket pair through WAYLAND_SOCKET.  The process is created with
+     * posix_spawn, so the JVM is never forked.
+     */
     public static native Client startClient(Display display, File executable,
             String[] args, boolean clearEnvironment);
 
@@ -48,6 +62,88 @@ public class Client extends NativeObjectWrapper
         return startClient(display, executable, args, false);
     }
 
+    /**
+     * Like startClient(), but only creates the Client on the calling
+     * thread and leaves starting the process to the executor.  If the
+     * process cannot be started, the client sees its socket close and the
+     * error goes to the display's UncaughtCallbackHandler.
+     */
+    public static Client startClientAsync(final Display display,
+            File executable, String[] args, final boolean clearEnvironment,
+            Executor executor)
+    {
+        final String path = executable.getPath();
+        final String[] arguments = args.clone();
+        final EventLoop loop = display.getEventLoop();
+
+        final int[] fds = new int[2];
+        createSocketPair(fds);
+
+        /* The client closes fds[0] itself if it can't be created */
+        final Client client;
+        boolean created = false;
+        try {
+            client = new Client(display, fds[0]);
+            created = true;
+        } finally {
+            if (!created)
+                closeNative(fds[1]);
+        }
+
+        Runnable spawn = new Runnable() {
+            public void run()
+            {
+                try {
+                    spawnNative(path, arguments, clearEnvironment, fds[1]);
+                } catch (final Exception e) {
+                    loop.post(new Runnable() {
+                        public void run()
+                        {
+                            display.reportUncaughtException(client, e);
+                        }
+                    });
+                }
+            }
+        };
+
+        try {
+            executor.execute(spawn);
+        } catch (RejectedExecutionException e) {
+            spawn.run();
+        }
+
+        return client;
+    }
+
+    public static Client startClientAsync(Display display, File executable,
+            String[] args)
+    {
+        return startClientAsync(display, executable, args, false,
+                getLauncher());
+    }
+
+    private static ExecutorService launcher;
+
+    private static synchronized ExecutorService getLauncher()
+    {
+        if (launcher == null) {
+            launcher = Executors.newCachedThreadPool(new ThreadFactory() {
+                public Thread newThread(Runnable runnable)
+                {
+                    Thread thread = new Thread(runnable, "wayland-launcher");
+                    thread.setDaemon(true);
+                    return thread;
+                }
+            });
+        }
+        return launcher;
+    }
+
+    static native void createSocketPair(int[] fds);
+    private static native void spawnNative(String path, String[] args,
+            boolean clearEnvironment, int fd);
+    private static native void closeNative(int fd);
+
     private native void setNative(long client_ptr);
     private native void create(Display display, int fd);
 
@@ -56,6 +152,19 @@ public class Client extends NativeObjectWrapper
     public native Display getDisplay();
     public native void destroy();
 
+    /**
+     * Returns a snapshot of the requests, events and resources this client
+     * has generated so far.
+     */
+    public native ClientStatistics getStatistics();
+
+    /**
+     * Returns the estimated number of bytes queued for this client as of
+     * the last Display.flushClients().
+     */
+    public native long getOutgoingBytes();
+    public native boolean isCongested();
+
     @Override
     protected void finalize() throws Throwable
     {
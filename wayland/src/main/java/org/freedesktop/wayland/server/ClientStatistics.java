@@ -0,0 +1,169 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.util.Collections;
+import java.util.HashMap;
+import java.util.HashSet;
+import java.util.Map;
+import java.util.Set;
+
+/**
+ * A snapshot of the traffic a client, or all clients of a display, have
+ * generated.  Only requests handled in Java and events posted from Java
+ * are counted; objects implemented inside libwayland, such as wl_shm
+ * pools, are not.
+ */
+public final class ClientStatistics
+{
+    private final long[] totals;
+    private final Map<String, long[]> requests;
+    private final Map<String, long[]> events;
+
+    /* Called from native code */
+    private ClientStatistics(long[] totals, String[] interfaces,
+            long[][] requests, long[][] events)
+    {
+        this.totals = totals;
+        this.requests = new HashMap<String, long[]>();
+        this.events = new HashMap<String, long[]>();
+
+        for (int i = 0; i < interfaces.length; ++i) {
+            merge(this.requests, interfaces[i], requests[i]);
+            merge(this.events, interfaces[i], events[i]);
+        }
+    }
+
+    /*
+     * Interfaces are tracked natively by identity, so the Java and
+     * libwayland definitions of one interface are combined here.
+     */
+    private static void merge(Map<String, long[]> map, String name,
+            long[] counts)
+    {
+        long[] existing = map.get(name);
+        if (existing == null) {
+            map.put(name, counts);
+            return;
+        }
+
+        if (existing.length < counts.length) {
+            long[] tmp = counts;
+            counts = existing;
+            existing = tmp;
+            map.put(name, existing);
+        }
+        for (int i = 0; i < counts.length; ++i)
+            existing[i] += counts[i];
+    }
+
+    public long getRequestCount()
+    {
+        return totals[0];
+    }
+
+    public long getEventCount()
+    {
+        return totals[1];
+    }
+
+    /** Bytes of event data queued for sending, not counting fds */
+    public long getBytesQueued()
+    {
+        return totals[2];
+    }
+
+    /** Number of live protocol objects, including native ones */
+    public long getResourceCount()
+    {
+        return totals[3];
+    }
+
+    /** Bytes of shared memory backing the client's live wl_shm buffers */
+    public long getShmBytes()
+    {
+        return totals[4];
+    }
+
+    /** Time spent in Java request implementations */
+    public long getHandlerNanos()
+    {
+        return totals[5];
+    }
+
+    /** Events coalesced or dropped while the client was congested */
+    public long getCoalescedEventCount()
+    {
+        return totals[6];
+    }
+
+    /** Requests held back because the client was over its request budget */
+    public long getDeferredRequestCount()
+    {
+        return totals[7];
+    }
+
+    /** Names of the interfaces that have seen any traffic */
+    public Set<String> getInterfaces()
+    {
+        Set<String> names = new HashSet<String>(requests.keySet());
+        names.addAll(events.keySet());
+        return Collections.unmodifiableSet(names);
+    }
+
+    public long getRequestCount(String iface, int opcode)
+    {
+        return count(requests, iface, opcode);
+    }
+
+    public long getEventCount(String iface, int opcode)
+    {
+        return count(events, iface, opcode);
+    }
+
+    public long getRequestCount(String iface)
+    {
+        return count(requests, iface, -1);
+    }
+
+    public long getEventCount(String iface)
+    {
+        return count(events, iface, -1);
+    }
+
+    /* An opcode of -1 sums over all of them */
+    private static long count(Map<String, long[]> map, String iface,
+            int opcode)
+    {
+        long[] counts = map.get(iface);
+        if (counts == null)
+            return 0;
+
+        if (opcode >= 0)
+            return opcode < counts.length ? counts[opcode] : 0;
+
+        long sum = 0;
+        for (long count : counts)
+            sum += count;
+        return sum;
+    }
+}
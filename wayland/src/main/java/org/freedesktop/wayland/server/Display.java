@@ -22,6 +22,7 @@
 package org.freedesktop.wayland.server;
 
 import java.io.File;
+import java.util.concurrent.atomic.AtomicLong;
 
 import org.freedesktop.wayland.arch.Native;
 import org.freedesktop.wayland.Interface;
@@ -30,6 +31,10 @@ public class Display
 {
     private long display_ptr;
 
+    private volatile UncaughtCallbackHandler uncaughtCallbackHandler;
+    private volatile boolean running;
+    private final AtomicLong callbackFailureCount = new AtomicLong();
+
     public Display()
     {
         create();
@@ -37,13 +42,119 @@ public class Display
 
     public native EventLoop getEventLoop();
     public native int addSocket(String name);
-    public native void terminate();
-    public native void run();
+
+    /**
+     * Creates the wl_shm global.  Client buffers from it can then be read
+     * through ShmBuffer.
+     */
+    public native void initShm();
+    /* ARGB8888 and XRGB8888 are always supported */
+    public native void addShmFormat(int format);
+
+    public void terminate()
+    {
+        running = false;
+        terminateNative();
+    }
+
+    /**
+     * Runs the event loop until terminate() is called, flushing clients
+     * through flushClients() before each iteration.
+     */
+    public void run()
+    {
+        final EventLoop loop = getEventLoop();
+
+        running = true;
+        while (running) {
+            flushClients();
+            loop.dispatch(-1);
+        }
+    }
+
+    /**
+     * Flushes all clients.  If outgoing limits are set, the queues of
+     * clients that were sent events since the last flush are re-measured
+     * and clients are moved in or out of the congested state.
+     */
     public native void flushClients();
 
+    /**
+     * Sets limits on how much may be queued for a client, in bytes, where
+     * zero disables a limit.  Above highWaterBytes a client is congested:
+     * its replaceable events are coalesced and its frame callbacks held
+     * back until it catches up.  Above disconnectBytes it is disconnected.
+     * Queue depths are measured in flushClients(), which run() calls
+     * before each iteration; a display driven some other way must call
+     * it as well.
+     */
+    public native void setOutgoingLimits(long highWaterBytes,
+            long disconnectBytes);
+
+    /**
+     * Marks an event as replaceable for congested clients: only the newest
+     * one per resource is sent once the client catches up.  If keyArgument
+     * is not -1, events are kept per value of that argument instead.
+     * wl_pointer.motion and wl_touch.motion, the latter keyed on the touch
+     * id, are replaceable by default.
+     */
+    public native void addReplaceableEvent(String iface, int opcode,
+            int keyArgument);
+
+    /**
+     * Limits how many requests of one client are handled per event loop
+     * iteration, where zero means no limit.  The rest are queued and
+     * handled in later iterations, after other clients have had their
+     * turn.  Requests creating objects, and requests to objects
+     * implemented by libwayland itself, are never held back; they run the
+     * queue first to keep the order.
+     */
+    public native void setRequestBudget(int requestsPerIteration);
+
     public native int getSerial();
     public native int nextSerial();
 
+    /**
+     * Returns the combined statistics of all clients, including those that
+     * have disconnected.  Resource and shm usage only cover live clients.
+     */
+    public native ClientStatistics getClientStatistics();
+
+    /**
+     * Sets the handler for exceptions thrown by global binds, request
+     * implementations and destroy listeners of this display.  Requests that
+     * throw RequestError are turned into protocol errors and are not
+     * reported here.
+     */
+    public void setUncaughtCallbackHandler(UncaughtCallbackHandler handler)
+    {
+        this.uncaughtCallbackHandler = handler;
+    }
+
+    public UncaughtCallbackHandler getUncaughtCallbackHandler()
+    {
+        return uncaughtCallbackHandler;
+    }
+
+    public long getCallbackFailureCount()
+    {
+        return callbackFailureCount.get();
+    }
+
+    /* Called from native code once the exception has been cleared */
+    void reportUncaughtException(Object source, Throwable t)
+    {
+        callbackFailureCount.incrementAndGet();
+
+        UncaughtCallbackHandler handler = uncaughtCallbackHandler;
+        if (handler != null)
+            handler.uncaughtCallbackException(source, t);
+        else
+            EventLoop.reportToDefaultHandler(t);
+    }
+
+    private native void terminateNative();
+
     private native void create();
     public native void destroy();
 
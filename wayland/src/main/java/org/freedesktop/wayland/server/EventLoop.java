@@ -21,6 +21,15 @@
  */
 package org.freedesktop.wayland.server;
 
+import java.nio.ByteBuffer;
+import java.util.Collection;
+import java.util.Iterator;
+import java.util.LinkedHashMap;
+import java.util.Map;
+import java.util.concurrent.ConcurrentLinkedQueue;
+import java.util.concurrent.atomic.AtomicBoolean;
+import java.util.concurrent.atomic.AtomicLong;
+
 import org.freedesktop.wayland.arch.Native;
 
 public class EventLoop extends NativeObjectWrapper
@@ -29,17 +38,28 @@ public class EventLoop extends NativeObjectWrapper
     public static final int EVENT_WRITABLE = 0x02;
     public static final int EVENT_HANGUP   = 0x04;
     public static final int EVENT_ERROR    = 0x08;
+    /* Buffered readers only: more descriptors arrived than could be kept */
+    public static final int EVENT_FDS_TRUNCATED = 0x10;
     
     public static class EventSource
     {
         private long source_ptr;
         private long handler_ptr;
+        private volatile long failureCount;
         
         private EventSource(long source_ptr, long handler_ptr)
         {
             this.source_ptr = source_ptr;
             this.handler_ptr = handler_ptr;
         }
+
+        /**
+         * Returns the number of times this source's handler has thrown.
+         */
+        public long getFailureCount()
+        {
+            return failureCount;
+        }
     }
 
     public interface FileDescriptorEventHandler
@@ -47,6 +67,26 @@ public class EventLoop extends NativeObjectWrapper
         public abstract int handleFileDescriptorEvent(int fd, int mask);
     }
 
+    public interface BufferedReadHandler
+    {
+        /**
+         * Called once per wakeup after the file descriptor has been read
+         * until it would block or the buffer is full.
+         *
+         * The data occupies bytes 0 through length - 1 of buffer.  The mask
+         * has EVENT_HANGUP set if end-of-file was reached and fds holds any
+         * file descriptors received with the data, or is null.  If some
+         * descriptors were dropped because too many came with one read,
+         * EVENT_FDS_TRUNCATED is set.  The handler may remove its source.  The return
+         * value is the number of bytes at the end of the data that were not
+         * consumed; they are moved to the start of the buffer and the next
+         * read is appended to them.  It must be less than the capacity of
+         * the buffer.
+         */
+        public abstract int handleRead(int fd, int mask, ByteBuffer buffer,
+                int length, int[] fds);
+    }
+
     public interface TimerEventHandler
     {
         public abstract int handleTimerEvent();
@@ -62,6 +102,23 @@ public class EventLoop extends NativeObjectWrapper
         public abstract void handleIdle();
     }
 
+    /* Cleared by native code under postLock when the loop is destroyed */
+    private volatile long post_source_ptr;
+    private final Object postLock = new Object();
+    private final ConcurrentLinkedQueue<Runnable> postedTasks =
+            new ConcurrentLinkedQueue<Runnable>();
+    private final AtomicBoolean wakeupPending = new AtomicBoolean(false);
+
+    private LinkedHashMap<Object, Runnable> deferredTasks =
+            new LinkedHashMap<Object, Runnable>();
+    private LinkedHashMap<Object, Runnable> runningDeferredTasks =
+            new LinkedHashMap<Object, Runnable>();
+    private boolean deferredScheduled;
+    private boolean dispatchingDeferred;
+
+    private volatile UncaughtCallbackHandler uncaughtCallbackHandler;
+    private final AtomicLong callbackFailureCount = new AtomicLong();
+
     EventLoop(long native_ptr)
     {
         _create(native_ptr);
@@ -75,6 +132,15 @@ public class EventLoop extends NativeObjectWrapper
     public native EventSource addFileDescriptor(int fd, int mask,
             FileDescriptorEventHandler handler);
     public native int updateFileDescriptor(EventSource source, int mask);
+    /**
+     * Adds a readable source that reads fd into the given direct buffer
+     * natively, so the handler gets the data without any further system
+     * calls.  Sockets are read with recvmsg and any file descriptors passed
+     * over them are handed to the handler as well.  The file descriptor is
+     * switched to non-blocking mode.
+     */
+    public native EventSource addBufferedReader(int fd, ByteBuffer buffer,
+            BufferedReadHandler handler);
     public native EventSource addTimer(TimerEventHandler handler);
     public native int updateTimer(EventSource source, int milliseconds);
     public native EventSource addSignal(int signalNumber, SignalEventHandler handler);
@@ -82,9 +148,239 @@ public class EventLoop extends NativeObjectWrapper
     public native int remove(EventSource source);
     public native void check(EventSource source);
 
+    /**
+     * Sets the handler for exceptions thrown by callbacks dispatched from
+     * this loop.  With no handler set they go to the dispatching
+     * thread's uncaught exception handler.
+     */
+    public void setUncaughtCallbackHandler(UncaughtCallbackHandler handler)
+    {
+        this.uncaughtCallbackHandler = handler;
+    }
+
+    public UncaughtCallbackHandler getUncaughtCallbackHandler()
+    {
+        return uncaughtCallbackHandler;
+    }
+
+    /**
+     * Returns the number of callback exceptions this loop has reported.
+     */
+    public long getCallbackFailureCount()
+    {
+        return callbackFailureCount.get();
+    }
+
+    /* Also called from native code once the exception has been cleared */
+    void reportUncaughtException(Object source, Throwable t)
+    {
+        callbackFailureCount.incrementAndGet();
+        if (source instanceof EventSource)
+            ++((EventSource)source).failureCount;
+
+        UncaughtCallbackHandler handler = uncaughtCallbackHandler;
+        if (handler != null)
+            handler.uncaughtCallbackException(source, t);
+        else
+            reportToDefaultHandler(t);
+    }
+
+    static void reportToDefaultHandler(Throwable t)
+    {
+        Thread thread = Thread.currentThread();
+        Thread.UncaughtExceptionHandler handler =
+                thread.getUncaughtExceptionHandler();
+        if (handler != null)
+            handler.uncaughtException(thread, t);
+        else
+            t.printStackTrace();
+    }
+
+    /**
+     * Queues a task to be run on the thread dispatching this event loop.
+     *
+     * This method may be called from any thread.  Tasks are run in the order
+     * they were posted and all tasks queued before a wakeup are run by a
+     * single dispatch of the loop.
+     */
+    public void post(Runnable task)
+    {
+        if (task == null)
+            throw new NullPointerException("task not allowed to be null");
+
+        postedTasks.add(task);
+        wakeup();
+    }
+
+    /**
+     * Queues several tasks at once, waking the event loop at most once.
+     *
+     * @see #post(Runnable)
+     */
+    public void postBatch(Collection<? extends Runnable> tasks)
+    {
+        for (Runnable task : tasks)
+            if (task == null)
+                throw new NullPointerException("tasks not allowed to contain null");
+
+        if (postedTasks.addAll(tasks))
+            wakeup();
+    }
+
+    private void wakeup()
+    {
+        /* Only the first producer since the last drain touches the eventfd */
+        if (wakeupPending.compareAndSet(false, true)) {
+            /* Keeps the loop from closing the eventfd under the write */
+            synchronized (postLock) {
+                wakeupNative(post_source_ptr);
+            }
+        }
+    }
+
+    /* Called from native code on the event loop thread */
+    private void dispatchPostedTasks()
+    {
+        wakeupPending.set(false);
+
+        try {
+            Runnable task;
+            while ((task = postedTasks.poll()) != null) {
+                try {
+                    task.run();
+                } catch (RuntimeException e) {
+                    reportUncaughtException(null, e);
+                }
+            }
+        } finally {
+            /* If a task threw an Error, make sure the rest still get run */
+            if (!postedTasks.isEmpty())
+                wakeup();
+        }
+    }
+
+    private static native void wakeupNative(long post_source_ptr);
+
+    /**
+     * Defers a task to the next iteration of the loop, coalescing it with
+     * any other pending task deferred under an equal key.
+     *
+     * Deferring a key that is already pending replaces its task but keeps
+     * its place in the queue, so it still runs only once.  All pending
+     * tasks run in order as one batch per loop iteration, from an idle
+     * source, so never in the middle of the iteration's other events;
+     * tasks deferred while that happens, including ones deferring
+     * themselves again, are run by the next iteration.  Unlike post(),
+     * this must only be called from the thread dispatching the loop.
+     */
+    public void defer(Object key, Runnable task)
+    {
+        if (key == null)
+            throw new NullPointerException("key not allowed to be null");
+        if (task == null)
+            throw new NullPointerException("task not allowed to be null");
+
+        deferredTasks.put(key, task);
+
+        /* A running batch hands what it defers on to the next dispatch */
+        if (!deferredScheduled && !dispatchingDeferred) {
+            scheduleDeferredNative(post_source_ptr, false);
+            deferredScheduled = true;
+        }
+    }
+
+    /**
+     * Defers a task keyed on itself.
+     *
+     * @see #defer(Object, Runnable)
+     */
+    public void defer(Runnable task)
+    {
+        defer(task, task);
+    }
+
+    /**
+     * Removes the pending task deferred under the given key, if any.
+     */
+    public boolean cancelDeferred(Object key)
+    {
+        return deferredTasks.remove(key) != null;
+    }
+
+    /* Called from native code by the loop's deferred idle source */
+    private void dispatchDeferred()
+    {
+        if (!deferredScheduled)
+            return;
+
+        LinkedHashMap<Object, Runnable> batch = deferredTasks;
+        deferredTasks = runningDeferredTasks;
+        runningDeferredTasks = batch;
+        deferredScheduled = false;
+        dispatchingDeferred = true;
+
+        try {
+            Iterator<Map.Entry<Object, Runnable>> it =
+                    batch.entrySet().iterator();
+            while (it.hasNext()) {
+                Map.Entry<Object, Runnable> entry = it.next();
+                Object key = entry.getKey();
+                Runnable task = entry.getValue();
+                it.remove();
+
+                try {
+                    task.run();
+                } catch (RuntimeException e) {
+                    reportUncaughtException(key, e);
+                }
+            }
+        } finally {
+            dispatchingDeferred = false;
+
+            /*
+             * If a task threw an Error, the rest of the batch runs next
+             * time, ahead of anything deferred since.
+             */
+            if (!batch.isEmpty()) {
+                batch.putAll(deferredTasks);
+                deferredTasks.clear();
+                runningDeferredTasks = deferredTasks;
+                deferredTasks = batch;
+            }
+
+            if (!deferredTasks.isEmpty()) {
+                scheduleDeferredNative(post_source_ptr, true);
+                deferredScheduled = true;
+            }
+        }
+    }
+
+    private static native void scheduleDeferredNative(long post_source_ptr,
+            boolean nextDispatch);
+
     public native int dispatch(int timeout);
     public native void dispatchIdle();
 
+    /**
+     * Returns the epoll file descriptor backing this loop.  It becomes
+     * readable whenever one of the loop's sources has work to do, so it can
+     * be registered with another reactor in place of a thread blocked in
+     * dispatch().  The descriptor is owned by the loop and must not be
+     * closed or read from.
+     */
+    public native int getFd();
+
+    /**
+     * Dispatches whatever is ready without blocking; call this when the fd
+     * returned by getFd() polls readable.  Idle sources are not reflected
+     * in the fd, so callers embedding a server Display should also run
+     * dispatchIdle() and Display.flushClients() before going back to sleep.
+     */
+    public int dispatchReady()
+    {
+        return dispatch(0);
+    }
+
     private native void _create(long native_ptr);
     private native void _destroy();
 
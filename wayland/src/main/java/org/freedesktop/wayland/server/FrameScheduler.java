@@ -0,0 +1,191 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import org.freedesktop.wayland.arch.Native;
+
+/**
+ * Batches wl_surface.frame callbacks for one output.
+ *
+ * Callbacks added here are wl_callback objects created in native code; no
+ * Resource is allocated for them.  On every refresh of the output all
+ * pending callbacks are sent their done event and destroyed in a single
+ * call.  With a refresh rate the ticks are driven from the event loop and
+ * only scheduled while callbacks are pending; with a rate of zero the
+ * compositor calls tick() itself, typically after presenting a frame.
+ * Callbacks of congested clients wait for a later refresh.  A
+ * FrameScheduler must only be used from the thread that dispatches its
+ * event loop.
+ */
+public class FrameScheduler
+{
+    /**
+     * Frame pacing statistics for one client.  Averages are exponential
+     * moving averages over recent frames.
+     */
+    public static final class ClientTiming
+    {
+        /** Number of frame callbacks completed for the client */
+        public final long frames;
+        /** Monotonic time of the last completed callback */
+        public final long lastFrameNanos;
+        /** Average time between completed callbacks */
+        public final long averageIntervalNanos;
+        /** Average time from a callback being requested to it completing */
+        public final long averageLatencyNanos;
+        /** Number of callbacks currently waiting for a refresh */
+        public final int pending;
+
+        private ClientTiming(long[] timing)
+        {
+            this.frames = timing[0];
+            this.lastFrameNanos = timing[1];
+            this.averageIntervalNanos = timing[2];
+            this.averageLatencyNanos = timing[3];
+            this.pending = (int)timing[4];
+        }
+    }
+
+    private long scheduler_ptr;
+    private int refreshMilliHz;
+
+    /**
+     * Creates a scheduler for an output refreshing at the given rate, in
+     * mHz as in wl_output.mode.  A rate of zero means ticks are manual.
+     */
+    public FrameScheduler(EventLoop loop, int refreshMilliHz)
+    {
+        if (loop == null)
+            throw new NullPointerException("loop not allowed to be null");
+        if (refreshMilliHz < 0)
+            throw new IllegalArgumentException("negative refresh rate");
+
+        this.refreshMilliHz = refreshMilliHz;
+        this.scheduler_ptr = createNative(loop, periodNanos(refreshMilliHz));
+    }
+
+    public FrameScheduler(EventLoop loop)
+    {
+        this(loop, 0);
+    }
+
+    private static long periodNanos(int refreshMilliHz)
+    {
+        return refreshMilliHz == 0 ? 0 : 1000000000000L / refreshMilliHz;
+    }
+
+    public int getRefreshRate()
+    {
+        return refreshMilliHz;
+    }
+
+    /**
+     * Changes the refresh rate.  If phaseNanos is positive it is a
+     * monotonic timestamp of a refresh, such as the last vblank, and later
+     * ticks are aligned to it.
+     */
+    public void setRefreshRate(int refreshMilliHz, long phaseNanos)
+    {
+        if (refreshMilliHz < 0)
+            throw new IllegalArgumentException("negative refresh rate");
+
+        setPeriodNative(checkValid(), periodNanos(refreshMilliHz), phaseNanos);
+        this.refreshMilliHz = refreshMilliHz;
+    }
+
+    public void setRefreshRate(int refreshMilliHz)
+    {
+        setRefreshRate(refreshMilliHz, 0);
+    }
+
+    /**
+     * Creates the wl_callback with the given id, as passed to
+     * wl_surface.frame, and queues it for the next refresh.
+     */
+    public void addFrameCallback(Client client, int id)
+    {
+        addCallbackNative(checkValid(), client, id);
+    }
+
+    /**
+     * Completes every pending callback now and returns how many there were.
+     */
+    public int tick()
+    {
+        return tickNative(checkValid());
+    }
+
+    public int getPendingCount()
+    {
+        return getPendingCountNative(checkValid());
+    }
+
+    /**
+     * Returns the frame statistics for the client, or null if it has never
+     * requested a frame callback from this scheduler.
+     */
+    public ClientTiming getClientTiming(Client client)
+    {
+        long[] timing = new long[5];
+        if (! getClientTimingNative(checkValid(), client, timing))
+            return null;
+        return new ClientTiming(timing);
+    }
+
+    /**
+     * Destroys the scheduler, completing any callbacks still pending.
+     */
+    public void destroy()
+    {
+        if (scheduler_ptr == 0)
+            return;
+
+        destroyNative(scheduler_ptr);
+        scheduler_ptr = 0;
+    }
+
+    private long checkValid()
+    {
+        if (scheduler_ptr == 0)
+            throw new IllegalStateException("FrameScheduler destroyed");
+        return scheduler_ptr;
+    }
+
+    private native long createNative(EventLoop loop, long periodNanos);
+    private native void destroyNative(long scheduler_ptr);
+    private static native void addCallbackNative(long scheduler_ptr,
+            Client client, int id);
+    private static native int tickNative(long scheduler_ptr);
+    private static native void setPeriodNative(long scheduler_ptr,
+            long periodNanos, long phaseNanos);
+    private static native int getPendingCountNative(long scheduler_ptr);
+    private static native boolean getClientTimingNative(long scheduler_ptr,
+            Client client, long[] timing);
+
+    private static native void initializeJNI();
+
+    static {
+        Native.loadLibrary("wayland-java-util");
+        Native.loadLibrary("wayland-java-server");
+        initializeJNI();
+    }
+}
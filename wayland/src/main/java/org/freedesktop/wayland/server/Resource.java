@@ -21,6 +21,8 @@
  */
 package org.freedesktop.wayland.server;
 
+import java.util.Collection;
+
 import org.freedesktop.wayland.arch.Native;
 import org.freedesktop.wayland.Interface;
 
@@ -45,6 +47,17 @@ public class Resource
         this(client, iface, version, 0);
     }
 
+    /*
+     * Wraps a resource implemented natively, such as a wl_shm buffer,
+     * when it is passed to Java as a request argument.
+     */
+    private
+    Resource(long resource_ptr)
+    {
+        this.resource_ptr = resource_ptr;
+        this.data = null;
+    }
+
     public void
     setImplementation(Object data)
     {
@@ -75,8 +88,41 @@ public class Resource
     public native void destroy();
 
     public native void postEvent(int opcode, Object...args);
+
+    /*
+     * Allocation-free variants of postEvent for events whose arguments are
+     * all int, uint, fixed or fd.  Fixed arguments are passed raw.  These
+     * are what the generated event methods call where they can.
+     */
+    protected final native void postEvent0(int opcode);
+    protected final native void postEvent1(int opcode, int arg0);
+    protected final native void postEvent2(int opcode, int arg0, int arg1);
+    protected final native void postEvent3(int opcode, int arg0, int arg1,
+            int arg2);
+    protected final native void postEvent4(int opcode, int arg0, int arg1,
+            int arg2, int arg3);
+    protected final native void postEvent5(int opcode, int arg0, int arg1,
+            int arg2, int arg3, int arg4);
+    protected final native void postEvent6(int opcode, int arg0, int arg1,
+            int arg2, int arg3, int arg4, int arg5);
     public native void postError(int code, String msg);
 
+    /**
+     * Posts the same event to every target in one native call, converting
+     * the arguments only once.  The targets must all be of the same
+     * interface; those bound at a version older than the event are
+     * skipped.  Events with a new_id argument cannot be broadcast, and
+     * object arguments must belong to the same client as every target.
+     */
+    public static native void broadcast(Resource[] targets, int opcode,
+            Object...args);
+
+    public static void broadcast(Collection<? extends Resource> targets,
+            int opcode, Object...args)
+    {
+        broadcast(targets.toArray(new Resource[targets.size()]), opcode, args);
+    }
+
     private static native void initializeJNI();
 
     @Override
@@ -0,0 +1,124 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+import org.freedesktop.wayland.arch.Native;
+
+/**
+ * Gives a compositor access to the pixels of a client's wl_shm buffer.
+ *
+ * The pixels are read straight out of libwayland's own mapping of the
+ * client's pool; nothing is copied or mapped again.  Reads must happen
+ * between beginAccess() and endAccess(): while access is open libwayland
+ * catches the SIGBUS a client would cause by shrinking the file behind
+ * the pool and maps zeroes in its place instead of killing the compositor.
+ * The buffer returned by getByteBuffer() is only valid until endAccess(),
+ * since a pool resize can move the mapping.
+ *
+ * Display.initShm() must have been called for clients to create shm
+ * buffers in the first place.
+ */
+public final class ShmBuffer
+{
+    private final Resource resource;
+
+    private ShmBuffer(Resource resource)
+    {
+        this.resource = resource;
+    }
+
+    /**
+     * Returns the ShmBuffer for a wl_buffer resource, such as the buffer
+     * argument of wl_surface.attach, or null if the buffer is not a wl_shm
+     * buffer.
+     */
+    public static ShmBuffer get(Resource resource)
+    {
+        if (! isShmBuffer(resource))
+            return null;
+
+        return new ShmBuffer(resource);
+    }
+
+    public Resource getResource()
+    {
+        return resource;
+    }
+
+    public int getWidth()
+    {
+        return getWidthNative(resource);
+    }
+
+    public int getHeight()
+    {
+        return getHeightNative(resource);
+    }
+
+    public int getStride()
+    {
+        return getStrideNative(resource);
+    }
+
+    public int getFormat()
+    {
+        return getFormatNative(resource);
+    }
+
+    /* Access may be nested; each beginAccess() needs its own endAccess() */
+    public void beginAccess()
+    {
+        beginAccessNative(resource);
+    }
+
+    public void endAccess()
+    {
+        endAccessNative(resource);
+    }
+
+    /**
+     * Returns a read-only view of the buffer's stride * height bytes in
+     * native byte order.  It can be handed to PixelOps as a source.
+     */
+    public ByteBuffer getByteBuffer()
+    {
+        return getDataNative(resource).asReadOnlyBuffer()
+                .order(ByteOrder.nativeOrder());
+    }
+
+    private static native boolean isShmBuffer(Resource resource);
+    private static native int getWidthNative(Resource resource);
+    private static native int getHeightNative(Resource resource);
+    private static native int getStrideNative(Resource resource);
+    private static native int getFormatNative(Resource resource);
+    private static native void beginAccessNative(Resource resource);
+    private static native void endAccessNative(Resource resource);
+    private static native ByteBuffer getDataNative(Resource resource);
+
+    static {
+        Native.loadLibrary("wayland-java-util");
+        Native.loadLibrary("wayland-java-server");
+    }
+}
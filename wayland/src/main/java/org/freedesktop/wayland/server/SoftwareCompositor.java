@@ -0,0 +1,434 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.concurrent.ForkJoinPool;
+import java.util.concurrent.RecursiveAction;
+
+import org.freedesktop.wayland.arch.Native;
+import org.freedesktop.wayland.Region;
+import org.freedesktop.wayland.ShmPool;
+
+/**
+ * Composites a stack of surfaces into an output image in software.
+ *
+ * The output is divided into TILE_SIZE square tiles.  compose() repaints
+ * only the tiles touched by damage since the last frame, spreading them
+ * over a fork/join pool.  Within a tile, every surface below the topmost
+ * opaque surface covering it is skipped.  Blending is premultiplied OVER
+ * with SSE2 or AVX2 where available.
+ *
+ * Surfaces get their pixels either from a client's ShmBuffer or from any
+ * direct ByteBuffer, in ARGB8888 or XRGB8888.  An ShmBuffer is read in
+ * place, so compose() must be called on the display thread, and a surface
+ * must be detached before the wl_buffer it shows is destroyed.
+ */
+public class SoftwareCompositor
+{
+    public static final int TILE_SIZE = 64;
+
+    /* Same values as wl_shm.FORMAT_* */
+    public static final int FORMAT_ARGB8888 = 0;
+    public static final int FORMAT_XRGB8888 = 1;
+
+    /* Must match compositor.c */
+    private static final int LAYER_X = 0;
+    private static final int LAYER_Y = 1;
+    private static final int LAYER_WIDTH = 2;
+    private static final int LAYER_HEIGHT = 3;
+    private static final int LAYER_STRIDE = 4;
+    private static final int LAYER_FORMAT = 5;
+    private static final int LAYER_OPACITY = 6;
+    private static final int LAYER_OPAQUE = 7;
+    private static final int LAYER_SIZE = 8;
+
+    public final class Surface
+    {
+        /* A ByteBuffer, the wl_buffer Resource of an ShmBuffer, or null */
+        private Object source;
+        private int x;
+        private int y;
+        private int width;
+        private int height;
+        private int stride;
+        private int format;
+        private int opacity;
+        private boolean opaque;
+        private boolean visible;
+
+        private Surface()
+        {
+            this.opacity = 255;
+            this.visible = true;
+        }
+
+        private void damageAll()
+        {
+            if (source != null && visible)
+                damage.unionRect(x, y, width, height);
+        }
+
+        public void attach(ShmBuffer buffer)
+        {
+            damageAll();
+            if (buffer == null) {
+                source = null;
+            } else {
+                source = buffer.getResource();
+                width = buffer.getWidth();
+                height = buffer.getHeight();
+                stride = buffer.getStride();
+                format = buffer.getFormat();
+            }
+            damageAll();
+        }
+
+        /**
+         * Shows width x height pixels of premultiplied data, with rows
+         * stride bytes apart, starting at index 0 of data.
+         */
+        public void attach(ByteBuffer data, int width, int height,
+                int stride, int format)
+        {
+            if (data != null && ! data.isDirect())
+                throw new IllegalArgumentException("Not a direct buffer");
+            if (format != FORMAT_ARGB8888 && format != FORMAT_XRGB8888)
+                throw new IllegalArgumentException("Unsupported format");
+
+            damageAll();
+            source = data;
+            this.width = width;
+            this.height = height;
+            this.stride = stride;
+            this.format = format;
+            damageAll();
+        }
+
+        public void detach()
+        {
+            damageAll();
+            source = null;
+        }
+
+        public void setPosition(int x, int y)
+        {
+            if (x == this.x && y == this.y)
+                return;
+
+            damageAll();
+            this.x = x;
+            this.y = y;
+            damageAll();
+        }
+
+        public int getX()
+        {
+            return x;
+        }
+
+        public int getY()
+        {
+            return y;
+        }
+
+        /* From 0, invisible, to 255, the default */
+        public void setOpacity(int opacity)
+        {
+            opacity = Math.max(0, Math.min(255, opacity));
+            if (opacity != this.opacity) {
+                this.opacity = opacity;
+                damageAll();
+            }
+        }
+
+        /**
+         * Marks an ARGB8888 surface as having no transparent pixels, as
+         * when a client sets an opaque region covering all of it.  Opaque
+         * surfaces hide what is below them.
+         */
+        public void setOpaque(boolean opaque)
+        {
+            if (opaque != this.opaque) {
+                this.opaque = opaque;
+                damageAll();
+            }
+        }
+
+        public void setVisible(boolean visible)
+        {
+            if (visible != this.visible) {
+                this.visible = visible;
+                if (source != null)
+                    damage.unionRect(x, y, width, height);
+            }
+        }
+
+        /* Damages a rectangle in surface coordinates */
+        public void damage(int x, int y, int width, int height)
+        {
+            if (source == null || ! visible)
+                return;
+
+            /* Clip to the surface so damage can't leak onto neighbours */
+            int x1 = Math.max(x, 0);
+            int y1 = Math.max(y, 0);
+            int x2 = Math.min(x + width, this.width);
+            int y2 = Math.min(y + height, this.height);
+            if (x1 < x2 && y1 < y2)
+                damage.unionRect(this.x + x1, this.y + y1, x2 - x1, y2 - y1);
+        }
+
+        public void raise()
+        {
+            damageAll();
+            surfaces.remove(this);
+            surfaces.add(this);
+        }
+
+        public void lower()
+        {
+            damageAll();
+            surfaces.remove(this);
+            surfaces.add(0, this);
+        }
+
+        public void destroy()
+        {
+            damageAll();
+            surfaces.remove(this);
+            source = null;
+        }
+    }
+
+    private final ShmPool output;
+    private final int width;
+    private final int height;
+    private final ForkJoinPool pool;
+    private final boolean ownsPool;
+    /* Bottom to top */
+    private final ArrayList<Surface> surfaces;
+    private final Region damage;
+    private int background;
+
+    /**
+     * Creates a compositor drawing a width x height XRGB8888 image with a
+     * stride of width * 4 at the start of output.  If pool is null the
+     * compositor creates one with a thread per CPU.
+     */
+    public SoftwareCompositor(ShmPool output, int width, int height,
+            ForkJoinPool pool)
+    {
+        if (output == null)
+            throw new NullPointerException("output not allowed to be null");
+        if (width <= 0 || height <= 0
+                || (long)width * height * 4 > output.size())
+            throw new IllegalArgumentException("Output does not fit the pool");
+
+        this.output = output;
+        this.width = width;
+        this.height = height;
+
+        if (pool == null) {
+            this.pool = new ForkJoinPool();
+            this.ownsPool = true;
+        } else {
+            this.pool = pool;
+            this.ownsPool = false;
+        }
+
+        this.surfaces = new ArrayList<Surface>();
+        this.damage = new Region(0, 0, width, height);
+        this.background = 0xff000000;
+    }
+
+    public SoftwareCompositor(ShmPool output, int width, int height)
+    {
+        this(output, width, height, null);
+    }
+
+    public ShmPool getOutput()
+    {
+        return output;
+    }
+
+    public int getWidth()
+    {
+        return width;
+    }
+
+    public int getHeight()
+    {
+        return height;
+    }
+
+    /* Creates a surface on top of the stack, initially with no buffer */
+    public Surface createSurface()
+    {
+        Surface surface = new Surface();
+        surfaces.add(surface);
+        return surface;
+    }
+
+    public void setBackground(int color)
+    {
+        if (color != background) {
+            background = color;
+            damage(0, 0, width, height);
+        }
+    }
+
+    /* Damages a rectangle in output coordinates */
+    public void damage(int x, int y, int width, int height)
+    {
+        damage.unionRect(x, y, width, height);
+    }
+
+    private final class ComposeTask extends RecursiveAction
+    {
+        private final long frame;
+        private final int[] tiles;
+        private final int first;
+        private final int last;
+
+        ComposeTask(long frame, int[] tiles, int first, int last)
+        {
+            this.frame = frame;
+            this.tiles = tiles;
+            this.first = first;
+            this.last = last;
+        }
+
+        @Override
+        protected void compute()
+        {
+            if (last - first == 1) {
+                int x = (tiles[first] & 0xffff) * TILE_SIZE;
+                int y = (tiles[first] >>> 16) * TILE_SIZE;
+                composeTileNative(frame, x, y,
+                        Math.min(x + TILE_SIZE, width),
+                        Math.min(y + TILE_SIZE, height));
+            } else {
+                int mid = (first + last) >>> 1;
+                invokeAll(new ComposeTask(frame, tiles, first, mid),
+                        new ComposeTask(frame, tiles, mid, last));
+            }
+        }
+    }
+
+    /**
+     * Repaints every damaged tile of the output and returns the region that
+     * was repainted, which is the accumulated damage rounded out to whole
+     * tiles.  The caller owns the returned region.
+     */
+    public Region compose()
+    {
+        damage.intersectRect(0, 0, width, height);
+        int[] rects = damage.getRectangles();
+        damage.clear();
+
+        /* Tiles are packed as (ty << 16) | tx */
+        int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        boolean[] marked = new boolean[tilesX * tilesY];
+        int[] tiles = new int[tilesX * tilesY];
+        int count = 0;
+        Region repainted = new Region();
+
+        for (int i = 0; i < rects.length; i += 4) {
+            int tx2 = (rects[i] + rects[i + 2] - 1) / TILE_SIZE;
+            int ty2 = (rects[i + 1] + rects[i + 3] - 1) / TILE_SIZE;
+            for (int ty = rects[i + 1] / TILE_SIZE; ty <= ty2; ++ty) {
+                for (int tx = rects[i] / TILE_SIZE; tx <= tx2; ++tx) {
+                    if (marked[ty * tilesX + tx])
+                        continue;
+                    marked[ty * tilesX + tx] = true;
+                    tiles[count++] = (ty << 16) | tx;
+                    repainted.unionRect(tx * TILE_SIZE, ty * TILE_SIZE,
+                            TILE_SIZE, TILE_SIZE);
+                }
+            }
+        }
+        repainted.intersectRect(0, 0, width, height);
+
+        if (count == 0)
+            return repainted;
+
+        Object[] sources = new Object[surfaces.size()];
+        int[] layers = new int[surfaces.size() * LAYER_SIZE];
+        int layerCount = 0;
+        for (Surface surface : surfaces) {
+            if (surface.source == null || ! surface.visible
+                    || surface.opacity == 0)
+                continue;
+
+            int base = layerCount * LAYER_SIZE;
+            sources[layerCount++] = surface.source;
+            layers[base + LAYER_X] = surface.x;
+            layers[base + LAYER_Y] = surface.y;
+            layers[base + LAYER_WIDTH] = surface.width;
+            layers[base + LAYER_HEIGHT] = surface.height;
+            layers[base + LAYER_STRIDE] = surface.stride;
+            layers[base + LAYER_FORMAT] = surface.format;
+            layers[base + LAYER_OPACITY] = surface.opacity;
+            layers[base + LAYER_OPAQUE] = surface.opaque ? 1 : 0;
+        }
+
+        long frame = beginFrameNative(output.asByteBuffer(), width * 4, width,
+                height, background, sources, layers, layerCount);
+        try {
+            ComposeTask task = new ComposeTask(frame, tiles, 0, count);
+            if (count == 1)
+                task.compute();
+            else
+                pool.invoke(task);
+        } finally {
+            endFrameNative(frame);
+        }
+
+        return repainted;
+    }
+
+    public void destroy()
+    {
+        surfaces.clear();
+        damage.destroy();
+        if (ownsPool)
+            pool.shutdown();
+    }
+
+    private static native long beginFrameNative(ByteBuffer output, int stride,
+            int width, int height, int background, Object[] sources,
+            int[] layers, int count);
+    private static native void composeTileNative(long frame, int x1, int y1,
+            int x2, int y2);
+    private static native void endFrameNative(long frame);
+
+    private static native void initializeJNI();
+
+    static {
+        Native.loadLibrary("wayland-java-util");
+        Native.loadLibrary("wayland-java-server");
+        initializeJNI();
+    }
+}
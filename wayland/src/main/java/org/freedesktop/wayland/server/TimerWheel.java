@@ -0,0 +1,228 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.util.ArrayList;
+
+import org.freedesktop.wayland.arch.Native;
+
+/**
+ * Multiplexes any number of timers over a single kernel timer.
+ *
+ * Unlike EventLoop.addTimer, timers created here do not each get their own
+ * event source.  Timer deadlines are rounded up to the wheel's tick length
+ * and all timers that expire on the same dispatch of the event loop are
+ * handed to Java in one batch.  A TimerWheel and its timers must only be
+ * used from the thread that dispatches its event loop.
+ */
+public class TimerWheel
+{
+    public interface TimeoutHandler
+    {
+        public abstract void handleTimeout(Timer timer);
+    }
+
+    public final class Timer
+    {
+        private final int id;
+        private long timer_ptr;
+        private final TimeoutHandler handler;
+        private boolean pending;
+        private boolean expiring;
+
+        private Timer(int id, TimeoutHandler handler)
+        {
+            this.id = id;
+            this.handler = handler;
+            this.timer_ptr = createTimerNative(checkValid(), id);
+        }
+
+        /**
+         * Arms the timer to fire after the given number of nanoseconds,
+         * replacing any previously scheduled expiry.
+         */
+        public void schedule(long delayNanos)
+        {
+            scheduleNative(checkValid(), checkTimer(), delayNanos);
+            pending = true;
+            expiring = false;
+        }
+
+        public void cancel()
+        {
+            cancelNative(checkValid(), checkTimer());
+            pending = false;
+            expiring = false;
+        }
+
+        public boolean isPending()
+        {
+            return pending;
+        }
+
+        public void destroy()
+        {
+            if (timer_ptr == 0)
+                return;
+
+            if (wheel_ptr != 0)
+                destroyTimerNative(wheel_ptr, timer_ptr);
+            timer_ptr = 0;
+            pending = false;
+            expiring = false;
+
+            timers.set(id, null);
+            freeIds.add(id);
+        }
+
+        private long checkTimer()
+        {
+            if (timer_ptr == 0)
+                throw new IllegalStateException("Timer destroyed");
+            return timer_ptr;
+        }
+    }
+
+    public static final long DEFAULT_TICK_NANOS = 1000000;
+
+    private long wheel_ptr;
+    private final EventLoop loop;
+    private final long tickNanos;
+    private final ArrayList<Timer> timers;
+    private final ArrayList<Integer> freeIds;
+
+    public TimerWheel(EventLoop loop, long tickNanos)
+    {
+        if (loop == null)
+            throw new NullPointerException("loop not allowed to be null");
+
+        this.loop = loop;
+        this.tickNanos = tickNanos;
+        this.timers = new ArrayList<Timer>();
+        this.freeIds = new ArrayList<Integer>();
+        this.wheel_ptr = createNative(loop, tickNanos);
+    }
+
+    public TimerWheel(EventLoop loop)
+    {
+        this(loop, DEFAULT_TICK_NANOS);
+    }
+
+    public long getTickNanos()
+    {
+        return tickNanos;
+    }
+
+    public Timer addTimer(TimeoutHandler handler)
+    {
+        if (handler == null)
+            throw new NullPointerException("handler not allowed to be null");
+
+        final int id;
+        if (freeIds.isEmpty()) {
+            id = timers.size();
+            timers.add(null);
+        } else {
+            id = freeIds.remove(freeIds.size() - 1);
+        }
+
+        Timer timer = new Timer(id, handler);
+        timers.set(id, timer);
+        return timer;
+    }
+
+    public void destroy()
+    {
+        if (wheel_ptr == 0)
+            return;
+
+        destroyNative(wheel_ptr);
+        wheel_ptr = 0;
+
+        for (Timer timer : timers) {
+            if (timer != null) {
+                timer.timer_ptr = 0;
+                timer.pending = false;
+            }
+        }
+        timers.clear();
+        freeIds.clear();
+    }
+
+    private long checkValid()
+    {
+        if (wheel_ptr == 0)
+            throw new IllegalStateException("TimerWheel destroyed");
+        return wheel_ptr;
+    }
+
+    private Timer getTimer(int id)
+    {
+        return id < timers.size() ? timers.get(id) : null;
+    }
+
+    /* Called from native code with every timer that expired this tick */
+    private void dispatchExpired(int[] ids, int count)
+    {
+        /*
+         * Mark the whole batch first so that a handler which cancels or
+         * reschedules a later timer in the batch keeps it from firing.
+         */
+        for (int i = 0; i < count; ++i) {
+            Timer timer = getTimer(ids[i]);
+            if (timer != null) {
+                timer.pending = false;
+                timer.expiring = true;
+            }
+        }
+
+        for (int i = 0; i < count; ++i) {
+            Timer timer = getTimer(ids[i]);
+            if (timer == null || !timer.expiring)
+                continue;
+
+            timer.expiring = false;
+            try {
+                timer.handler.handleTimeout(timer);
+            } catch (RuntimeException e) {
+                loop.reportUncaughtException(timer, e);
+            }
+        }
+    }
+
+    private native long createNative(EventLoop loop, long tickNanos);
+    private native void destroyNative(long wheel_ptr);
+    private static native long createTimerNative(long wheel_ptr, int id);
+    private static native void destroyTimerNative(long wheel_ptr,
+            long timer_ptr);
+    private static native void scheduleNative(long wheel_ptr, long timer_ptr,
+            long delayNanos);
+    private static native void cancelNative(long wheel_ptr, long timer_ptr);
+
+    private static native void initializeJNI();
+
+    static {
+        Native.loadLibrary("wayland-java-util");
+        Native.loadLibrary("wayland-java-server");
+        initializeJNI();
+    }
+}
@@ -49,3 +49,13 @@ LOCAL_SHARED_LIBRARIES	:= libwayland-java-util
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(CLEAR_VARS)
+
+LOCAL_MODULE 			:= libwayland-java-protocol
+LOCAL_CFLAGS			:= $(WAYLAND_JNI_CFLAGS)
+LOCAL_C_INCLUDES		:= $(foreach file, $(WAYLAND_JNI_C_INCLUDES), $(LOCAL_PATH)/$(file))
+LOCAL_SRC_FILES 		:= $(foreach file, $(WAYLAND_JNI_PROTOCOL_SRC), $(LOCAL_PATH)/$(file))
+LOCAL_SHARED_LIBRARIES	:= libwayland-java-util
+
+include $(BUILD_SHARED_LIBRARY)
+
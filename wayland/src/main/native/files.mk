@@ -23,6 +23,8 @@ WAYLAND_JNI_UTIL_SRC := \
 	src/fixed.c \
 	src/object.c \
 	src/shm_pool.c \
+	src/pixel_ops.c \
+	src/region.c \
 	src/wayland-jni.c
 
 WAYLAND_JNI_SERVER_SRC := \
@@ -30,10 +32,20 @@ WAYLAND_JNI_SERVER_SRC := \
 	src/server/display.c \
 	src/server/global.c \
 	src/server/client.c \
+	src/server/client_stats.c \
+	src/server/request_budget.c \
 	src/server/event_loop.c \
+	src/server/timer_wheel.c \
+	src/server/frame_scheduler.c \
 	src/server/resource.c \
+	src/server/shm_buffer.c \
+	src/server/compositor.c \
 	src/server/listener.c
 
+# Generated by the protocol scanner
+WAYLAND_JNI_PROTOCOL_SRC := \
+	src/protocol/wayland-protocol.c
+
 WAYLAND_JNI_CLIENT_SRC := \
 	src/client/display.c \
 	src/client/proxy.c \
@@ -225,3 +225,85 @@ Java_org_freedesktop_wayland_client_Display_roundtrip(JNIEnv * env,
         wl_jni_throw_from_errno(env, errno);
 }
 
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_client_Display_prepareRead(JNIEnv * env,
+        jobject jdisplay)
+{
+    struct wl_display *display;
+
+    display = (struct wl_display *)wl_jni_proxy_from_java(env, jdisplay);
+    if (display == NULL) {
+        wl_jni_throw_IllegalStateException(env, "Display not connected");
+        return JNI_FALSE;
+    }
+
+    if (wl_display_prepare_read(display) == 0)
+        return JNI_TRUE;
+
+    /* EAGAIN just means there are events to dispatch first */
+    if (errno != EAGAIN)
+        wl_jni_throw_from_errno(env, errno);
+
+    return JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_client_Display_prepareReadQueue(JNIEnv * env,
+        jobject jdisplay, jobject jqueue)
+{
+    struct wl_display *display;
+    struct wl_event_queue *queue;
+
+    display = (struct wl_display *)wl_jni_proxy_from_java(env, jdisplay);
+    if (display == NULL) {
+        wl_jni_throw_IllegalStateException(env, "Display not connected");
+        return JNI_FALSE;
+    }
+
+    queue = wl_jni_event_queue_from_java(env, jqueue);
+    if ((*env)->ExceptionCheck(env)) {
+        return JNI_FALSE;
+    } else if (queue == NULL) {
+        wl_jni_throw_NullPointerException(env, "queue not allowed to be null");
+        return JNI_FALSE;
+    }
+
+    if (wl_display_prepare_read_queue(display, queue) == 0)
+        return JNI_TRUE;
+
+    if (errno != EAGAIN)
+        wl_jni_throw_from_errno(env, errno);
+
+    return JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_client_Display_readEvents(JNIEnv * env,
+        jobject jdisplay)
+{
+    struct wl_display *display;
+
+    display = (struct wl_display *)wl_jni_proxy_from_java(env, jdisplay);
+    if (display == NULL) {
+        wl_jni_throw_IllegalStateException(env, "Display not connected");
+        return;
+    }
+
+    if (wl_display_read_events(display) < 0)
+        wl_jni_throw_from_errno(env, errno);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_client_Display_cancelRead(JNIEnv * env,
+        jobject jdisplay)
+{
+    struct wl_display *display;
+
+    display = (struct wl_display *)wl_jni_proxy_from_java(env, jdisplay);
+    if (display == NULL) {
+        wl_jni_throw_IllegalStateException(env, "Display not connected");
+        return;
+    }
+
+    wl_display_cancel_read(display);
+}
@@ -78,7 +78,7 @@ Java_org_freedesktop_wayland_client_Proxy_createNative(JNIEnv * env,
         return;
     }
 
-    proxy = wl_proxy_create(factory, &interface->interface);
+    proxy = wl_proxy_create(factory, interface->interface);
     if (proxy == NULL) {
         wl_jni_throw_OutOfMemoryError(env, NULL);
     }
@@ -129,7 +129,7 @@ Java_org_freedesktop_wayland_client_Proxy_marshal(JNIEnv * env, jobject jproxy,
         return;
     }
 
-    signature = interface->interface.methods[opcode].signature;
+    signature = interface->interface->methods[opcode].signature;
     nargs = 0;
     while (*signature) {
         if (*signature != '?')
@@ -143,7 +143,7 @@ Java_org_freedesktop_wayland_client_Proxy_marshal(JNIEnv * env, jobject jproxy,
         return;
     }
 
-    signature = interface->interface.methods[opcode].signature;
+    signature = interface->interface->methods[opcode].signature;
     wl_jni_arguments_from_java(env, args, jargs, signature, nargs,
             (struct wl_object *(*)(JNIEnv *, jobject))&wl_jni_proxy_from_java);
     if ((*env)->ExceptionCheck(env))
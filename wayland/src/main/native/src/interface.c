@@ -108,6 +108,7 @@ get_native_message(JNIEnv * env, jobject jmsg, struct wl_message * msg)
     jstring jstr;
     jarray jarr;
     int num_types, type;
+    struct wl_jni_interface *jni_type;
 
     jstr = (*env)->GetObjectField(env, jmsg, Interface.Message.name);
     if ((*env)->ExceptionCheck(env) == JNI_TRUE) return;
@@ -144,9 +145,11 @@ get_native_message(JNIEnv * env, jobject jmsg, struct wl_message * msg)
         jobj = (*env)->GetObjectArrayElement(env, jarr, type);
         if ((*env)->ExceptionCheck(env) == JNI_TRUE) goto delete_types;
 
-        msg->types[type] = &wl_jni_interface_from_java(env, jobj)->interface;
+        jni_type = wl_jni_interface_from_java(env, jobj);
         (*env)->DeleteLocalRef(env, jobj);
         if ((*env)->ExceptionCheck(env) == JNI_TRUE) goto delete_types;
+
+        msg->types[type] = jni_type ? jni_type->interface : NULL;
     }
 
     return;
@@ -252,6 +255,238 @@ get_java_method(JNIEnv * env, jobject jinterface, struct wl_message *message,
     return (*env)->GetMethodID(env, cls, message->name, jsignature);
 }
 
+static struct {
+    const struct wl_jni_protocol **list;
+    int count;
+    int size;
+} protocols;
+
+/*
+ * Called from the load-time constructor of each scanner-generated protocol
+ * source, before any Java Interface of that protocol is bound.
+ */
+void
+wl_jni_protocol_register(const struct wl_jni_protocol *protocol)
+{
+    const struct wl_jni_protocol **list;
+    int size;
+
+    if (protocols.count == protocols.size) {
+        size = protocols.size ? protocols.size * 2 : 4;
+        list = realloc(protocols.list, size * sizeof(*list));
+        if (list == NULL) {
+            /* Its interfaces get built from the Java descriptions instead */
+            LOG_DEBUG("Unable to register protocol %s\n", protocol->name);
+            return;
+        }
+        protocols.list = list;
+        protocols.size = size;
+    }
+
+    protocols.list[protocols.count++] = protocol;
+}
+
+/* Whether a String field of obj holds str */
+static jboolean
+string_field_equals(JNIEnv *env, jobject obj, jfieldID field,
+        const char *str)
+{
+    jstring jstr;
+    const char *chars;
+    jboolean equal;
+
+    jstr = (*env)->GetObjectField(env, obj, field);
+    if (jstr == NULL)
+        return JNI_FALSE;
+
+    chars = (*env)->GetStringUTFChars(env, jstr, NULL);
+    if (chars == NULL) {
+        (*env)->DeleteLocalRef(env, jstr);
+        return JNI_FALSE; /* Exception Thrown */
+    }
+
+    equal = strcmp(chars, str) == 0;
+
+    (*env)->ReleaseStringUTFChars(env, jstr, chars);
+    (*env)->DeleteLocalRef(env, jstr);
+
+    return equal;
+}
+
+/*
+ * Whether the Java message descriptions in field have the same Java names
+ * and wire signatures as the prebuilt table.  Anything else would make
+ * GetMethodID fail on the precomputed JNI signatures.
+ */
+static jboolean
+messages_equal(JNIEnv *env, jobject jinterface, jfieldID field,
+        const struct wl_message *messages,
+        const struct wl_jni_method *methods, int count)
+{
+    jarray jmessages;
+    jobject jmsg;
+    jboolean equal;
+    int i;
+
+    jmessages = (*env)->GetObjectField(env, jinterface, field);
+    if (jmessages == NULL)
+        return JNI_FALSE;
+
+    equal = (*env)->GetArrayLength(env, jmessages) == count;
+    for (i = 0; i < count && equal; ++i) {
+        jmsg = (*env)->GetObjectArrayElement(env, jmessages, i);
+        if (jmsg == NULL) {
+            equal = JNI_FALSE;
+            break;
+        }
+
+        equal = string_field_equals(env, jmsg, Interface.Message.name,
+                    methods[i].name)
+                && string_field_equals(env, jmsg, Interface.Message.signature,
+                    messages[i].signature);
+        (*env)->DeleteLocalRef(env, jmsg);
+    }
+
+    (*env)->DeleteLocalRef(env, jmessages);
+
+    return equal;
+}
+
+static const struct wl_jni_protocol_interface *
+find_prebuilt_interface(JNIEnv *env, jobject jinterface)
+{
+    const struct wl_jni_protocol_interface *found;
+    const struct wl_interface *interface;
+    const char *name;
+    jstring jname;
+    int p, i;
+
+    if (protocols.count == 0)
+        return NULL;
+
+    jname = (*env)->GetObjectField(env, jinterface, Interface.name);
+    if (jname == NULL)
+        return NULL;
+
+    name = (*env)->GetStringUTFChars(env, jname, NULL);
+    if (name == NULL) {
+        (*env)->DeleteLocalRef(env, jname);
+        return NULL; /* Exception Thrown */
+    }
+
+    found = NULL;
+    for (p = 0; p < protocols.count && found == NULL; ++p) {
+        for (i = 0; i < protocols.list[p]->interface_count; ++i) {
+            if (strcmp(protocols.list[p]->interfaces[i].interface->name,
+                        name) == 0) {
+                found = &protocols.list[p]->interfaces[i];
+                break;
+            }
+        }
+    }
+
+    (*env)->ReleaseStringUTFChars(env, jname, name);
+    (*env)->DeleteLocalRef(env, jname);
+
+    if (found == NULL)
+        return NULL;
+
+    /* Tables built from a different protocol version than the classes */
+    interface = found->interface;
+    if ((*env)->GetIntField(env, jinterface, Interface.version)
+                != interface->version
+            || !messages_equal(env, jinterface, Interface.requests,
+                interface->methods, found->requests, interface->method_count)
+            || !messages_equal(env, jinterface, Interface.events,
+                interface->events, found->events, interface->event_count))
+        return NULL;
+
+    return found;
+}
+
+static void
+resolve_java_methods(JNIEnv *env, jobject jinterface, jfieldID ifaces_field,
+        const struct wl_jni_method *methods, int count, jmethodID *ids)
+{
+    jarray classList;
+    jclass cls;
+    int i;
+
+    if (count == 0)
+        return;
+
+    classList = (*env)->GetObjectField(env, jinterface, ifaces_field);
+    if ((*env)->ExceptionCheck(env))
+        return;
+    if (classList == NULL) {
+        wl_jni_throw_NullPointerException(env, "Null listener class list");
+        return;
+    }
+
+    cls = (*env)->GetObjectArrayElement(env, classList,
+            (*env)->GetArrayLength(env, classList) - 1);
+    (*env)->DeleteLocalRef(env, classList);
+    if ((*env)->ExceptionCheck(env))
+        return;
+
+    for (i = 0; i < count; ++i) {
+        ids[i] = (*env)->GetMethodID(env, cls,
+                methods[i].name, methods[i].signature);
+        if (ids[i] == NULL)
+            break; /* Exception Thrown */
+    }
+
+    (*env)->DeleteLocalRef(env, cls);
+}
+
+static struct wl_jni_interface *
+create_prebuilt_interface(JNIEnv *env, jobject jinterface,
+        const struct wl_jni_protocol_interface *prebuilt)
+{
+    const struct wl_interface *interface;
+    struct wl_jni_interface *jni_interface;
+
+    interface = prebuilt->interface;
+
+    /* The methodID arrays live in the same allocation */
+    jni_interface = malloc(sizeof(struct wl_jni_interface)
+            + (interface->method_count + interface->event_count)
+            * sizeof(jmethodID));
+    if (jni_interface == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return NULL;
+    }
+
+    jni_interface->interface = interface;
+    jni_interface->requests = (jmethodID *)(jni_interface + 1);
+    jni_interface->events = jni_interface->requests + interface->method_count;
+    jni_interface->dynamic = NULL;
+
+    resolve_java_methods(env, jinterface, Interface.requestsIfaces,
+            prebuilt->requests, interface->method_count,
+            jni_interface->requests);
+    if ((*env)->ExceptionCheck(env))
+        goto delete_interface;
+
+    resolve_java_methods(env, jinterface, Interface.eventsIfaces,
+            prebuilt->events, interface->event_count,
+            jni_interface->events);
+    if ((*env)->ExceptionCheck(env))
+        goto delete_interface;
+
+    (*env)->SetLongField(env, jinterface, Interface.interface_ptr,
+            (jlong)(intptr_t)jni_interface);
+    if ((*env)->ExceptionCheck(env))
+        goto delete_interface;
+
+    return jni_interface;
+
+delete_interface:
+    free(jni_interface);
+
+    return NULL;
+}
+
 static struct wl_jni_interface *
 create_native_interface(JNIEnv *env, jobject jinterface)
 {
@@ -270,7 +505,15 @@ create_native_interface(JNIEnv *env, jobject jinterface)
     }
     memset(jni_interface, 0, sizeof(*jni_interface));
 
-    interface = &jni_interface->interface;
+    interface = malloc(sizeof(struct wl_interface));
+    if (interface == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        goto delete_interface;
+    }
+    memset(interface, 0, sizeof(*interface));
+
+    jni_interface->interface = interface;
+    jni_interface->dynamic = interface;
 
     jstr = (*env)->GetObjectField(env, jinterface, Interface.name);
     if ((*env)->ExceptionCheck(env))
@@ -399,6 +642,7 @@ delete_name:
         free((void *)interface->name);
 
 delete_interface:
+    free(jni_interface->dynamic);
     free(jni_interface);
 
     return NULL;
@@ -407,6 +651,7 @@ delete_interface:
 struct wl_jni_interface *
 wl_jni_interface_from_java(JNIEnv * env, jobject jinterface)
 {
+    const struct wl_jni_protocol_interface *prebuilt;
     struct wl_jni_interface *jni_interface;
 
     if (jinterface == NULL)
@@ -417,15 +662,36 @@ wl_jni_interface_from_java(JNIEnv * env, jobject jinterface)
 
     if (jni_interface != NULL)
         return jni_interface;
+
+    prebuilt = find_prebuilt_interface(env, jinterface);
+    if ((*env)->ExceptionCheck(env))
+        return NULL;
+
+    if (prebuilt != NULL)
+        return create_prebuilt_interface(env, jinterface, prebuilt);
     else
         return create_native_interface(env, jinterface);
 }
 
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_Interface_isPrebuilt(JNIEnv * env,
+        jobject jinterface)
+{
+    struct wl_jni_interface *jni_interface;
+
+    jni_interface = wl_jni_interface_from_java(env, jinterface);
+    if (jni_interface == NULL)
+        return JNI_FALSE; /* Exception Thrown */
+
+    return jni_interface->dynamic == NULL;
+}
+
 JNIEXPORT void JNICALL
 Java_org_freedesktop_wayland_Interface_destroyNative(JNIEnv * env,
         jobject jinterface)
 {
     struct wl_jni_interface * jni_interface;
+    struct wl_interface * interface;
     int i;
 
     jni_interface = wl_jni_interface_from_java(env, jinterface);
@@ -433,29 +699,27 @@ Java_org_freedesktop_wayland_Interface_destroyNative(JNIEnv * env,
         return;
     }
 
-    /* Free the events */
-    for (i = 0; i < jni_interface->interface.event_count; ++i) {
-        free((void *)jni_interface->interface.events[i].name);
-        free((void *)jni_interface->interface.events[i].signature);
-        free((void *)jni_interface->interface.events[i].types);
-    }
-    free((void *)jni_interface->interface.events);
-
-    /* Free the methods */
-    for (i = 0; i < jni_interface->interface.method_count; ++i) {
-        free((void *)jni_interface->interface.methods[i].name);
-        free((void *)jni_interface->interface.methods[i].signature);
-        free((void *)jni_interface->interface.methods[i].types);
+    interface = jni_interface->dynamic;
+    if (interface != NULL) {
+        /* Free the events */
+        for (i = 0; i < interface->event_count; ++i)
+            destroy_native_message(&interface->events[i]);
+        free((void *)interface->events);
+
+        /* Free the methods */
+        for (i = 0; i < interface->method_count; ++i)
+            destroy_native_message(&interface->methods[i]);
+        free((void *)interface->methods);
+
+        /* Free the name */
+        if (interface->name != NULL)
+            free((void *)interface->name);
+        free(interface);
+
+        /* Free the methodID arrays */
+        free(jni_interface->requests);
+        free(jni_interface->events);
     }
-    free((void *)jni_interface->interface.methods);
-
-    /* Free the name */
-    if (jni_interface->interface.name != NULL)
-        free((void *)jni_interface->interface.name);
-
-    /* Free the methodID arrays */
-    free(jni_interface->requests);
-    free(jni_interface->events);
 
     /* Free the actual interface */
     free(jni_interface);
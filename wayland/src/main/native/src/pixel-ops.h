@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#ifndef __WAYLAND_JAVA_PIXEL_OPS_H__
+#define __WAYLAND_JAVA_PIXEL_OPS_H__
+
+#include <stdint.h>
+
+/*
+ * Kernels over 32-bit pixels.  Strides are in bytes and must be multiples
+ * of four.  Pixels are native-endian words with alpha or padding in the top
+ * byte, which is how wl_shm lays out ARGB8888 and friends.  Blending
+ * kernels expect premultiplied alpha.
+ */
+
+void wl_jni_pixel_fill(uint32_t *dst, int stride, int width, int height,
+        uint32_t color);
+void wl_jni_pixel_fill_gradient(uint32_t *dst, int stride, int width,
+        int height, uint32_t color0, uint32_t color1, int vertical);
+void wl_jni_pixel_copy(uint32_t *dst, int dst_stride, const uint32_t *src,
+        int src_stride, int width, int height);
+void wl_jni_pixel_convert(uint32_t *dst, int dst_stride, const uint32_t *src,
+        int src_stride, int width, int height, int swap_rb,
+        uint32_t or_mask);
+void wl_jni_pixel_premultiply(uint32_t *dst, int stride, int width,
+        int height);
+void wl_jni_pixel_unpremultiply(uint32_t *dst, int stride, int width,
+        int height);
+void wl_jni_pixel_over(uint32_t *dst, int dst_stride, const uint32_t *src,
+        int src_stride, int width, int height);
+/* OVER with the source first ORed with or_mask and then scaled by alpha */
+void wl_jni_pixel_over_alpha(uint32_t *dst, int dst_stride,
+        const uint32_t *src, int src_stride, int width, int height,
+        uint32_t alpha, uint32_t or_mask);
+
+#endif /* ! defined __WAYLAND_JAVA_PIXEL_OPS_H__ */
@@ -0,0 +1,925 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#include <jni.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "wayland-jni.h"
+#include "pixel-ops.h"
+#include "region.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#ifdef __SSE2__
+#define HAVE_SSE2 1
+#endif
+#define HAVE_AVX2 1
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define ROW(p, stride, y) \
+    ((uint32_t *)((char *)(p) + (ptrdiff_t)(y) * (stride)))
+#define CONST_ROW(p, stride, y) \
+    ((const uint32_t *)((const char *)(p) + (ptrdiff_t)(y) * (stride)))
+
+typedef void (*fill_row_func)(uint32_t *dst, int width, uint32_t color);
+typedef void (*convert_row_func)(uint32_t *dst, const uint32_t *src,
+        int width, int swap_rb, uint32_t or_mask);
+typedef void (*premultiply_row_func)(uint32_t *dst, int width);
+typedef void (*over_row_func)(uint32_t *dst, const uint32_t *src, int width);
+typedef void (*over_alpha_row_func)(uint32_t *dst, const uint32_t *src,
+        int width, uint32_t alpha, uint32_t or_mask);
+
+/* Must match the KERNELS_ constants in PixelOps.java */
+#define KERNELS_SCALAR  0
+#define KERNELS_SSE2    1
+#define KERNELS_AVX2    2
+
+/* The best kernels to use.  Only lowered by tests, to compare against */
+static int kernel_level = KERNELS_AVX2;
+
+#ifdef HAVE_AVX2
+static int
+cpu_has_avx2(void)
+{
+    static int has_avx2 = -1;
+
+    /* Racing threads all compute the same answer */
+    if (has_avx2 < 0) {
+        __builtin_cpu_init();
+        has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+
+    return has_avx2;
+}
+#endif
+
+/* Exact x / 255 for x <= 255 * 255, rounded to nearest */
+static inline uint32_t
+div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+/*
+ * Scalar kernels.  These are the reference the vector versions must match
+ * bit for bit, and handle the tail of every row.
+ */
+
+static void
+fill_row_scalar(uint32_t *dst, int width, uint32_t color)
+{
+    int x;
+
+    for (x = 0; x < width; ++x)
+        dst[x] = color;
+}
+
+static inline uint32_t
+convert_pixel(uint32_t p, int swap_rb, uint32_t or_mask)
+{
+    if (swap_rb)
+        p = (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+    return p | or_mask;
+}
+
+static void
+convert_row_scalar(uint32_t *dst, const uint32_t *src, int width,
+        int swap_rb, uint32_t or_mask)
+{
+    int x;
+
+    for (x = 0; x < width; ++x)
+        dst[x] = convert_pixel(src[x], swap_rb, or_mask);
+}
+
+static inline uint32_t
+premultiply_pixel(uint32_t p)
+{
+    uint32_t a = p >> 24;
+
+    return (a << 24) |
+           (div255(((p >> 16) & 0xff) * a) << 16) |
+           (div255(((p >> 8) & 0xff) * a) << 8) |
+           div255((p & 0xff) * a);
+}
+
+static void
+premultiply_row_scalar(uint32_t *dst, int width)
+{
+    int x;
+
+    for (x = 0; x < width; ++x)
+        dst[x] = premultiply_pixel(dst[x]);
+}
+
+static inline uint32_t
+unpremultiply_channel(uint32_t c, uint32_t a)
+{
+    c = (c * 255 + a / 2) / a;
+    return c > 255 ? 255 : c;
+}
+
+static inline uint32_t
+over_pixel(uint32_t s, uint32_t d)
+{
+    uint32_t ia, r, c;
+    int shift;
+
+    ia = 255 - (s >> 24);
+    r = 0;
+    for (shift = 0; shift < 32; shift += 8) {
+        c = ((s >> shift) & 0xff) + div255(((d >> shift) & 0xff) * ia);
+        r |= (c > 255 ? 255 : c) << shift;
+    }
+
+    return r;
+}
+
+static void
+over_row_scalar(uint32_t *dst, const uint32_t *src, int width)
+{
+    int x;
+
+    for (x = 0; x < width; ++x)
+        dst[x] = over_pixel(src[x], dst[x]);
+}
+
+static inline uint32_t
+scale_pixel(uint32_t p, uint32_t alpha)
+{
+    return (div255((p >> 24) * alpha) << 24) |
+           (div255(((p >> 16) & 0xff) * alpha) << 16) |
+           (div255(((p >> 8) & 0xff) * alpha) << 8) |
+           div255((p & 0xff) * alpha);
+}
+
+static void
+over_alpha_row_scalar(uint32_t *dst, const uint32_t *src, int width,
+        uint32_t alpha, uint32_t or_mask)
+{
+    int x;
+
+    for (x = 0; x < width; ++x)
+        dst[x] = over_pixel(scale_pixel(src[x] | or_mask, alpha), dst[x]);
+}
+
+#ifdef HAVE_SSE2
+
+static void
+fill_row_sse2(uint32_t *dst, int width, uint32_t color)
+{
+    __m128i c = _mm_set1_epi32(color);
+    int x;
+
+    for (x = 0; x + 4 <= width; x += 4)
+        _mm_storeu_si128((__m128i *)(dst + x), c);
+
+    fill_row_scalar(dst + x, width - x, color);
+}
+
+static void
+convert_row_sse2(uint32_t *dst, const uint32_t *src, int width,
+        int swap_rb, uint32_t or_mask)
+{
+    const __m128i ga = _mm_set1_epi32(0xff00ff00);
+    const __m128i lo = _mm_set1_epi32(0x000000ff);
+    const __m128i mask = _mm_set1_epi32(or_mask);
+    __m128i p;
+    int x;
+
+    for (x = 0; x + 4 <= width; x += 4) {
+        p = _mm_loadu_si128((const __m128i *)(src + x));
+        if (swap_rb)
+            p = _mm_or_si128(_mm_and_si128(p, ga),
+                    _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), lo),
+                                 _mm_slli_epi32(_mm_and_si128(p, lo), 16)));
+        _mm_storeu_si128((__m128i *)(dst + x), _mm_or_si128(p, mask));
+    }
+
+    convert_row_scalar(dst + x, src + x, width - x, swap_rb, or_mask);
+}
+
+/* (x + 128 + ((x + 128) >> 8)) >> 8 on each 16-bit lane */
+static inline __m128i
+div255_epu16_sse2(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static void
+premultiply_row_sse2(uint32_t *dst, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i opaque = _mm_set1_epi32(255 << 16);
+    __m128i p, a, aa, ar, lo, hi;
+    int x;
+
+    for (x = 0; x + 4 <= width; x += 4) {
+        p = _mm_loadu_si128((const __m128i *)(dst + x));
+
+        /* Per pixel factors (a, a, a, 255) for (b, g, r, a) */
+        a = _mm_srli_epi32(p, 24);
+        aa = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+        ar = _mm_or_si128(a, opaque);
+
+        lo = _mm_mullo_epi16(_mm_unpacklo_epi8(p, zero),
+                _mm_unpacklo_epi32(aa, ar));
+        hi = _mm_mullo_epi16(_mm_unpackhi_epi8(p, zero),
+                _mm_unpackhi_epi32(aa, ar));
+
+        p = _mm_packus_epi16(div255_epu16_sse2(lo), div255_epu16_sse2(hi));
+        _mm_storeu_si128((__m128i *)(dst + x), p);
+    }
+
+    premultiply_row_scalar(dst + x, width - x);
+}
+
+static inline __m128i
+over_sse2(__m128i s, __m128i d)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i ia, lo, hi;
+
+    ia = _mm_sub_epi32(_mm_set1_epi32(255), _mm_srli_epi32(s, 24));
+    ia = _mm_or_si128(ia, _mm_slli_epi32(ia, 16));
+
+    lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+            _mm_unpacklo_epi32(ia, ia));
+    hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+            _mm_unpackhi_epi32(ia, ia));
+
+    d = _mm_packus_epi16(div255_epu16_sse2(lo), div255_epu16_sse2(hi));
+    return _mm_adds_epu8(s, d);
+}
+
+static void
+over_row_sse2(uint32_t *dst, const uint32_t *src, int width)
+{
+    __m128i s, d;
+    int x;
+
+    for (x = 0; x + 4 <= width; x += 4) {
+        s = _mm_loadu_si128((const __m128i *)(src + x));
+        d = _mm_loadu_si128((const __m128i *)(dst + x));
+        _mm_storeu_si128((__m128i *)(dst + x), over_sse2(s, d));
+    }
+
+    over_row_scalar(dst + x, src + x, width - x);
+}
+
+static void
+over_alpha_row_sse2(uint32_t *dst, const uint32_t *src, int width,
+        uint32_t alpha, uint32_t or_mask)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i a = _mm_set1_epi16(alpha);
+    const __m128i mask = _mm_set1_epi32(or_mask);
+    __m128i s, d, lo, hi;
+    int x;
+
+    for (x = 0; x + 4 <= width; x += 4) {
+        s = _mm_loadu_si128((const __m128i *)(src + x));
+        d = _mm_loadu_si128((const __m128i *)(dst + x));
+
+        s = _mm_or_si128(s, mask);
+        lo = _mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), a);
+        hi = _mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), a);
+        s = _mm_packus_epi16(div255_epu16_sse2(lo), div255_epu16_sse2(hi));
+
+        _mm_storeu_si128((__m128i *)(dst + x), over_sse2(s, d));
+    }
+
+    over_alpha_row_scalar(dst + x, src + x, width - x, alpha, or_mask);
+}
+
+#endif /* HAVE_SSE2 */
+
+#ifdef HAVE_AVX2
+
+static TARGET_AVX2 void
+fill_row_avx2(uint32_t *dst, int width, uint32_t color)
+{
+    __m256i c = _mm256_set1_epi32(color);
+    int x;
+
+    for (x = 0; x + 8 <= width; x += 8)
+        _mm256_storeu_si256((__m256i *)(dst + x), c);
+
+    fill_row_scalar(dst + x, width - x, color);
+}
+
+static TARGET_AVX2 void
+convert_row_avx2(uint32_t *dst, const uint32_t *src, int width,
+        int swap_rb, uint32_t or_mask)
+{
+    const __m256i swap = _mm256_setr_epi8(
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m256i mask = _mm256_set1_epi32(or_mask);
+    __m256i p;
+    int x;
+
+    for (x = 0; x + 8 <= width; x += 8) {
+        p = _mm256_loadu_si256((const __m256i *)(src + x));
+        if (swap_rb)
+            p = _mm256_shuffle_epi8(p, swap);
+        _mm256_storeu_si256((__m256i *)(dst + x), _mm256_or_si256(p, mask));
+    }
+
+    convert_row_scalar(dst + x, src + x, width - x, swap_rb, or_mask);
+}
+
+static TARGET_AVX2 inline __m256i
+div255_epu16_avx2(__m256i x)
+{
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+/* Unpack, pack and 32-bit interleaves all work within 128-bit lanes */
+static TARGET_AVX2 void
+premultiply_row_avx2(uint32_t *dst, int width)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32(255 << 16);
+    __m256i p, a, aa, ar, lo, hi;
+    int x;
+
+    for (x = 0; x + 8 <= width; x += 8) {
+        p = _mm256_loadu_si256((const __m256i *)(dst + x));
+
+        a = _mm256_srli_epi32(p, 24);
+        aa = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+        ar = _mm256_or_si256(a, opaque);
+
+        lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(p, zero),
+                _mm256_unpacklo_epi32(aa, ar));
+        hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(p, zero),
+                _mm256_unpackhi_epi32(aa, ar));
+
+        p = _mm256_packus_epi16(div255_epu16_avx2(lo),
+                div255_epu16_avx2(hi));
+        _mm256_storeu_si256((__m256i *)(dst + x), p);
+    }
+
+    premultiply_row_scalar(dst + x, width - x);
+}
+
+static TARGET_AVX2 inline __m256i
+over_avx2(__m256i s, __m256i d)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i ia, lo, hi;
+
+    ia = _mm256_sub_epi32(_mm256_set1_epi32(255), _mm256_srli_epi32(s, 24));
+    ia = _mm256_or_si256(ia, _mm256_slli_epi32(ia, 16));
+
+    lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+            _mm256_unpacklo_epi32(ia, ia));
+    hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+            _mm256_unpackhi_epi32(ia, ia));
+
+    d = _mm256_packus_epi16(div255_epu16_avx2(lo), div255_epu16_avx2(hi));
+    return _mm256_adds_epu8(s, d);
+}
+
+static TARGET_AVX2 void
+over_row_avx2(uint32_t *dst, const uint32_t *src, int width)
+{
+    __m256i s, d;
+    int x;
+
+    for (x = 0; x + 8 <= width; x += 8) {
+        s = _mm256_loadu_si256((const __m256i *)(src + x));
+        d = _mm256_loadu_si256((const __m256i *)(dst + x));
+        _mm256_storeu_si256((__m256i *)(dst + x), over_avx2(s, d));
+    }
+
+    over_row_scalar(dst + x, src + x, width - x);
+}
+
+static TARGET_AVX2 void
+over_alpha_row_avx2(uint32_t *dst, const uint32_t *src, int width,
+        uint32_t alpha, uint32_t or_mask)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i a = _mm256_set1_epi16(alpha);
+    const __m256i mask = _mm256_set1_epi32(or_mask);
+    __m256i s, d, lo, hi;
+    int x;
+
+    for (x = 0; x + 8 <= width; x += 8) {
+        s = _mm256_loadu_si256((const __m256i *)(src + x));
+        d = _mm256_loadu_si256((const __m256i *)(dst + x));
+
+        s = _mm256_or_si256(s, mask);
+        lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), a);
+        hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), a);
+        s = _mm256_packus_epi16(div255_epu16_avx2(lo),
+                div255_epu16_avx2(hi));
+
+        _mm256_storeu_si256((__m256i *)(dst + x), over_avx2(s, d));
+    }
+
+    over_alpha_row_scalar(dst + x, src + x, width - x, alpha, or_mask);
+}
+
+#endif /* HAVE_AVX2 */
+
+static fill_row_func
+choose_fill_row(void)
+{
+#ifdef HAVE_AVX2
+    if (kernel_level >= KERNELS_AVX2 && cpu_has_avx2())
+        return fill_row_avx2;
+#endif
+#ifdef HAVE_SSE2
+    if (kernel_level >= KERNELS_SSE2)
+        return fill_row_sse2;
+#endif
+    return fill_row_scalar;
+}
+
+static convert_row_func
+choose_convert_row(void)
+{
+#ifdef HAVE_AVX2
+    if (kernel_level >= KERNELS_AVX2 && cpu_has_avx2())
+        return convert_row_avx2;
+#endif
+#ifdef HAVE_SSE2
+    if (kernel_level >= KERNELS_SSE2)
+        return convert_row_sse2;
+#endif
+    return convert_row_scalar;
+}
+
+static premultiply_row_func
+choose_premultiply_row(void)
+{
+#ifdef HAVE_AVX2
+    if (kernel_level >= KERNELS_AVX2 && cpu_has_avx2())
+        return premultiply_row_avx2;
+#endif
+#ifdef HAVE_SSE2
+    if (kernel_level >= KERNELS_SSE2)
+        return premultiply_row_sse2;
+#endif
+    return premultiply_row_scalar;
+}
+
+static over_row_func
+choose_over_row(void)
+{
+#ifdef HAVE_AVX2
+    if (kernel_level >= KERNELS_AVX2 && cpu_has_avx2())
+        return over_row_avx2;
+#endif
+#ifdef HAVE_SSE2
+    if (kernel_level >= KERNELS_SSE2)
+        return over_row_sse2;
+#endif
+    return over_row_scalar;
+}
+
+static over_alpha_row_func
+choose_over_alpha_row(void)
+{
+#ifdef HAVE_AVX2
+    if (kernel_level >= KERNELS_AVX2 && cpu_has_avx2())
+        return over_alpha_row_avx2;
+#endif
+#ifdef HAVE_SSE2
+    if (kernel_level >= KERNELS_SSE2)
+        return over_alpha_row_sse2;
+#endif
+    return over_alpha_row_scalar;
+}
+
+void
+wl_jni_pixel_fill(uint32_t *dst, int stride, int width, int height,
+        uint32_t color)
+{
+    fill_row_func fill_row = choose_fill_row();
+    int y;
+
+    for (y = 0; y < height; ++y)
+        fill_row(ROW(dst, stride, y), width, color);
+}
+
+/* Channel-wise interpolation from c0 at i = 0 to c1 at i = n - 1 */
+static uint32_t
+lerp_color(uint32_t c0, uint32_t c1, int i, int n)
+{
+    uint32_t r, v;
+    int shift;
+
+    if (n <= 1)
+        return c0;
+
+    r = 0;
+    for (shift = 0; shift < 32; shift += 8) {
+        v = ((c0 >> shift) & 0xff) * (n - 1 - i) + ((c1 >> shift) & 0xff) * i;
+        r |= ((2 * v + (n - 1)) / (2 * (n - 1))) << shift;
+    }
+
+    return r;
+}
+
+void
+wl_jni_pixel_fill_gradient(uint32_t *dst, int stride, int width, int height,
+        uint32_t color0, uint32_t color1, int vertical)
+{
+    fill_row_func fill_row;
+    int x, y;
+
+    if (width <= 0 || height <= 0)
+        return;
+
+    if (vertical) {
+        fill_row = choose_fill_row();
+        for (y = 0; y < height; ++y)
+            fill_row(ROW(dst, stride, y), width,
+                    lerp_color(color0, color1, y, height));
+    } else {
+        /* Every row is the same; build one and copy it */
+        for (x = 0; x < width; ++x)
+            dst[x] = lerp_color(color0, color1, x, width);
+        for (y = 1; y < height; ++y)
+            memcpy(ROW(dst, stride, y), dst, width * sizeof(uint32_t));
+    }
+}
+
+void
+wl_jni_pixel_copy(uint32_t *dst, int dst_stride, const uint32_t *src,
+        int src_stride, int width, int height)
+{
+    size_t row_size = width * sizeof(uint32_t);
+    int y;
+
+    /* Walk bottom-up when moving a rectangle down within one buffer */
+    if ((const void *)dst > (const void *)src) {
+        for (y = height - 1; y >= 0; --y)
+            memmove(ROW(dst, dst_stride, y), CONST_ROW(src, src_stride, y),
+                    row_size);
+    } else {
+        for (y = 0; y < height; ++y)
+            memmove(ROW(dst, dst_stride, y), CONST_ROW(src, src_stride, y),
+                    row_size);
+    }
+}
+
+void
+wl_jni_pixel_convert(uint32_t *dst, int dst_stride, const uint32_t *src,
+        int src_stride, int width, int height, int swap_rb, uint32_t or_mask)
+{
+    convert_row_func convert_row = choose_convert_row();
+    int y;
+
+    for (y = 0; y < height; ++y)
+        convert_row(ROW(dst, dst_stride, y), CONST_ROW(src, src_stride, y),
+                width, swap_rb, or_mask);
+}
+
+void
+wl_jni_pixel_premultiply(uint32_t *dst, int stride, int width, int height)
+{
+    premultiply_row_func premultiply_row = choose_premultiply_row();
+    int y;
+
+    for (y = 0; y < height; ++y)
+        premultiply_row(ROW(dst, stride, y), width);
+}
+
+/* Division doesn't vectorize usefully; this is scalar everywhere */
+void
+wl_jni_pixel_unpremultiply(uint32_t *dst, int stride, int width, int height)
+{
+    uint32_t *row, p, a;
+    int x, y;
+
+    for (y = 0; y < height; ++y) {
+        row = ROW(dst, stride, y);
+        for (x = 0; x < width; ++x) {
+            p = row[x];
+            a = p >> 24;
+            if (a == 255)
+                continue;
+            if (a == 0) {
+                row[x] = 0;
+                continue;
+            }
+            row[x] = (a << 24) |
+                     (unpremultiply_channel((p >> 16) & 0xff, a) << 16) |
+                     (unpremultiply_channel((p >> 8) & 0xff, a) << 8) |
+                     unpremultiply_channel(p & 0xff, a);
+        }
+    }
+}
+
+void
+wl_jni_pixel_over(uint32_t *dst, int dst_stride, const uint32_t *src,
+        int src_stride, int width, int height)
+{
+    over_row_func over_row = choose_over_row();
+    int y;
+
+    for (y = 0; y < height; ++y)
+        over_row(ROW(dst, dst_stride, y), CONST_ROW(src, src_stride, y),
+                width);
+}
+
+void
+wl_jni_pixel_over_alpha(uint32_t *dst, int dst_stride, const uint32_t *src,
+        int src_stride, int width, int height, uint32_t alpha,
+        uint32_t or_mask)
+{
+    over_alpha_row_func over_alpha_row;
+    int y;
+
+    if (alpha == 0)
+        return;
+
+    if (alpha == 255 && or_mask == 0) {
+        wl_jni_pixel_over(dst, dst_stride, src, src_stride, width, height);
+        return;
+    }
+
+    over_alpha_row = choose_over_alpha_row();
+    for (y = 0; y < height; ++y)
+        over_alpha_row(ROW(dst, dst_stride, y), CONST_ROW(src, src_stride, y),
+                width, alpha, or_mask);
+}
+
+/* Must match the format constants in PixelOps.java, which are wl_shm's */
+#define PIXEL_FORMAT_ARGB8888   0
+#define PIXEL_FORMAT_XRGB8888   1
+#define PIXEL_FORMAT_ABGR8888   0x34324241
+#define PIXEL_FORMAT_XBGR8888   0x34324258
+
+/*
+ * Checks that the rectangle lies inside the buffer and returns a pointer to
+ * its first pixel, or throws and returns NULL.
+ */
+static uint32_t *
+get_rect(JNIEnv * env, jobject jbuffer, jint offset, jint stride, jint x,
+        jint y, jint width, jint height)
+{
+    char * data;
+    jlong capacity, end;
+
+    if (jbuffer == NULL) {
+        wl_jni_throw_NullPointerException(env, "buffer not allowed to be null");
+        return NULL;
+    }
+
+    data = (*env)->GetDirectBufferAddress(env, jbuffer);
+    capacity = (*env)->GetDirectBufferCapacity(env, jbuffer);
+    if (data == NULL || capacity < 0) {
+        wl_jni_throw_IllegalArgumentException(env, "Not a direct buffer");
+        return NULL;
+    }
+
+    if (((offset | stride) & 3) != 0 || ((uintptr_t)data & 3) != 0) {
+        wl_jni_throw_IllegalArgumentException(env,
+                "Pixel data must be 4-byte aligned");
+        return NULL;
+    }
+
+    if (offset < 0 || x < 0 || y < 0 || width < 0 || height < 0
+            || ((jlong)x + width) * 4 > stride) {
+        wl_jni_throw_by_name(env, "java/lang/IndexOutOfBoundsException",
+                "Rectangle outside of buffer");
+        return NULL;
+    }
+
+    if (width > 0 && height > 0) {
+        end = offset + ((jlong)y + height - 1) * stride
+                + ((jlong)x + width) * 4;
+        if (end > capacity) {
+            wl_jni_throw_by_name(env, "java/lang/IndexOutOfBoundsException",
+                    "Rectangle outside of buffer");
+            return NULL;
+        }
+    }
+
+    return (uint32_t *)(data + offset + (ptrdiff_t)y * stride) + x;
+}
+
+static int
+format_has_alpha(jint format)
+{
+    return format == PIXEL_FORMAT_ARGB8888 || format == PIXEL_FORMAT_ABGR8888;
+}
+
+static int
+format_is_bgr(jint format)
+{
+    return format == PIXEL_FORMAT_ABGR8888 || format == PIXEL_FORMAT_XBGR8888;
+}
+
+static int
+format_is_known(jint format)
+{
+    return format == PIXEL_FORMAT_ARGB8888 || format == PIXEL_FORMAT_XRGB8888
+        || format == PIXEL_FORMAT_ABGR8888 || format == PIXEL_FORMAT_XBGR8888;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_PixelOps_setKernelLevelNative(JNIEnv * env,
+        jclass clazz, jint level)
+{
+    kernel_level = level;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_PixelOps_fillRectNative(JNIEnv * env, jclass clazz,
+        jobject jdst, jint offset, jint stride, jint x, jint y,
+        jint width, jint height, jint color)
+{
+    uint32_t *dst;
+
+    dst = get_rect(env, jdst, offset, stride, x, y, width, height);
+    if (dst == NULL)
+        return; /* Exception Thrown */
+
+    wl_jni_pixel_fill(dst, stride, width, height, color);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_PixelOps_fillGradientNative(JNIEnv * env,
+        jclass clazz, jobject jdst, jint offset, jint stride, jint x, jint y,
+        jint width, jint height, jint color0, jint color1, jboolean vertical)
+{
+    uint32_t *dst;
+
+    dst = get_rect(env, jdst, offset, stride, x, y, width, height);
+    if (dst == NULL)
+        return; /* Exception Thrown */
+
+    wl_jni_pixel_fill_gradient(dst, stride, width, height, color0, color1,
+            vertical);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_PixelOps_copyRectNative(JNIEnv * env, jclass clazz,
+        jobject jsrc, jint src_offset, jint src_stride, jint src_x, jint src_y,
+        jobject jdst, jint dst_offset, jint dst_stride, jint dst_x, jint dst_y,
+        jint width, jint height)
+{
+    uint32_t *src, *dst;
+
+    src = get_rect(env, jsrc, src_offset, src_stride, src_x, src_y,
+            width, height);
+    if (src == NULL)
+        return; /* Exception Thrown */
+
+    dst = get_rect(env, jdst, dst_offset, dst_stride, dst_x, dst_y,
+            width, height);
+    if (dst == NULL)
+        return; /* Exception Thrown */
+
+    wl_jni_pixel_copy(dst, dst_stride, src, src_stride, width, height);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_PixelOps_convertRectNative(JNIEnv * env,
+        jclass clazz, jobject jsrc, jint src_offset, jint src_stride,
+        jint src_x, jint src_y, jint src_format, jobject jdst, jint dst_offset,
+        jint dst_stride, jint dst_x, jint dst_y, jint dst_format, jint width,
+        jint height)
+{
+    uint32_t *src, *dst, or_mask;
+
+    if (!format_is_known(src_format) || !format_is_known(dst_format)) {
+        wl_jni_throw_IllegalArgumentException(env, "Unsupported format");
+        return;
+    }
+
+    src = get_rect(env, jsrc, src_offset, src_stride, src_x, src_y,
+            width, height);
+    if (src == NULL)
+        return; /* Exception Thrown */
+
+    dst = get_rect(env, jdst, dst_offset, dst_stride, dst_x, dst_y,
+            width, height);
+    if (dst == NULL)
+        return; /* Exception Thrown */
+
+    /* Padding becomes opaque alpha; alpha becomes don't-care padding */
+    or_mask = (!format_has_alpha(src_format) && format_has_alpha(dst_format))
+            ? 0xff000000 : 0;
+
+    wl_jni_pixel_convert(dst, dst_stride, src, src_stride, width, height,
+            format_is_bgr(src_format) != format_is_bgr(dst_format), or_mask);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_PixelOps_premultiplyNative(JNIEnv * env,
+        jclass clazz, jobject jdst, jint offset, jint stride, jint x, jint y,
+        jint width, jint height)
+{
+    uint32_t *dst;
+
+    dst = get_rect(env, jdst, offset, stride, x, y, width, height);
+    if (dst == NULL)
+        return; /* Exception Thrown */
+
+    wl_jni_pixel_premultiply(dst, stride, width, height);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_PixelOps_unpremultiplyNative(JNIEnv * env,
+        jclass clazz, jobject jdst, jint offset, jint stride, jint x, jint y,
+        jint width, jint height)
+{
+    uint32_t *dst;
+
+    dst = get_rect(env, jdst, offset, stride, x, y, width, height);
+    if (dst == NULL)
+        return; /* Exception Thrown */
+
+    wl_jni_pixel_unpremultiply(dst, stride, width, height);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_PixelOps_blendOverNative(JNIEnv * env,
+        jclass clazz, jobject jsrc, jint src_offset, jint src_stride,
+        jint src_x, jint src_y, jobject jdst, jint dst_offset, jint dst_stride,
+        jint dst_x, jint dst_y, jint width, jint height)
+{
+    uint32_t *src, *dst;
+
+    src = get_rect(env, jsrc, src_offset, src_stride, src_x, src_y,
+            width, height);
+    if (src == NULL)
+        return; /* Exception Thrown */
+
+    dst = get_rect(env, jdst, dst_offset, dst_stride, dst_x, dst_y,
+            width, height);
+    if (dst == NULL)
+        return; /* Exception Thrown */
+
+    wl_jni_pixel_over(dst, dst_stride, src, src_stride, width, height);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_PixelOps_copyRegionNative(JNIEnv * env,
+        jclass clazz, jobject jsrc, jint src_offset, jobject jdst,
+        jint dst_offset, jint stride, jobject jregion)
+{
+    struct wl_jni_region *region;
+    struct wl_jni_box *box;
+    uint32_t *src, *dst;
+    int i;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return; /* Exception Thrown */
+
+    /* Check every box before copying any so a bad region copies nothing */
+    for (i = 0; i < region->count; ++i) {
+        box = &region->boxes[i];
+        if (get_rect(env, jsrc, src_offset, stride, box->x1, box->y1,
+                    box->x2 - box->x1, box->y2 - box->y1) == NULL)
+            return; /* Exception Thrown */
+        if (get_rect(env, jdst, dst_offset, stride, box->x1, box->y1,
+                    box->x2 - box->x1, box->y2 - box->y1) == NULL)
+            return; /* Exception Thrown */
+    }
+
+    for (i = 0; i < region->count; ++i) {
+        box = &region->boxes[i];
+        src = get_rect(env, jsrc, src_offset, stride, box->x1, box->y1,
+                box->x2 - box->x1, box->y2 - box->y1);
+        dst = get_rect(env, jdst, dst_offset, stride, box->x1, box->y1,
+                box->x2 - box->x1, box->y2 - box->y1);
+        wl_jni_pixel_copy(dst, stride, src, stride,
+                box->x2 - box->x1, box->y2 - box->y1);
+    }
+}
@@ -0,0 +1,1064 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "wayland-jni.h"
+#include "region.h"
+
+struct {
+    jclass class;
+    jfieldID region_ptr;
+} Region;
+
+void
+wl_jni_region_init(struct wl_jni_region *region)
+{
+    memset(region, 0, sizeof(*region));
+}
+
+void
+wl_jni_region_fini(struct wl_jni_region *region)
+{
+    free(region->boxes);
+    wl_jni_region_init(region);
+}
+
+static int
+region_reserve(struct wl_jni_region *region, int count)
+{
+    struct wl_jni_box *boxes;
+    int alloc;
+
+    if (region->count + count <= region->alloc)
+        return 0;
+
+    alloc = region->alloc ? region->alloc : 8;
+    while (alloc < region->count + count)
+        alloc *= 2;
+
+    boxes = realloc(region->boxes, alloc * sizeof(*boxes));
+    if (boxes == NULL)
+        return -1;
+    region->boxes = boxes;
+    region->alloc = alloc;
+
+    return 0;
+}
+
+static int
+region_append(struct wl_jni_region *region, int32_t x1, int32_t y1,
+        int32_t x2, int32_t y2)
+{
+    struct wl_jni_box *box;
+
+    if (x1 >= x2 || y1 >= y2)
+        return 0;
+
+    if (region_reserve(region, 1) < 0)
+        return -1;
+
+    box = &region->boxes[region->count++];
+    box->x1 = x1;
+    box->y1 = y1;
+    box->x2 = x2;
+    box->y2 = y2;
+
+    return 0;
+}
+
+static void
+region_update_extents(struct wl_jni_region *region)
+{
+    int i;
+
+    if (region->count == 0) {
+        memset(&region->extents, 0, sizeof(region->extents));
+        return;
+    }
+
+    /* Banding makes y easy; x needs a look at every band */
+    region->extents.y1 = region->boxes[0].y1;
+    region->extents.y2 = region->boxes[region->count - 1].y2;
+    region->extents.x1 = region->boxes[0].x1;
+    region->extents.x2 = region->boxes[0].x2;
+    for (i = 1; i < region->count; ++i) {
+        if (region->boxes[i].x1 < region->extents.x1)
+            region->extents.x1 = region->boxes[i].x1;
+        if (region->boxes[i].x2 > region->extents.x2)
+            region->extents.x2 = region->boxes[i].x2;
+    }
+}
+
+static int
+region_copy(struct wl_jni_region *dst, const struct wl_jni_region *src)
+{
+    if (dst == src)
+        return 0;
+
+    dst->count = 0;
+    if (region_reserve(dst, src->count) < 0)
+        return -1;
+
+    if (src->count > 0)
+        memcpy(dst->boxes, src->boxes, src->count * sizeof(*src->boxes));
+    dst->count = src->count;
+    dst->extents = src->extents;
+
+    return 0;
+}
+
+static void
+region_swap(struct wl_jni_region *a, struct wl_jni_region *b)
+{
+    struct wl_jni_region tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static int
+extents_overlap(const struct wl_jni_box *a, const struct wl_jni_box *b)
+{
+    return a->x1 < b->x2 && b->x1 < a->x2 && a->y1 < b->y2 && b->y1 < a->y2;
+}
+
+static const struct wl_jni_box *
+band_end(const struct wl_jni_box *box, const struct wl_jni_box *end)
+{
+    int32_t y1 = box->y1;
+
+    while (box != end && box->y1 == y1)
+        ++box;
+
+    return box;
+}
+
+/*
+ * Merges the band starting at cur into the one starting at prev if they
+ * touch and have the same x spans.  Returns the start of the last band.
+ */
+static int
+region_coalesce(struct wl_jni_region *region, int prev, int cur)
+{
+    struct wl_jni_box *p, *c;
+    int i, n;
+
+    n = region->count - cur;
+    if (n == 0)
+        return prev;
+    if (cur - prev != n)
+        return cur;
+
+    p = &region->boxes[prev];
+    c = &region->boxes[cur];
+    if (p->y2 != c->y1)
+        return cur;
+
+    for (i = 0; i < n; ++i)
+        if (p[i].x1 != c[i].x1 || p[i].x2 != c[i].x2)
+            return cur;
+
+    for (i = 0; i < n; ++i)
+        p[i].y2 = c[i].y2;
+    region->count = cur;
+
+    return prev;
+}
+
+static int
+append_band(struct wl_jni_region *region, const struct wl_jni_box *box,
+        const struct wl_jni_box *end, int32_t y1, int32_t y2)
+{
+    for (; box != end; ++box)
+        if (region_append(region, box->x1, y1, box->x2, y2) < 0)
+            return -1;
+
+    return 0;
+}
+
+typedef int (*band_op_func)(struct wl_jni_region *region,
+        const struct wl_jni_box *r1, const struct wl_jni_box *r1_end,
+        const struct wl_jni_box *r2, const struct wl_jni_box *r2_end,
+        int32_t y1, int32_t y2);
+
+static int
+union_bands(struct wl_jni_region *region,
+        const struct wl_jni_box *r1, const struct wl_jni_box *r1_end,
+        const struct wl_jni_box *r2, const struct wl_jni_box *r2_end,
+        int32_t y1, int32_t y2)
+{
+    const struct wl_jni_box *next;
+    int32_t x1, x2;
+
+    x1 = r1->x1 < r2->x1 ? r1->x1 : r2->x1;
+    x2 = x1;
+
+    /* Take spans in order of x1, merging any that touch */
+    while (r1 != r1_end || r2 != r2_end) {
+        if (r2 == r2_end || (r1 != r1_end && r1->x1 < r2->x1))
+            next = r1++;
+        else
+            next = r2++;
+
+        if (next->x1 <= x2) {
+            if (next->x2 > x2)
+                x2 = next->x2;
+        } else {
+            if (region_append(region, x1, y1, x2, y2) < 0)
+                return -1;
+            x1 = next->x1;
+            x2 = next->x2;
+        }
+    }
+
+    return region_append(region, x1, y1, x2, y2);
+}
+
+static int
+intersect_bands(struct wl_jni_region *region,
+        const struct wl_jni_box *r1, const struct wl_jni_box *r1_end,
+        const struct wl_jni_box *r2, const struct wl_jni_box *r2_end,
+        int32_t y1, int32_t y2)
+{
+    int32_t x1, x2;
+
+    while (r1 != r1_end && r2 != r2_end) {
+        x1 = r1->x1 > r2->x1 ? r1->x1 : r2->x1;
+        x2 = r1->x2 < r2->x2 ? r1->x2 : r2->x2;
+        if (region_append(region, x1, y1, x2, y2) < 0)
+            return -1;
+
+        if (r1->x2 < r2->x2)
+            ++r1;
+        else if (r2->x2 < r1->x2)
+            ++r2;
+        else
+            ++r1, ++r2;
+    }
+
+    return 0;
+}
+
+static int
+subtract_bands(struct wl_jni_region *region,
+        const struct wl_jni_box *r1, const struct wl_jni_box *r1_end,
+        const struct wl_jni_box *r2, const struct wl_jni_box *r2_end,
+        int32_t y1, int32_t y2)
+{
+    int32_t x1 = r1->x1;
+
+    while (r1 != r1_end && r2 != r2_end) {
+        if (r2->x2 <= x1) {
+            /* Subtrahend entirely to the left */
+            ++r2;
+        } else if (r2->x1 <= x1) {
+            /* Subtrahend covers the left end of the minuend */
+            x1 = r2->x2;
+            if (x1 >= r1->x2) {
+                if (++r1 != r1_end)
+                    x1 = r1->x1;
+            } else {
+                ++r2;
+            }
+        } else if (r2->x1 < r1->x2) {
+            /* Subtrahend splits the minuend */
+            if (region_append(region, x1, y1, r2->x1, y2) < 0)
+                return -1;
+            x1 = r2->x2;
+            if (x1 >= r1->x2) {
+                if (++r1 != r1_end)
+                    x1 = r1->x1;
+            } else {
+                ++r2;
+            }
+        } else {
+            /* Subtrahend entirely to the right */
+            if (region_append(region, x1, y1, r1->x2, y2) < 0)
+                return -1;
+            if (++r1 != r1_end)
+                x1 = r1->x1;
+        }
+    }
+
+    while (r1 != r1_end) {
+        if (region_append(region, x1, y1, r1->x2, y2) < 0)
+            return -1;
+        if (++r1 != r1_end)
+            x1 = r1->x1;
+    }
+
+    return 0;
+}
+
+/*
+ * Walks the bands of a and b from top to bottom.  Where both have a band,
+ * band_op combines them; where only one does, its band is kept if keep_a
+ * or keep_b says so.  This is miRegionOp from the X server.
+ */
+static int
+region_op(struct wl_jni_region *dst, const struct wl_jni_region *a,
+        const struct wl_jni_region *b, band_op_func band_op,
+        int keep_a, int keep_b)
+{
+    const struct wl_jni_box *r1, *r1_end, *r1_band_end;
+    const struct wl_jni_box *r2, *r2_end, *r2_band_end;
+    struct wl_jni_region result;
+    int32_t ytop, ybot, top, bot;
+    int prev_band, cur_band;
+
+    wl_jni_region_init(&result);
+    if (region_reserve(&result, a->count + b->count) < 0)
+        goto err;
+
+    r1 = a->boxes;
+    r1_end = r1 + a->count;
+    r2 = b->boxes;
+    r2_end = r2 + b->count;
+
+    ybot = r1->y1 < r2->y1 ? r1->y1 : r2->y1;
+    prev_band = 0;
+
+    do {
+        r1_band_end = band_end(r1, r1_end);
+        r2_band_end = band_end(r2, r2_end);
+
+        /* The part of the higher band that's above the other */
+        if (r1->y1 < r2->y1) {
+            if (keep_a) {
+                top = r1->y1 > ybot ? r1->y1 : ybot;
+                bot = r1->y2 < r2->y1 ? r1->y2 : r2->y1;
+                if (top < bot) {
+                    cur_band = result.count;
+                    if (append_band(&result, r1, r1_band_end, top, bot) < 0)
+                        goto err;
+                    prev_band = region_coalesce(&result, prev_band, cur_band);
+                }
+            }
+            ytop = r2->y1;
+        } else if (r2->y1 < r1->y1) {
+            if (keep_b) {
+                top = r2->y1 > ybot ? r2->y1 : ybot;
+                bot = r2->y2 < r1->y1 ? r2->y2 : r1->y1;
+                if (top < bot) {
+                    cur_band = result.count;
+                    if (append_band(&result, r2, r2_band_end, top, bot) < 0)
+                        goto err;
+                    prev_band = region_coalesce(&result, prev_band, cur_band);
+                }
+            }
+            ytop = r1->y1;
+        } else {
+            ytop = r1->y1;
+        }
+
+        /* The part where both bands overlap */
+        ybot = r1->y2 < r2->y2 ? r1->y2 : r2->y2;
+        if (ybot > ytop) {
+            cur_band = result.count;
+            if (band_op(&result, r1, r1_band_end, r2, r2_band_end,
+                        ytop, ybot) < 0)
+                goto err;
+            prev_band = region_coalesce(&result, prev_band, cur_band);
+        }
+
+        if (r1->y2 == ybot)
+            r1 = r1_band_end;
+        if (r2->y2 == ybot)
+            r2 = r2_band_end;
+    } while (r1 != r1_end && r2 != r2_end);
+
+    /* Whatever is left of one region lies below all of the other */
+    if (keep_a) {
+        for (; r1 != r1_end; r1 = r1_band_end) {
+            r1_band_end = band_end(r1, r1_end);
+            cur_band = result.count;
+            if (append_band(&result, r1, r1_band_end,
+                        r1->y1 > ybot ? r1->y1 : ybot, r1->y2) < 0)
+                goto err;
+            prev_band = region_coalesce(&result, prev_band, cur_band);
+        }
+    }
+    if (keep_b) {
+        for (; r2 != r2_end; r2 = r2_band_end) {
+            r2_band_end = band_end(r2, r2_end);
+            cur_band = result.count;
+            if (append_band(&result, r2, r2_band_end,
+                        r2->y1 > ybot ? r2->y1 : ybot, r2->y2) < 0)
+                goto err;
+            prev_band = region_coalesce(&result, prev_band, cur_band);
+        }
+    }
+
+    region_update_extents(&result);
+    region_swap(dst, &result);
+    wl_jni_region_fini(&result);
+    return 0;
+
+err:
+    wl_jni_region_fini(&result);
+    return -1;
+}
+
+int
+wl_jni_region_union(struct wl_jni_region *dst,
+        const struct wl_jni_region *a, const struct wl_jni_region *b)
+{
+    if (a->count == 0)
+        return region_copy(dst, b);
+    if (b->count == 0)
+        return region_copy(dst, a);
+
+    return region_op(dst, a, b, union_bands, 1, 1);
+}
+
+int
+wl_jni_region_intersect(struct wl_jni_region *dst,
+        const struct wl_jni_region *a, const struct wl_jni_region *b)
+{
+    if (a->count == 0 || b->count == 0
+            || ! extents_overlap(&a->extents, &b->extents)) {
+        dst->count = 0;
+        region_update_extents(dst);
+        return 0;
+    }
+
+    return region_op(dst, a, b, intersect_bands, 0, 0);
+}
+
+int
+wl_jni_region_subtract(struct wl_jni_region *dst,
+        const struct wl_jni_region *a, const struct wl_jni_region *b)
+{
+    if (a->count == 0 || b->count == 0
+            || ! extents_overlap(&a->extents, &b->extents))
+        return region_copy(dst, a);
+
+    return region_op(dst, a, b, subtract_bands, 1, 0);
+}
+
+/* Unions the boxes pairwise, merge-sort style */
+static int
+region_union_boxes(struct wl_jni_region *dst, const struct wl_jni_box *boxes,
+        int count)
+{
+    struct wl_jni_region left, right;
+    int ret;
+
+    if (count <= 1) {
+        dst->count = 0;
+        if (count == 1 && region_append(dst, boxes->x1, boxes->y1,
+                    boxes->x2, boxes->y2) < 0)
+            return -1;
+        region_update_extents(dst);
+        return 0;
+    }
+
+    wl_jni_region_init(&left);
+    wl_jni_region_init(&right);
+
+    ret = region_union_boxes(&left, boxes, count / 2);
+    if (ret == 0)
+        ret = region_union_boxes(&right, boxes + count / 2,
+                count - count / 2);
+    if (ret == 0)
+        ret = wl_jni_region_union(dst, &left, &right);
+
+    wl_jni_region_fini(&left);
+    wl_jni_region_fini(&right);
+    return ret;
+}
+
+int
+wl_jni_region_set_boxes(struct wl_jni_region *region,
+        const struct wl_jni_box *boxes, int count)
+{
+    return region_union_boxes(region, boxes, count);
+}
+
+struct wl_jni_region *
+wl_jni_region_from_java(JNIEnv * env, jobject jregion)
+{
+    struct wl_jni_region *region;
+
+    if (jregion == NULL) {
+        wl_jni_throw_NullPointerException(env, "region not allowed to be null");
+        return NULL;
+    }
+
+    region = (struct wl_jni_region *)(intptr_t)
+            (*env)->GetLongField(env, jregion, Region.region_ptr);
+    if (region == NULL)
+        wl_jni_throw_IllegalStateException(env, "Region destroyed");
+
+    return region;
+}
+
+typedef int (*region_op_func)(struct wl_jni_region *,
+        const struct wl_jni_region *, const struct wl_jni_region *);
+
+/* Indexed by the OP_ constants in Region.java */
+static const region_op_func region_ops[] = {
+    wl_jni_region_union,
+    wl_jni_region_intersect,
+    wl_jni_region_subtract,
+};
+
+static void
+region_apply(JNIEnv * env, jobject jregion, const struct wl_jni_region *other,
+        region_op_func op)
+{
+    struct wl_jni_region *region;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return; /* Exception Thrown */
+
+    if (op(region, region, other) < 0)
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+}
+
+static void
+region_apply_java(JNIEnv * env, jobject jregion, jobject jother,
+        region_op_func op)
+{
+    struct wl_jni_region *other;
+
+    other = wl_jni_region_from_java(env, jother);
+    if (other == NULL)
+        return; /* Exception Thrown */
+
+    region_apply(env, jregion, other, op);
+}
+
+/* The far edge of a span, clamped instead of overflowing past INT32_MAX */
+static int32_t
+rect_end(jint start, jint length)
+{
+    int64_t end;
+
+    end = (int64_t)start + (length > 0 ? length : 0);
+    return end > INT32_MAX ? INT32_MAX : (int32_t)end;
+}
+
+static void
+box_from_rect(struct wl_jni_box *box, jint x, jint y, jint width,
+        jint height)
+{
+    box->x1 = x;
+    box->y1 = y;
+    box->x2 = rect_end(x, width);
+    box->y2 = rect_end(y, height);
+}
+
+static void
+region_apply_rect(JNIEnv * env, jobject jregion, jint x, jint y,
+        jint width, jint height, region_op_func op)
+{
+    struct wl_jni_box box;
+    struct wl_jni_region other;
+
+    box_from_rect(&box, x, y, width, height);
+
+    other.boxes = &box;
+    other.count = (width > 0 && height > 0) ? 1 : 0;
+    other.alloc = 1;
+    other.extents = box;
+    if (other.count == 0)
+        memset(&other.extents, 0, sizeof(other.extents));
+
+    region_apply(env, jregion, &other, op);
+}
+
+/* Applies op with the union of count x, y, width, height quadruples */
+static void
+region_apply_rects(JNIEnv * env, jobject jregion, const jint *rects,
+        int count, jint op)
+{
+    struct wl_jni_region other;
+    struct wl_jni_box *boxes;
+    int i;
+
+    boxes = malloc(count * sizeof(*boxes) + 1);
+    if (boxes == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return;
+    }
+
+    for (i = 0; i < count; ++i)
+        box_from_rect(&boxes[i], rects[i * 4], rects[i * 4 + 1],
+                rects[i * 4 + 2], rects[i * 4 + 3]);
+
+    wl_jni_region_init(&other);
+    if (wl_jni_region_set_boxes(&other, boxes, count) < 0)
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+    else
+        region_apply(env, jregion, &other, region_ops[op]);
+
+    wl_jni_region_fini(&other);
+    free(boxes);
+}
+
+static void
+region_get_rects(const struct wl_jni_region *region, jint *rects)
+{
+    int i;
+
+    for (i = 0; i < region->count; ++i) {
+        rects[i * 4 + 0] = region->boxes[i].x1;
+        rects[i * 4 + 1] = region->boxes[i].y1;
+        rects[i * 4 + 2] = region->boxes[i].x2 - region->boxes[i].x1;
+        rects[i * 4 + 3] = region->boxes[i].y2 - region->boxes[i].y1;
+    }
+}
+
+/*
+ * Returns a pointer to count quadruples of ints at offset bytes into a
+ * direct buffer, or throws and returns NULL.
+ */
+static jint *
+get_rects_buffer(JNIEnv * env, jobject jbuffer, jint offset, jint count)
+{
+    char *data;
+    jlong capacity;
+
+    if (jbuffer == NULL) {
+        wl_jni_throw_NullPointerException(env, "buffer not allowed to be null");
+        return NULL;
+    }
+
+    data = (*env)->GetDirectBufferAddress(env, jbuffer);
+    capacity = (*env)->GetDirectBufferCapacity(env, jbuffer);
+    if (data == NULL || capacity < 0) {
+        wl_jni_throw_IllegalArgumentException(env, "Not a direct buffer");
+        return NULL;
+    }
+
+    if (((uintptr_t)(data + offset) & 3) != 0) {
+        wl_jni_throw_IllegalArgumentException(env,
+                "Rectangles must be 4-byte aligned");
+        return NULL;
+    }
+
+    if (offset < 0 || count < 0
+            || offset + (jlong)count * 4 * sizeof(jint) > capacity) {
+        wl_jni_throw_by_name(env, "java/lang/IndexOutOfBoundsException",
+                "Rectangles outside of buffer");
+        return NULL;
+    }
+
+    return (jint *)(data + offset);
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_freedesktop_wayland_Region_createNative(JNIEnv * env, jclass cls)
+{
+    struct wl_jni_region *region;
+
+    region = malloc(sizeof(*region));
+    if (region == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return 0;
+    }
+    wl_jni_region_init(region);
+
+    return (jlong)(intptr_t)region;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_destroyNative(JNIEnv * env, jclass cls,
+        jlong region_ptr)
+{
+    struct wl_jni_region *region;
+
+    region = (struct wl_jni_region *)(intptr_t)region_ptr;
+    if (region == NULL)
+        return;
+
+    wl_jni_region_fini(region);
+    free(region);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_set(JNIEnv * env, jobject jregion,
+        jobject jother)
+{
+    struct wl_jni_region *region, *other;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return; /* Exception Thrown */
+
+    other = wl_jni_region_from_java(env, jother);
+    if (other == NULL)
+        return; /* Exception Thrown */
+
+    if (region_copy(region, other) < 0)
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_clear(JNIEnv * env, jobject jregion)
+{
+    struct wl_jni_region *region;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return; /* Exception Thrown */
+
+    region->count = 0;
+    region_update_extents(region);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_union(JNIEnv * env, jobject jregion,
+        jobject jother)
+{
+    region_apply_java(env, jregion, jother, wl_jni_region_union);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_unionRect(JNIEnv * env, jobject jregion,
+        jint x, jint y, jint width, jint height)
+{
+    region_apply_rect(env, jregion, x, y, width, height, wl_jni_region_union);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_intersect(JNIEnv * env, jobject jregion,
+        jobject jother)
+{
+    region_apply_java(env, jregion, jother, wl_jni_region_intersect);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_intersectRect(JNIEnv * env,
+        jobject jregion, jint x, jint y, jint width, jint height)
+{
+    region_apply_rect(env, jregion, x, y, width, height,
+            wl_jni_region_intersect);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_subtract(JNIEnv * env, jobject jregion,
+        jobject jother)
+{
+    region_apply_java(env, jregion, jother, wl_jni_region_subtract);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_subtractRect(JNIEnv * env,
+        jobject jregion, jint x, jint y, jint width, jint height)
+{
+    region_apply_rect(env, jregion, x, y, width, height,
+            wl_jni_region_subtract);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_applyRectanglesNative(JNIEnv * env,
+        jobject jregion, jint op, jintArray jrects, jint offset, jint count)
+{
+    jint *rects;
+
+    if (jrects == NULL) {
+        wl_jni_throw_NullPointerException(env, "rects not allowed to be null");
+        return;
+    }
+
+    if (count < 0 || offset < 0 || (jlong)offset + (jlong)count * 4
+            > (*env)->GetArrayLength(env, jrects)) {
+        wl_jni_throw_by_name(env, "java/lang/IndexOutOfBoundsException",
+                "Rectangles outside of array");
+        return;
+    }
+
+    rects = malloc(count * 4 * sizeof(jint) + 1);
+    if (rects == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return;
+    }
+
+    (*env)->GetIntArrayRegion(env, jrects, offset, count * 4, rects);
+    region_apply_rects(env, jregion, rects, count, op);
+
+    free(rects);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_applyRectanglesBufferNative(JNIEnv * env,
+        jobject jregion, jint op, jobject jrects, jint offset, jint count)
+{
+    jint *rects;
+
+    rects = get_rects_buffer(env, jrects, offset, count);
+    if (rects == NULL)
+        return; /* Exception Thrown */
+
+    region_apply_rects(env, jregion, rects, count, op);
+}
+
+/* Moves an edge, clamped to the int32 range instead of overflowing */
+static int32_t
+translate_edge(int32_t edge, jint delta)
+{
+    int64_t moved;
+
+    moved = (int64_t)edge + delta;
+    if (moved > INT32_MAX)
+        return INT32_MAX;
+    if (moved < INT32_MIN)
+        return INT32_MIN;
+    return (int32_t)moved;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_translate(JNIEnv * env, jobject jregion,
+        jint dx, jint dy)
+{
+    struct wl_jni_region *region, result;
+    struct wl_jni_box *box;
+    int i, count, clamped;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return; /* Exception Thrown */
+
+    clamped = region->count > 0
+            && ((int64_t)region->extents.x1 + dx < INT32_MIN
+                || (int64_t)region->extents.x2 + dx > INT32_MAX
+                || (int64_t)region->extents.y1 + dy < INT32_MIN
+                || (int64_t)region->extents.y2 + dy > INT32_MAX);
+
+    /* Boxes clamped down to nothing are dropped */
+    count = 0;
+    for (i = 0; i < region->count; ++i) {
+        box = &region->boxes[count];
+        box->x1 = translate_edge(region->boxes[i].x1, dx);
+        box->y1 = translate_edge(region->boxes[i].y1, dy);
+        box->x2 = translate_edge(region->boxes[i].x2, dx);
+        box->y2 = translate_edge(region->boxes[i].y2, dy);
+        if (box->x1 < box->x2 && box->y1 < box->y2)
+            ++count;
+    }
+    region->count = count;
+
+    if (! clamped) {
+        region_update_extents(region);
+        return;
+    }
+
+    /* Clamping can make neighbouring bands identical; merge them again */
+    wl_jni_region_init(&result);
+    if (region_union_boxes(&result, region->boxes, region->count) < 0) {
+        wl_jni_region_fini(&result);
+        region_update_extents(region);
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return;
+    }
+    region_swap(region, &result);
+    wl_jni_region_fini(&result);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_Region_getRectangleCount(JNIEnv * env,
+        jobject jregion)
+{
+    struct wl_jni_region *region;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return 0; /* Exception Thrown */
+
+    return region->count;
+}
+
+JNIEXPORT jintArray JNICALL
+Java_org_freedesktop_wayland_Region_getRectangles__(JNIEnv * env,
+        jobject jregion)
+{
+    struct wl_jni_region *region;
+    jintArray jrects;
+    jint *rects;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return NULL; /* Exception Thrown */
+
+    jrects = (*env)->NewIntArray(env, region->count * 4);
+    if (jrects == NULL)
+        return NULL; /* Exception Thrown */
+
+    rects = (*env)->GetPrimitiveArrayCritical(env, jrects, NULL);
+    if (rects == NULL)
+        return NULL; /* Exception Thrown */
+
+    region_get_rects(region, rects);
+
+    (*env)->ReleasePrimitiveArrayCritical(env, jrects, rects, 0);
+
+    return jrects;
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_Region_getRectangles___3II(JNIEnv * env,
+        jobject jregion, jintArray jrects, jint offset)
+{
+    struct wl_jni_region *region;
+    jint *rects;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return 0; /* Exception Thrown */
+
+    if (jrects == NULL) {
+        wl_jni_throw_NullPointerException(env, "rects not allowed to be null");
+        return 0;
+    }
+
+    if (offset < 0 || (jlong)offset + (jlong)region->count * 4
+            > (*env)->GetArrayLength(env, jrects)) {
+        wl_jni_throw_by_name(env, "java/lang/IndexOutOfBoundsException",
+                "Rectangles do not fit in the array");
+        return 0;
+    }
+
+    rects = (*env)->GetPrimitiveArrayCritical(env, jrects, NULL);
+    if (rects == NULL)
+        return 0; /* Exception Thrown */
+
+    region_get_rects(region, rects + offset);
+
+    (*env)->ReleasePrimitiveArrayCritical(env, jrects, rects, 0);
+
+    return region->count;
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_Region_getRectangles__Ljava_nio_ByteBuffer_2I(
+        JNIEnv * env, jobject jregion, jobject jrects, jint offset)
+{
+    struct wl_jni_region *region;
+    jint *rects;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return 0; /* Exception Thrown */
+
+    rects = get_rects_buffer(env, jrects, offset, region->count);
+    if (rects == NULL)
+        return 0; /* Exception Thrown */
+
+    region_get_rects(region, rects);
+
+    return region->count;
+}
+
+JNIEXPORT jintArray JNICALL
+Java_org_freedesktop_wayland_Region_getExtents(JNIEnv * env, jobject jregion)
+{
+    struct wl_jni_region *region;
+    jintArray jextents;
+    jint extents[4];
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return NULL; /* Exception Thrown */
+
+    jextents = (*env)->NewIntArray(env, 4);
+    if (jextents == NULL)
+        return NULL; /* Exception Thrown */
+
+    extents[0] = region->extents.x1;
+    extents[1] = region->extents.y1;
+    extents[2] = region->extents.x2 - region->extents.x1;
+    extents[3] = region->extents.y2 - region->extents.y1;
+    (*env)->SetIntArrayRegion(env, jextents, 0, 4, extents);
+
+    return jextents;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_Region_containsPoint(JNIEnv * env,
+        jobject jregion, jint x, jint y)
+{
+    struct wl_jni_region *region;
+    struct wl_jni_box *box;
+    int i;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return JNI_FALSE; /* Exception Thrown */
+
+    if (region->count == 0 || x < region->extents.x1
+            || x >= region->extents.x2 || y < region->extents.y1
+            || y >= region->extents.y2)
+        return JNI_FALSE;
+
+    for (i = 0; i < region->count; ++i) {
+        box = &region->boxes[i];
+        if (box->y1 > y)
+            break; /* Bands are sorted */
+        if (y < box->y2 && x >= box->x1 && x < box->x2)
+            return JNI_TRUE;
+    }
+
+    return JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_Region_intersectsRect(JNIEnv * env,
+        jobject jregion, jint x, jint y, jint width, jint height)
+{
+    struct wl_jni_region *region;
+    struct wl_jni_box rect;
+    int i;
+
+    region = wl_jni_region_from_java(env, jregion);
+    if (region == NULL)
+        return JNI_FALSE; /* Exception Thrown */
+
+    box_from_rect(&rect, x, y, width, height);
+    if (region->count == 0 || rect.x1 >= rect.x2 || rect.y1 >= rect.y2
+            || ! extents_overlap(&region->extents, &rect))
+        return JNI_FALSE;
+
+    for (i = 0; i < region->count; ++i) {
+        if (region->boxes[i].y1 >= rect.y2)
+            break; /* Bands are sorted */
+        if (extents_overlap(&region->boxes[i], &rect))
+            return JNI_TRUE;
+    }
+
+    return JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_Region_initializeJNI(JNIEnv * env, jclass cls)
+{
+    Region.class = (*env)->NewGlobalRef(env, cls);
+    if (Region.class == NULL)
+        return; /* Exception Thrown */
+
+    Region.region_ptr = (*env)->GetFieldID(env, Region.class,
+            "region_ptr", "J");
+    if (Region.region_ptr == NULL)
+        return; /* Exception Thrown */
+}
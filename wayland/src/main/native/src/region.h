@@ -0,0 +1,66 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#ifndef __WAYLAND_JAVA_REGION_H__
+#define __WAYLAND_JAVA_REGION_H__
+
+#include <jni.h>
+
+#include <stdint.h>
+
+struct wl_jni_box {
+    int32_t x1, y1, x2, y2;
+};
+
+/*
+ * A set of pixels stored as non-overlapping boxes.  Boxes are half-open:
+ * x1 <= x < x2, y1 <= y < y2.
+ *
+ * The boxes are banded, as in pixman and the X server: they are sorted by
+ * y1 and then x1, boxes with the same y1 form a band sharing one y2, boxes
+ * within a band never touch, and vertically adjacent bands with identical
+ * x spans are merged.  Every operation relies on its inputs being banded
+ * and produces banded output, which keeps them linear in the number of
+ * boxes.  extents is the bounding box, or all zero if the region is empty.
+ */
+struct wl_jni_region {
+    struct wl_jni_box *boxes;
+    int count;
+    int alloc;
+    struct wl_jni_box extents;
+};
+
+void wl_jni_region_init(struct wl_jni_region *region);
+void wl_jni_region_fini(struct wl_jni_region *region);
+/* Replaces the region with the union of count possibly overlapping boxes */
+int wl_jni_region_set_boxes(struct wl_jni_region *region,
+        const struct wl_jni_box *boxes, int count);
+int wl_jni_region_union(struct wl_jni_region *dst,
+        const struct wl_jni_region *a, const struct wl_jni_region *b);
+int wl_jni_region_intersect(struct wl_jni_region *dst,
+        const struct wl_jni_region *a, const struct wl_jni_region *b);
+int wl_jni_region_subtract(struct wl_jni_region *dst,
+        const struct wl_jni_region *a, const struct wl_jni_region *b);
+
+struct wl_jni_region * wl_jni_region_from_java(JNIEnv * env,
+        jobject jregion);
+
+#endif /* ! defined __WAYLAND_JAVA_REGION_H__ */
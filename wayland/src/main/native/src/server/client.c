@@ -20,10 +20,13 @@
  * OF THIS SOFTWARE.
  */
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <errno.h>
+#include <signal.h>
+#include <spawn.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 
@@ -65,23 +68,144 @@ wl_jni_client_to_java(JNIEnv * env, struct wl_client * client)
             (jlong)(intptr_t)client);
 }
 
+/* The fd the client finds its end of the socket on */
+#define CLIENT_SOCKET_FD 3
+#define CLIENT_SOCKET_ENV "WAYLAND_SOCKET=3"
+
+extern char **environ;
+
+/*
+ * Builds the client's environment in the parent, so that the child has
+ * nothing left to do but exec.  WAYLAND_SOCKET is always replaced.
+ */
+static char **
+build_environment(jboolean clear_environment)
+{
+    char **envp;
+    int i, count;
+
+    count = 0;
+    if (! clear_environment)
+        while (environ[count])
+            ++count;
+
+    envp = malloc((count + 2) * sizeof(char *));
+    if (envp == NULL)
+        return NULL;
+
+    count = 0;
+    if (! clear_environment)
+        for (i = 0; environ[i]; ++i)
+            if (strncmp(environ[i], "WAYLAND_SOCKET=", 15) != 0)
+                envp[count++] = environ[i];
+
+    envp[count++] = CLIENT_SOCKET_ENV;
+    envp[count] = NULL;
+
+    return envp;
+}
+
+/*
+ * Starts the client with posix_spawn, handing it fd as its Wayland socket.
+ * Unlike fork(), this neither copies the JVM's page tables nor runs
+ * anything but exec in the child.
+ */
+static int
+spawn_client(JNIEnv * env, const char * exec_path, jarray jargs,
+        jboolean clear_environment, int fd)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t signals;
+    jstring jarg;
+    char ** args;
+    char ** envp;
+    int nargs, arg, err, moved_fd;
+    pid_t pid;
+
+    nargs = jargs ? (*env)->GetArrayLength(env, jargs) : 0;
+    args = calloc(nargs + 1, sizeof(char *));
+    if (args == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return -1;
+    }
+
+    err = 0;
+    moved_fd = -1;
+    for (arg = 0; arg < nargs; ++arg) {
+        jarg = (*env)->GetObjectArrayElement(env, jargs, arg);
+        if ((*env)->ExceptionCheck(env) == JNI_TRUE)
+            goto cleanup_arguments;
+
+        args[arg] = wl_jni_string_to_utf8(env, jarg);
+        (*env)->DeleteLocalRef(env, jarg);
+        if ((*env)->ExceptionCheck(env) == JNI_TRUE)
+            goto cleanup_arguments;
+    }
+
+    envp = build_environment(clear_environment);
+    if (envp == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        goto cleanup_arguments;
+    }
+
+    /* dup2() onto itself would leave close-on-exec set */
+    if (fd == CLIENT_SOCKET_FD) {
+        moved_fd = fcntl(fd, F_DUPFD_CLOEXEC, CLIENT_SOCKET_FD + 1);
+        if (moved_fd < 0) {
+            err = errno;
+            goto cleanup_environment;
+        }
+        fd = moved_fd;
+    }
+
+    posix_spawn_file_actions_init(&actions);
+    err = posix_spawn_file_actions_adddup2(&actions, fd, CLIENT_SOCKET_FD);
+    if (err)
+        goto cleanup_actions;
+
+    /* Don't pass on the JVM's blocked signals or handlers */
+    posix_spawnattr_init(&attr);
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigfillset(&signals);
+    sigdelset(&signals, SIGKILL);
+    sigdelset(&signals, SIGSTOP);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setflags(&attr,
+            POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    err = posix_spawn(&pid, exec_path, &actions, &attr, args, envp);
+
+    posix_spawnattr_destroy(&attr);
+cleanup_actions:
+    posix_spawn_file_actions_destroy(&actions);
+    if (moved_fd >= 0)
+        close(moved_fd);
+cleanup_environment:
+    free(envp);
+
+    if (err)
+        wl_jni_throw_IOException(env, strerror(err));
+
+cleanup_arguments:
+    for (arg = 0; arg < nargs; ++arg)
+        free(args[arg]);
+    free(args);
+
+    return (*env)->ExceptionCheck(env) ? -1 : 0;
+}
+
 JNIEXPORT jobject JNICALL
 Java_org_freedesktop_wayland_server_Client_startClient(JNIEnv * env,
         jclass cls, jobject jdisplay, jobject jfile, jarray jargs,
         jboolean clearEnvironment)
 {
     jmethodID mid;
-    jstring jexec_path, jarg;
+    jstring jexec_path;
     jobject jclient;
-    int nargs, arg;
     char * exec_path;
-    char fd_str[16];
-    char ** args;
-    pid_t pid;
     int sockets[2];
-    int flags;
-
-    jclient = NULL;
 
     /* Make sure that Client is properly loaded */
     ensure_client_object_cache(env, cls);
@@ -101,79 +225,65 @@ Java_org_freedesktop_wayland_server_Client_startClient(JNIEnv * env,
     (*env)->DeleteLocalRef(env, cls);
     (*env)->DeleteLocalRef(env, jexec_path);
 
-    nargs = (*env)->GetArrayLength(env, jargs);
-    args = malloc((nargs + 1) * sizeof(char *));
-    if (args == NULL) {
-        free(exec_path);
-        wl_jni_throw_OutOfMemoryError(env, NULL);
-        return NULL;
-    }
-
-    args[nargs] = NULL;
-    for (arg = 0; arg < nargs; ++arg) {
-        jarg = (*env)->GetObjectArrayElement(env, jargs, arg);
-        if ((*env)->ExceptionCheck(env) == JNI_TRUE) {
-            --arg;
-            goto cleanup_arguments;
-        }
-
-        args[arg] = wl_jni_string_to_utf8(env, jarg);
-        if ((*env)->ExceptionCheck(env) == JNI_TRUE) {
-            goto cleanup_arguments;
-        }
-        (*env)->DeleteLocalRef(env, jarg);
-    }
+    jclient = NULL;
 
-    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets)) {
-        (*env)->ThrowNew(env,
-            (*env)->FindClass(env, "java/lang/io/IOException"),
-            "socketpair failed");
-        goto cleanup_arguments;
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets)) {
+        wl_jni_throw_IOException(env, strerror(errno));
+        goto cleanup_path;
     }
 
-    pid = fork();
-    if (pid == -1) {
-        (*env)->ThrowNew(env,
-                (*env)->FindClass(env, "java/lang/io/IOException"),
-                "Fork Failed");
-    } else if (pid == 0) {
-        // We are the child
-        
-        // Close the parent socket
+    if (spawn_client(env, exec_path, jargs, clearEnvironment, sockets[1]) < 0) {
         close(sockets[0]);
+        close(sockets[1]);
+        goto cleanup_path;
+    }
+    close(sockets[1]);
 
-        if (clearEnvironment)
-            clearenv();
+    jclient = (*env)->NewObject(env, Client.class, Client.init_display_int,
+            jdisplay, (jint)sockets[0]);
 
-        snprintf(fd_str, 16, "%d", sockets[1]);
-        setenv("WAYLAND_SOCKET", fd_str, 1);
+cleanup_path:
+    free(exec_path);
 
-        execv(exec_path, args);
-        // This is bad
-        exit(-1);
-    } else {
-        close(sockets[1]);
-        flags = fcntl(sockets[0], F_GETFD);
-        flags |= FD_CLOEXEC;
-        if (fcntl(sockets[0], F_SETFD, flags) == -1) {
-            (*env)->ThrowNew(env,
-                (*env)->FindClass(env, "java/lang/io/IOException"),
-                "fnctl failed");
-            goto cleanup_arguments;
-        }
+    return jclient;
+}
 
-        jclient = (*env)->NewObject(env, Client.class, Client.init_display_int,
-                jdisplay, (jint)sockets[0]);
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Client_createSocketPair(JNIEnv * env,
+        jclass cls, jintArray jfds)
+{
+    int sockets[2];
 
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets)) {
+        wl_jni_throw_IOException(env, strerror(errno));
+        return;
     }
 
-cleanup_arguments:
-    for (; arg >= 0; --arg)
-        free(args[arg]);
-    free(args);
-    free(exec_path);
+    (*env)->SetIntArrayRegion(env, jfds, 0, 2, (jint *)sockets);
+}
 
-    return jclient;
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Client_closeNative(JNIEnv * env,
+        jclass cls, jint fd)
+{
+    if (close(fd) < 0)
+        wl_jni_throw_from_errno(env, errno);
+}
+
+/* Takes ownership of fd, which is closed whether or not the spawn works */
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Client_spawnNative(JNIEnv * env,
+        jclass cls, jstring jexec_path, jarray jargs,
+        jboolean clearEnvironment, jint fd)
+{
+    char * exec_path;
+
+    exec_path = wl_jni_string_to_default(env, jexec_path);
+    if (exec_path != NULL)
+        spawn_client(env, exec_path, jargs, clearEnvironment, fd);
+
+    free(exec_path);
+    close(fd);
 }
 
 JNIEXPORT void JNICALL
@@ -210,18 +320,18 @@ Java_org_freedesktop_wayland_server_Client_create(JNIEnv * env, jobject jclient,
 
     display = wl_jni_display_from_java(env, jdisplay);
     if ((*env)->ExceptionCheck(env))
-        return; /* Exception Thrown */
+        goto err_close; /* Exception Thrown */
 
     if (display == NULL) {
         wl_jni_throw_NullPointerException(env, "Display cannot be null");
-        return; /* Exception Thrown */
+        goto err_close;
     }
 
     client = wl_client_create(display, fd);
 
     if (client == NULL) {
         wl_jni_throw_from_errno(env, errno);
-        return;
+        goto err_close;
     }
 
     wrapper = wl_jni_object_wrapper_set_data(env, jclient, client);
@@ -237,6 +347,11 @@ Java_org_freedesktop_wayland_server_Client_create(JNIEnv * env, jobject jclient,
     }
 
     wl_client_add_destroy_listener(client, &wrapper->destroy_listener);
+    return;
+
+err_close:
+    /* Destroying a client closes fd; without one, it is closed here */
+    close(fd);
 }
 
 JNIEXPORT void JNICALL
@@ -258,12 +373,13 @@ Java_org_freedesktop_wayland_server_Client_addDestroyListener(JNIEnv * env,
         return;
     }
 
-    jni_listener = wl_jni_destroy_listener_add_to_signal(env, jlistener);
+    client = wl_jni_client_from_java(env, jclient);
+
+    jni_listener = wl_jni_destroy_listener_add_to_signal(env, jlistener,
+            wl_client_get_display(client));
     if (jni_listener == NULL)
         return; /*Exception throw */
 
-    client = wl_jni_client_from_java(env, jclient);
-
     wl_client_add_destroy_listener(client, &jni_listener->listener);
 }
 
@@ -0,0 +1,1111 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+
+#include <wayland-server.h>
+
+#include "server/server-jni.h"
+
+/*
+ * Per-client traffic accounting.  Counters live in a structure hung off a
+ * client destroy listener, so the dispatch paths find them without going
+ * through Java.  When a client goes away its counts are folded into its
+ * display's totals for disconnected clients.  Resource counts and shm
+ * usage are not tracked as they change but computed when a snapshot is
+ * taken.
+ *
+ * The same structure carries outgoing flow control.  libwayland does not
+ * say how much it has buffered for a client, so the queue depth is taken
+ * as what the kernel still holds in the socket plus what was posted since
+ * the last flush.  A flush leaves behind at most what fits in libwayland's
+ * own bounded buffer, so only the kernel part is carried over.  Clients
+ * above the high-water mark are congested: their replaceable events are
+ * coalesced, keeping only the newest per resource and key, until they are
+ * back under it.  Congested clients are measured again once their socket
+ * takes more, or every CONGESTION_RECHECK_MS while it polls writable but
+ * still holds too much.  Clients above the disconnect mark are destroyed
+ * from an idle callback.
+ */
+
+/* Must match ClientStatistics */
+#define TOTAL_REQUESTS          0
+#define TOTAL_EVENTS            1
+#define TOTAL_BYTES_QUEUED      2
+#define TOTAL_RESOURCES         3
+#define TOTAL_SHM_BYTES         4
+#define TOTAL_HANDLER_NANOS     5
+#define TOTAL_COALESCED         6
+#define TOTAL_DEFERRED          7
+#define TOTAL_COUNT             8
+
+/* Most arguments a coalesced event may have */
+#define COALESCED_MAX_ARGS      8
+
+#define CONGESTION_RECHECK_MS   10
+
+struct interface_counts {
+    const struct wl_interface *interface;
+    uint64_t *requests;
+    uint64_t *events;
+};
+
+struct display_stats;
+
+struct client_stats {
+    struct wl_client *client;
+    struct display_stats *display;
+    struct wl_listener destroy_listener;
+    struct wl_list link;
+
+    uint64_t requests;
+    uint64_t events;
+    uint64_t bytes_queued;
+    uint64_t handler_ns;
+    uint64_t coalesced;
+
+    /* Requests whose handlers are running, innermost first */
+    struct wl_jni_request_stats *dispatching;
+
+    struct interface_counts *interfaces;
+    int interface_count;
+    int interface_alloc;
+    int last_interface;
+
+    /* Flow control */
+    struct wl_list dirty_link;
+    uint64_t unflushed;
+    uint64_t kernel_queued;
+    int congested;
+    struct wl_list coalesced_events;
+    struct wl_event_source *writable_source;
+    struct wl_event_source *recheck_source;
+    struct wl_event_source *disconnect_source;
+};
+
+struct replaceable_event {
+    char *interface;
+    uint32_t opcode;
+    int key;
+};
+
+struct coalesced_event {
+    struct wl_resource *resource;
+    struct wl_listener resource_destroy_listener;
+    struct wl_list link;
+    uint32_t opcode;
+    int32_t key;
+    union wl_argument args[COALESCED_MAX_ARGS];
+};
+
+struct display_stats {
+    struct wl_display *display;
+    struct wl_listener destroy_listener;
+    struct wl_list clients;
+    struct client_stats retired;
+
+    /* Clients with events posted since the last flush */
+    struct wl_list dirty;
+    uint64_t high_water;
+    uint64_t disconnect_water;
+    struct replaceable_event *replaceable;
+    int replaceable_count;
+};
+
+struct {
+    jclass class;
+    jmethodID init;
+} ClientStatistics;
+
+static struct interface_counts *
+interface_counts_get(struct client_stats *stats,
+        const struct wl_interface *interface)
+{
+    struct interface_counts *counts;
+    uint64_t *block;
+    int i, size;
+
+    /* Traffic tends to come in runs on one interface */
+    if (stats->last_interface < stats->interface_count) {
+        counts = &stats->interfaces[stats->last_interface];
+        if (counts->interface == interface)
+            return counts;
+    }
+
+    for (i = 0; i < stats->interface_count; ++i) {
+        if (stats->interfaces[i].interface == interface) {
+            stats->last_interface = i;
+            return &stats->interfaces[i];
+        }
+    }
+
+    if (stats->interface_count == stats->interface_alloc) {
+        size = stats->interface_alloc ? stats->interface_alloc * 2 : 8;
+        counts = realloc(stats->interfaces, size * sizeof(*counts));
+        if (counts == NULL)
+            return NULL;
+        stats->interfaces = counts;
+        stats->interface_alloc = size;
+    }
+
+    size = interface->method_count + interface->event_count;
+    block = calloc(size ? size : 1, sizeof(uint64_t));
+    if (block == NULL)
+        return NULL;
+
+    counts = &stats->interfaces[stats->interface_count];
+    counts->interface = interface;
+    counts->requests = block;
+    counts->events = block + interface->method_count;
+
+    stats->last_interface = stats->interface_count++;
+    return counts;
+}
+
+static void
+client_stats_merge(struct client_stats *dst, struct client_stats *src)
+{
+    struct interface_counts *from, *to;
+    int i, j;
+
+    dst->requests += src->requests;
+    dst->events += src->events;
+    dst->bytes_queued += src->bytes_queued;
+    dst->handler_ns += src->handler_ns;
+    dst->coalesced += src->coalesced;
+
+    for (i = 0; i < src->interface_count; ++i) {
+        from = &src->interfaces[i];
+        to = interface_counts_get(dst, from->interface);
+        if (to == NULL)
+            continue;
+
+        for (j = 0; j < from->interface->method_count; ++j)
+            to->requests[j] += from->requests[j];
+        for (j = 0; j < from->interface->event_count; ++j)
+            to->events[j] += from->events[j];
+    }
+}
+
+static void
+client_stats_release(struct client_stats *stats)
+{
+    int i;
+
+    for (i = 0; i < stats->interface_count; ++i)
+        free(stats->interfaces[i].requests);
+    free(stats->interfaces);
+}
+
+static void
+coalesced_event_destroy(struct coalesced_event *event)
+{
+    wl_list_remove(&event->resource_destroy_listener.link);
+    wl_list_remove(&event->link);
+    free(event);
+}
+
+static void
+coalesced_event_resource_destroyed(struct wl_listener *listener, void *data)
+{
+    struct coalesced_event *event;
+
+    event = wl_container_of(listener, event, resource_destroy_listener);
+    coalesced_event_destroy(event);
+}
+
+/* Drops everything flow control holds on to for the client */
+static void
+client_stats_stop_flow_control(struct client_stats *stats)
+{
+    struct coalesced_event *event, *tmp;
+
+    wl_list_for_each_safe(event, tmp, &stats->coalesced_events, link)
+        coalesced_event_destroy(event);
+
+    if (stats->writable_source) {
+        wl_event_source_remove(stats->writable_source);
+        stats->writable_source = NULL;
+    }
+
+    if (stats->recheck_source) {
+        wl_event_source_remove(stats->recheck_source);
+        stats->recheck_source = NULL;
+    }
+
+    if (stats->disconnect_source) {
+        wl_event_source_remove(stats->disconnect_source);
+        stats->disconnect_source = NULL;
+    }
+
+    wl_list_remove(&stats->dirty_link);
+    wl_list_init(&stats->dirty_link);
+    stats->congested = 0;
+}
+
+static void
+display_stats_destroy_func(struct wl_listener *listener, void *data)
+{
+    struct display_stats *display;
+    struct client_stats *stats, *tmp;
+    int i;
+
+    display = wl_container_of(listener, display, destroy_listener);
+
+    /* Clients may outlive the display; they just stop reporting to it */
+    wl_list_for_each_safe(stats, tmp, &display->clients, link) {
+        client_stats_stop_flow_control(stats);
+        wl_list_remove(&stats->link);
+        wl_list_init(&stats->link);
+        stats->display = NULL;
+    }
+
+    wl_list_remove(&display->destroy_listener.link);
+    client_stats_release(&display->retired);
+
+    for (i = 0; i < display->replaceable_count; ++i)
+        free(display->replaceable[i].interface);
+    free(display->replaceable);
+
+    free(display);
+}
+
+static struct replaceable_event *
+replaceable_event_find(struct display_stats *display, const char *interface,
+        uint32_t opcode)
+{
+    int i;
+
+    for (i = 0; i < display->replaceable_count; ++i)
+        if (display->replaceable[i].opcode == opcode
+                && strcmp(display->replaceable[i].interface, interface) == 0)
+            return &display->replaceable[i];
+
+    return NULL;
+}
+
+static int
+replaceable_event_add(struct display_stats *display, const char *interface,
+        uint32_t opcode, int key)
+{
+    struct replaceable_event *event;
+
+    event = replaceable_event_find(display, interface, opcode);
+    if (event) {
+        event->key = key;
+        return 0;
+    }
+
+    event = realloc(display->replaceable,
+            (display->replaceable_count + 1) * sizeof(*event));
+    if (event == NULL)
+        return -1;
+    display->replaceable = event;
+
+    event = &display->replaceable[display->replaceable_count];
+    event->interface = strdup(interface);
+    if (event->interface == NULL)
+        return -1;
+    event->opcode = opcode;
+    event->key = key;
+    ++display->replaceable_count;
+
+    return 0;
+}
+
+static struct display_stats *
+display_stats_get(struct wl_display *display, int create)
+{
+    struct display_stats *stats;
+    struct wl_listener *listener;
+
+    listener = wl_display_get_destroy_listener(display,
+            display_stats_destroy_func);
+    if (listener != NULL)
+        return wl_container_of(listener, stats, destroy_listener);
+
+    if (! create)
+        return NULL;
+
+    stats = calloc(1, sizeof(*stats));
+    if (stats == NULL)
+        return NULL;
+
+    stats->display = display;
+    wl_list_init(&stats->clients);
+    wl_list_init(&stats->dirty);
+
+    /* Pointer motion, and touch motion per touch point */
+    replaceable_event_add(stats, "wl_pointer", 2, -1);
+    replaceable_event_add(stats, "wl_touch", 2, 1);
+
+    stats->destroy_listener.notify = display_stats_destroy_func;
+    wl_display_add_destroy_listener(display, &stats->destroy_listener);
+
+    return stats;
+}
+
+static void
+client_stats_destroy_func(struct wl_listener *listener, void *data)
+{
+    struct client_stats *stats;
+
+    struct wl_jni_request_stats *request;
+
+    stats = wl_container_of(listener, stats, destroy_listener);
+
+    /* A handler destroyed its own client; its time is not accounted */
+    for (request = stats->dispatching; request; request = request->prev)
+        request->stats = NULL;
+
+    if (stats->display)
+        client_stats_merge(&stats->display->retired, stats);
+
+    client_stats_stop_flow_control(stats);
+    wl_list_remove(&stats->link);
+    client_stats_release(stats);
+    free(stats);
+}
+
+static struct client_stats *
+client_stats_get(struct wl_client *client, int create)
+{
+    struct client_stats *stats;
+    struct wl_listener *listener;
+
+    listener = wl_client_get_destroy_listener(client,
+            client_stats_destroy_func);
+    if (listener != NULL)
+        return wl_container_of(listener, stats, destroy_listener);
+
+    if (! create)
+        return NULL;
+
+    stats = calloc(1, sizeof(*stats));
+    if (stats == NULL)
+        return NULL;
+
+    stats->client = client;
+    wl_list_init(&stats->dirty_link);
+    wl_list_init(&stats->coalesced_events);
+    stats->display = display_stats_get(wl_client_get_display(client), 1);
+    if (stats->display)
+        wl_list_insert(&stats->display->clients, &stats->link);
+    else
+        wl_list_init(&stats->link);
+
+    stats->destroy_listener.notify = client_stats_destroy_func;
+    wl_client_add_destroy_listener(client, &stats->destroy_listener);
+
+    return stats;
+}
+
+static void client_stats_update_congestion(struct client_stats *stats);
+
+static void
+client_stats_mark_dirty(struct client_stats *stats)
+{
+    if (stats->display && wl_list_empty(&stats->dirty_link))
+        wl_list_insert(&stats->display->dirty, &stats->dirty_link);
+}
+
+static void
+disconnect_client(void *data)
+{
+    struct client_stats *stats = data;
+
+    /* Idle sources go away once dispatched */
+    stats->disconnect_source = NULL;
+    wl_client_destroy(stats->client);
+}
+
+static void
+client_stats_check_disconnect(struct client_stats *stats)
+{
+    struct display_stats *display = stats->display;
+
+    if (display == NULL || display->disconnect_water == 0
+            || stats->disconnect_source != NULL)
+        return;
+
+    if (stats->kernel_queued + stats->unflushed <= display->disconnect_water)
+        return;
+
+    /* Not from here, as the caller may still be using its resources */
+    stats->disconnect_source = wl_event_loop_add_idle(
+            wl_display_get_event_loop(display->display), disconnect_client,
+            stats);
+}
+
+/*
+ * Counts a request before its handler runs, as the handler may destroy the
+ * resource or the client.  The handler time is added afterwards by
+ * wl_jni_client_stats_request_done(), which must always follow.
+ */
+void
+wl_jni_client_stats_request(struct wl_jni_request_stats *request,
+        struct wl_resource *resource, uint32_t opcode)
+{
+    struct client_stats *stats;
+    struct interface_counts *counts;
+
+    request->stats = NULL;
+    request->prev = NULL;
+
+    stats = client_stats_get(resource->client, 1);
+    if (stats == NULL)
+        return;
+
+    ++stats->requests;
+
+    counts = interface_counts_get(stats, resource->object.interface);
+    if (counts != NULL)
+        ++counts->requests[opcode];
+
+    request->stats = stats;
+    request->prev = stats->dispatching;
+    stats->dispatching = request;
+}
+
+void
+wl_jni_client_stats_request_done(struct wl_jni_request_stats *request,
+        uint64_t handler_ns)
+{
+    struct client_stats *stats = request->stats;
+
+    if (stats == NULL)
+        return;
+
+    stats->handler_ns += handler_ns;
+    stats->dispatching = request->prev;
+}
+
+/* Size of the event on the wire; file descriptors travel out of band */
+static uint32_t
+event_size(const char *signature, const union wl_argument *args)
+{
+    uint32_t size;
+    int i;
+
+    size = 8;
+    for (i = 0; *signature; ++signature) {
+        switch (*signature) {
+        case 'i':
+        case 'u':
+        case 'f':
+        case 'o':
+        case 'n':
+            size += 4;
+            break;
+        case 's':
+            size += 4;
+            if (args[i].s)
+                size += (strlen(args[i].s) + 1 + 3) & ~3;
+            break;
+        case 'a':
+            size += 4;
+            if (args[i].a)
+                size += (args[i].a->size + 3) & ~3;
+            break;
+        case 'h':
+            break;
+        default:
+            continue;
+        }
+        ++i;
+    }
+
+    return size;
+}
+
+void
+wl_jni_client_stats_event(struct wl_resource *resource, uint32_t opcode,
+        const union wl_argument *args)
+{
+    struct client_stats *stats;
+    struct interface_counts *counts;
+    const struct wl_interface *interface;
+    uint32_t size;
+
+    stats = client_stats_get(resource->client, 1);
+    if (stats == NULL)
+        return;
+
+    interface = resource->object.interface;
+
+    size = event_size(interface->events[opcode].signature, args);
+    ++stats->events;
+    stats->bytes_queued += size;
+    stats->unflushed += size;
+
+    counts = interface_counts_get(stats, interface);
+    if (counts != NULL)
+        ++counts->events[opcode];
+
+    client_stats_mark_dirty(stats);
+    client_stats_check_disconnect(stats);
+}
+
+static void
+replay_coalesced_event(struct coalesced_event *event)
+{
+    wl_resource_post_event_array(event->resource, event->opcode, event->args);
+    wl_jni_client_stats_event(event->resource, event->opcode, event->args);
+    coalesced_event_destroy(event);
+}
+
+/* Sends the events held back for one resource, in the order they came */
+static void
+replay_resource_events(struct client_stats *stats,
+        struct wl_resource *resource)
+{
+    struct coalesced_event *event, *tmp;
+
+    wl_list_for_each_safe(event, tmp, &stats->coalesced_events, link) {
+        if (event->resource == resource)
+            replay_coalesced_event(event);
+    }
+}
+
+/*
+ * Called before an event is posted.  Returns nonzero if the client is
+ * congested and the event was coalesced or dropped instead.
+ */
+int
+wl_jni_client_filter_event(struct wl_resource *resource, uint32_t opcode,
+        const union wl_argument *args)
+{
+    struct client_stats *stats;
+    struct replaceable_event *replaceable;
+    struct coalesced_event *event;
+    const struct wl_interface *interface;
+    const char *signature;
+    int nargs, storable;
+    int32_t key;
+
+    stats = client_stats_get(resource->client, 0);
+    if (stats == NULL)
+        return 0;
+
+    if (! stats->congested || stats->display == NULL) {
+        replay_resource_events(stats, resource);
+        return 0;
+    }
+
+    interface = resource->object.interface;
+    replaceable = replaceable_event_find(stats->display, interface->name,
+            opcode);
+    if (replaceable == NULL) {
+        /* Held events must not be overtaken by ones sent straight away */
+        replay_resource_events(stats, resource);
+        return 0;
+    }
+
+    ++stats->coalesced;
+    client_stats_mark_dirty(stats);
+
+    /* Only events made of plain values can be kept for later */
+    nargs = 0;
+    storable = 1;
+    for (signature = interface->events[opcode].signature; *signature;
+            ++signature) {
+        switch (*signature) {
+        case 'i':
+        case 'u':
+        case 'f':
+            ++nargs;
+            break;
+        case 's':
+        case 'o':
+        case 'n':
+        case 'a':
+        case 'h':
+            storable = 0;
+            break;
+        }
+    }
+    if (! storable || nargs > COALESCED_MAX_ARGS)
+        return 1;
+
+    key = replaceable->key >= 0 && replaceable->key < nargs ?
+            args[replaceable->key].i : 0;
+
+    wl_list_for_each(event, &stats->coalesced_events, link) {
+        if (event->resource == resource && event->opcode == opcode
+                && event->key == key) {
+            memcpy(event->args, args, nargs * sizeof(union wl_argument));
+            return 1;
+        }
+    }
+
+    event = malloc(sizeof(*event));
+    if (event == NULL)
+        return 1;
+
+    event->resource = resource;
+    event->opcode = opcode;
+    event->key = key;
+    memcpy(event->args, args, nargs * sizeof(union wl_argument));
+
+    event->resource_destroy_listener.notify =
+            coalesced_event_resource_destroyed;
+    wl_signal_add(&resource->destroy_signal,
+            &event->resource_destroy_listener);
+    wl_list_insert(stats->coalesced_events.prev, &event->link);
+
+    return 1;
+}
+
+static void
+replay_coalesced_events(struct client_stats *stats)
+{
+    struct coalesced_event *event, *tmp;
+
+    wl_list_for_each_safe(event, tmp, &stats->coalesced_events, link)
+        replay_coalesced_event(event);
+}
+
+static int
+handle_client_writable(int fd, uint32_t mask, void *data)
+{
+    struct client_stats *stats = data;
+
+    wl_client_flush(stats->client);
+    client_stats_update_congestion(stats);
+
+    return 0;
+}
+
+static int
+handle_client_recheck(void *data)
+{
+    struct client_stats *stats = data;
+
+    wl_client_flush(stats->client);
+    client_stats_update_congestion(stats);
+
+    return 0;
+}
+
+/*
+ * Makes sure a congested client gets measured again even if nothing more
+ * is posted to it.  A writable watch would fire continuously on a socket
+ * that already polls writable, so such clients are polled on a timer.
+ */
+static void
+client_stats_watch_congestion(struct client_stats *stats, int fd)
+{
+    struct wl_event_loop *loop;
+    struct pollfd pfd;
+    int writable;
+
+    loop = wl_display_get_event_loop(stats->display->display);
+
+    writable = 0;
+    if (stats->congested) {
+        pfd.fd = fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        writable = poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLOUT);
+    }
+
+    if (stats->congested && ! writable) {
+        if (stats->writable_source == NULL)
+            stats->writable_source = wl_event_loop_add_fd(loop, fd,
+                    WL_EVENT_WRITABLE, handle_client_writable, stats);
+    } else if (stats->writable_source) {
+        wl_event_source_remove(stats->writable_source);
+        stats->writable_source = NULL;
+    }
+
+    if (stats->congested && writable) {
+        if (stats->recheck_source == NULL)
+            stats->recheck_source = wl_event_loop_add_timer(loop,
+                    handle_client_recheck, stats);
+        if (stats->recheck_source)
+            wl_event_source_timer_update(stats->recheck_source,
+                    CONGESTION_RECHECK_MS);
+    } else if (stats->recheck_source) {
+        wl_event_source_timer_update(stats->recheck_source, 0);
+    }
+}
+
+/*
+ * Re-measures a client's outgoing queue right after a flush and moves it
+ * in or out of the congested state.
+ */
+static void
+client_stats_update_congestion(struct client_stats *stats)
+{
+    struct display_stats *display = stats->display;
+    int fd, queued;
+
+    fd = wl_client_get_fd(stats->client);
+    if (ioctl(fd, SIOCOUTQ, &queued) == 0)
+        stats->kernel_queued = queued;
+    stats->unflushed = 0;
+
+    if (! stats->congested) {
+        if (display->high_water && stats->kernel_queued > display->high_water)
+            stats->congested = 1;
+    } else if (display->high_water == 0
+            || stats->kernel_queued <= display->high_water) {
+        stats->congested = 0;
+        replay_coalesced_events(stats);
+        wl_client_flush(stats->client);
+        stats->unflushed = 0;
+    }
+
+    client_stats_watch_congestion(stats, fd);
+    client_stats_check_disconnect(stats);
+}
+
+/*
+ * Flushes every client, then re-measures the queues of those that had
+ * events posted since the last flush.  libwayland switches clients whose
+ * sockets are full to writable interest itself, so blocked clients finish
+ * flushing from the event loop.
+ */
+void
+wl_jni_display_flush_clients(struct wl_display *display)
+{
+    struct display_stats *dstats;
+    struct client_stats *stats, *tmp;
+    int limited;
+
+    wl_display_flush_clients(display);
+
+    dstats = display_stats_get(display, 0);
+    if (dstats == NULL)
+        return;
+
+    limited = dstats->high_water || dstats->disconnect_water;
+    wl_list_for_each_safe(stats, tmp, &dstats->dirty, dirty_link) {
+        wl_list_remove(&stats->dirty_link);
+        wl_list_init(&stats->dirty_link);
+
+        if (limited)
+            client_stats_update_congestion(stats);
+        else
+            stats->unflushed = 0;
+    }
+}
+
+int
+wl_jni_client_is_congested(struct wl_client *client)
+{
+    struct client_stats *stats;
+
+    stats = client_stats_get(client, 0);
+
+    return stats != NULL && stats->congested;
+}
+
+struct resource_usage {
+    jlong resources;
+    jlong shm_bytes;
+};
+
+static enum wl_iterator_result
+add_resource_usage(struct wl_resource *resource, void *data)
+{
+    struct resource_usage *usage = data;
+    struct wl_shm_buffer *buffer;
+
+    ++usage->resources;
+
+    buffer = wl_shm_buffer_get(resource);
+    if (buffer)
+        usage->shm_bytes += (jlong)wl_shm_buffer_get_stride(buffer)
+                * wl_shm_buffer_get_height(buffer);
+
+    return WL_ITERATOR_CONTINUE;
+}
+
+static jlongArray
+counts_to_java(JNIEnv * env, const uint64_t *counts, int count)
+{
+    jlongArray jcounts;
+
+    jcounts = (*env)->NewLongArray(env, count);
+    if (jcounts == NULL)
+        return NULL; /* Exception Thrown */
+
+    (*env)->SetLongArrayRegion(env, jcounts, 0, count, (const jlong *)counts);
+
+    return jcounts;
+}
+
+static jobject
+client_stats_to_java(JNIEnv * env, struct client_stats *stats,
+        struct resource_usage *usage, uint64_t deferred)
+{
+    jlong totals[TOTAL_COUNT];
+    jlongArray jtotals, jcounts;
+    jobjectArray jnames, jrequests, jevents;
+    jclass cls;
+    jstring jname;
+    struct interface_counts *counts;
+    int i;
+
+    if (ClientStatistics.class == NULL) {
+        cls = (*env)->FindClass(env,
+                "org/freedesktop/wayland/server/ClientStatistics");
+        if (cls == NULL)
+            return NULL; /* Exception Thrown */
+        ClientStatistics.init = (*env)->GetMethodID(env, cls, "<init>",
+                "([J[Ljava/lang/String;[[J[[J)V");
+        if (ClientStatistics.init == NULL)
+            return NULL; /* Exception Thrown */
+        ClientStatistics.class = (*env)->NewGlobalRef(env, cls);
+        (*env)->DeleteLocalRef(env, cls);
+        if (ClientStatistics.class == NULL)
+            return NULL; /* Exception Thrown */
+    }
+
+    totals[TOTAL_REQUESTS] = stats->requests;
+    totals[TOTAL_EVENTS] = stats->events;
+    totals[TOTAL_BYTES_QUEUED] = stats->bytes_queued;
+    totals[TOTAL_RESOURCES] = usage->resources;
+    totals[TOTAL_SHM_BYTES] = usage->shm_bytes;
+    totals[TOTAL_HANDLER_NANOS] = stats->handler_ns;
+    totals[TOTAL_COALESCED] = stats->coalesced;
+    totals[TOTAL_DEFERRED] = deferred;
+
+    jtotals = (*env)->NewLongArray(env, TOTAL_COUNT);
+    if (jtotals == NULL)
+        return NULL; /* Exception Thrown */
+    (*env)->SetLongArrayRegion(env, jtotals, 0, TOTAL_COUNT, totals);
+
+    jnames = (*env)->NewObjectArray(env, stats->interface_count,
+            (*env)->FindClass(env, "java/lang/String"), NULL);
+    if (jnames == NULL)
+        return NULL; /* Exception Thrown */
+
+    cls = (*env)->GetObjectClass(env, jtotals);
+    jrequests = (*env)->NewObjectArray(env, stats->interface_count, cls, NULL);
+    if (jrequests == NULL)
+        return NULL; /* Exception Thrown */
+    jevents = (*env)->NewObjectArray(env, stats->interface_count, cls, NULL);
+    if (jevents == NULL)
+        return NULL; /* Exception Thrown */
+    (*env)->DeleteLocalRef(env, cls);
+
+    for (i = 0; i < stats->interface_count; ++i) {
+        counts = &stats->interfaces[i];
+
+        jname = (*env)->NewStringUTF(env, counts->interface->name);
+        if (jname == NULL)
+            return NULL; /* Exception Thrown */
+        (*env)->SetObjectArrayElement(env, jnames, i, jname);
+        (*env)->DeleteLocalRef(env, jname);
+
+        jcounts = counts_to_java(env, counts->requests,
+                counts->interface->method_count);
+        if (jcounts == NULL)
+            return NULL; /* Exception Thrown */
+        (*env)->SetObjectArrayElement(env, jrequests, i, jcounts);
+        (*env)->DeleteLocalRef(env, jcounts);
+
+        jcounts = counts_to_java(env, counts->events,
+                counts->interface->event_count);
+        if (jcounts == NULL)
+            return NULL; /* Exception Thrown */
+        (*env)->SetObjectArrayElement(env, jevents, i, jcounts);
+        (*env)->DeleteLocalRef(env, jcounts);
+    }
+
+    return (*env)->NewObject(env, ClientStatistics.class,
+            ClientStatistics.init, jtotals, jnames, jrequests, jevents);
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_freedesktop_wayland_server_Client_getStatistics(JNIEnv * env,
+        jobject jclient)
+{
+    struct wl_client *client;
+    struct client_stats empty, *stats;
+    struct resource_usage usage;
+
+    client = wl_jni_client_from_java(env, jclient);
+    if (client == NULL) {
+        if (! (*env)->ExceptionCheck(env))
+            wl_jni_throw_IllegalStateException(env, "Client destroyed");
+        return NULL;
+    }
+
+    stats = client_stats_get(client, 0);
+    if (stats == NULL) {
+        memset(&empty, 0, sizeof(empty));
+        stats = &empty;
+    }
+
+    memset(&usage, 0, sizeof(usage));
+    wl_client_for_each_resource(client, add_resource_usage, &usage);
+
+    return client_stats_to_java(env, stats, &usage,
+            wl_jni_client_deferred_requests(client));
+}
+
+/*
+ * Traffic totals cover every client the display has had; resource and shm
+ * usage only the ones still connected.
+ */
+JNIEXPORT jobject JNICALL
+Java_org_freedesktop_wayland_server_Display_getClientStatistics(JNIEnv * env,
+        jobject jdisplay)
+{
+    struct wl_display *display;
+    struct display_stats *dstats;
+    struct client_stats total, *stats;
+    struct resource_usage usage;
+    jobject jstats;
+
+    display = wl_jni_display_from_java(env, jdisplay);
+    if (display == NULL) {
+        if (! (*env)->ExceptionCheck(env))
+            wl_jni_throw_IllegalStateException(env, "Display destroyed");
+        return NULL;
+    }
+
+    memset(&total, 0, sizeof(total));
+    memset(&usage, 0, sizeof(usage));
+
+    dstats = display_stats_get(display, 0);
+    if (dstats) {
+        client_stats_merge(&total, &dstats->retired);
+        wl_list_for_each(stats, &dstats->clients, link) {
+            client_stats_merge(&total, stats);
+            wl_client_for_each_resource(stats->client, add_resource_usage,
+                    &usage);
+        }
+    }
+
+    jstats = client_stats_to_java(env, &total, &usage,
+            wl_jni_display_deferred_requests(display));
+    client_stats_release(&total);
+
+    return jstats;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Display_setOutgoingLimits(JNIEnv * env,
+        jobject jdisplay, jlong high_water, jlong disconnect_water)
+{
+    struct wl_display *display;
+    struct display_stats *dstats;
+
+    display = wl_jni_display_from_java(env, jdisplay);
+    if (display == NULL) {
+        if (! (*env)->ExceptionCheck(env))
+            wl_jni_throw_IllegalStateException(env, "Display destroyed");
+        return;
+    }
+
+    if (high_water < 0 || disconnect_water < 0) {
+        wl_jni_throw_IllegalArgumentException(env, "Negative limit");
+        return;
+    }
+
+    dstats = display_stats_get(display, 1);
+    if (dstats == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return;
+    }
+
+    dstats->high_water = high_water;
+    dstats->disconnect_water = disconnect_water;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Display_addReplaceableEvent(JNIEnv * env,
+        jobject jdisplay, jstring jinterface, jint opcode, jint key)
+{
+    struct wl_display *display;
+    struct display_stats *dstats;
+    char *interface;
+
+    display = wl_jni_display_from_java(env, jdisplay);
+    if (display == NULL) {
+        if (! (*env)->ExceptionCheck(env))
+            wl_jni_throw_IllegalStateException(env, "Display destroyed");
+        return;
+    }
+
+    if (jinterface == NULL) {
+        wl_jni_throw_NullPointerException(env,
+                "interface not allowed to be null");
+        return;
+    }
+
+    if (opcode < 0 || key < -1 || key >= COALESCED_MAX_ARGS) {
+        wl_jni_throw_IllegalArgumentException(env,
+                "Invalid opcode or key argument");
+        return;
+    }
+
+    interface = wl_jni_string_to_utf8(env, jinterface);
+    if (interface == NULL)
+        return; /* Exception Thrown */
+
+    dstats = display_stats_get(display, 1);
+    if (dstats == NULL || replaceable_event_add(dstats, interface, opcode,
+            key) < 0)
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+
+    free(interface);
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_freedesktop_wayland_server_Client_getOutgoingBytes(JNIEnv * env,
+        jobject jclient)
+{
+    struct wl_client *client;
+    struct client_stats *stats;
+
+    client = wl_jni_client_from_java(env, jclient);
+    if (client == NULL)
+        return 0;
+
+    stats = client_stats_get(client, 0);
+    if (stats == NULL)
+        return 0;
+
+    return stats->kernel_queued + stats->unflushed;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_server_Client_isCongested(JNIEnv * env,
+        jobject jclient)
+{
+    struct wl_client *client;
+
+    client = wl_jni_client_from_java(env, jclient);
+    if (client == NULL)
+        return JNI_FALSE;
+
+    return wl_jni_client_is_congested(client) ? JNI_TRUE : JNI_FALSE;
+}
@@ -0,0 +1,300 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#include <stdlib.h>
+
+#include "server-jni.h"
+#include "pixel-ops.h"
+
+/* Must match SoftwareCompositor.java */
+#define LAYER_X         0
+#define LAYER_Y         1
+#define LAYER_WIDTH     2
+#define LAYER_HEIGHT    3
+#define LAYER_STRIDE    4
+#define LAYER_FORMAT    5
+#define LAYER_OPACITY   6
+#define LAYER_OPAQUE    7
+#define LAYER_SIZE      8
+
+/* wl_shm.FORMAT_* */
+#define FORMAT_ARGB8888 0
+#define FORMAT_XRGB8888 1
+
+#define PIXEL(p, stride, x, y) \
+    ((uint32_t *)((char *)(p) + (ptrdiff_t)(y) * (stride)) + (x))
+
+struct {
+    jclass Resource;
+} SoftwareCompositor;
+
+struct compositor_layer {
+    uint32_t *data;
+    struct wl_shm_buffer *shm;
+    int32_t x, y, width, height, stride;
+    uint32_t opacity;
+    uint32_t or_mask;
+    int opaque;
+};
+
+/*
+ * A snapshot of the surface stack taken on the display thread.  Tiles are
+ * then composed from it on any thread, which is safe as long as the
+ * display thread does not dispatch client requests until the frame ends.
+ */
+struct compositor_frame {
+    uint32_t *output;
+    int32_t stride, width, height;
+    uint32_t background;
+    int count;
+    struct compositor_layer layers[];
+};
+
+static int
+layer_from_shm_buffer(JNIEnv * env, struct compositor_layer *layer,
+        jobject jresource)
+{
+    struct wl_resource *resource;
+    uint32_t format;
+
+    resource = wl_jni_resource_from_java(env, jresource);
+    if (resource == NULL)
+        return 0;
+
+    layer->shm = wl_shm_buffer_get(resource);
+    if (layer->shm == NULL)
+        return 0;
+
+    /* A format the engine can't read is skipped rather than misread */
+    format = wl_shm_buffer_get_format(layer->shm);
+    if (format != FORMAT_ARGB8888 && format != FORMAT_XRGB8888)
+        return 0;
+
+    layer->data = wl_shm_buffer_get_data(layer->shm);
+    layer->width = wl_shm_buffer_get_width(layer->shm);
+    layer->height = wl_shm_buffer_get_height(layer->shm);
+    layer->stride = wl_shm_buffer_get_stride(layer->shm);
+    layer->or_mask = format == FORMAT_XRGB8888 ? 0xff000000 : 0;
+
+    return 1;
+}
+
+static int
+layer_from_byte_buffer(JNIEnv * env, struct compositor_layer *layer,
+        jobject jbuffer, const jint *info)
+{
+    char *data;
+    jlong capacity;
+
+    data = (*env)->GetDirectBufferAddress(env, jbuffer);
+    capacity = (*env)->GetDirectBufferCapacity(env, jbuffer);
+    if (data == NULL || capacity < 0) {
+        wl_jni_throw_IllegalArgumentException(env, "Not a direct buffer");
+        return -1;
+    }
+
+    layer->shm = NULL;
+    layer->data = (uint32_t *)data;
+    layer->width = info[LAYER_WIDTH];
+    layer->height = info[LAYER_HEIGHT];
+    layer->stride = info[LAYER_STRIDE];
+    layer->or_mask = info[LAYER_FORMAT] == FORMAT_XRGB8888 ? 0xff000000 : 0;
+
+    if (((uintptr_t)data & 3) != 0 || (layer->stride & 3) != 0
+            || (jlong)layer->width * 4 > layer->stride
+            || (layer->height > 0 && (jlong)(layer->height - 1)
+                * layer->stride + (jlong)layer->width * 4 > capacity)) {
+        wl_jni_throw_IllegalArgumentException(env,
+                "Surface buffer does not match its size");
+        return -1;
+    }
+
+    return 1;
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_freedesktop_wayland_server_SoftwareCompositor_beginFrameNative(
+        JNIEnv * env, jclass cls, jobject joutput, jint stride, jint width,
+        jint height, jint background, jobjectArray jsources,
+        jintArray jlayers, jint count)
+{
+    struct compositor_frame *frame;
+    struct compositor_layer *layer;
+    jobject jsource;
+    jint *layers;
+    int i, ret;
+
+    frame = malloc(sizeof(*frame) + count * sizeof(frame->layers[0]));
+    layers = malloc(count * LAYER_SIZE * sizeof(jint) + 1);
+    if (frame == NULL || layers == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        goto err;
+    }
+
+    frame->output = (*env)->GetDirectBufferAddress(env, joutput);
+    if (frame->output == NULL || ((uintptr_t)frame->output & 3) != 0
+            || (*env)->GetDirectBufferCapacity(env, joutput)
+                < (jlong)stride * height) {
+        wl_jni_throw_IllegalArgumentException(env, "Invalid output buffer");
+        goto err;
+    }
+    frame->stride = stride;
+    frame->width = width;
+    frame->height = height;
+    frame->background = background;
+    frame->count = 0;
+
+    (*env)->GetIntArrayRegion(env, jlayers, 0, count * LAYER_SIZE, layers);
+    if ((*env)->ExceptionCheck(env))
+        goto err; /* Exception Thrown */
+
+    for (i = 0; i < count; ++i) {
+        const jint *info = layers + i * LAYER_SIZE;
+
+        jsource = (*env)->GetObjectArrayElement(env, jsources, i);
+        if (jsource == NULL)
+            continue;
+
+        layer = &frame->layers[frame->count];
+        if ((*env)->IsInstanceOf(env, jsource, SoftwareCompositor.Resource))
+            ret = layer_from_shm_buffer(env, layer, jsource);
+        else
+            ret = layer_from_byte_buffer(env, layer, jsource, info);
+        (*env)->DeleteLocalRef(env, jsource);
+
+        if (ret < 0)
+            goto err; /* Exception Thrown */
+        if (ret == 0 || layer->width <= 0 || layer->height <= 0
+                || info[LAYER_OPACITY] <= 0)
+            continue;
+
+        layer->x = info[LAYER_X];
+        layer->y = info[LAYER_Y];
+        layer->opacity = info[LAYER_OPACITY] > 255 ? 255 : info[LAYER_OPACITY];
+        layer->opaque = layer->opacity == 255
+                && (layer->or_mask != 0 || info[LAYER_OPAQUE]);
+        if (layer->opaque)
+            layer->or_mask = 0xff000000;
+
+        frame->count++;
+    }
+
+    free(layers);
+    return (jlong)(intptr_t)frame;
+
+err:
+    free(layers);
+    free(frame);
+    return 0;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_SoftwareCompositor_composeTileNative(
+        JNIEnv * env, jclass cls, jlong frame_ptr, jint x1, jint y1,
+        jint x2, jint y2)
+{
+    struct compositor_frame *frame;
+    struct compositor_layer *layer;
+    const uint32_t *src;
+    int32_t lx1, ly1, lx2, ly2;
+    int64_t right, bottom;
+    int i, start;
+
+    frame = (struct compositor_frame *)(intptr_t)frame_ptr;
+
+    /*
+     * Everything below the topmost opaque layer covering the whole tile is
+     * hidden, so start there.  If there is no such layer, start from the
+     * background.
+     */
+    for (start = frame->count - 1; start >= 0; --start) {
+        layer = &frame->layers[start];
+        if (layer->opaque && layer->x <= x1 && layer->y <= y1
+                && (int64_t)layer->x + layer->width >= x2
+                && (int64_t)layer->y + layer->height >= y2)
+            break;
+    }
+
+    if (start < 0) {
+        wl_jni_pixel_fill(PIXEL(frame->output, frame->stride, x1, y1),
+                frame->stride, x2 - x1, y2 - y1, frame->background);
+        start = 0;
+    }
+
+    for (i = start; i < frame->count; ++i) {
+        layer = &frame->layers[i];
+
+        /* Positions are arbitrary, so the far edges may not fit an int */
+        right = (int64_t)layer->x + layer->width;
+        bottom = (int64_t)layer->y + layer->height;
+
+        lx1 = layer->x > x1 ? layer->x : x1;
+        ly1 = layer->y > y1 ? layer->y : y1;
+        lx2 = right < x2 ? (int32_t)right : x2;
+        ly2 = bottom < y2 ? (int32_t)bottom : y2;
+        if (lx1 >= lx2 || ly1 >= ly2)
+            continue;
+
+        /* Access is per thread in libwayland, so open it on this one */
+        if (layer->shm)
+            wl_shm_buffer_begin_access(layer->shm);
+
+        src = PIXEL(layer->data, layer->stride,
+                lx1 - layer->x, ly1 - layer->y);
+        if (layer->opaque)
+            wl_jni_pixel_convert(PIXEL(frame->output, frame->stride, lx1, ly1),
+                    frame->stride, src, layer->stride, lx2 - lx1, ly2 - ly1,
+                    0, layer->or_mask);
+        else
+            wl_jni_pixel_over_alpha(
+                    PIXEL(frame->output, frame->stride, lx1, ly1),
+                    frame->stride, src, layer->stride, lx2 - lx1, ly2 - ly1,
+                    layer->opacity, layer->or_mask);
+
+        if (layer->shm)
+            wl_shm_buffer_end_access(layer->shm);
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_SoftwareCompositor_endFrameNative(
+        JNIEnv * env, jclass cls, jlong frame_ptr)
+{
+    free((struct compositor_frame *)(intptr_t)frame_ptr);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_SoftwareCompositor_initializeJNI(
+        JNIEnv * env, jclass cls)
+{
+    jclass resource;
+
+    resource = (*env)->FindClass(env, "org/freedesktop/wayland/server/Resource");
+    if (resource == NULL)
+        return; /* Exception Thrown */
+
+    SoftwareCompositor.Resource = (*env)->NewGlobalRef(env, resource);
+    (*env)->DeleteLocalRef(env, resource);
+    if (SoftwareCompositor.Resource == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return;
+    }
+}
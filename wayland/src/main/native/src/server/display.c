@@ -28,6 +28,7 @@
 struct {
     jclass class;
     jfieldID display_ptr;
+    jmethodID reportUncaughtException;
 } Display;
 
 struct wl_display * wl_jni_display_from_java(JNIEnv * env, jobject jdisplay)
@@ -41,6 +42,26 @@ jobject wl_jni_display_to_java(JNIEnv * env, struct wl_display * display)
     return wl_jni_find_reference(env, display);
 }
 
+void
+wl_jni_display_report_exception(JNIEnv * env, struct wl_display * display,
+        jobject jsource, jthrowable exception)
+{
+    jobject jdisplay;
+
+    jdisplay = wl_jni_display_to_java(env, display);
+    if (jdisplay == NULL) {
+        (*env)->ExceptionClear(env);
+        return;
+    }
+
+    (*env)->CallVoidMethod(env, jdisplay, Display.reportUncaughtException,
+            jsource, exception);
+    (*env)->DeleteLocalRef(env, jdisplay);
+
+    /* Never return to libwayland with an exception pending */
+    (*env)->ExceptionClear(env);
+}
+
 JNIEXPORT jobject JNICALL
 Java_org_freedesktop_wayland_server_Display_getEventLoop(JNIEnv *env,
         jobject jdisplay)
@@ -105,24 +126,35 @@ Java_org_freedesktop_wayland_server_Display_addSocket(JNIEnv * env,
 }
 
 JNIEXPORT void JNICALL
-Java_org_freedesktop_wayland_server_Display_terminate(JNIEnv * env,
+Java_org_freedesktop_wayland_server_Display_initShm(JNIEnv * env,
         jobject jdisplay)
 {
-    wl_display_terminate(wl_jni_display_from_java(env, jdisplay));
+    if (wl_display_init_shm(wl_jni_display_from_java(env, jdisplay)) < 0)
+        wl_jni_throw_OutOfMemoryError(env, NULL);
 }
 
 JNIEXPORT void JNICALL
-Java_org_freedesktop_wayland_server_Display_run(JNIEnv * env,
+Java_org_freedesktop_wayland_server_Display_addShmFormat(JNIEnv * env,
+        jobject jdisplay, jint format)
+{
+    if (wl_display_add_shm_format(wl_jni_display_from_java(env, jdisplay),
+                format) == NULL)
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+}
+
+/* Display.run() loops in Java; this only wakes a blocked dispatch */
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Display_terminateNative(JNIEnv * env,
         jobject jdisplay)
 {
-    wl_display_run(wl_jni_display_from_java(env, jdisplay));
+    wl_display_terminate(wl_jni_display_from_java(env, jdisplay));
 }
 
 JNIEXPORT void JNICALL
 Java_org_freedesktop_wayland_server_Display_flushClients(JNIEnv * env,
         jobject jdisplay)
 {
-    wl_display_flush_clients(wl_jni_display_from_java(env, jdisplay));
+    wl_jni_display_flush_clients(wl_jni_display_from_java(env, jdisplay));
 }
 
 JNIEXPORT jint JNICALL
@@ -181,5 +213,11 @@ Java_org_freedesktop_wayland_server_Display_initializeJNI(JNIEnv * env,
     Display.display_ptr = (*env)->GetFieldID(env, cls, "display_ptr", "J");
     if (Display.display_ptr == NULL)
         return; /* Exception Thrown */
+
+    Display.reportUncaughtException = (*env)->GetMethodID(env, cls,
+            "reportUncaughtException",
+            "(Ljava/lang/Object;Ljava/lang/Throwable;)V");
+    if (Display.reportUncaughtException == NULL)
+        return; /* Exception Thrown */
 }
 
@@ -22,6 +22,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
 #include <wayland-server.h>
 
 #include "server/server-jni.h"
@@ -29,6 +34,11 @@
 struct {
     jclass class;
     jmethodID init_long;
+    jfieldID post_source_ptr;
+    jfieldID postLock;
+    jmethodID dispatchPostedTasks;
+    jmethodID dispatchDeferred;
+    jmethodID reportUncaughtException;
 
     struct {
         jclass class;
@@ -43,6 +53,11 @@ struct {
         jmethodID handleFileDescriptorEvent;
     } FileDescriptorEventHandler;
 
+    struct {
+        jclass class;
+        jmethodID handleRead;
+    } BufferedReadHandler;
+
     struct {
         jclass class;
         jmethodID handleTimerEvent;
@@ -64,7 +79,50 @@ static void ensure_event_loop_object_cache(JNIEnv * env, jclass cls);
 struct event_handler {
     jobject jhandler;
     jmethodID mid;
+    struct wl_event_loop *loop;
+    jweak jsource;
+    struct wl_listener destroy_listener;
+
+    /* Set while the Java handler runs; removal then waits for it to return */
+    int dispatching;
+    int removed;
+};
+
+/* The maximum number of file descriptors received in one recvmsg call */
+#define MAX_FDS_IN 28
+
+/* Must match EventLoop.EVENT_FDS_TRUNCATED */
+#define EVENT_FDS_TRUNCATED 0x10
+
+struct buffered_reader {
+    struct event_handler base;
+    jobject jbuffer;
+    char *data;
+    size_t capacity;
+    size_t retained;
+    int is_socket;
+    int *fds;
+    int fds_alloc;
+};
+
+/*
+ * The post source is a single eventfd registered with the loop.  Other
+ * threads queue Runnables on the Java side and write to the eventfd to wake
+ * the loop thread, which then drains the whole queue in one upcall.
+ *
+ * Deferred tasks are drained by an idle source instead, so they run before
+ * or after the loop's batch of events but never in the middle of it.  A
+ * batch deferring more work carries it over to the next dispatch.
+ */
+struct post_source {
+    int fd;
+    struct wl_event_source *source;
+    jweak jevent_loop;
+    struct wl_event_loop *loop;
     struct wl_listener destroy_listener;
+
+    struct wl_event_source *deferred_source;
+    int deferred_carried;
 };
 
 struct wl_event_loop *
@@ -89,9 +147,58 @@ wl_jni_event_loop_create(JNIEnv * env, struct wl_event_loop *loop)
             (jlong)(intptr_t)loop);
 }
 
+void
+wl_jni_event_loop_report_exception(JNIEnv *env, struct wl_event_loop *loop,
+        jobject jsource, jthrowable exception)
+{
+    jobject jevent_loop;
+
+    jevent_loop = wl_jni_event_loop_to_java(env, loop);
+    if (jevent_loop == NULL) {
+        /* The Java loop is gone; there is nobody left to tell */
+        (*env)->ExceptionClear(env);
+        return;
+    }
+
+    (*env)->CallVoidMethod(env, jevent_loop,
+            EventLoop.reportUncaughtException, jsource, exception);
+    (*env)->DeleteLocalRef(env, jevent_loop);
+
+    /* Never return to libwayland with an exception pending */
+    (*env)->ExceptionClear(env);
+}
+
+/*
+ * Clears any exception thrown by a handler callback and passes it on to the
+ * loop's UncaughtCallbackHandler.  Returns non-zero if there was one.
+ */
+static int
+event_handler_check_exception(JNIEnv *env, struct event_handler *handler)
+{
+    jthrowable exception;
+    jobject jsource;
+
+    exception = (*env)->ExceptionOccurred(env);
+    if (exception == NULL)
+        return 0;
+    (*env)->ExceptionClear(env);
+
+    jsource = (*env)->NewLocalRef(env, handler->jsource);
+
+    wl_jni_event_loop_report_exception(env, handler->loop, jsource, exception);
+
+    if (jsource != NULL)
+        (*env)->DeleteLocalRef(env, jsource);
+    (*env)->DeleteLocalRef(env, exception);
+
+    return 1;
+}
+
 static void
 event_handler_destroy(JNIEnv *env, struct event_handler *handler)
 {
+    if (handler->jsource != NULL)
+        (*env)->DeleteWeakGlobalRef(env, handler->jsource);
     (*env)->DeleteGlobalRef(env, handler->jhandler);
     wl_list_remove(&handler->destroy_listener.link);
     free(handler);
@@ -109,22 +216,85 @@ event_handler_destroy_func(struct wl_listener *listener, void *data)
     event_handler_destroy(env, handler);
 }
 
+/* Frees the handler the way its kind of source needs */
+static void
+event_handler_release(struct event_handler *handler)
+{
+    handler->destroy_listener.notify(&handler->destroy_listener, NULL);
+}
+
+static void
+event_handler_begin_call(struct event_handler *handler)
+{
+    handler->dispatching = 1;
+}
+
+/*
+ * Returns non-zero if the handler removed its own source while it ran, in
+ * which case the handler has now been freed.
+ */
+static int
+event_handler_end_call(struct event_handler *handler)
+{
+    handler->dispatching = 0;
+    if (! handler->removed)
+        return 0;
+
+    event_handler_release(handler);
+    return 1;
+}
+
+/* Idle sources are freed by libwayland once dispatched */
+static void
+event_handler_clear_source(JNIEnv *env, struct event_handler *handler)
+{
+    jobject jsource;
+
+    jsource = (*env)->NewLocalRef(env, handler->jsource);
+    if (jsource == NULL)
+        return;
+
+    (*env)->SetLongField(env, jsource, EventLoop.EventSource.source_ptr, 0);
+    (*env)->SetLongField(env, jsource, EventLoop.EventSource.handler_ptr, 0);
+    (*env)->DeleteLocalRef(env, jsource);
+}
+
 static jobject
 create_source_wrapper(JNIEnv *env, struct wl_event_loop *loop,
         struct wl_event_source *source, struct event_handler *handler,
         jobject jhandler, jmethodID method)
 {
+    jobject jsource;
+
     handler->jhandler = (*env)->NewGlobalRef(env, jhandler);
     if (handler->jhandler == NULL)
         return NULL; /* Exception Thrown */
 
     handler->mid = method;
-    handler->destroy_listener.notify = event_handler_destroy_func;
-    wl_event_loop_add_destroy_listener(loop, &handler->destroy_listener);
+    handler->loop = loop;
+    handler->dispatching = 0;
+    handler->removed = 0;
 
-    return (*env)->NewObject(env, EventLoop.EventSource.class,
+    jsource = (*env)->NewObject(env, EventLoop.EventSource.class,
             EventLoop.EventSource.init_long_long,
             (jlong)(intptr_t)source, (jlong)(intptr_t)handler);
+    if (jsource == NULL) {
+        (*env)->DeleteGlobalRef(env, handler->jhandler);
+        return NULL; /* Exception Thrown */
+    }
+
+    /* Weak so that exception reports don't keep the source alive */
+    handler->jsource = (*env)->NewWeakGlobalRef(env, jsource);
+    if (handler->jsource == NULL) {
+        (*env)->DeleteLocalRef(env, jsource);
+        (*env)->DeleteGlobalRef(env, handler->jhandler);
+        return NULL; /* Exception Thrown */
+    }
+
+    handler->destroy_listener.notify = event_handler_destroy_func;
+    wl_event_loop_add_destroy_listener(loop, &handler->destroy_listener);
+
+    return jsource;
 }
 
 static int
@@ -134,10 +304,15 @@ handle_event_loop_fd_call(int fd, uint32_t mask, void *data)
 
     JNIEnv * env = wl_jni_get_env();
 
+    event_handler_begin_call(handler);
     int ret = (*env)->CallIntMethod(env, handler->jhandler, handler->mid,
             (jint)fd, (jint)mask);
 
-    // TODO: Handle Exceptions
+    if (event_handler_check_exception(env, handler))
+        ret = 0;
+
+    if (event_handler_end_call(handler))
+        return 0;
 
     return ret;
 }
@@ -187,6 +362,242 @@ Java_org_freedesktop_wayland_server_EventLoop_addFileDescriptor(JNIEnv * env,
     return jsource;
 }
 
+static void
+buffered_reader_destroy_func(struct wl_listener *listener, void *data)
+{
+    struct buffered_reader *reader;
+    JNIEnv *env;
+
+    env = wl_jni_get_env();
+    reader = wl_container_of(listener, reader, base.destroy_listener);
+
+    (*env)->DeleteGlobalRef(env, reader->jbuffer);
+    free(reader->fds);
+    event_handler_destroy(env, &reader->base);
+}
+
+static int
+buffered_reader_add_fds(struct buffered_reader *reader, int *nfds,
+        struct msghdr *msg)
+{
+    struct cmsghdr *cmsg;
+    int count, alloc, *fds;
+
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+            cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        if (*nfds + count > reader->fds_alloc) {
+            alloc = reader->fds_alloc ? reader->fds_alloc : MAX_FDS_IN;
+            while (alloc < *nfds + count)
+                alloc *= 2;
+
+            fds = realloc(reader->fds, alloc * sizeof(int));
+            if (fds == NULL) {
+                /* Don't leak descriptors we have no room for */
+                while (count--)
+                    close(((int *)CMSG_DATA(cmsg))[count]);
+                return -1;
+            }
+            reader->fds = fds;
+            reader->fds_alloc = alloc;
+        }
+
+        memcpy(reader->fds + *nfds, CMSG_DATA(cmsg), count * sizeof(int));
+        *nfds += count;
+    }
+
+    return 0;
+}
+
+static int
+handle_event_loop_buffered_read_call(int fd, uint32_t mask, void *data)
+{
+    struct buffered_reader *reader = data;
+    char control[CMSG_SPACE(MAX_FDS_IN * sizeof(int))];
+    struct msghdr msg;
+    struct iovec iov;
+    size_t length;
+    ssize_t len;
+    int nfds, ret;
+    jintArray jfds;
+    JNIEnv *env;
+
+    env = wl_jni_get_env();
+
+    length = reader->retained;
+    nfds = 0;
+
+    /* Drain the descriptor so that one upcall covers the whole wakeup */
+    while (length < reader->capacity) {
+        iov.iov_base = reader->data + length;
+        iov.iov_len = reader->capacity - length;
+
+        if (reader->is_socket) {
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            len = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        } else {
+            len = read(fd, iov.iov_base, iov.iov_len);
+        }
+
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                mask |= WL_EVENT_ERROR;
+            break;
+        } else if (len == 0) {
+            mask |= WL_EVENT_HANGUP;
+            break;
+        }
+
+        length += len;
+
+        if (reader->is_socket && msg.msg_controllen > 0)
+            if (buffered_reader_add_fds(reader, &nfds, &msg) < 0)
+                mask |= WL_EVENT_ERROR;
+
+        /* The kernel closed the descriptors that did not fit */
+        if (reader->is_socket && (msg.msg_flags & MSG_CTRUNC))
+            mask |= EVENT_FDS_TRUNCATED;
+    }
+
+    jfds = NULL;
+    if (nfds > 0) {
+        jfds = (*env)->NewIntArray(env, nfds);
+        if (jfds == NULL)
+            goto exception;
+        (*env)->SetIntArrayRegion(env, jfds, 0, nfds, reader->fds);
+    }
+
+    event_handler_begin_call(&reader->base);
+    ret = (*env)->CallIntMethod(env, reader->base.jhandler, reader->base.mid,
+            (jint)fd, (jint)mask, reader->jbuffer, (jint)length, jfds);
+    if (jfds != NULL)
+        (*env)->DeleteLocalRef(env, jfds);
+
+    if (event_handler_check_exception(env, &reader->base))
+        ret = 0;
+
+    /* A handler seeing EVENT_HANGUP typically removes its source */
+    if (event_handler_end_call(&reader->base))
+        return 0;
+
+    /* The handler returns how many unconsumed bytes at the end to keep */
+    if (ret > 0 && (size_t)ret <= length && (size_t)ret < reader->capacity) {
+        memmove(reader->data, reader->data + length - ret, ret);
+        reader->retained = ret;
+    } else {
+        reader->retained = 0;
+    }
+
+    return 1;
+
+exception:
+    /* The descriptors never made it to Java */
+    while (nfds--)
+        close(reader->fds[nfds]);
+
+    reader->retained = 0;
+    event_handler_check_exception(env, &reader->base);
+
+    return 0;
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_freedesktop_wayland_server_EventLoop_addBufferedReader(JNIEnv * env,
+        jobject jevent_loop, jint fd, jobject jbuffer, jobject jhandler)
+{
+    struct wl_event_loop *loop;
+    struct buffered_reader *reader;
+    struct wl_event_source *source;
+    struct stat st;
+    jobject jsource;
+    int flags;
+
+    loop = wl_jni_event_loop_from_java(env, jevent_loop);
+    if ((*env)->ExceptionCheck(env) == JNI_TRUE)
+        return NULL;
+
+    if (fd < 0) {
+        wl_jni_throw_IllegalArgumentException(env,
+                "File descriptor is negative");
+        return NULL; /* Exception Thrown */
+    }
+
+    if (jbuffer == NULL) {
+        wl_jni_throw_NullPointerException(env, "Buffer cannot be null");
+        return NULL;
+    }
+
+    reader = malloc(sizeof(struct buffered_reader));
+    if (reader == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return NULL;
+    }
+    memset(reader, 0, sizeof(struct buffered_reader));
+
+    reader->data = (*env)->GetDirectBufferAddress(env, jbuffer);
+    reader->capacity = (*env)->GetDirectBufferCapacity(env, jbuffer);
+    if (reader->data == NULL || reader->capacity <= 0) {
+        free(reader);
+        wl_jni_throw_IllegalArgumentException(env,
+                "Buffer must be a non-empty direct buffer");
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0) {
+        free(reader);
+        wl_jni_throw_from_errno(env, errno);
+        return NULL;
+    }
+    reader->is_socket = S_ISSOCK(st.st_mode);
+
+    /* We read until EAGAIN, so a blocking descriptor would hang the loop */
+    flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        free(reader);
+        wl_jni_throw_from_errno(env, errno);
+        return NULL;
+    }
+
+    reader->jbuffer = (*env)->NewGlobalRef(env, jbuffer);
+    if (reader->jbuffer == NULL) {
+        free(reader);
+        return NULL; /* Exception Thrown */
+    }
+
+    source = wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE,
+            handle_event_loop_buffered_read_call, reader);
+    if (source == NULL) {
+        (*env)->DeleteGlobalRef(env, reader->jbuffer);
+        free(reader);
+        wl_jni_throw_from_errno(env, errno);
+        return NULL; /* Exception Thrown */
+    }
+
+    jsource = create_source_wrapper(env, loop, source, &reader->base,
+            jhandler, EventLoop.BufferedReadHandler.handleRead);
+
+    if (jsource == NULL) {
+        (*env)->DeleteGlobalRef(env, reader->jbuffer);
+        free(reader);
+        wl_event_source_remove(source);
+        return NULL; /* Exception Thrown */
+    }
+
+    reader->base.destroy_listener.notify = buffered_reader_destroy_func;
+
+    return jsource;
+}
+
 static int
 handle_event_loop_timer_call(void *data)
 {
@@ -194,15 +605,20 @@ handle_event_loop_timer_call(void *data)
 
     JNIEnv * env = wl_jni_get_env();
 
+    event_handler_begin_call(handler);
     int ret = (*env)->CallIntMethod(env, handler->jhandler, handler->mid);
 
-    // TODO: Handle Exceptions
+    if (event_handler_check_exception(env, handler))
+        ret = 0;
+
+    if (event_handler_end_call(handler))
+        return 0;
 
     return ret;
 }
 
 JNIEXPORT jobject JNICALL
-Java_org_freedesktop_wayland_server_EventLoop_addTier(JNIEnv * env,
+Java_org_freedesktop_wayland_server_EventLoop_addTimer(JNIEnv * env,
         jobject jevent_loop, jobject jhandler)
 {
     struct wl_event_loop *loop;
@@ -247,10 +663,15 @@ handle_event_loop_signal_call(int signal_number, void * data)
 
     JNIEnv * env = wl_jni_get_env();
 
+    event_handler_begin_call(handler);
     int ret = (*env)->CallIntMethod(env, handler->jhandler, handler->mid,
             (jint)signal_number);
 
-    // TODO: Handle Exceptions
+    if (event_handler_check_exception(env, handler))
+        ret = 0;
+
+    if (event_handler_end_call(handler))
+        return 0;
 
     return ret;
 }
@@ -301,14 +722,17 @@ handle_event_loop_idle_call(void * data)
 
     JNIEnv * env = wl_jni_get_env();
 
-    (*env)->CallVoidMethod(env, handler->jhandler, handler->mid);
+    /*
+     * libwayland frees the source after this returns, so the Java side
+     * must not remove it again, not even from the handler itself.
+     */
+    event_handler_clear_source(env, handler);
 
-    event_handler_destroy(env, handler);
+    (*env)->CallVoidMethod(env, handler->jhandler, handler->mid);
 
-    if ((*env)->ExceptionCheck(env))
-        (*env)->ExceptionDescribe(env);
+    event_handler_check_exception(env, handler);
 
-    // TODO: Handle Exceptions
+    event_handler_destroy(env, handler);
 }
 
 JNIEXPORT jobject JNICALL
@@ -349,14 +773,321 @@ Java_org_freedesktop_wayland_server_EventLoop_addIdle(JNIEnv * env,
     return jsource;
 }
 
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_server_EventLoop_remove(JNIEnv * env,
+        jobject jevent_loop, jobject jsource)
+{
+    struct wl_event_source *source;
+    struct event_handler *handler;
+    int ret;
+
+    if (jsource == NULL) {
+        wl_jni_throw_NullPointerException(env, "EventSource cannot be null");
+        return -1;
+    }
+
+    source = (struct wl_event_source *)(intptr_t)(*env)->GetLongField(env,
+            jsource, EventLoop.EventSource.source_ptr);
+    handler = (struct event_handler *)(intptr_t)(*env)->GetLongField(env,
+            jsource, EventLoop.EventSource.handler_ptr);
+    if (source == NULL)
+        return 0; /* Already removed */
+
+    ret = wl_event_source_remove(source);
+
+    (*env)->SetLongField(env, jsource, EventLoop.EventSource.source_ptr, 0);
+    (*env)->SetLongField(env, jsource, EventLoop.EventSource.handler_ptr, 0);
+
+    /* A handler removing its own source is freed once it returns */
+    if (handler->dispatching)
+        handler->removed = 1;
+    else
+        event_handler_release(handler);
+
+    return ret;
+}
+
+/*
+ * Other threads only write to the eventfd while holding the Java loop's
+ * post lock, so once the pointer has been cleared under it the Java loop
+ * can no longer reach the post source.  If the Java loop is gone nobody
+ * can post to it any more.
+ */
+static void
+post_source_detach(JNIEnv *env, struct post_source *post)
+{
+    jobject jevent_loop, jlock;
+
+    jevent_loop = (*env)->NewLocalRef(env, post->jevent_loop);
+    if (jevent_loop != NULL) {
+        jlock = (*env)->GetObjectField(env, jevent_loop, EventLoop.postLock);
+        (*env)->MonitorEnter(env, jlock);
+        (*env)->SetLongField(env, jevent_loop, EventLoop.post_source_ptr, 0);
+        (*env)->MonitorExit(env, jlock);
+        (*env)->DeleteLocalRef(env, jlock);
+        (*env)->DeleteLocalRef(env, jevent_loop);
+    }
+
+    (*env)->DeleteWeakGlobalRef(env, post->jevent_loop);
+    post->jevent_loop = NULL;
+}
+
+static void
+post_source_destroy(JNIEnv *env, struct post_source *post)
+{
+    post_source_detach(env, post);
+
+    wl_list_remove(&post->destroy_listener.link);
+    if (post->deferred_source)
+        wl_event_source_remove(post->deferred_source);
+    wl_event_source_remove(post->source);
+    close(post->fd);
+    free(post);
+}
+
+static void
+post_source_destroy_func(struct wl_listener *listener, void *data)
+{
+    struct post_source *post;
+
+    post = wl_container_of(listener, post, destroy_listener);
+
+    post_source_destroy(wl_jni_get_env(), post);
+}
+
+static void
+post_call_report_exception(JNIEnv *env, struct post_source *post)
+{
+    jthrowable exception;
+
+    if (! (*env)->ExceptionCheck(env))
+        return;
+
+    exception = (*env)->ExceptionOccurred(env);
+    (*env)->ExceptionClear(env);
+    wl_jni_event_loop_report_exception(env, post->loop, NULL, exception);
+    (*env)->DeleteLocalRef(env, exception);
+}
+
+static int
+handle_event_loop_post_call(int fd, uint32_t mask, void *data)
+{
+    struct post_source *post = data;
+    jobject jevent_loop;
+    uint64_t count;
+    JNIEnv *env;
+
+    /* Reset the counter; any number of wakeups collapse into this one */
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return 0;
+
+    env = wl_jni_get_env();
+
+    jevent_loop = (*env)->NewLocalRef(env, post->jevent_loop);
+    if (jevent_loop == NULL)
+        return 0;
+
+    /* Tasks that throw are reported from Java; this can only be an Error */
+    (*env)->CallVoidMethod(env, jevent_loop, EventLoop.dispatchPostedTasks);
+    post_call_report_exception(env, post);
+
+    (*env)->DeleteLocalRef(env, jevent_loop);
+
+    return 1;
+}
+
+static void
+handle_event_loop_deferred(void *data)
+{
+    struct post_source *post = data;
+    jobject jevent_loop;
+    JNIEnv *env;
+
+    /* Idle sources go away once dispatched */
+    post->deferred_source = NULL;
+
+    env = wl_jni_get_env();
+
+    jevent_loop = (*env)->NewLocalRef(env, post->jevent_loop);
+    if (jevent_loop == NULL)
+        return;
+
+    (*env)->CallVoidMethod(env, jevent_loop, EventLoop.dispatchDeferred);
+    post_call_report_exception(env, post);
+
+    (*env)->DeleteLocalRef(env, jevent_loop);
+}
+
+static int
+post_source_arm_deferred(struct post_source *post)
+{
+    if (post->deferred_source)
+        return 0;
+
+    post->deferred_source = wl_event_loop_add_idle(post->loop,
+            handle_event_loop_deferred, post);
+
+    return post->deferred_source ? 0 : -1;
+}
+
+/* Arms the batch carried over from the last dispatch, if any */
+static void
+arm_carried_deferred(JNIEnv *env, jobject jevent_loop)
+{
+    struct post_source *post;
+
+    post = (struct post_source *)(intptr_t)(*env)->GetLongField(env,
+            jevent_loop, EventLoop.post_source_ptr);
+    if (post == NULL || ! post->deferred_carried)
+        return;
+
+    post->deferred_carried = 0;
+    if (post_source_arm_deferred(post) < 0)
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+}
+
+static void
+add_post_source(JNIEnv *env, jobject jevent_loop, struct wl_event_loop *loop)
+{
+    struct post_source *post;
+    struct wl_listener *listener;
+    jweak jweak_loop;
+
+    /*
+     * A loop has one post source.  A new Java object wrapping the loop,
+     * such as one returned by Display.getEventLoop() after the last was
+     * collected, takes it over rather than adding another.
+     */
+    listener = wl_event_loop_get_destroy_listener(loop,
+            post_source_destroy_func);
+    if (listener != NULL) {
+        post = wl_container_of(listener, post, destroy_listener);
+
+        jweak_loop = (*env)->NewWeakGlobalRef(env, jevent_loop);
+        if (jweak_loop == NULL)
+            return; /* Exception Thrown */
+
+        post_source_detach(env, post);
+        post->jevent_loop = jweak_loop;
+        (*env)->SetLongField(env, jevent_loop, EventLoop.post_source_ptr,
+                (jlong)(intptr_t)post);
+        return;
+    }
+
+    post = malloc(sizeof(struct post_source));
+    if (post == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return;
+    }
+
+    post->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (post->fd < 0) {
+        wl_jni_throw_from_errno(env, errno);
+        free(post);
+        return;
+    }
+
+    post->source = wl_event_loop_add_fd(loop, post->fd, WL_EVENT_READABLE,
+            handle_event_loop_post_call, post);
+    if (post->source == NULL) {
+        wl_jni_throw_from_errno(env, errno);
+        close(post->fd);
+        free(post);
+        return;
+    }
+
+    post->jevent_loop = (*env)->NewWeakGlobalRef(env, jevent_loop);
+    if (post->jevent_loop == NULL) {
+        wl_event_source_remove(post->source);
+        close(post->fd);
+        free(post);
+        return; /* Exception Thrown */
+    }
+
+    post->loop = loop;
+    post->deferred_source = NULL;
+    post->deferred_carried = 0;
+    post->destroy_listener.notify = post_source_destroy_func;
+    wl_event_loop_add_destroy_listener(loop, &post->destroy_listener);
+
+    (*env)->SetLongField(env, jevent_loop, EventLoop.post_source_ptr,
+            (jlong)(intptr_t)post);
+}
+
 JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_EventLoop_wakeupNative(JNIEnv * env,
+        jclass cls, jlong post_source_ptr)
+{
+    struct post_source *post;
+    uint64_t one = 1;
+
+    post = (struct post_source *)(intptr_t)post_source_ptr;
+    if (post == NULL) {
+        wl_jni_throw_IllegalStateException(env, "EventLoop destroyed");
+        return;
+    }
+
+    /* EAGAIN means the counter is saturated, so a wakeup is pending anyway */
+    if (write(post->fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        wl_jni_throw_from_errno(env, errno);
+}
+
+/* Only called on the thread dispatching the loop */
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_EventLoop_scheduleDeferredNative(
+        JNIEnv * env, jclass cls, jlong post_source_ptr, jboolean next_dispatch)
+{
+    struct post_source *post;
+
+    post = (struct post_source *)(intptr_t)post_source_ptr;
+    if (post == NULL) {
+        wl_jni_throw_IllegalStateException(env, "EventLoop destroyed");
+        return;
+    }
+
+    if (next_dispatch)
+        post->deferred_carried = 1;
+    else if (post_source_arm_deferred(post) < 0)
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+}
+
+JNIEXPORT jint JNICALL
 Java_org_freedesktop_wayland_server_EventLoop_dispatch(JNIEnv * env,
         jobject jevent_loop, jint timeout)
 {
-    struct wl_event_loop * event_loop =
-            wl_jni_event_loop_from_java(env, jevent_loop);
+    struct wl_event_loop * event_loop;
+    int ret;
 
-    wl_event_loop_dispatch(event_loop, timeout);
+    event_loop = wl_jni_event_loop_from_java(env, jevent_loop);
+    if (event_loop == NULL) {
+        wl_jni_throw_IllegalStateException(env, "EventLoop destroyed");
+        return -1;
+    }
+
+    arm_carried_deferred(env, jevent_loop);
+    if ((*env)->ExceptionCheck(env))
+        return -1; /* Exception Thrown */
+
+    ret = wl_event_loop_dispatch(event_loop, timeout);
+    if (ret < 0 && errno != EINTR && !(*env)->ExceptionCheck(env))
+        wl_jni_throw_from_errno(env, errno);
+
+    return ret;
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_server_EventLoop_getFd(JNIEnv * env,
+        jobject jevent_loop)
+{
+    struct wl_event_loop * event_loop;
+
+    event_loop = wl_jni_event_loop_from_java(env, jevent_loop);
+    if (event_loop == NULL) {
+        wl_jni_throw_IllegalStateException(env, "EventLoop destroyed");
+        return -1;
+    }
+
+    return wl_event_loop_get_fd(event_loop);
 }
 
 JNIEXPORT void JNICALL
@@ -366,6 +1097,10 @@ Java_org_freedesktop_wayland_server_EventLoop_dispatchIdle(JNIEnv * env,
     struct wl_event_loop * event_loop =
             wl_jni_event_loop_from_java(env, jevent_loop);
 
+    arm_carried_deferred(env, jevent_loop);
+    if ((*env)->ExceptionCheck(env))
+        return; /* Exception Thrown */
+
     wl_event_loop_dispatch_idle(event_loop);
 }
 
@@ -385,7 +1120,13 @@ Java_org_freedesktop_wayland_server_EventLoop__1create(JNIEnv * env,
         }
     }
 
-    wl_jni_object_wrapper_set_data(env, jevent_loop, event_loop);
+    if (wl_jni_object_wrapper_set_data(env, jevent_loop, event_loop) == NULL) {
+        if (! native_ptr)
+            wl_event_loop_destroy(event_loop);
+        return; /* Exception Thrown */
+    }
+
+    add_post_source(env, jevent_loop, event_loop);
 }
 
 JNIEXPORT void JNICALL
@@ -415,6 +1156,32 @@ Java_org_freedesktop_wayland_server_EventLoop_initializeJNI(JNIEnv * env,
     if (EventLoop.init_long == NULL)
         return; /* Exception Thrown */
 
+    EventLoop.post_source_ptr =
+            (*env)->GetFieldID(env, EventLoop.class, "post_source_ptr", "J");
+    if (EventLoop.post_source_ptr == NULL)
+        return; /* Exception Thrown */
+
+    EventLoop.postLock = (*env)->GetFieldID(env, EventLoop.class,
+            "postLock", "Ljava/lang/Object;");
+    if (EventLoop.postLock == NULL)
+        return; /* Exception Thrown */
+
+    EventLoop.dispatchPostedTasks = (*env)->GetMethodID(env, EventLoop.class,
+            "dispatchPostedTasks", "()V");
+    if (EventLoop.dispatchPostedTasks == NULL)
+        return; /* Exception Thrown */
+
+    EventLoop.dispatchDeferred = (*env)->GetMethodID(env, EventLoop.class,
+            "dispatchDeferred", "()V");
+    if (EventLoop.dispatchDeferred == NULL)
+        return; /* Exception Thrown */
+
+    EventLoop.reportUncaughtException = (*env)->GetMethodID(env,
+            EventLoop.class, "reportUncaughtException",
+            "(Ljava/lang/Object;Ljava/lang/Throwable;)V");
+    if (EventLoop.reportUncaughtException == NULL)
+        return; /* Exception Thrown */
+
     cls = (*env)->FindClass(env, "org/freedesktop/wayland/server/"
             "EventLoop$EventSource");
     if (cls == NULL)
@@ -458,6 +1225,21 @@ Java_org_freedesktop_wayland_server_EventLoop_initializeJNI(JNIEnv * env,
     if (EventLoop.FileDescriptorEventHandler.handleFileDescriptorEvent == NULL)
         return; /* Exception Thrown */
 
+    cls = (*env)->FindClass(env, "org/freedesktop/wayland/server/"
+            "EventLoop$BufferedReadHandler");
+    if (cls == NULL)
+        return; /* Exception Thrown */
+    EventLoop.BufferedReadHandler.class = (*env)->NewGlobalRef(env, cls);
+    (*env)->DeleteLocalRef(env, cls);
+    if (EventLoop.BufferedReadHandler.class == NULL)
+        return; /* Exception Thrown */
+
+    EventLoop.BufferedReadHandler.handleRead =
+            (*env)->GetMethodID(env, EventLoop.BufferedReadHandler.class,
+                "handleRead", "(IILjava/nio/ByteBuffer;I[I)I");
+    if (EventLoop.BufferedReadHandler.handleRead == NULL)
+        return; /* Exception Thrown */
+
     cls = (*env)->FindClass(env, "org/freedesktop/wayland/server/"
             "EventLoop$TimerEventHandler");
     if (cls == NULL)
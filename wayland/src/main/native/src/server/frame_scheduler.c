@@ -0,0 +1,511 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <wayland-server.h>
+
+#include "server/server-jni.h"
+
+/*
+ * Collects wl_callback resources for frame callbacks and completes them
+ * all at once on each refresh of an output.  The callbacks are created,
+ * completed and destroyed entirely in C, so Java never sees a Resource for
+ * them.  Refresh ticks come from a timerfd armed on absolute deadlines at
+ * whole refresh periods from the scheduler's creation, and only while
+ * callbacks are pending.  A scheduler without a refresh rate is ticked
+ * from Java instead.
+ */
+
+/* Weight of the newest sample in the timing averages, as a shift */
+#define TIMING_EMA_SHIFT 3
+
+/* Must match FrameScheduler.ClientTiming */
+#define TIMING_FRAMES           0
+#define TIMING_LAST_FRAME       1
+#define TIMING_INTERVAL         2
+#define TIMING_LATENCY          3
+#define TIMING_PENDING          4
+#define TIMING_SIZE             5
+
+struct frame_client {
+    struct wl_client *client;
+    struct frame_scheduler *scheduler;
+    struct wl_listener destroy_listener;
+    struct wl_list link;
+
+    uint64_t frames;
+    uint64_t last_frame_ns;
+    uint64_t interval_ns;
+    uint64_t latency_ns;
+    int pending;
+};
+
+struct frame_callback {
+    struct wl_resource *resource;
+    struct frame_client *client;
+    uint64_t requested_ns;
+    struct wl_list link;
+};
+
+struct frame_scheduler {
+    int fd;
+    struct wl_event_source *source;
+    struct wl_event_loop *loop;
+    struct wl_listener destroy_listener;
+    jweak jscheduler;
+
+    uint64_t start_ns;
+    uint64_t period_ns;
+    int armed;
+
+    struct wl_list callbacks;
+    struct wl_list clients;
+};
+
+struct {
+    jfieldID scheduler_ptr;
+} FrameScheduler;
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void
+update_average(uint64_t *average, uint64_t sample)
+{
+    if (*average == 0)
+        *average = sample;
+    else
+        *average += ((int64_t)sample - (int64_t)*average) >> TIMING_EMA_SHIFT;
+}
+
+static void
+frame_client_destroy_func(struct wl_listener *listener, void *data)
+{
+    struct frame_client *fclient;
+    struct frame_callback *callback;
+
+    fclient = wl_container_of(listener, fclient, destroy_listener);
+
+    /* libwayland destroys the client's callbacks only after this */
+    wl_list_for_each(callback, &fclient->scheduler->callbacks, link)
+        if (callback->client == fclient)
+            callback->client = NULL;
+
+    wl_list_remove(&fclient->link);
+    free(fclient);
+}
+
+static struct frame_client *
+frame_client_get(struct frame_scheduler *scheduler, struct wl_client *client,
+        int create)
+{
+    struct frame_client *fclient;
+
+    wl_list_for_each(fclient, &scheduler->clients, link)
+        if (fclient->client == client)
+            return fclient;
+
+    if (! create)
+        return NULL;
+
+    fclient = malloc(sizeof(*fclient));
+    if (fclient == NULL)
+        return NULL;
+    memset(fclient, 0, sizeof(*fclient));
+
+    fclient->client = client;
+    fclient->scheduler = scheduler;
+    fclient->destroy_listener.notify = frame_client_destroy_func;
+    wl_client_add_destroy_listener(client, &fclient->destroy_listener);
+    wl_list_insert(&scheduler->clients, &fclient->link);
+
+    return fclient;
+}
+
+static void
+frame_callback_destroy(struct wl_resource *resource)
+{
+    struct frame_callback *callback;
+
+    callback = wl_resource_get_user_data(resource);
+
+    wl_list_remove(&callback->link);
+    if (callback->client)
+        --callback->client->pending;
+    free(callback);
+}
+
+static int
+scheduler_arm(struct frame_scheduler *scheduler)
+{
+    struct itimerspec its;
+    uint64_t now, next;
+
+    if (scheduler->armed || scheduler->period_ns == 0
+            || wl_list_empty(&scheduler->callbacks))
+        return 0;
+
+    now = monotonic_ns();
+
+    /* A phase given in the future is moved back by whole periods */
+    if (scheduler->start_ns > now)
+        scheduler->start_ns -= ((scheduler->start_ns - now)
+                / scheduler->period_ns + 1) * scheduler->period_ns;
+
+    /* The first refresh boundary strictly after now */
+    next = scheduler->start_ns + ((now - scheduler->start_ns)
+            / scheduler->period_ns + 1) * scheduler->period_ns;
+
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = next / 1000000000ull;
+    its.it_value.tv_nsec = next % 1000000000ull;
+
+    scheduler->armed = 1;
+    return timerfd_settime(scheduler->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/*
+ * Sends done to every pending callback and destroys it.  Callbacks of
+ * congested clients are held back to the next refresh unless forced.
+ */
+static int
+scheduler_fire(struct frame_scheduler *scheduler, int force)
+{
+    struct frame_callback *callback, *tmp;
+    struct frame_client *fclient;
+    uint64_t now;
+    int count;
+
+    now = monotonic_ns();
+    count = 0;
+
+    wl_list_for_each_safe(callback, tmp, &scheduler->callbacks, link) {
+        fclient = callback->client;
+        if (! force && fclient && wl_jni_client_is_congested(fclient->client))
+            continue;
+
+        if (fclient) {
+            if (fclient->last_frame_ns != 0)
+                update_average(&fclient->interval_ns,
+                        now - fclient->last_frame_ns);
+            update_average(&fclient->latency_ns,
+                    now - callback->requested_ns);
+            fclient->last_frame_ns = now;
+            ++fclient->frames;
+        }
+
+        /* wl_callback.done; the destructor unlinks and frees callback */
+        wl_resource_post_event(callback->resource, 0,
+                (uint32_t)(now / 1000000));
+        wl_resource_destroy(callback->resource);
+        ++count;
+    }
+
+    return count;
+}
+
+static int
+handle_frame_scheduler_tick(int fd, uint32_t mask, void *data)
+{
+    struct frame_scheduler *scheduler = data;
+    uint64_t expirations;
+
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        return 0;
+
+    scheduler->armed = 0;
+    scheduler_fire(scheduler, 0);
+    scheduler_arm(scheduler);
+
+    return 1;
+}
+
+/*
+ * Unhooks the scheduler from everything.  Pending callbacks stay alive
+ * until their client goes away, but are no longer tracked.
+ */
+static void
+frame_scheduler_destroy(JNIEnv *env, struct frame_scheduler *scheduler)
+{
+    struct frame_callback *callback, *ctmp;
+    struct frame_client *fclient, *ftmp;
+    jobject jscheduler;
+
+    jscheduler = (*env)->NewLocalRef(env, scheduler->jscheduler);
+    if (jscheduler != NULL) {
+        (*env)->SetLongField(env, jscheduler, FrameScheduler.scheduler_ptr, 0);
+        (*env)->DeleteLocalRef(env, jscheduler);
+    }
+
+    wl_list_for_each_safe(callback, ctmp, &scheduler->callbacks, link) {
+        wl_list_remove(&callback->link);
+        wl_list_init(&callback->link);
+        callback->client = NULL;
+    }
+
+    wl_list_for_each_safe(fclient, ftmp, &scheduler->clients, link) {
+        wl_list_remove(&fclient->destroy_listener.link);
+        free(fclient);
+    }
+
+    wl_list_remove(&scheduler->destroy_listener.link);
+    wl_event_source_remove(scheduler->source);
+    close(scheduler->fd);
+
+    (*env)->DeleteWeakGlobalRef(env, scheduler->jscheduler);
+    free(scheduler);
+}
+
+static void
+frame_scheduler_destroy_func(struct wl_listener *listener, void *data)
+{
+    struct frame_scheduler *scheduler;
+
+    scheduler = wl_container_of(listener, scheduler, destroy_listener);
+
+    frame_scheduler_destroy(wl_jni_get_env(), scheduler);
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_freedesktop_wayland_server_FrameScheduler_createNative(JNIEnv * env,
+        jobject jscheduler, jobject jevent_loop, jlong period_ns)
+{
+    struct wl_event_loop *loop;
+    struct frame_scheduler *scheduler;
+
+    loop = wl_jni_event_loop_from_java(env, jevent_loop);
+    if ((*env)->ExceptionCheck(env))
+        return 0; /* Exception Thrown */
+
+    if (loop == NULL) {
+        wl_jni_throw_NullPointerException(env, "EventLoop cannot be null");
+        return 0;
+    }
+
+    scheduler = malloc(sizeof(struct frame_scheduler));
+    if (scheduler == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return 0;
+    }
+    memset(scheduler, 0, sizeof(struct frame_scheduler));
+
+    wl_list_init(&scheduler->callbacks);
+    wl_list_init(&scheduler->clients);
+    scheduler->loop = loop;
+    scheduler->period_ns = period_ns;
+    scheduler->start_ns = monotonic_ns();
+
+    scheduler->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (scheduler->fd < 0) {
+        wl_jni_throw_from_errno(env, errno);
+        free(scheduler);
+        return 0;
+    }
+
+    scheduler->source = wl_event_loop_add_fd(loop, scheduler->fd,
+            WL_EVENT_READABLE, handle_frame_scheduler_tick, scheduler);
+    if (scheduler->source == NULL) {
+        wl_jni_throw_from_errno(env, errno);
+        close(scheduler->fd);
+        free(scheduler);
+        return 0;
+    }
+
+    scheduler->jscheduler = (*env)->NewWeakGlobalRef(env, jscheduler);
+    if (scheduler->jscheduler == NULL) {
+        wl_event_source_remove(scheduler->source);
+        close(scheduler->fd);
+        free(scheduler);
+        return 0; /* Exception Thrown */
+    }
+
+    scheduler->destroy_listener.notify = frame_scheduler_destroy_func;
+    wl_event_loop_add_destroy_listener(loop, &scheduler->destroy_listener);
+
+    return (jlong)(intptr_t)scheduler;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_FrameScheduler_destroyNative(JNIEnv * env,
+        jobject jscheduler, jlong scheduler_ptr)
+{
+    struct frame_scheduler *scheduler;
+
+    scheduler = (struct frame_scheduler *)(intptr_t)scheduler_ptr;
+    if (scheduler == NULL)
+        return;
+
+    /* Complete what's pending so clients aren't left waiting forever */
+    scheduler_fire(scheduler, 1);
+    frame_scheduler_destroy(env, scheduler);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_FrameScheduler_addCallbackNative(
+        JNIEnv * env, jclass cls, jlong scheduler_ptr, jobject jclient,
+        jint id)
+{
+    struct frame_scheduler *scheduler;
+    struct frame_callback *callback;
+    struct wl_client *client;
+
+    scheduler = (struct frame_scheduler *)(intptr_t)scheduler_ptr;
+
+    client = wl_jni_client_from_java(env, jclient);
+    if (client == NULL) {
+        if (! (*env)->ExceptionCheck(env))
+            wl_jni_throw_NullPointerException(env,
+                    "client not allowed to be null");
+        return;
+    }
+
+    callback = malloc(sizeof(*callback));
+    if (callback == NULL)
+        goto no_memory;
+
+    callback->client = frame_client_get(scheduler, client, 1);
+    if (callback->client == NULL) {
+        free(callback);
+        goto no_memory;
+    }
+
+    callback->resource = wl_resource_create(client, &wl_callback_interface,
+            1, id);
+    if (callback->resource == NULL) {
+        free(callback);
+        goto no_memory;
+    }
+
+    wl_resource_set_implementation(callback->resource, NULL, callback,
+            frame_callback_destroy);
+    callback->requested_ns = monotonic_ns();
+    wl_list_insert(scheduler->callbacks.prev, &callback->link);
+    ++callback->client->pending;
+
+    if (scheduler_arm(scheduler) < 0)
+        wl_jni_throw_from_errno(env, errno);
+
+    return;
+
+no_memory:
+    wl_client_post_no_memory(client);
+    wl_jni_throw_OutOfMemoryError(env, NULL);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_server_FrameScheduler_tickNative(JNIEnv * env,
+        jclass cls, jlong scheduler_ptr)
+{
+    struct frame_scheduler *scheduler;
+    int count;
+
+    scheduler = (struct frame_scheduler *)(intptr_t)scheduler_ptr;
+
+    count = scheduler_fire(scheduler, 0);
+    scheduler_arm(scheduler);
+
+    return count;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_FrameScheduler_setPeriodNative(
+        JNIEnv * env, jclass cls, jlong scheduler_ptr, jlong period_ns,
+        jlong phase_ns)
+{
+    struct frame_scheduler *scheduler;
+    struct itimerspec its;
+
+    scheduler = (struct frame_scheduler *)(intptr_t)scheduler_ptr;
+
+    scheduler->period_ns = period_ns;
+    if (phase_ns > 0)
+        scheduler->start_ns = phase_ns;
+
+    /* Re-arm against the new period */
+    memset(&its, 0, sizeof(its));
+    timerfd_settime(scheduler->fd, TFD_TIMER_ABSTIME, &its, NULL);
+    scheduler->armed = 0;
+
+    if (scheduler_arm(scheduler) < 0)
+        wl_jni_throw_from_errno(env, errno);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_server_FrameScheduler_getPendingCountNative(
+        JNIEnv * env, jclass cls, jlong scheduler_ptr)
+{
+    struct frame_scheduler *scheduler;
+
+    scheduler = (struct frame_scheduler *)(intptr_t)scheduler_ptr;
+
+    return wl_list_length(&scheduler->callbacks);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_server_FrameScheduler_getClientTimingNative(
+        JNIEnv * env, jclass cls, jlong scheduler_ptr, jobject jclient,
+        jlongArray jtiming)
+{
+    struct frame_scheduler *scheduler;
+    struct frame_client *fclient;
+    struct wl_client *client;
+    jlong timing[TIMING_SIZE];
+
+    scheduler = (struct frame_scheduler *)(intptr_t)scheduler_ptr;
+
+    client = wl_jni_client_from_java(env, jclient);
+    if (client == NULL)
+        return JNI_FALSE;
+
+    fclient = frame_client_get(scheduler, client, 0);
+    if (fclient == NULL)
+        return JNI_FALSE;
+
+    timing[TIMING_FRAMES] = fclient->frames;
+    timing[TIMING_LAST_FRAME] = fclient->last_frame_ns;
+    timing[TIMING_INTERVAL] = fclient->interval_ns;
+    timing[TIMING_LATENCY] = fclient->latency_ns;
+    timing[TIMING_PENDING] = fclient->pending;
+    (*env)->SetLongArrayRegion(env, jtiming, 0, TIMING_SIZE, timing);
+
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_FrameScheduler_initializeJNI(JNIEnv * env,
+        jclass cls)
+{
+    FrameScheduler.scheduler_ptr = (*env)->GetFieldID(env, cls,
+            "scheduler_ptr", "J");
+    if (FrameScheduler.scheduler_ptr == NULL)
+        return; /* Exception Thrown */
+}
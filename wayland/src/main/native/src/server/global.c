@@ -40,14 +40,15 @@ wl_jni_global_from_java(JNIEnv * env, jobject jglobal)
             (*env)->GetLongField(env, jglobal, Global.global_ptr);
 }
 
-// FIXME: This isn't exception-safe!!!
 static void
 wl_jni_global_bind_func(struct wl_client * client, void * data,
         uint32_t version, uint32_t id)
 {
     JNIEnv * env;
+    struct wl_display *display;
     jobject jglobal;
     jobject jclient;
+    jthrowable exception;
 
     env = wl_jni_get_env();
 
@@ -57,17 +58,36 @@ wl_jni_global_bind_func(struct wl_client * client, void * data,
 
     jclient = wl_jni_client_to_java(env, client);
     if ((*env)->ExceptionCheck(env))
-        goto exception;
+        goto delete_global;
 
     (*env)->CallVoidMethod(env, jglobal, Global.bindClient, jclient,
             (jint)version, (jint)id);
 
-    (*env)->DeleteLocalRef(env, jglobal);
     (*env)->DeleteLocalRef(env, jclient);
 
+delete_global:
+    exception = (*env)->ExceptionOccurred(env);
+    if (exception != NULL) {
+        (*env)->ExceptionClear(env);
+
+        /*
+         * There may be no object behind the client's new_id, so end the
+         * client with an error now rather than an invalid object error
+         * later.  Posted before reporting, since the handler may destroy
+         * the client.
+         */
+        display = wl_client_get_display(client);
+        wl_client_post_no_memory(client);
+        wl_jni_display_report_exception(env, display, jglobal, exception);
+        (*env)->DeleteLocalRef(env, exception);
+    }
+    (*env)->DeleteLocalRef(env, jglobal);
+    return;
+
 exception:
-    if ((*env)->ExceptionCheck(env))
-        (*env)->ExceptionDescribe(env);
+    /* The Global is already gone; nothing sensible to report against */
+    (*env)->ExceptionClear(env);
+    wl_client_post_no_memory(client);
 }
 
 JNIEXPORT jlong JNICALL
@@ -84,6 +104,11 @@ Java_org_freedesktop_wayland_server_Global_createNative(JNIEnv * env,
     jni_interface = wl_jni_interface_from_java(env, jinterface);
     if ((*env)->ExceptionCheck(env))
         return 0;
+    if (jni_interface == NULL) {
+        wl_jni_throw_NullPointerException(env,
+                "interface not allowed to be null");
+        return 0;
+    }
 
     jglobal = (*env)->NewGlobalRef(env, jglobal);
     if (jglobal == NULL) {
@@ -91,7 +116,7 @@ Java_org_freedesktop_wayland_server_Global_createNative(JNIEnv * env,
         return 0;
     }
 
-    global = wl_global_create(display, &jni_interface->interface,
+    global = wl_global_create(display, jni_interface->interface,
             version, jglobal, &wl_jni_global_bind_func);
 
     if (global == NULL) {
@@ -49,6 +49,7 @@ listener_notify_func(struct wl_listener * listener, void * data)
     struct wl_jni_destroy_listener * jni_listener;
     JNIEnv * env;
     jobject jlistener;
+    jthrowable exception;
 
     jni_listener = wl_container_of(listener, jni_listener, listener);
 
@@ -58,11 +59,12 @@ listener_notify_func(struct wl_listener * listener, void * data)
 
     /* TODO: Do something with the data parameter? */
     (*env)->CallVoidMethod(env, jni_listener->self_ref, DestroyListener.onDestroy);
-    if ((*env)->ExceptionCheck(env) == JNI_TRUE) {
-        (*env)->DeleteLocalRef(env, jlistener);
-        (*env)->ExceptionDescribe(env);
-        return;
-        /* TODO */
+    exception = (*env)->ExceptionOccurred(env);
+    if (exception != NULL) {
+        (*env)->ExceptionClear(env);
+        wl_jni_display_report_exception(env, jni_listener->display,
+                jlistener, exception);
+        (*env)->DeleteLocalRef(env, exception);
     }
 
     Java_org_freedesktop_wayland_server_DestroyListener_detach(env,
@@ -71,7 +73,8 @@ listener_notify_func(struct wl_listener * listener, void * data)
 }
 
 struct wl_jni_destroy_listener *
-wl_jni_destroy_listener_add_to_signal(JNIEnv * env, jobject jlistener)
+wl_jni_destroy_listener_add_to_signal(JNIEnv * env, jobject jlistener,
+        struct wl_display * display)
 {
     struct wl_jni_destroy_listener * jni_listener;
 
@@ -90,6 +93,7 @@ wl_jni_destroy_listener_add_to_signal(JNIEnv * env, jobject jlistener)
 
     memset(jni_listener, 0, sizeof(struct wl_jni_destroy_listener));
     jni_listener->listener.notify = &listener_notify_func;
+    jni_listener->display = display;
 
     jni_listener->self_ref = (*env)->NewGlobalRef(env, jlistener);
     if (jni_listener->self_ref == NULL) {
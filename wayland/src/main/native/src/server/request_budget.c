@@ -0,0 +1,739 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <wayland-server.h>
+
+#include "server/server-jni.h"
+
+/*
+ * Per-client request budgets.  libwayland dispatches everything it has
+ * read from a client in one go, so once a client has used up its budget
+ * for the current loop iteration its requests to Java objects are copied
+ * into a queue instead.  The queues are drained, a budget's worth per
+ * client at a time, from an eventfd source that stays readable while any
+ * queue is non-empty.  That source takes its turn in the epoll batch like
+ * any client, so other clients get dispatched in between.
+ *
+ * Requests stay in order: once a client has a queue, everything it sends
+ * to Java objects goes through it.  Requests creating objects are never
+ * deferred, as libwayland checks later messages against its object map
+ * as soon as they arrive; the queue is drained first instead.  The same
+ * happens when a queue grows past DEFER_LIMIT budgets.  Requests to
+ * objects implemented inside libwayland, such as wl_display.sync, never
+ * reach the resource dispatcher, so a protocol logger drains the queue
+ * before them; a roundtrip still covers everything sent ahead of it.
+ */
+
+#define DEFER_LIMIT 16
+
+struct deferred_object {
+    struct wl_listener destroy_listener;
+    union wl_argument *arg;
+};
+
+struct budget_client;
+
+struct deferred_request {
+    struct budget_client *bclient;
+    struct wl_list link;
+    struct wl_resource *resource;
+    struct wl_listener resource_destroy_listener;
+    const void *implementation;
+    uint32_t opcode;
+    const struct wl_message *message;
+
+    union wl_argument *args;
+    struct deferred_object *objects;
+    int nargs;
+    int nobjects;
+};
+
+struct budget_display;
+
+struct budget_client {
+    struct wl_client *client;
+    struct budget_display *display;
+    struct wl_listener destroy_listener;
+    struct wl_list link;
+    struct wl_list pending_link;
+
+    uint32_t generation;
+    int dispatched;
+    struct wl_list queue;
+    int queued;
+    uint64_t deferred;
+    int draining;
+};
+
+struct budget_display {
+    struct wl_display *display;
+    struct wl_listener destroy_listener;
+    int budget;
+
+    /* Bumped once per loop iteration by an idle source */
+    uint32_t generation;
+    struct wl_event_source *generation_source;
+
+    int fd;
+    struct wl_event_source *drain_source;
+    struct wl_protocol_logger *logger;
+
+    struct wl_list clients;
+    struct wl_list pending;
+    uint64_t retired_deferred;
+};
+
+/* Number of displays with a budget; lets the common case skip lookups */
+static int budgets_enabled;
+
+static int
+count_arguments(const char *signature)
+{
+    int nargs = 0;
+
+    for (; *signature; ++signature) {
+        switch (*signature) {
+        case 'i':
+        case 'u':
+        case 'f':
+        case 's':
+        case 'o':
+        case 'n':
+        case 'a':
+        case 'h':
+            ++nargs;
+        }
+    }
+
+    return nargs;
+}
+
+static void
+deferred_request_destroy(struct deferred_request *request, int close_fds)
+{
+    const char *signature;
+    int i;
+
+    wl_list_remove(&request->link);
+    wl_list_remove(&request->resource_destroy_listener.link);
+    for (i = 0; i < request->nobjects; ++i)
+        wl_list_remove(&request->objects[i].destroy_listener.link);
+
+    i = 0;
+    for (signature = request->message->signature; *signature; ++signature) {
+        switch (*signature) {
+        case 's':
+            free((char *)request->args[i].s);
+            break;
+        case 'a':
+            if (request->args[i].a) {
+                wl_array_release(request->args[i].a);
+                free(request->args[i].a);
+            }
+            break;
+        case 'h':
+            if (close_fds)
+                close(request->args[i].h);
+            break;
+        case 'i':
+        case 'u':
+        case 'f':
+        case 'o':
+        case 'n':
+            break;
+        default:
+            continue;
+        }
+        ++i;
+    }
+
+    free(request);
+}
+
+static void
+deferred_request_resource_destroyed(struct wl_listener *listener,
+        void *data)
+{
+    struct deferred_request *request;
+    struct budget_client *bclient;
+
+    request = wl_container_of(listener, request, resource_destroy_listener);
+    bclient = request->bclient;
+
+    deferred_request_destroy(request, 1);
+
+    --bclient->queued;
+    if (wl_list_empty(&bclient->queue)) {
+        wl_list_remove(&bclient->pending_link);
+        wl_list_init(&bclient->pending_link);
+    }
+}
+
+/*
+ * Takes a request off its queue and stops watching its resource and
+ * objects, as the handler about to run may destroy any of them.
+ */
+static void
+deferred_request_unhook(struct deferred_request *request)
+{
+    int i;
+
+    wl_list_remove(&request->link);
+    wl_list_init(&request->link);
+    --request->bclient->queued;
+
+    wl_list_remove(&request->resource_destroy_listener.link);
+    wl_list_init(&request->resource_destroy_listener.link);
+    for (i = 0; i < request->nobjects; ++i) {
+        wl_list_remove(&request->objects[i].destroy_listener.link);
+        wl_list_init(&request->objects[i].destroy_listener.link);
+    }
+}
+
+/* Objects destroyed while a request waits are passed as null */
+static void
+deferred_object_destroyed(struct wl_listener *listener, void *data)
+{
+    struct deferred_object *object;
+
+    object = wl_container_of(listener, object, destroy_listener);
+
+    object->arg->o = NULL;
+    wl_list_remove(&object->destroy_listener.link);
+    wl_list_init(&object->destroy_listener.link);
+}
+
+static struct deferred_request *
+deferred_request_create(struct wl_resource *resource,
+        const void *implementation, uint32_t opcode,
+        const struct wl_message *message, union wl_argument *args)
+{
+    struct deferred_request *request;
+    struct wl_resource *object;
+    struct wl_array *array;
+    const char *signature;
+    int i, nargs, nobjects;
+
+    nargs = count_arguments(message->signature);
+    nobjects = 0;
+    for (signature = message->signature; *signature; ++signature)
+        if (*signature == 'o')
+            ++nobjects;
+
+    /* One block for the request, its arguments and object listeners */
+    request = calloc(1, sizeof(*request)
+            + nargs * sizeof(union wl_argument)
+            + nobjects * sizeof(struct deferred_object));
+    if (request == NULL)
+        return NULL;
+
+    request->args = (union wl_argument *)(request + 1);
+    request->objects = (struct deferred_object *)(request->args + nargs);
+    request->resource = resource;
+    request->implementation = implementation;
+    request->opcode = opcode;
+    request->message = message;
+    request->nargs = nargs;
+    wl_list_init(&request->link);
+
+    request->resource_destroy_listener.notify =
+            deferred_request_resource_destroyed;
+    wl_signal_add(&resource->destroy_signal,
+            &request->resource_destroy_listener);
+
+    i = 0;
+    for (signature = message->signature; *signature; ++signature) {
+        switch (*signature) {
+        case 's':
+            if (args[i].s) {
+                request->args[i].s = strdup(args[i].s);
+                if (request->args[i].s == NULL)
+                    goto err_copy;
+            }
+            break;
+        case 'a':
+            if (args[i].a) {
+                array = malloc(sizeof(*array));
+                if (array == NULL)
+                    goto err_copy;
+                wl_array_init(array);
+                if (wl_array_copy(array, args[i].a) < 0) {
+                    free(array);
+                    goto err_copy;
+                }
+                request->args[i].a = array;
+            }
+            break;
+        case 'o':
+            request->args[i].o = args[i].o;
+            object = (struct wl_resource *)args[i].o;
+            if (object) {
+                request->objects[request->nobjects].arg = &request->args[i];
+                request->objects[request->nobjects].destroy_listener.notify =
+                        deferred_object_destroyed;
+                wl_signal_add(&object->destroy_signal,
+                        &request->objects[request->nobjects].destroy_listener);
+                ++request->nobjects;
+            }
+            break;
+        case 'i':
+        case 'u':
+        case 'f':
+        case 'n':
+        case 'h':
+            request->args[i] = args[i];
+            break;
+        default:
+            continue;
+        }
+        ++i;
+    }
+
+    return request;
+
+err_copy:
+    /* The fds still belong to the caller */
+    deferred_request_destroy(request, 0);
+    return NULL;
+}
+
+static void
+budget_client_drop_queue(struct budget_client *bclient)
+{
+    struct deferred_request *request, *tmp;
+
+    wl_list_for_each_safe(request, tmp, &bclient->queue, link)
+        deferred_request_destroy(request, 1);
+    bclient->queued = 0;
+
+    wl_list_remove(&bclient->pending_link);
+    wl_list_init(&bclient->pending_link);
+}
+
+/*
+ * Dispatches up to max queued requests, or all of them if max is negative.
+ * Returns -1 if a handler destroyed the client, in which case bclient is
+ * gone as well.
+ */
+static int
+budget_client_drain(struct budget_client *bclient, int max)
+{
+    struct deferred_request *request;
+
+    bclient->draining = 1;
+    while (max != 0 && ! wl_list_empty(&bclient->queue)) {
+        request = wl_container_of(bclient->queue.next, request, link);
+
+        deferred_request_unhook(request);
+        wl_jni_resource_dispatch(request->implementation, request->resource,
+                request->opcode, request->message, request->args);
+        deferred_request_destroy(request, 0);
+
+        if (bclient->client == NULL) {
+            free(bclient);
+            return -1;
+        }
+
+        if (max > 0)
+            --max;
+    }
+    bclient->draining = 0;
+
+    if (wl_list_empty(&bclient->queue)) {
+        wl_list_remove(&bclient->pending_link);
+        wl_list_init(&bclient->pending_link);
+    }
+
+    return 0;
+}
+
+static void
+budget_client_destroy_func(struct wl_listener *listener, void *data)
+{
+    struct budget_client *bclient;
+
+    bclient = wl_container_of(listener, bclient, destroy_listener);
+
+    budget_client_drop_queue(bclient);
+    if (bclient->display)
+        bclient->display->retired_deferred += bclient->deferred;
+    wl_list_remove(&bclient->link);
+
+    /* A drain in progress frees it once the handler returns */
+    if (bclient->draining)
+        bclient->client = NULL;
+    else
+        free(bclient);
+}
+
+static struct budget_client *
+budget_client_get(struct budget_display *bdisplay, struct wl_client *client,
+        int create)
+{
+    struct budget_client *bclient;
+    struct wl_listener *listener;
+
+    listener = wl_client_get_destroy_listener(client,
+            budget_client_destroy_func);
+    if (listener != NULL)
+        return wl_container_of(listener, bclient, destroy_listener);
+
+    if (! create)
+        return NULL;
+
+    bclient = calloc(1, sizeof(*bclient));
+    if (bclient == NULL)
+        return NULL;
+
+    bclient->client = client;
+    bclient->display = bdisplay;
+    bclient->generation = bdisplay->generation;
+    wl_list_init(&bclient->queue);
+    wl_list_init(&bclient->pending_link);
+    wl_list_insert(&bdisplay->clients, &bclient->link);
+
+    bclient->destroy_listener.notify = budget_client_destroy_func;
+    wl_client_add_destroy_listener(client, &bclient->destroy_listener);
+
+    return bclient;
+}
+
+static void
+budget_display_next_generation(void *data)
+{
+    struct budget_display *bdisplay = data;
+
+    bdisplay->generation_source = NULL;
+    ++bdisplay->generation;
+}
+
+static int
+handle_budget_drain(int fd, uint32_t mask, void *data)
+{
+    struct budget_display *bdisplay = data;
+    struct budget_client *bclient;
+    struct wl_list round;
+    uint64_t value;
+    int max;
+
+    /* Clients that used up their budget get a fresh one next iteration */
+    if (bdisplay->generation_source == NULL)
+        bdisplay->generation_source = wl_event_loop_add_idle(
+                wl_display_get_event_loop(bdisplay->display),
+                budget_display_next_generation, bdisplay);
+
+    /*
+     * Work from a private list: a handler may destroy any client, which
+     * unlinks it from whichever list it is on.
+     */
+    wl_list_init(&round);
+    wl_list_insert_list(&round, &bdisplay->pending);
+    wl_list_init(&bdisplay->pending);
+
+    while (! wl_list_empty(&round)) {
+        bclient = wl_container_of(round.next, bclient, pending_link);
+        wl_list_remove(&bclient->pending_link);
+        wl_list_insert(bdisplay->pending.prev, &bclient->pending_link);
+
+        if (bclient->generation != bdisplay->generation) {
+            bclient->generation = bdisplay->generation;
+            bclient->dispatched = 0;
+        }
+
+        if (bclient->dispatched < bdisplay->budget) {
+            max = bdisplay->budget - bclient->dispatched;
+            if (max > bclient->queued)
+                max = bclient->queued;
+            bclient->dispatched += max;
+            budget_client_drain(bclient, max);
+        }
+    }
+
+    /* Level-triggered: stays readable while anything is left */
+    if (wl_list_empty(&bdisplay->pending))
+        if (read(bdisplay->fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+            return 0;
+
+    return 1;
+}
+
+/* Sees every request before libwayland dispatches it */
+static void
+budget_display_log(void *data, enum wl_protocol_logger_type type,
+        const struct wl_protocol_logger_message *message)
+{
+    struct budget_display *bdisplay = data;
+    struct budget_client *bclient;
+
+    if (type != WL_PROTOCOL_LOGGER_REQUEST || bdisplay->budget == 0)
+        return;
+
+    /* Those keep their place through wl_jni_client_defer_request */
+    if (wl_jni_resource_is_java(message->resource))
+        return;
+
+    bclient = budget_client_get(bdisplay,
+            wl_resource_get_client(message->resource), 0);
+    if (bclient == NULL || wl_list_empty(&bclient->queue))
+        return;
+
+    bclient->dispatched += bclient->queued;
+    budget_client_drain(bclient, -1);
+}
+
+static void
+budget_display_destroy_func(struct wl_listener *listener, void *data)
+{
+    struct budget_display *bdisplay;
+    struct budget_client *bclient, *tmp;
+
+    bdisplay = wl_container_of(listener, bdisplay, destroy_listener);
+
+    wl_list_for_each_safe(bclient, tmp, &bdisplay->clients, link) {
+        budget_client_drop_queue(bclient);
+        wl_list_remove(&bclient->link);
+        wl_list_init(&bclient->link);
+        bclient->display = NULL;
+    }
+
+    if (bdisplay->budget > 0)
+        --budgets_enabled;
+
+    if (bdisplay->generation_source)
+        wl_event_source_remove(bdisplay->generation_source);
+    wl_protocol_logger_destroy(bdisplay->logger);
+    wl_event_source_remove(bdisplay->drain_source);
+    close(bdisplay->fd);
+
+    wl_list_remove(&bdisplay->destroy_listener.link);
+    free(bdisplay);
+}
+
+static struct budget_display *
+budget_display_get(struct wl_display *display, int create)
+{
+    struct budget_display *bdisplay;
+    struct wl_listener *listener;
+
+    listener = wl_display_get_destroy_listener(display,
+            budget_display_destroy_func);
+    if (listener != NULL)
+        return wl_container_of(listener, bdisplay, destroy_listener);
+
+    if (! create)
+        return NULL;
+
+    bdisplay = calloc(1, sizeof(*bdisplay));
+    if (bdisplay == NULL)
+        return NULL;
+
+    bdisplay->display = display;
+    wl_list_init(&bdisplay->clients);
+    wl_list_init(&bdisplay->pending);
+
+    bdisplay->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (bdisplay->fd < 0) {
+        free(bdisplay);
+        return NULL;
+    }
+
+    bdisplay->drain_source = wl_event_loop_add_fd(
+            wl_display_get_event_loop(display), bdisplay->fd,
+            WL_EVENT_READABLE, handle_budget_drain, bdisplay);
+    if (bdisplay->drain_source == NULL) {
+        close(bdisplay->fd);
+        free(bdisplay);
+        return NULL;
+    }
+
+    bdisplay->logger = wl_display_add_protocol_logger(display,
+            budget_display_log, bdisplay);
+    if (bdisplay->logger == NULL) {
+        wl_event_source_remove(bdisplay->drain_source);
+        close(bdisplay->fd);
+        free(bdisplay);
+        return NULL;
+    }
+
+    bdisplay->destroy_listener.notify = budget_display_destroy_func;
+    wl_display_add_destroy_listener(display, &bdisplay->destroy_listener);
+
+    return bdisplay;
+}
+
+/*
+ * Called from the resource dispatcher for every request to a Java object.
+ * Returns nonzero if the request was queued rather than dispatched.
+ */
+int
+wl_jni_client_defer_request(struct wl_resource *resource,
+        const void *implementation, uint32_t opcode,
+        const struct wl_message *message, union wl_argument *args)
+{
+    struct budget_display *bdisplay;
+    struct budget_client *bclient;
+    struct deferred_request *request;
+    uint64_t value;
+    int creates_object;
+
+    if (budgets_enabled == 0)
+        return 0;
+
+    bdisplay = budget_display_get(wl_client_get_display(resource->client), 0);
+    if (bdisplay == NULL || bdisplay->budget == 0)
+        return 0;
+
+    bclient = budget_client_get(bdisplay, resource->client, 1);
+    if (bclient == NULL)
+        return 0;
+
+    if (bclient->generation != bdisplay->generation) {
+        bclient->generation = bdisplay->generation;
+        bclient->dispatched = 0;
+    }
+
+    if (bdisplay->generation_source == NULL)
+        bdisplay->generation_source = wl_event_loop_add_idle(
+                wl_display_get_event_loop(bdisplay->display),
+                budget_display_next_generation, bdisplay);
+
+    creates_object = strchr(message->signature, 'n') != NULL;
+
+    if (wl_list_empty(&bclient->queue)) {
+        if (creates_object || bclient->dispatched < bdisplay->budget) {
+            ++bclient->dispatched;
+            return 0;
+        }
+    } else if (creates_object
+            || bclient->queued >= bdisplay->budget * DEFER_LIMIT) {
+        /* Keep the order by running what's queued first */
+        bclient->dispatched += bclient->queued + 1;
+        if (budget_client_drain(bclient, -1) < 0)
+            return 1; /* The client is gone */
+        return 0;
+    }
+
+    /* Wake the drain source when the first request gets queued */
+    if (wl_list_empty(&bdisplay->pending)) {
+        value = 1;
+        /* EAGAIN means the counter is saturated, so it's readable anyway */
+        if (write(bdisplay->fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+            return 0;
+    }
+
+    request = deferred_request_create(resource, implementation, opcode,
+            message, args);
+    if (request == NULL)
+        return 0; /* Better late fairness than a lost request */
+
+    request->bclient = bclient;
+    wl_list_insert(bclient->queue.prev, &request->link);
+    ++bclient->queued;
+    ++bclient->deferred;
+
+    if (wl_list_empty(&bclient->pending_link))
+        wl_list_insert(bdisplay->pending.prev, &bclient->pending_link);
+
+    return 1;
+}
+
+uint64_t
+wl_jni_client_deferred_requests(struct wl_client *client)
+{
+    struct budget_client *bclient;
+    struct wl_listener *listener;
+
+    listener = wl_client_get_destroy_listener(client,
+            budget_client_destroy_func);
+    if (listener == NULL)
+        return 0;
+
+    bclient = wl_container_of(listener, bclient, destroy_listener);
+    return bclient->deferred;
+}
+
+uint64_t
+wl_jni_display_deferred_requests(struct wl_display *display)
+{
+    struct budget_display *bdisplay;
+    struct budget_client *bclient;
+    uint64_t deferred;
+
+    bdisplay = budget_display_get(display, 0);
+    if (bdisplay == NULL)
+        return 0;
+
+    deferred = bdisplay->retired_deferred;
+    wl_list_for_each(bclient, &bdisplay->clients, link)
+        deferred += bclient->deferred;
+
+    return deferred;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Display_setRequestBudget(JNIEnv * env,
+        jobject jdisplay, jint budget)
+{
+    struct wl_display *display;
+    struct budget_display *bdisplay;
+    struct budget_client *bclient;
+
+    display = wl_jni_display_from_java(env, jdisplay);
+    if (display == NULL) {
+        if (! (*env)->ExceptionCheck(env))
+            wl_jni_throw_IllegalStateException(env, "Display destroyed");
+        return;
+    }
+
+    if (budget < 0) {
+        wl_jni_throw_IllegalArgumentException(env, "Negative budget");
+        return;
+    }
+
+    bdisplay = budget_display_get(display, budget > 0);
+    if (bdisplay == NULL) {
+        if (budget > 0)
+            wl_jni_throw_OutOfMemoryError(env, NULL);
+        return;
+    }
+
+    if (bdisplay->budget == 0 && budget > 0)
+        ++budgets_enabled;
+    else if (bdisplay->budget > 0 && budget == 0)
+        --budgets_enabled;
+    bdisplay->budget = budget;
+
+    /* Without a budget nothing may stay queued */
+    if (budget == 0) {
+        while (! wl_list_empty(&bdisplay->pending)) {
+            bclient = wl_container_of(bdisplay->pending.next, bclient,
+                    pending_link);
+            budget_client_drain(bclient, -1);
+        }
+    }
+}
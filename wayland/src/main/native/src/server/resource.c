@@ -23,6 +23,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <time.h>
 
 #include <wayland-server.h>
 #include <wayland-util.h>
@@ -31,6 +32,7 @@
 
 struct {
     jclass class;
+    jmethodID init_long;
     jfieldID resource_ptr;
     jfieldID data;
     jmethodID destroy;
@@ -56,6 +58,15 @@ struct {
     } lang;
 } java;
 
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
 struct wl_resource *
 wl_jni_resource_from_java(JNIEnv * env, jobject jresource)
 {
@@ -66,15 +77,6 @@ wl_jni_resource_from_java(JNIEnv * env, jobject jresource)
             (*env)->GetLongField(env, jresource, Resource.resource_ptr);
 }
 
-jobject
-wl_jni_resource_to_java(JNIEnv * env, struct wl_resource * resource)
-{
-    if (resource == NULL)
-        return NULL;
-
-    return (*env)->NewLocalRef(env, resource->data);
-}
-
 static void
 resource_destroyed(struct wl_resource * resource)
 {
@@ -87,6 +89,92 @@ resource_destroyed(struct wl_resource * resource)
     (*env)->DeleteGlobalRef(env, resource->data);
 }
 
+/*
+ * Resources implemented by libwayland itself, such as wl_shm buffers, get
+ * a plain Resource the first time they are handed to Java.  It is kept
+ * until the resource is destroyed, when its pointer is cleared.
+ */
+struct foreign_resource {
+    jobject jresource;
+    struct wl_listener destroy_listener;
+};
+
+static void
+foreign_resource_destroyed(struct wl_listener *listener, void *data)
+{
+    struct foreign_resource *foreign;
+    JNIEnv *env;
+
+    foreign = wl_container_of(listener, foreign, destroy_listener);
+
+    env = wl_jni_get_env();
+    (*env)->SetLongField(env, foreign->jresource, Resource.resource_ptr, 0);
+    (*env)->DeleteGlobalRef(env, foreign->jresource);
+
+    wl_list_remove(&foreign->destroy_listener.link);
+    free(foreign);
+}
+
+static jobject
+foreign_resource_to_java(JNIEnv * env, struct wl_resource * resource)
+{
+    struct foreign_resource *foreign;
+    struct wl_listener *listener;
+    jobject jresource;
+
+    listener = wl_resource_get_destroy_listener(resource,
+            foreign_resource_destroyed);
+    if (listener != NULL) {
+        foreign = wl_container_of(listener, foreign, destroy_listener);
+        return (*env)->NewLocalRef(env, foreign->jresource);
+    }
+
+    foreign = malloc(sizeof(*foreign));
+    if (foreign == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return NULL;
+    }
+
+    jresource = (*env)->NewObject(env, Resource.class, Resource.init_long,
+            (jlong)(intptr_t)resource);
+    if (jresource == NULL) {
+        free(foreign);
+        return NULL; /* Exception Thrown */
+    }
+
+    foreign->jresource = (*env)->NewGlobalRef(env, jresource);
+    if (foreign->jresource == NULL) {
+        (*env)->DeleteLocalRef(env, jresource);
+        free(foreign);
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return NULL;
+    }
+
+    foreign->destroy_listener.notify = foreign_resource_destroyed;
+    wl_resource_add_destroy_listener(resource, &foreign->destroy_listener);
+
+    return jresource;
+}
+
+int
+wl_jni_resource_is_java(struct wl_resource * resource)
+{
+    return resource->destroy == resource_destroyed;
+}
+
+jobject
+wl_jni_resource_to_java(JNIEnv * env, struct wl_resource * resource)
+{
+    if (resource == NULL)
+        return NULL;
+
+    /* Only resources created from Java carry their Java object */
+    if (! wl_jni_resource_is_java(resource))
+        return foreign_resource_to_java(env, resource);
+
+    return (*env)->NewLocalRef(env, resource->data);
+}
+
 JNIEXPORT jlong JNICALL
 Java_org_freedesktop_wayland_server_Resource_createNative(JNIEnv * env,
         jobject jresource, jobject jclient, jobject jiface, jint version,
@@ -117,7 +205,7 @@ Java_org_freedesktop_wayland_server_Resource_createNative(JNIEnv * env,
         return 0;
     }
 
-    resource = wl_resource_create(client, &jni_interface->interface,
+    resource = wl_resource_create(client, jni_interface->interface,
             version, id);
     if (resource == NULL) {
         (*env)->DeleteGlobalRef(env, jresource);
@@ -173,12 +261,13 @@ Java_org_freedesktop_wayland_server_Resource_addDestroyListener(JNIEnv * env,
         return;
     }
 
-    jni_listener = wl_jni_destroy_listener_add_to_signal(env, jlistener);
+    resource = wl_jni_resource_from_java(env, jresource);
+
+    jni_listener = wl_jni_destroy_listener_add_to_signal(env, jlistener,
+            wl_client_get_display(resource->client));
     if (jni_listener == NULL)
         return; /*Exception throw */
 
-    resource = wl_jni_resource_from_java(env, jresource);
-
     wl_signal_add(&resource->destroy_signal, &jni_listener->listener);
 }
 
@@ -196,30 +285,19 @@ Java_org_freedesktop_wayland_server_Resource_destroy(JNIEnv * env,
     (*env)->SetLongField(env, jresource, Resource.resource_ptr, (jlong)0);
 }
 
-JNIEXPORT void JNICALL
-Java_org_freedesktop_wayland_server_Resource_postEvent(JNIEnv * env,
-        jobject jresource, jint opcode, jarray jargs)
+static int
+event_since(const char *signature)
 {
-    struct wl_resource *resource;
-    union wl_argument *args;
-    const char *signature;
-    int nargs, since;
-
-    resource = wl_jni_resource_from_java(env, jresource);
-
-    signature = resource->object.interface->events[opcode].signature;
+    int since = atoi(signature);
 
-	since = atoi(signature);
-    if (since == 0)
-        since = 1;
+    return since == 0 ? 1 : since;
+}
 
-    if (since > wl_resource_get_version(resource)) {
-        wl_jni_throw_by_name(env,
-                "java.lang.UnsupportedOperationException",
-                "Event version higher than bound resource version.");
-    }
+static int
+count_arguments(const char *signature)
+{
+    int nargs = 0;
 
-    nargs = 0;
 	for(; *signature; ++signature) {
 		switch(*signature) {
 		case 'i':
@@ -234,22 +312,335 @@ Java_org_freedesktop_wayland_server_Resource_postEvent(JNIEnv * env,
 		}
     }
 
+    return nargs;
+}
+
+/*
+ * Returns nonzero if every object argument is null or belongs to client.
+ * Object ids only mean something to the client that owns the object.
+ */
+static int
+objects_owned_by(struct wl_client *client, const char *signature,
+        const union wl_argument *args)
+{
+    struct wl_resource *object;
+    int i = 0;
+
+    for (; *signature; ++signature) {
+        switch (*signature) {
+        case 'o':
+            object = (struct wl_resource *)args[i].o;
+            if (object != NULL && wl_resource_get_client(object) != client)
+                return 0;
+            /* Fall through */
+        case 'i':
+        case 'u':
+        case 'f':
+        case 's':
+        case 'n':
+        case 'a':
+        case 'h':
+            ++i;
+        }
+    }
+
+    return 1;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Resource_postEvent(JNIEnv * env,
+        jobject jresource, jint opcode, jarray jargs)
+{
+    struct wl_resource *resource;
+    union wl_argument *args;
+    const char *signature;
+    int nargs;
+
+    resource = wl_jni_resource_from_java(env, jresource);
+
+    signature = resource->object.interface->events[opcode].signature;
+
+    if (event_since(signature) > wl_resource_get_version(resource)) {
+        wl_jni_throw_by_name(env,
+                "java.lang.UnsupportedOperationException",
+                "Event version higher than bound resource version.");
+    }
+
+    nargs = count_arguments(signature);
+
     args = malloc(nargs * sizeof(union wl_argument));
     if (args == NULL) {
         wl_jni_throw_OutOfMemoryError(env, NULL);
         return;
     }
 
-    signature = resource->object.interface->events[opcode].signature;
     wl_jni_arguments_from_java(env, args, jargs, signature, nargs,
             (struct wl_object *(*)(JNIEnv *, jobject))&wl_jni_resource_from_java);
     if ((*env)->ExceptionCheck(env))
         return;
 
+    if (! wl_jni_client_filter_event(resource, opcode, args)) {
+        wl_resource_post_event_array(resource, opcode, args);
+        wl_jni_client_stats_event(resource, opcode, args);
+    }
+
+    wl_jni_arguments_from_java_destroy(args, signature, nargs);
+    free(args);
+}
+
+/*
+ * Backs the postEventN() variants.  The event's signature must consist of
+ * exactly count int-like arguments; the values go straight into a
+ * wl_argument array on the stack.
+ */
+static void
+post_primitive_event(JNIEnv * env, jobject jresource, jint opcode,
+        const jint *values, int count)
+{
+    struct wl_resource *resource;
+    const struct wl_interface *interface;
+    union wl_argument args[6];
+    const char *signature;
+    int nargs;
+
+    resource = wl_jni_resource_from_java(env, jresource);
+    if (resource == NULL) {
+        wl_jni_throw_NullPointerException(env, "Resource destroyed");
+        return;
+    }
+
+    interface = resource->object.interface;
+    if (opcode < 0 || opcode >= interface->event_count) {
+        wl_jni_throw_IllegalArgumentException(env, "Invalid opcode");
+        return;
+    }
+    signature = interface->events[opcode].signature;
+
+    if (event_since(signature) > wl_resource_get_version(resource)) {
+        wl_jni_throw_by_name(env,
+                "java/lang/UnsupportedOperationException",
+                "Event version higher than bound resource version.");
+        return;
+    }
+
+    nargs = 0;
+    for (; *signature; ++signature) {
+        switch (*signature) {
+        case 'i':
+        case 'u':
+        case 'f':
+        case 'h':
+            break;
+        case 's':
+        case 'o':
+        case 'n':
+        case 'a':
+            wl_jni_throw_IllegalArgumentException(env,
+                    "Event has non-primitive arguments");
+            return;
+        default:
+            continue;
+        }
+
+        if (nargs == count)
+            break;
+
+        switch (*signature) {
+        case 'i':
+            args[nargs].i = values[nargs];
+            break;
+        case 'u':
+            args[nargs].u = (uint32_t)values[nargs];
+            break;
+        case 'f':
+            args[nargs].f = values[nargs];
+            break;
+        case 'h':
+            args[nargs].h = values[nargs];
+            break;
+        }
+        ++nargs;
+    }
+
+    if (nargs != count || *signature != '\0') {
+        wl_jni_throw_IllegalArgumentException(env,
+                "Wrong number of event arguments");
+        return;
+    }
+
+    if (wl_jni_client_filter_event(resource, opcode, args))
+        return;
+
     wl_resource_post_event_array(resource, opcode, args);
+    wl_jni_client_stats_event(resource, opcode, args);
+}
 
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Resource_postEvent0(JNIEnv * env,
+        jobject jresource, jint opcode)
+{
+    post_primitive_event(env, jresource, opcode, NULL, 0);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Resource_postEvent1(JNIEnv * env,
+        jobject jresource, jint opcode, jint arg0)
+{
+    jint values[] = { arg0 };
+
+    post_primitive_event(env, jresource, opcode, values, 1);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Resource_postEvent2(JNIEnv * env,
+        jobject jresource, jint opcode, jint arg0, jint arg1)
+{
+    jint values[] = { arg0, arg1 };
+
+    post_primitive_event(env, jresource, opcode, values, 2);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Resource_postEvent3(JNIEnv * env,
+        jobject jresource, jint opcode, jint arg0, jint arg1, jint arg2)
+{
+    jint values[] = { arg0, arg1, arg2 };
+
+    post_primitive_event(env, jresource, opcode, values, 3);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Resource_postEvent4(JNIEnv * env,
+        jobject jresource, jint opcode, jint arg0, jint arg1, jint arg2,
+        jint arg3)
+{
+    jint values[] = { arg0, arg1, arg2, arg3 };
+
+    post_primitive_event(env, jresource, opcode, values, 4);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Resource_postEvent5(JNIEnv * env,
+        jobject jresource, jint opcode, jint arg0, jint arg1, jint arg2,
+        jint arg3, jint arg4)
+{
+    jint values[] = { arg0, arg1, arg2, arg3, arg4 };
+
+    post_primitive_event(env, jresource, opcode, values, 5);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Resource_postEvent6(JNIEnv * env,
+        jobject jresource, jint opcode, jint arg0, jint arg1, jint arg2,
+        jint arg3, jint arg4, jint arg5)
+{
+    jint values[] = { arg0, arg1, arg2, arg3, arg4, arg5 };
+
+    post_primitive_event(env, jresource, opcode, values, 6);
+}
+
+/*
+ * Posts one event to every target, converting the arguments only once.
+ * All targets are checked before anything is sent, so an exception means
+ * no client saw the event.
+ */
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_Resource_broadcast(JNIEnv * env,
+        jclass cls, jobjectArray jtargets, jint opcode, jarray jargs)
+{
+    struct wl_resource **targets;
+    const struct wl_interface *interface;
+    union wl_argument *args;
+    const char *signature;
+    jobject jtarget;
+    int i, ntargets, nargs, since;
+
+    if (jtargets == NULL) {
+        wl_jni_throw_NullPointerException(env, "targets not allowed to be null");
+        return;
+    }
+
+    ntargets = (*env)->GetArrayLength(env, jtargets);
+    if (ntargets == 0)
+        return;
+
+    targets = malloc(ntargets * sizeof(*targets));
+    if (targets == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return;
+    }
+
+    args = NULL;
+    interface = NULL;
+    signature = NULL;
+    for (i = 0; i < ntargets; ++i) {
+        jtarget = (*env)->GetObjectArrayElement(env, jtargets, i);
+        targets[i] = wl_jni_resource_from_java(env, jtarget);
+        (*env)->DeleteLocalRef(env, jtarget);
+
+        if (targets[i] == NULL) {
+            wl_jni_throw_NullPointerException(env,
+                    "Broadcast target is null or destroyed");
+            goto out;
+        }
+
+        if (interface == NULL) {
+            interface = targets[i]->object.interface;
+            if (opcode < 0 || opcode >= interface->event_count) {
+                wl_jni_throw_IllegalArgumentException(env, "Invalid opcode");
+                goto out;
+            }
+            signature = interface->events[opcode].signature;
+        } else if (targets[i]->object.interface != interface) {
+            wl_jni_throw_IllegalArgumentException(env,
+                    "Broadcast targets have different interfaces");
+            goto out;
+        }
+    }
+
+    /* A new_id would have to be a different object for each target */
+    if (strchr(signature, 'n') != NULL) {
+        wl_jni_throw_IllegalArgumentException(env,
+                "Cannot broadcast an event that creates objects");
+        goto out;
+    }
+
+    nargs = count_arguments(signature);
+    args = malloc(nargs * sizeof(union wl_argument) + 1);
+    if (args == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        goto out;
+    }
+
+    wl_jni_arguments_from_java(env, args, jargs, signature, nargs,
+            (struct wl_object *(*)(JNIEnv *, jobject))&wl_jni_resource_from_java);
+    if ((*env)->ExceptionCheck(env))
+        goto out;
+
+    for (i = 0; i < ntargets; ++i) {
+        if (! objects_owned_by(wl_resource_get_client(targets[i]),
+                signature, args)) {
+            wl_jni_throw_IllegalArgumentException(env,
+                    "Broadcast argument belongs to another client");
+            goto destroy_args;
+        }
+    }
+
+    /* Targets bound at a version without the event are skipped */
+    since = event_since(signature);
+    for (i = 0; i < ntargets; ++i)
+        if (wl_resource_get_version(targets[i]) >= since
+                && ! wl_jni_client_filter_event(targets[i], opcode, args)) {
+            wl_resource_post_event_array(targets[i], opcode, args);
+            wl_jni_client_stats_event(targets[i], opcode, args);
+        }
+
+destroy_args:
     wl_jni_arguments_from_java_destroy(args, signature, nargs);
+
+out:
     free(args);
+    free(targets);
 }
 
 JNIEXPORT void JNICALL
@@ -274,96 +665,92 @@ Java_org_freedesktop_wayland_server_Resource_postError(JNIEnv * env,
     free(msg);
 }
 
-/* TODO: This code DOES NOT WORK!!! */
+/*
+ * Turns an exception thrown by a request handler into a protocol error.
+ * RequestError and NoSuchMethodError are reported to the client; anything
+ * else goes to the Display's UncaughtCallbackHandler.  In every case the
+ * exception is cleared before returning to libwayland.
+ */
 static int
 handle_resource_errors(JNIEnv * env, struct wl_resource * resource)
 {
-    jthrowable exception, exception2;
+    jthrowable exception;
+    jobject jresource;
     jstring message;
     char * c_msg;
     int error_code;
 
     exception = (*env)->ExceptionOccurred(env);
-
     if (exception == NULL)
         return 0;
 
-    (*env)->ExceptionDescribe(env);
+    (*env)->ExceptionClear(env);
 
     if ((*env)->IsInstanceOf(env, exception,
-            java.lang.OutOfMemoryError.class)) {
+            java.lang.OutOfMemoryError.class))
         goto out_of_memory;
-    }
-    
-    if ((*env)->IsInstanceOf(env, exception,
-            java.lang.NoSuchMethodError.class) ||
-        (*env)->IsInstanceOf(env, exception, RequestError.class))
-    {
-        (*env)->ExceptionClear(env);
 
-        message = (*env)->CallObjectMethod(env, exception,
-                java.lang.Throwable.getMessage);
+    if ((*env)->IsInstanceOf(env, exception,
+            java.lang.NoSuchMethodError.class)) {
+        error_code = WL_DISPLAY_ERROR_INVALID_METHOD;
+    } else if ((*env)->IsInstanceOf(env, exception, RequestError.class)) {
+        error_code = (*env)->GetIntField(env, exception,
+                RequestError.errorCode);
+    } else {
+        goto unhandled_exception;
+    }
 
-        exception2 = (*env)->ExceptionOccurred(env);
-        if (exception2 != NULL) {
-            if ((*env)->IsInstanceOf(env, exception,
-                    java.lang.OutOfMemoryError.class)) {
-                goto out_of_memory;
-            } else {
-                goto unhandled_exception;
-            }
-        }
+    message = (*env)->CallObjectMethod(env, exception,
+            java.lang.Throwable.getMessage);
+    if ((*env)->ExceptionCheck(env)) {
+        (*env)->ExceptionClear(env);
+        goto out_of_memory;
+    }
 
+    if (message != NULL) {
         c_msg = wl_jni_string_to_utf8(env, message);
-        exception2 = (*env)->ExceptionOccurred(env);
-        if (exception2 != NULL) {
-            if ((*env)->IsInstanceOf(env, exception,
-                    java.lang.OutOfMemoryError.class)) {
-                goto out_of_memory;
-            } else {
-                goto unhandled_exception;
-            }
-        }
-
-        if ((*env)->IsInstanceOf(env, exception,
-                java.lang.NoSuchMethodError.class)) {
-            wl_resource_post_error(resource, WL_DISPLAY_ERROR_INVALID_METHOD,
-                    "%s", c_msg);
-            free(c_msg);
-            (*env)->ExceptionClear(env);
-            return 0;
-        } else if ((*env)->IsInstanceOf(env, exception,
-                RequestError.class)) {
-            error_code = (*env)->GetIntField(env, exception,
-                    RequestError.errorCode);
-            wl_resource_post_error(resource, error_code, "%s", c_msg);
-            free(c_msg);
+        (*env)->DeleteLocalRef(env, message);
+        if (c_msg == NULL) {
             (*env)->ExceptionClear(env);
-            return 0;
-        } else {
-            free(c_msg);
-            goto unhandled_exception;
+            goto out_of_memory;
         }
     } else {
-        goto unhandled_exception;
+        c_msg = NULL;
     }
 
+    wl_resource_post_error(resource, error_code, "%s",
+            c_msg ? c_msg : "unknown error");
+    free(c_msg);
+    (*env)->DeleteLocalRef(env, exception);
+    return 0;
+
 out_of_memory:
     wl_resource_post_no_memory(resource);
-    (*env)->ExceptionClear(env);
+    (*env)->DeleteLocalRef(env, exception);
     return 0;
 
 unhandled_exception:
-    (*env)->ExceptionDescribe(env);
+    jresource = wl_jni_resource_to_java(env, resource);
     (*env)->ExceptionClear(env);
+
+    wl_jni_display_report_exception(env,
+            wl_client_get_display(resource->client), jresource, exception);
+
+    if (jresource != NULL)
+        (*env)->DeleteLocalRef(env, jresource);
+    (*env)->DeleteLocalRef(env, exception);
     return -1;
 }
 
+/*
+ * Calls the Java implementation of a request.  data is the resource's
+ * table of method IDs.
+ */
 int
-wl_jni_resource_dispatcher(const void *data, void *target, uint32_t opcode,
-        const struct wl_message *message, union wl_argument *args)
+wl_jni_resource_dispatch(const void *data, struct wl_resource *resource,
+        uint32_t opcode, const struct wl_message *message,
+        union wl_argument *args)
 {
-    struct wl_resource *resource;
     const char *signature;
     int nargs, nrefs;
 
@@ -371,11 +758,15 @@ wl_jni_resource_dispatcher(const void *data, void *target, uint32_t opcode,
     JNIEnv *env;
     jobject jimplementation, jresource;
     jmethodID mid;
+    uint64_t start_ns, handler_ns;
+    struct wl_jni_request_stats request_stats;
 
-    resource = wl_container_of(target, resource, object);
+    handler_ns = 0;
 
     env = wl_jni_get_env();
 
+    wl_jni_client_stats_request(&request_stats, resource, opcode);
+
     /* Count the number of arguments and references */
     nargs = 0;
     nrefs = 0;
@@ -429,17 +820,36 @@ wl_jni_resource_dispatcher(const void *data, void *target, uint32_t opcode,
 
     jargs[0].l = jresource;
     mid = ((jmethodID *)data)[opcode];
+    start_ns = monotonic_ns();
     (*env)->CallVoidMethodA(env, jimplementation, mid, jargs);
+    handler_ns = monotonic_ns() - start_ns;
 
 pop_local_frame:
     (*env)->PopLocalFrame(env, NULL);
     free(jargs);
 
 handle_exceptions:
+    wl_jni_client_stats_request_done(&request_stats, handler_ns);
+
     /* Handle Exceptions here */
     return handle_resource_errors(env, resource);
 }
 
+int
+wl_jni_resource_dispatcher(const void *data, void *target, uint32_t opcode,
+        const struct wl_message *message, union wl_argument *args)
+{
+    struct wl_resource *resource;
+
+    resource = wl_container_of(target, resource, object);
+
+    /* Over-budget requests are dispatched later from the request queue */
+    if (wl_jni_client_defer_request(resource, data, opcode, message, args))
+        return 0;
+
+    return wl_jni_resource_dispatch(data, resource, opcode, message, args);
+}
+
 JNIEXPORT void JNICALL
 Java_org_freedesktop_wayland_server_Resource_initializeJNI(JNIEnv * env,
         jclass cls)
@@ -448,6 +858,11 @@ Java_org_freedesktop_wayland_server_Resource_initializeJNI(JNIEnv * env,
     if (Resource.class == NULL)
         return; /* Exception Thrown */
 
+    Resource.init_long = (*env)->GetMethodID(env, Resource.class,
+            "<init>", "(J)V");
+    if (Resource.init_long == NULL)
+        return; /* Exception Thrown */
+
     Resource.resource_ptr = (*env)->GetFieldID(env, Resource.class,
             "resource_ptr", "J");
     if (Resource.resource_ptr == NULL)
@@ -54,28 +54,62 @@ jobject wl_jni_client_to_java(JNIEnv * env, struct wl_client * client);
 
 struct wl_display * wl_jni_display_from_java(JNIEnv * env, jobject display);
 jobject wl_jni_display_to_java(JNIEnv * env, struct wl_display * display);
+void wl_jni_display_report_exception(JNIEnv * env, struct wl_display * display,
+        jobject jsource, jthrowable exception);
 
 struct wl_global * wl_jni_global_from_java(JNIEnv * env, jobject jglobal);
 
 struct wl_event_loop * wl_jni_event_loop_from_java(JNIEnv * env, jobject event_loop);
 jobject wl_jni_event_loop_to_java(JNIEnv * env, struct wl_event_loop * event_loop);
 jobject wl_jni_event_loop_create(JNIEnv * env, struct wl_event_loop *loop);
+void wl_jni_event_loop_report_exception(JNIEnv * env,
+        struct wl_event_loop * loop, jobject jsource, jthrowable exception);
 
 struct wl_resource * wl_jni_resource_from_java(JNIEnv * env, jobject resource);
 jobject wl_jni_resource_to_java(JNIEnv * env, struct wl_resource * resource);
+int wl_jni_resource_is_java(struct wl_resource * resource);
 int wl_jni_resource_dispatcher(const void *data, void *target, uint32_t opcode,
         const struct wl_message *message, union wl_argument *args);
+int wl_jni_resource_dispatch(const void *data, struct wl_resource *resource,
+        uint32_t opcode, const struct wl_message *message,
+        union wl_argument *args);
+
+int wl_jni_client_defer_request(struct wl_resource *resource,
+        const void *implementation, uint32_t opcode,
+        const struct wl_message *message, union wl_argument *args);
+uint64_t wl_jni_client_deferred_requests(struct wl_client *client);
+uint64_t wl_jni_display_deferred_requests(struct wl_display *display);
+
+struct client_stats;
+
+/* One request being handled; survives the handler destroying the client */
+struct wl_jni_request_stats {
+    struct client_stats *stats;
+    struct wl_jni_request_stats *prev;
+};
+
+void wl_jni_client_stats_request(struct wl_jni_request_stats *request,
+        struct wl_resource *resource, uint32_t opcode);
+void wl_jni_client_stats_request_done(struct wl_jni_request_stats *request,
+        uint64_t handler_ns);
+void wl_jni_client_stats_event(struct wl_resource *resource, uint32_t opcode,
+        const union wl_argument *args);
+int wl_jni_client_filter_event(struct wl_resource *resource, uint32_t opcode,
+        const union wl_argument *args);
+int wl_jni_client_is_congested(struct wl_client *client);
+void wl_jni_display_flush_clients(struct wl_display *display);
 
 struct wl_jni_destroy_listener {
     struct wl_listener listener;
     jobject self_ref;
+    struct wl_display * display;
 };
 
 struct wl_jni_destroy_listener * wl_jni_destroy_listener_from_java(
         JNIEnv * env, jobject jlistener);
 
 struct wl_jni_destroy_listener *wl_jni_destroy_listener_add_to_signal(
-        JNIEnv * env, jobject jlistener);
+        JNIEnv * env, jobject jlistener, struct wl_display * display);
 
 #endif /* ! defined __WAYLAND_JAVA_SERVER_JNI_H__ */
 
@@ -0,0 +1,141 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#include <stdlib.h>
+
+#include "server-jni.h"
+
+static struct wl_shm_buffer *
+shm_buffer_from_java(JNIEnv * env, jobject jresource)
+{
+    struct wl_resource * resource;
+    struct wl_shm_buffer * buffer;
+
+    resource = wl_jni_resource_from_java(env, jresource);
+    if (resource == NULL) {
+        wl_jni_throw_NullPointerException(env, "resource not allowed to be null");
+        return NULL;
+    }
+
+    buffer = wl_shm_buffer_get(resource);
+    if (buffer == NULL)
+        wl_jni_throw_IllegalArgumentException(env, "Not a wl_shm buffer");
+
+    return buffer;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_server_ShmBuffer_isShmBuffer(JNIEnv * env,
+        jclass cls, jobject jresource)
+{
+    struct wl_resource * resource;
+
+    resource = wl_jni_resource_from_java(env, jresource);
+    if (resource == NULL)
+        return JNI_FALSE;
+
+    return wl_shm_buffer_get(resource) != NULL;
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_server_ShmBuffer_getWidthNative(JNIEnv * env,
+        jclass cls, jobject jresource)
+{
+    struct wl_shm_buffer * buffer = shm_buffer_from_java(env, jresource);
+    if (buffer == NULL)
+        return 0; /* Exception Thrown */
+
+    return wl_shm_buffer_get_width(buffer);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_server_ShmBuffer_getHeightNative(JNIEnv * env,
+        jclass cls, jobject jresource)
+{
+    struct wl_shm_buffer * buffer = shm_buffer_from_java(env, jresource);
+    if (buffer == NULL)
+        return 0; /* Exception Thrown */
+
+    return wl_shm_buffer_get_height(buffer);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_server_ShmBuffer_getStrideNative(JNIEnv * env,
+        jclass cls, jobject jresource)
+{
+    struct wl_shm_buffer * buffer = shm_buffer_from_java(env, jresource);
+    if (buffer == NULL)
+        return 0; /* Exception Thrown */
+
+    return wl_shm_buffer_get_stride(buffer);
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_server_ShmBuffer_getFormatNative(JNIEnv * env,
+        jclass cls, jobject jresource)
+{
+    struct wl_shm_buffer * buffer = shm_buffer_from_java(env, jresource);
+    if (buffer == NULL)
+        return 0; /* Exception Thrown */
+
+    return wl_shm_buffer_get_format(buffer);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_ShmBuffer_beginAccessNative(JNIEnv * env,
+        jclass cls, jobject jresource)
+{
+    struct wl_shm_buffer * buffer = shm_buffer_from_java(env, jresource);
+    if (buffer == NULL)
+        return; /* Exception Thrown */
+
+    wl_shm_buffer_begin_access(buffer);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_ShmBuffer_endAccessNative(JNIEnv * env,
+        jclass cls, jobject jresource)
+{
+    struct wl_shm_buffer * buffer = shm_buffer_from_java(env, jresource);
+    if (buffer == NULL)
+        return; /* Exception Thrown */
+
+    wl_shm_buffer_end_access(buffer);
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_freedesktop_wayland_server_ShmBuffer_getDataNative(JNIEnv * env,
+        jclass cls, jobject jresource)
+{
+    struct wl_shm_buffer * buffer;
+    void * data;
+    jlong size;
+
+    buffer = shm_buffer_from_java(env, jresource);
+    if (buffer == NULL)
+        return NULL; /* Exception Thrown */
+
+    data = wl_shm_buffer_get_data(buffer);
+    size = (jlong)wl_shm_buffer_get_stride(buffer)
+            * wl_shm_buffer_get_height(buffer);
+
+    return (*env)->NewDirectByteBuffer(env, data, size);
+}
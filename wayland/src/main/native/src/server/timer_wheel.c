@@ -0,0 +1,578 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <wayland-server.h>
+
+#include "server/server-jni.h"
+
+/*
+ * A hierarchical timing wheel in the style of the Linux kernel's timer
+ * wheel.  Level 0 has one slot per tick and every higher level has slots
+ * that are WHEEL_SLOTS times as wide as the level below it.  Timers are
+ * cascaded down one level whenever the wheel crosses the boundary of the
+ * slot they live in.  The whole wheel is driven by a single timerfd that is
+ * always armed for the next tick on which something has to happen.
+ */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_MAX_DELTA ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+struct {
+    jclass class;
+    jfieldID wheel_ptr;
+    jmethodID dispatchExpired;
+} TimerWheel;
+
+struct wheel_timer {
+    jint id;
+    uint64_t expires;
+    int pending;
+    int level;
+    int slot;
+    struct wl_list link;
+    struct wl_list wheel_link;
+};
+
+struct timer_wheel {
+    int fd;
+    struct wl_event_source *source;
+    jweak jwheel;
+    struct wl_event_loop *loop;
+    struct wl_listener destroy_listener;
+
+    uint64_t tick_ns;
+    uint64_t start_ns;
+    uint64_t current;
+    uint64_t armed;
+    int pending_count;
+    struct wl_list timers;
+
+    uint64_t occupied[WHEEL_LEVELS];
+    struct wl_list slots[WHEEL_LEVELS][WHEEL_SLOTS];
+
+    struct wl_list expired;
+    jintArray jexpired;
+    jint expired_capacity;
+};
+
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t
+wheel_now_tick(struct timer_wheel *wheel)
+{
+    return (monotonic_ns() - wheel->start_ns) / wheel->tick_ns;
+}
+
+static void
+wheel_insert(struct timer_wheel *wheel, struct wheel_timer *timer)
+{
+    uint64_t expires, delta;
+    int level;
+
+    expires = timer->expires;
+
+    if (expires <= wheel->current) {
+        /* Only happens while cascading; expire on the current tick */
+        level = 0;
+        expires = wheel->current;
+    } else {
+        delta = expires - wheel->current;
+        if (delta >= WHEEL_MAX_DELTA) {
+            /* Park it in the top level; it gets re-cascaded later */
+            expires = wheel->current + WHEEL_MAX_DELTA - 1;
+            delta = WHEEL_MAX_DELTA - 1;
+        }
+
+        for (level = 0; level < WHEEL_LEVELS - 1; ++level)
+            if (delta < ((uint64_t)1 << (WHEEL_BITS * (level + 1))))
+                break;
+    }
+
+    timer->level = level;
+    timer->slot = (expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    timer->pending = 1;
+
+    wl_list_insert(wheel->slots[level][timer->slot].prev, &timer->link);
+    wheel->occupied[level] |= (uint64_t)1 << timer->slot;
+}
+
+static void
+wheel_remove(struct timer_wheel *wheel, struct wheel_timer *timer)
+{
+    struct wl_list *slot;
+
+    slot = &wheel->slots[timer->level][timer->slot];
+    wl_list_remove(&timer->link);
+    wl_list_init(&timer->link);
+    if (wl_list_empty(slot))
+        wheel->occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+
+    timer->pending = 0;
+}
+
+/* Returns the next tick on which a timer expires or cascades, or 0 */
+static uint64_t
+wheel_next_tick(struct timer_wheel *wheel)
+{
+    uint64_t next, tick, rotated, base;
+    int level, shift, index, offset;
+
+    if (wheel->pending_count == 0)
+        return 0;
+
+    next = 0;
+    for (level = 0; level < WHEEL_LEVELS; ++level) {
+        if (wheel->occupied[level] == 0)
+            continue;
+
+        shift = WHEEL_BITS * level;
+        base = wheel->current >> shift;
+        index = (base + 1) & WHEEL_MASK;
+
+        /* Rotate so that bit 0 is the slot after the current one */
+        rotated = wheel->occupied[level] >> index;
+        if (index != 0)
+            rotated |= wheel->occupied[level] << (WHEEL_SLOTS - index);
+
+        offset = __builtin_ctzll(rotated) + 1;
+        tick = (base + offset) << shift;
+
+        if (next == 0 || tick < next)
+            next = tick;
+    }
+
+    return next;
+}
+
+static void
+wheel_cascade(struct timer_wheel *wheel, int level, int slot)
+{
+    struct wheel_timer *timer, *tmp;
+    struct wl_list list;
+
+    wl_list_init(&list);
+    wl_list_insert_list(&list, &wheel->slots[level][slot]);
+    wl_list_init(&wheel->slots[level][slot]);
+    wheel->occupied[level] &= ~((uint64_t)1 << slot);
+
+    wl_list_for_each_safe(timer, tmp, &list, link)
+        wheel_insert(wheel, timer);
+}
+
+static void
+wheel_advance(struct timer_wheel *wheel, uint64_t now)
+{
+    struct wheel_timer *timer, *tmp;
+    uint64_t next;
+    int level, slot;
+
+    while (wheel->current < now) {
+        next = wheel_next_tick(wheel);
+        if (next == 0 || next > now) {
+            wheel->current = now;
+            break;
+        }
+
+        /* Nothing happens on the ticks in between, so skip them */
+        wheel->current = next;
+
+        for (level = WHEEL_LEVELS - 1; level > 0; --level) {
+            if (next & (((uint64_t)1 << (WHEEL_BITS * level)) - 1))
+                continue;
+
+            slot = (next >> (WHEEL_BITS * level)) & WHEEL_MASK;
+            if (wheel->occupied[level] & ((uint64_t)1 << slot))
+                wheel_cascade(wheel, level, slot);
+        }
+
+        slot = next & WHEEL_MASK;
+        wl_list_for_each_safe(timer, tmp, &wheel->slots[0][slot], link) {
+            wl_list_remove(&timer->link);
+            wl_list_insert(wheel->expired.prev, &timer->link);
+            timer->pending = 0;
+            --wheel->pending_count;
+        }
+        wl_list_init(&wheel->slots[0][slot]);
+        wheel->occupied[0] &= ~((uint64_t)1 << slot);
+    }
+}
+
+static int
+wheel_arm(struct timer_wheel *wheel, int force)
+{
+    struct itimerspec its;
+    uint64_t next, ns;
+
+    next = wheel_next_tick(wheel);
+    if (! force && next == wheel->armed)
+        return 0;
+    /* An early wakeup is harmless, so don't bother re-arming later */
+    if (! force && wheel->armed != 0 && next > wheel->armed)
+        return 0;
+
+    memset(&its, 0, sizeof(its));
+    if (next != 0) {
+        ns = wheel->start_ns + next * wheel->tick_ns;
+        its.it_value.tv_sec = ns / 1000000000ull;
+        its.it_value.tv_nsec = ns % 1000000000ull;
+    }
+
+    wheel->armed = next;
+    return timerfd_settime(wheel->fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static jint
+wheel_collect_expired(JNIEnv *env, struct timer_wheel *wheel)
+{
+    struct wheel_timer *timer, *tmp;
+    jint count, capacity, *ids;
+    jintArray jarr;
+
+    count = wl_list_length(&wheel->expired);
+    if (count == 0)
+        return 0;
+
+    if (count > wheel->expired_capacity) {
+        capacity = wheel->expired_capacity ? wheel->expired_capacity : 16;
+        while (capacity < count)
+            capacity *= 2;
+
+        jarr = (*env)->NewIntArray(env, capacity);
+        if (jarr == NULL)
+            return -1; /* Exception Thrown */
+
+        if (wheel->jexpired)
+            (*env)->DeleteGlobalRef(env, wheel->jexpired);
+        wheel->jexpired = (*env)->NewGlobalRef(env, jarr);
+        (*env)->DeleteLocalRef(env, jarr);
+        if (wheel->jexpired == NULL) {
+            wheel->expired_capacity = 0;
+            return -1; /* Exception Thrown */
+        }
+        wheel->expired_capacity = capacity;
+    }
+
+    ids = (*env)->GetPrimitiveArrayCritical(env, wheel->jexpired, NULL);
+    if (ids == NULL)
+        return -1; /* Exception Thrown */
+
+    count = 0;
+    wl_list_for_each_safe(timer, tmp, &wheel->expired, link) {
+        ids[count++] = timer->id;
+        wl_list_remove(&timer->link);
+        wl_list_init(&timer->link);
+    }
+
+    (*env)->ReleasePrimitiveArrayCritical(env, wheel->jexpired, ids, 0);
+
+    return count;
+}
+
+static int
+handle_timer_wheel_call(int fd, uint32_t mask, void *data)
+{
+    struct timer_wheel *wheel = data;
+    struct wl_event_loop *loop;
+    jthrowable exception;
+    uint64_t expirations;
+    jobject jwheel;
+    jint count;
+    JNIEnv *env;
+
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        return 0;
+
+    env = wl_jni_get_env();
+
+    wheel_advance(wheel, wheel_now_tick(wheel));
+    wheel_arm(wheel, 1);
+
+    /* A handler may destroy the wheel, so nothing below may touch it */
+    loop = wheel->loop;
+    jwheel = (*env)->NewLocalRef(env, wheel->jwheel);
+
+    count = wheel_collect_expired(env, wheel);
+    if (count > 0 && jwheel != NULL)
+        (*env)->CallVoidMethod(env, jwheel, TimerWheel.dispatchExpired,
+                wheel->jexpired, count);
+
+    if ((*env)->ExceptionCheck(env)) {
+        exception = (*env)->ExceptionOccurred(env);
+        (*env)->ExceptionClear(env);
+
+        wl_jni_event_loop_report_exception(env, loop, jwheel, exception);
+        (*env)->DeleteLocalRef(env, exception);
+    }
+
+    if (jwheel != NULL)
+        (*env)->DeleteLocalRef(env, jwheel);
+
+    return 1;
+}
+
+static void
+timer_wheel_destroy(JNIEnv *env, struct timer_wheel *wheel)
+{
+    struct wheel_timer *timer, *tmp;
+    jobject jwheel;
+
+    jwheel = (*env)->NewLocalRef(env, wheel->jwheel);
+    if (jwheel != NULL) {
+        (*env)->SetLongField(env, jwheel, TimerWheel.wheel_ptr, 0);
+        (*env)->DeleteLocalRef(env, jwheel);
+    }
+
+    wl_list_for_each_safe(timer, tmp, &wheel->timers, wheel_link)
+        free(timer);
+
+    wl_list_remove(&wheel->destroy_listener.link);
+    wl_event_source_remove(wheel->source);
+    close(wheel->fd);
+
+    if (wheel->jexpired)
+        (*env)->DeleteGlobalRef(env, wheel->jexpired);
+    (*env)->DeleteWeakGlobalRef(env, wheel->jwheel);
+    free(wheel);
+}
+
+static void
+timer_wheel_destroy_func(struct wl_listener *listener, void *data)
+{
+    struct timer_wheel *wheel;
+
+    wheel = wl_container_of(listener, wheel, destroy_listener);
+
+    timer_wheel_destroy(wl_jni_get_env(), wheel);
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_freedesktop_wayland_server_TimerWheel_createNative(JNIEnv * env,
+        jobject jwheel, jobject jevent_loop, jlong tick_ns)
+{
+    struct wl_event_loop *loop;
+    struct timer_wheel *wheel;
+    int level, slot;
+
+    loop = wl_jni_event_loop_from_java(env, jevent_loop);
+    if ((*env)->ExceptionCheck(env))
+        return 0; /* Exception Thrown */
+
+    if (loop == NULL) {
+        wl_jni_throw_NullPointerException(env, "EventLoop cannot be null");
+        return 0;
+    }
+
+    if (tick_ns <= 0) {
+        wl_jni_throw_IllegalArgumentException(env,
+                "Tick length must be positive");
+        return 0;
+    }
+
+    wheel = malloc(sizeof(struct timer_wheel));
+    if (wheel == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return 0;
+    }
+    memset(wheel, 0, sizeof(struct timer_wheel));
+
+    for (level = 0; level < WHEEL_LEVELS; ++level)
+        for (slot = 0; slot < WHEEL_SLOTS; ++slot)
+            wl_list_init(&wheel->slots[level][slot]);
+    wl_list_init(&wheel->expired);
+    wl_list_init(&wheel->timers);
+
+    wheel->loop = loop;
+    wheel->tick_ns = tick_ns;
+    wheel->start_ns = monotonic_ns();
+
+    wheel->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (wheel->fd < 0) {
+        wl_jni_throw_from_errno(env, errno);
+        free(wheel);
+        return 0;
+    }
+
+    wheel->source = wl_event_loop_add_fd(loop, wheel->fd, WL_EVENT_READABLE,
+            handle_timer_wheel_call, wheel);
+    if (wheel->source == NULL) {
+        wl_jni_throw_from_errno(env, errno);
+        close(wheel->fd);
+        free(wheel);
+        return 0;
+    }
+
+    wheel->jwheel = (*env)->NewWeakGlobalRef(env, jwheel);
+    if (wheel->jwheel == NULL) {
+        wl_event_source_remove(wheel->source);
+        close(wheel->fd);
+        free(wheel);
+        return 0; /* Exception Thrown */
+    }
+
+    wheel->destroy_listener.notify = timer_wheel_destroy_func;
+    wl_event_loop_add_destroy_listener(loop, &wheel->destroy_listener);
+
+    return (jlong)(intptr_t)wheel;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_TimerWheel_destroyNative(JNIEnv * env,
+        jobject jwheel, jlong wheel_ptr)
+{
+    struct timer_wheel *wheel;
+
+    wheel = (struct timer_wheel *)(intptr_t)wheel_ptr;
+    if (wheel == NULL)
+        return;
+
+    timer_wheel_destroy(env, wheel);
+}
+
+JNIEXPORT jlong JNICALL
+Java_org_freedesktop_wayland_server_TimerWheel_createTimerNative(JNIEnv * env,
+        jclass cls, jlong wheel_ptr, jint id)
+{
+    struct timer_wheel *wheel;
+    struct wheel_timer *timer;
+
+    wheel = (struct timer_wheel *)(intptr_t)wheel_ptr;
+
+    timer = malloc(sizeof(struct wheel_timer));
+    if (timer == NULL) {
+        wl_jni_throw_OutOfMemoryError(env, NULL);
+        return 0;
+    }
+    memset(timer, 0, sizeof(struct wheel_timer));
+
+    timer->id = id;
+    wl_list_init(&timer->link);
+    wl_list_insert(&wheel->timers, &timer->wheel_link);
+
+    return (jlong)(intptr_t)timer;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_TimerWheel_destroyTimerNative(JNIEnv * env,
+        jclass cls, jlong wheel_ptr, jlong timer_ptr)
+{
+    struct timer_wheel *wheel;
+    struct wheel_timer *timer;
+
+    wheel = (struct timer_wheel *)(intptr_t)wheel_ptr;
+    timer = (struct wheel_timer *)(intptr_t)timer_ptr;
+    if (timer->pending) {
+        wheel_remove(wheel, timer);
+        --wheel->pending_count;
+    } else {
+        wl_list_remove(&timer->link);
+    }
+
+    wl_list_remove(&timer->wheel_link);
+    free(timer);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_TimerWheel_scheduleNative(JNIEnv * env,
+        jclass cls, jlong wheel_ptr, jlong timer_ptr, jlong delay_ns)
+{
+    struct timer_wheel *wheel;
+    struct wheel_timer *timer;
+    uint64_t now_ns;
+
+    wheel = (struct timer_wheel *)(intptr_t)wheel_ptr;
+    timer = (struct wheel_timer *)(intptr_t)timer_ptr;
+
+    if (delay_ns < 0) {
+        wl_jni_throw_IllegalArgumentException(env, "Delay cannot be negative");
+        return;
+    }
+
+    if (timer->pending) {
+        wheel_remove(wheel, timer);
+        --wheel->pending_count;
+    } else {
+        /* It may still be sitting in the expired list */
+        wl_list_remove(&timer->link);
+        wl_list_init(&timer->link);
+    }
+
+    now_ns = monotonic_ns() - wheel->start_ns;
+    timer->expires = (now_ns + delay_ns + wheel->tick_ns - 1) / wheel->tick_ns;
+    if (timer->expires <= wheel->current)
+        timer->expires = wheel->current + 1;
+
+    wheel_insert(wheel, timer);
+    ++wheel->pending_count;
+
+    if (wheel_arm(wheel, 0) < 0)
+        wl_jni_throw_from_errno(env, errno);
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_TimerWheel_cancelNative(JNIEnv * env,
+        jclass cls, jlong wheel_ptr, jlong timer_ptr)
+{
+    struct timer_wheel *wheel;
+    struct wheel_timer *timer;
+
+    wheel = (struct timer_wheel *)(intptr_t)wheel_ptr;
+    timer = (struct wheel_timer *)(intptr_t)timer_ptr;
+
+    if (! timer->pending)
+        return;
+
+    wheel_remove(wheel, timer);
+    --wheel->pending_count;
+}
+
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_server_TimerWheel_initializeJNI(JNIEnv * env,
+        jclass cls)
+{
+    TimerWheel.class = (*env)->NewGlobalRef(env, cls);
+    if (TimerWheel.class == NULL)
+        return; /* Exception Thrown */
+
+    TimerWheel.wheel_ptr = (*env)->GetFieldID(env, TimerWheel.class,
+            "wheel_ptr", "J");
+    if (TimerWheel.wheel_ptr == NULL)
+        return; /* Exception Thrown */
+
+    TimerWheel.dispatchExpired = (*env)->GetMethodID(env, TimerWheel.class,
+            "dispatchExpired", "([II)V");
+    if (TimerWheel.dispatchExpired == NULL)
+        return; /* Exception Thrown */
+}
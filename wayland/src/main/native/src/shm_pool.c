@@ -19,20 +19,75 @@
  * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
  * OF THIS SOFTWARE.
  */
+#define _GNU_SOURCE /* For mremap */
+
 #include <jni.h>
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 
 #include "wayland-jni.h"
 
-JNIEXPORT jint JNICALL
-Java_org_freedesktop_wayland_ShmPool_createTmpFileNative(JNIEnv * env,
-        jclass clazz)
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC             0x0001U
+#define MFD_ALLOW_SEALING       0x0002U
+#endif
+
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB             0x0004U
+#endif
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE           14
+#endif
+
+#ifndef MADV_POPULATE_READ
+#define MADV_POPULATE_READ      22
+#define MADV_POPULATE_WRITE     23
+#endif
+
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS             (1024 + 9)
+#define F_GET_SEALS             (1024 + 10)
+#define F_SEAL_SEAL             0x0001
+#define F_SEAL_SHRINK           0x0002
+#define F_SEAL_GROW             0x0004
+#define F_SEAL_WRITE            0x0008
+#endif
+
+/* Must match the flags in ShmPool.java */
+#define SHM_POOL_SEAL_SHRINK    0x1
+#define SHM_POOL_POPULATE       0x2
+#define SHM_POOL_HUGETLB        0x4
+#define SHM_POOL_HUGEPAGE       0x8
+
+/* Must match the advice constants in ShmPool.java */
+#define SHM_POOL_ADVICE_WILLNEED    0
+#define SHM_POOL_ADVICE_DONTNEED    1
+
+/*
+ * Called through syscall() so that we don't depend on the C library having
+ * a wrapper; older glibc and Bionic don't.
+ */
+static int
+shm_memfd_create(const char *name, unsigned int flags)
+{
+#ifdef __NR_memfd_create
+    return syscall(__NR_memfd_create, name, flags);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static int
+shm_create_tmpfile(JNIEnv * env)
 {
     static const char template[] = "/wayland-java-shm-XXXXXX";
 	const char *path;
@@ -56,6 +111,10 @@ Java_org_freedesktop_wayland_ShmPool_createTmpFileNative(JNIEnv * env,
 
     fd = mkstemp(name);
 
+    /* Only the file descriptor is ever shared, never the name */
+    if (fd >= 0)
+        unlink(name);
+
     free(name);
 
     if (fd < 0) {
@@ -80,62 +139,203 @@ close_file:
     return -1;
 }
 
-JNIEXPORT jobject JNICALL
-Java_org_freedesktop_wayland_ShmPool_mapNative(JNIEnv * env, jclass clazz,
-        jint fd, jlong size, jboolean dupFD, jboolean readOnly)
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_ShmPool_createAnonymousFileNative(JNIEnv * env,
+        jclass clazz, jint pool_flags)
 {
-    void * buffer;
-    int flags, success, prot;
+    unsigned int flags;
+    int fd;
 
-    if (dupFD) {
-        fd = dup(fd);
-        if (fd < 0) {
-            wl_jni_throw_from_errno(env, errno);
-            return NULL;
-        }
+    flags = MFD_CLOEXEC;
+    if (pool_flags & SHM_POOL_SEAL_SHRINK)
+        flags |= MFD_ALLOW_SEALING;
 
-        flags = fcntl(fd, F_GETFD);
-        if (flags == -1) {
-            close(fd);
+    if (pool_flags & SHM_POOL_HUGETLB) {
+        fd = shm_memfd_create("wayland-java-shm", flags | MFD_HUGETLB);
+        if (fd >= 0)
+            return fd;
+
+        /*
+         * Kernels before 4.14 reject MFD_HUGETLB and before 4.16 reject
+         * it together with sealing; treat huge pages as a hint.
+         */
+        if (errno != EINVAL && errno != ENOSYS) {
             wl_jni_throw_from_errno(env, errno);
-            return NULL;
+            return -1;
         }
+    }
 
-        flags |= FD_CLOEXEC;
-        success = fcntl(fd, F_SETFD, flags);
-        if (success == -1) {
-            close(fd);
+    fd = shm_memfd_create("wayland-java-shm", flags);
+    if (fd >= 0)
+        return fd;
+
+    /* Anything other than "not supported here" is a real error */
+    if (errno != ENOSYS && errno != EINVAL) {
+        wl_jni_throw_from_errno(env, errno);
+        return -1;
+    }
+
+    return shm_create_tmpfile(env);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_ShmPool_sealShrinkNative(JNIEnv * env,
+        jclass clazz, jint fd)
+{
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK) == 0)
+        return JNI_TRUE;
+
+    /* Not a memfd, or one created without sealing support */
+    if (errno == EINVAL || errno == EPERM)
+        return JNI_FALSE;
+
+    wl_jni_throw_from_errno(env, errno);
+    return JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_ShmPool_isShrinkSealedNative(JNIEnv * env,
+        jclass clazz, jint fd)
+{
+    int seals;
+
+    seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0) {
+        if (errno != EINVAL)
             wl_jni_throw_from_errno(env, errno);
-            return NULL;
-        }
+        return JNI_FALSE;
     }
-    
+
+    return (seals & F_SEAL_SHRINK) ? JNI_TRUE : JNI_FALSE;
+}
+
+/*
+ * Faults in every page of a mapping that has already been advised, so that
+ * the faults honour the advice.  MAP_POPULATE can't be used for that since
+ * it populates before madvise() gets a chance to run.
+ */
+static void
+shm_populate(void * data, size_t size, int readOnly)
+{
+    volatile const char * p;
+    size_t page, offset;
+
+    if (madvise(data, size, readOnly ? MADV_POPULATE_READ
+                                     : MADV_POPULATE_WRITE) == 0)
+        return;
+
+    /* Pre-5.14 kernels: touch each page instead */
+    page = sysconf(_SC_PAGESIZE);
+    p = data;
+    for (offset = 0; offset < size; offset += page)
+        (void)p[offset];
+}
+
+JNIEXPORT jint JNICALL
+Java_org_freedesktop_wayland_ShmPool_dupNative(JNIEnv * env, jclass clazz,
+        jint fd)
+{
+    int dup_fd;
+
+    dup_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (dup_fd < 0)
+        wl_jni_throw_from_errno(env, errno);
+
+    return dup_fd;
+}
+
+JNIEXPORT jobject JNICALL
+Java_org_freedesktop_wayland_ShmPool_mapNative(JNIEnv * env, jclass clazz,
+        jint fd, jlong size, jboolean readOnly, jint pool_flags,
+        jlong valid_size)
+{
+    void * buffer;
+    int prot, map_flags;
+
     if (readOnly) {
         prot = PROT_READ;
     } else {
         prot = PROT_READ | PROT_WRITE;
     }
 
-    buffer = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+    /*
+     * A reserved mapping may extend past the end of the file.  Populating
+     * it there would fault, so only populate up front when it doesn't.
+     */
+    map_flags = MAP_SHARED;
+    if ((pool_flags & SHM_POOL_POPULATE) && !(pool_flags & SHM_POOL_HUGEPAGE)
+            && valid_size == size)
+        map_flags |= MAP_POPULATE;
+
+    buffer = mmap(NULL, size, prot, map_flags, fd, 0);
 
     if (buffer == MAP_FAILED) {
         wl_jni_throw_from_errno(env, errno);
+        return NULL;
+    }
 
-        if (dupFD)
-            close(fd);
+    if (pool_flags & SHM_POOL_HUGEPAGE) {
+        /* Only a hint; fails harmlessly where THP is compiled out */
+        madvise(buffer, size, MADV_HUGEPAGE);
 
-        return NULL;
     }
 
+    if ((pool_flags & SHM_POOL_POPULATE) && !(map_flags & MAP_POPULATE))
+        shm_populate(buffer, valid_size, readOnly);
+
     return (*env)->NewDirectByteBuffer(env, buffer, size);
 }
 
+/*
+ * Grows a mapping, in place if the address space after it is free.
+ * Otherwise the pages are mapped a second time at a new address and the old
+ * mapping is left alone, since ByteBuffers handed out earlier may still
+ * point at it; the caller retires it once the pool is closed.
+ */
+JNIEXPORT jobject JNICALL
+Java_org_freedesktop_wayland_ShmPool_remapNative(JNIEnv * env, jclass clazz,
+        jobject buffer, jlong size, jint pool_flags)
+{
+    void * data, * new_data;
+    jlong old_size;
+
+    data = (*env)->GetDirectBufferAddress(env, buffer);
+    old_size = (*env)->GetDirectBufferCapacity(env, buffer);
+    if (data == NULL || old_size < 0) {
+        wl_jni_throw_IllegalArgumentException(env, "Not a direct buffer");
+        return NULL;
+    }
+
+    new_data = mremap(data, old_size, size, 0);
+    if (new_data == MAP_FAILED) {
+        /* An old_size of zero duplicates a shared mapping */
+        new_data = mremap(data, 0, size, MREMAP_MAYMOVE);
+        if (new_data == MAP_FAILED) {
+            wl_jni_throw_from_errno(env, errno);
+            return NULL;
+        }
+
+        if (pool_flags & SHM_POOL_HUGEPAGE)
+            madvise(new_data, size, MADV_HUGEPAGE);
+    }
+
+    return (*env)->NewDirectByteBuffer(env, new_data, size);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_org_freedesktop_wayland_ShmPool_isSameMappingNative(JNIEnv * env,
+        jclass clazz, jobject a, jobject b)
+{
+    return (*env)->GetDirectBufferAddress(env, a) ==
+            (*env)->GetDirectBufferAddress(env, b);
+}
+
 JNIEXPORT void JNICALL
 Java_org_freedesktop_wayland_ShmPool_unmapNative(JNIEnv * env, jclass clazz,
         jobject buffer)
 {
     void * data;
-    int size;
+    jlong size;
 
     data = (*env)->GetDirectBufferAddress(env, buffer);
     size = (*env)->GetDirectBufferCapacity(env, buffer);
@@ -144,6 +344,43 @@ Java_org_freedesktop_wayland_ShmPool_unmapNative(JNIEnv * env, jclass clazz,
         wl_jni_throw_from_errno(env, errno);
 }
 
+JNIEXPORT void JNICALL
+Java_org_freedesktop_wayland_ShmPool_adviseNative(JNIEnv * env, jclass clazz,
+        jobject buffer, jlong offset, jlong length, jint advice)
+{
+    uintptr_t start, end, page;
+    char * data;
+
+    data = (*env)->GetDirectBufferAddress(env, buffer);
+    if (data == NULL) {
+        wl_jni_throw_IllegalArgumentException(env, "Not a direct buffer");
+        return;
+    }
+
+    if (length == 0)
+        return;
+
+    /* madvise works on whole pages; widen the range to cover them */
+    page = sysconf(_SC_PAGESIZE);
+    start = (uintptr_t)(data + offset) & ~(page - 1);
+    end = ((uintptr_t)(data + offset + length) + page - 1) & ~(page - 1);
+
+    switch (advice) {
+    case SHM_POOL_ADVICE_WILLNEED:
+        advice = MADV_WILLNEED;
+        break;
+    case SHM_POOL_ADVICE_DONTNEED:
+        advice = MADV_DONTNEED;
+        break;
+    default:
+        wl_jni_throw_IllegalArgumentException(env, "Unknown advice");
+        return;
+    }
+
+    if (madvise((void *)start, end - start, advice) < 0)
+        wl_jni_throw_from_errno(env, errno);
+}
+
 JNIEXPORT void JNICALL
 Java_org_freedesktop_wayland_ShmPool_truncateNative(JNIEnv * env, jclass clazz,
         jint fd, jlong size)
@@ -43,11 +43,42 @@ jobject wl_jni_fixed_to_java(JNIEnv * env, wl_fixed_t fixed);
 
 struct wl_jni_interface
 {
-    struct wl_interface interface;
+    const struct wl_interface *interface;
     jmethodID *requests;
     jmethodID *events;
+
+    /* Only set when built at runtime from the Java message descriptions */
+    struct wl_interface *dynamic;
 };
 
+/*
+ * Static protocol tables emitted by the scanner.  Each method entry gives the
+ * Java method name and JNI signature of the listener method that handles the
+ * corresponding wl_message, so binding an interface only has to resolve the
+ * jmethodIDs.
+ */
+struct wl_jni_method
+{
+    const char *name;
+    const char *signature;
+};
+
+struct wl_jni_protocol_interface
+{
+    const struct wl_interface *interface;
+    const struct wl_jni_method *requests;
+    const struct wl_jni_method *events;
+};
+
+struct wl_jni_protocol
+{
+    const char *name;
+    int interface_count;
+    const struct wl_jni_protocol_interface *interfaces;
+};
+
+void wl_jni_protocol_register(const struct wl_jni_protocol *protocol);
+
 struct wl_jni_interface * wl_jni_interface_from_java(JNIEnv * env,
         jobject jinterface);
 void wl_jni_interface_init_object(JNIEnv * env, jobject jinterface,
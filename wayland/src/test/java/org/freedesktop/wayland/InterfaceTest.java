@@ -0,0 +1,182 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.ArrayList;
+
+import org.freedesktop.wayland.protocol.wl_compositor;
+import org.freedesktop.wayland.protocol.wl_data_device;
+import org.freedesktop.wayland.protocol.wl_data_offer;
+import org.freedesktop.wayland.protocol.wl_keyboard;
+import org.freedesktop.wayland.protocol.wl_registry;
+import org.freedesktop.wayland.protocol.wl_surface;
+import org.freedesktop.wayland.server.Client;
+import org.freedesktop.wayland.server.Global;
+import org.freedesktop.wayland.server.Loopback;
+
+import org.junit.*;
+
+public class InterfaceTest
+{
+    Loopback loopback;
+    ArrayList<String> received;
+    wl_surface.Resource surface;
+
+    public InterfaceTest()
+    { }
+
+    @Before
+    public void createLoopback()
+    {
+        loopback = new Loopback();
+        received = new ArrayList<String>();
+
+        final wl_compositor.Requests compositor = new wl_compositor.Requests() {
+            public void createSurface(wl_compositor.Resource resource, int id)
+            {
+                surface = new wl_surface.Resource(resource.getClient(), 1, id);
+                received.add("create_surface " + id);
+            }
+
+            public void createRegion(wl_compositor.Resource resource, int id)
+            { }
+        };
+
+        new Global(loopback.display, wl_compositor.WAYLAND_INTERFACE, 1,
+                new Global.BindHandler() {
+            public void bindClient(Client client, int version, int id)
+            {
+                wl_compositor.Resource res = new wl_compositor.Resource(
+                        client, version, id);
+                res.setImplementation(compositor);
+            }
+        });
+    }
+
+    /*
+     * The core protocol's tables come from the scanner.  Exercise the
+     * argument types whose JNI signatures the scanner writes by hand: an
+     * untyped new_id request (wl_registry.bind), a typed one, an array
+     * event and a new_id event.  The core protocol has no array request.
+     */
+    @Test
+    public void prebuiltTablesDispatch()
+    {
+        wl_compositor.Proxy compositor = (wl_compositor.Proxy)loopback.bind(
+                wl_compositor.WAYLAND_INTERFACE, 1);
+        wl_surface.Proxy surfaceProxy = compositor.createSurface();
+        loopback.roundtrip();
+
+        Assert.assertTrue(wl_registry.WAYLAND_INTERFACE.isPrebuilt());
+        Assert.assertTrue(wl_compositor.WAYLAND_INTERFACE.isPrebuilt());
+        Assert.assertEquals("create_surface " + surfaceProxy.getID(),
+                received.get(0));
+
+        wl_keyboard.Proxy keyboardProxy =
+                new wl_keyboard.Proxy(loopback.clientDisplay);
+        keyboardProxy.addListener(new wl_keyboard.Events() {
+            public void keymap(wl_keyboard.Proxy proxy, int format, int fd,
+                    int size)
+            { }
+
+            public void enter(wl_keyboard.Proxy proxy, int serial,
+                    org.freedesktop.wayland.client.Proxy surface,
+                    ByteBuffer keys)
+            {
+                keys.order(ByteOrder.nativeOrder());
+                received.add("enter " + serial + " " + surface.getID() + " "
+                        + keys.capacity() + " " + keys.getInt(0) + " "
+                        + keys.getInt(4));
+            }
+
+            public void leave(wl_keyboard.Proxy proxy, int serial,
+                    org.freedesktop.wayland.client.Proxy surface)
+            { }
+
+            public void key(wl_keyboard.Proxy proxy, int serial, int time,
+                    int key, int state)
+            { }
+
+            public void modifiers(wl_keyboard.Proxy proxy, int serial,
+                    int modsDepressed, int modsLatched, int modsLocked,
+                    int group)
+            { }
+        }, null);
+        wl_keyboard.Resource keyboard = new wl_keyboard.Resource(
+                loopback.client, 1, keyboardProxy.getID());
+
+        wl_data_device.Proxy deviceProxy =
+                new wl_data_device.Proxy(loopback.clientDisplay);
+        deviceProxy.addListener(new wl_data_device.Events() {
+            public void dataOffer(wl_data_device.Proxy proxy,
+                    org.freedesktop.wayland.client.Proxy id)
+            {
+                received.add("data_offer");
+            }
+
+            public void enter(wl_data_device.Proxy proxy, int serial,
+                    org.freedesktop.wayland.client.Proxy surface,
+                    Fixed x, Fixed y,
+                    org.freedesktop.wayland.client.Proxy id)
+            { }
+
+            public void leave(wl_data_device.Proxy proxy)
+            { }
+
+            public void motion(wl_data_device.Proxy proxy, int time,
+                    Fixed x, Fixed y)
+            { }
+
+            public void drop(wl_data_device.Proxy proxy)
+            { }
+
+            public void selection(wl_data_device.Proxy proxy,
+                    org.freedesktop.wayland.client.Proxy id)
+            { }
+        }, null);
+        wl_data_device.Resource device = new wl_data_device.Resource(
+                loopback.client, 1, deviceProxy.getID());
+
+        ByteBuffer keys = ByteBuffer.allocateDirect(8)
+                .order(ByteOrder.nativeOrder());
+        keys.putInt(0, 30);
+        keys.putInt(4, 48);
+        keyboard.enter(7, surface, keys);
+        device.dataOffer(new wl_data_offer.Resource(loopback.client, 1, 0));
+        loopback.roundtrip();
+
+        Assert.assertTrue(wl_keyboard.WAYLAND_INTERFACE.isPrebuilt());
+        Assert.assertTrue(wl_data_device.WAYLAND_INTERFACE.isPrebuilt());
+        Assert.assertEquals("enter 7 " + surfaceProxy.getID() + " 8 30 48",
+                received.get(1));
+        Assert.assertEquals("data_offer", received.get(2));
+        Assert.assertEquals(3, received.size());
+    }
+
+    @After
+    public void destroyLoopback()
+    {
+        loopback.destroy();
+    }
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ReadOnlyBufferException;
+import java.util.Random;
+
+import org.junit.*;
+
+public class PixelOpsTest
+{
+    /* Room for every width and start column the comparisons try */
+    private static final int STRIDE = 32 * 4;
+    private static final int HEIGHT = 3;
+
+    private interface Kernel
+    {
+        void run(ByteBuffer src, ByteBuffer dst, int x, int width);
+    }
+
+    ShmPool pool;
+    ByteBuffer pixels;
+
+    public PixelOpsTest()
+    { }
+
+    @Before
+    public void createPool() throws IOException
+    {
+        pool = new ShmPool(64 * 64 * 4);
+        pixels = pool.asByteBuffer();
+    }
+
+    @Test
+    public void fillAndBlend()
+    {
+        PixelOps.fillRect(pixels, 0, 64 * 4, 0, 0, 64, 64, 0xff0000ff);
+        PixelOps.fillRect(pixels, 0, 64 * 4, 32, 0, 32, 1, 0x80800000);
+        PixelOps.blendOver(pixels, 0, 64 * 4, 32, 0, pixels, 0, 64 * 4, 0, 0,
+                32, 1);
+
+        Assert.assertEquals(0xff80007f, pixels.getInt(4 * 5));
+        Assert.assertEquals(0xff0000ff, pixels.getInt(64 * 4 * 2));
+    }
+
+    @Test
+    public void convert()
+    {
+        PixelOps.fillRect(pixels, 0, 64 * 4, 0, 0, 10, 1, 0x00112233);
+        PixelOps.convertRect(pixels, 0, 64 * 4, 0, 0, PixelOps.FORMAT_XRGB8888,
+                pixels, 0, 64 * 4, 0, 1, PixelOps.FORMAT_ABGR8888, 10, 1);
+
+        Assert.assertEquals(0xff332211, pixels.getInt(64 * 4 + 4 * 9));
+    }
+
+    @Test(expected = IndexOutOfBoundsException.class)
+    public void outOfBounds()
+    {
+        PixelOps.fillRect(pixels, 0, 64 * 4, 60, 60, 8, 8, 0);
+    }
+
+    @Test(expected = ReadOnlyBufferException.class)
+    public void readOnlyDestination()
+    {
+        PixelOps.copyRect(pixels, 0, 64 * 4, 0, 0, pixels.asReadOnlyBuffer(),
+                0, 64 * 4, 0, 1, 8, 1);
+    }
+
+    @Test
+    public void gradient()
+    {
+        PixelOps.fillGradient(pixels, 0, 64 * 4, 0, 0, 5, 2, 0x00000000,
+                0xff804020, false);
+
+        Assert.assertEquals(0x00000000, pixels.getInt(0));
+        Assert.assertEquals(0x80402010, pixels.getInt(4 * 2));
+        Assert.assertEquals(0xff804020, pixels.getInt(4 * 4));
+        Assert.assertEquals(0x80402010, pixels.getInt(64 * 4 + 4 * 2));
+
+        PixelOps.fillGradient(pixels, 0, 64 * 4, 8, 0, 3, 5, 0xff804020,
+                0x00000000, true);
+
+        Assert.assertEquals(0xff804020, pixels.getInt(4 * 10));
+        Assert.assertEquals(0x80402010, pixels.getInt(64 * 4 * 2 + 4 * 9));
+        Assert.assertEquals(0x00000000, pixels.getInt(64 * 4 * 4 + 4 * 8));
+
+        /* A single column is all color0 */
+        PixelOps.fillGradient(pixels, 0, 64 * 4, 12, 0, 1, 1, 0x11223344,
+                0x55667788, false);
+
+        Assert.assertEquals(0x11223344, pixels.getInt(4 * 12));
+    }
+
+    @Test
+    public void premultiplyRoundTrip()
+    {
+        pixels.putInt(0, 0x80ff8000);
+        pixels.putInt(4, 0x00123456);
+        pixels.putInt(8, 0xff123456);
+
+        PixelOps.premultiply(pixels, 0, 64 * 4, 0, 0, 3, 1);
+
+        Assert.assertEquals(0x80804000, pixels.getInt(0));
+        Assert.assertEquals(0x00000000, pixels.getInt(4));
+        Assert.assertEquals(0xff123456, pixels.getInt(8));
+
+        /* A channel brighter than its alpha saturates */
+        pixels.putInt(4, 0x10ff0000);
+
+        PixelOps.unpremultiply(pixels, 0, 64 * 4, 0, 0, 3, 1);
+
+        Assert.assertEquals(0x80ff8000, pixels.getInt(0));
+        Assert.assertEquals(0x10ff0000, pixels.getInt(4));
+        Assert.assertEquals(0xff123456, pixels.getInt(8));
+    }
+
+    @Test
+    public void vectorFillMatchesScalar()
+    {
+        compareWithScalar(new Kernel() {
+            @Override
+            public void run(ByteBuffer src, ByteBuffer dst, int x, int width)
+            {
+                PixelOps.fillRect(dst, 0, STRIDE, x, 0, width, HEIGHT,
+                        0x80c0ff01);
+            }
+        });
+    }
+
+    @Test
+    public void vectorGradientMatchesScalar()
+    {
+        compareWithScalar(new Kernel() {
+            @Override
+            public void run(ByteBuffer src, ByteBuffer dst, int x, int width)
+            {
+                PixelOps.fillGradient(dst, 0, STRIDE, x, 0, width, HEIGHT,
+                        0x00ff7f01, 0xff00807e, true);
+            }
+        });
+    }
+
+    @Test
+    public void vectorConvertMatchesScalar()
+    {
+        final int[] formats = {
+            PixelOps.FORMAT_ARGB8888, PixelOps.FORMAT_XRGB8888,
+            PixelOps.FORMAT_ABGR8888, PixelOps.FORMAT_XBGR8888
+        };
+
+        for (final int srcFormat : formats) {
+            for (final int dstFormat : formats) {
+                compareWithScalar(new Kernel() {
+                    @Override
+                    public void run(ByteBuffer src, ByteBuffer dst, int x,
+                            int width)
+                    {
+                        PixelOps.convertRect(src, 0, STRIDE, x, 0, srcFormat,
+                                dst, 0, STRIDE, x, 0, dstFormat, width,
+                                HEIGHT);
+                    }
+                });
+            }
+        }
+    }
+
+    @Test
+    public void vectorPremultiplyMatchesScalar()
+    {
+        compareWithScalar(new Kernel() {
+            @Override
+            public void run(ByteBuffer src, ByteBuffer dst, int x, int width)
+            {
+                PixelOps.premultiply(dst, 0, STRIDE, x, 0, width, HEIGHT);
+            }
+        });
+    }
+
+    @Test
+    public void vectorBlendMatchesScalar()
+    {
+        compareWithScalar(new Kernel() {
+            @Override
+            public void run(ByteBuffer src, ByteBuffer dst, int x, int width)
+            {
+                PixelOps.blendOver(src, 0, STRIDE, x, 0, dst, 0, STRIDE, x, 0,
+                        width, HEIGHT);
+            }
+        });
+    }
+
+    /*
+     * Runs the kernel on the same random pixels with every kernel level
+     * and checks the results are identical.  Widths up to 17 cover every
+     * tail the SSE2 and AVX2 loops leave, and the start columns every
+     * alignment.
+     */
+    private void compareWithScalar(Kernel kernel)
+    {
+        ByteBuffer src = ByteBuffer.allocateDirect(STRIDE * HEIGHT);
+        ByteBuffer dst = ByteBuffer.allocateDirect(STRIDE * HEIGHT);
+        ByteBuffer expected = ByteBuffer.allocateDirect(STRIDE * HEIGHT);
+        int level, width, x;
+
+        try {
+            for (width = 1; width <= 17; ++width) {
+                for (x = 0; x < 4; ++x) {
+                    PixelOps.setKernelLevel(PixelOps.KERNELS_SCALAR);
+                    randomize(src, dst, width * 4 + x);
+                    kernel.run(src, dst, x, width);
+                    expected.clear();
+                    expected.put(dst);
+
+                    for (level = PixelOps.KERNELS_SSE2;
+                            level <= PixelOps.KERNELS_AVX2; ++level) {
+                        PixelOps.setKernelLevel(level);
+                        randomize(src, dst, width * 4 + x);
+                        kernel.run(src, dst, x, width);
+                        expected.clear();
+                        dst.clear();
+                        Assert.assertEquals("width " + width + ", x " + x
+                                + ", level " + level, expected, dst);
+                    }
+                }
+            }
+        } finally {
+            PixelOps.setKernelLevel(PixelOps.KERNELS_AVX2);
+        }
+    }
+
+    /* Random pixels, with plenty of fully transparent and opaque ones */
+    private static void randomize(ByteBuffer src, ByteBuffer dst, long seed)
+    {
+        Random random = new Random(seed);
+        int i;
+
+        src.clear();
+        dst.clear();
+        for (i = 0; i < STRIDE * HEIGHT; i += 4) {
+            src.putInt(i, randomPixel(random, i / 4));
+            dst.putInt(i, randomPixel(random, i / 4 + 1));
+        }
+    }
+
+    private static int randomPixel(Random random, int i)
+    {
+        int p = random.nextInt();
+
+        if (i % 3 == 0)
+            return p & 0x00ffffff;
+        else if (i % 3 == 1)
+            return p | 0xff000000;
+        else
+            return p;
+    }
+
+    @After
+    public void destroyPool() throws IOException
+    {
+        pool.close();
+    }
+}
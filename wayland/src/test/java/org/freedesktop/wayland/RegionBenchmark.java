@@ -0,0 +1,187 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland;
+
+import java.util.Arrays;
+import java.util.Random;
+
+/**
+ * Compares Region against a naive rectangle list, the kind of region a
+ * compositor ends up writing in Java: every operation checks every
+ * rectangle against every other.  Not a unit test; run its main().
+ */
+public class RegionBenchmark
+{
+    /* Non-overlapping x1, y1, x2, y2 quadruples */
+    static final class NaiveRegion
+    {
+        int[] boxes = new int[64];
+        int count;
+
+        void add(int x1, int y1, int x2, int y2)
+        {
+            if (x1 >= x2 || y1 >= y2)
+                return;
+            if (count * 4 == boxes.length)
+                boxes = Arrays.copyOf(boxes, boxes.length * 2);
+            boxes[count * 4] = x1;
+            boxes[count * 4 + 1] = y1;
+            boxes[count * 4 + 2] = x2;
+            boxes[count * 4 + 3] = y2;
+            count++;
+        }
+
+        /* Adds the parts of p outside of s */
+        void addDifference(int[] p, int i, int[] s, int j)
+        {
+            int px1 = p[i], py1 = p[i + 1], px2 = p[i + 2], py2 = p[i + 3];
+            int sx1 = s[j], sy1 = s[j + 1], sx2 = s[j + 2], sy2 = s[j + 3];
+
+            if (sx1 >= px2 || sx2 <= px1 || sy1 >= py2 || sy2 <= py1) {
+                add(px1, py1, px2, py2);
+                return;
+            }
+
+            int y1 = Math.max(sy1, py1);
+            int y2 = Math.min(sy2, py2);
+            add(px1, py1, px2, y1);
+            add(px1, y1, Math.min(sx1, px2), y2);
+            add(Math.max(sx2, px1), y1, px2, y2);
+            add(px1, y2, px2, py2);
+        }
+
+        NaiveRegion subtractBox(int[] s, int j)
+        {
+            NaiveRegion result = new NaiveRegion();
+            for (int i = 0; i < count; ++i)
+                result.addDifference(boxes, i * 4, s, j);
+            return result;
+        }
+
+        void unionRect(int x, int y, int width, int height)
+        {
+            NaiveRegion pieces = new NaiveRegion();
+            pieces.add(x, y, x + width, y + height);
+            for (int i = 0; i < count && pieces.count > 0; ++i)
+                pieces = pieces.subtractBox(boxes, i * 4);
+            for (int i = 0; i < pieces.count; ++i)
+                add(pieces.boxes[i * 4], pieces.boxes[i * 4 + 1],
+                        pieces.boxes[i * 4 + 2], pieces.boxes[i * 4 + 3]);
+        }
+
+        NaiveRegion subtractRect(int x, int y, int width, int height)
+        {
+            return subtractBox(new int[] { x, y, x + width, y + height }, 0);
+        }
+
+        long area()
+        {
+            long area = 0;
+            for (int i = 0; i < count; ++i)
+                area += (long)(boxes[i * 4 + 2] - boxes[i * 4])
+                        * (boxes[i * 4 + 3] - boxes[i * 4 + 1]);
+            return area;
+        }
+    }
+
+    static long area(Region region)
+    {
+        int[] rects = region.getRectangles();
+        long area = 0;
+        for (int i = 0; i < rects.length; i += 4)
+            area += (long)rects[i + 2] * rects[i + 3];
+        return area;
+    }
+
+    /* Scattered damage and opaque windows on a 1920x1080 output */
+    static int[] damage;
+    static int[] windows;
+
+    /* The damaged parts of the desktop background left uncovered */
+    static long naive()
+    {
+        NaiveRegion repaint = new NaiveRegion();
+        for (int i = 0; i < damage.length; i += 4)
+            repaint.unionRect(damage[i], damage[i + 1], damage[i + 2],
+                    damage[i + 3]);
+
+        for (int i = 0; i < windows.length; i += 4)
+            repaint = repaint.subtractRect(windows[i], windows[i + 1],
+                    windows[i + 2], windows[i + 3]);
+
+        return repaint.area();
+    }
+
+    static long banded()
+    {
+        Region repaint = new Region();
+        repaint.unionRectangles(damage, 0, damage.length / 4);
+        repaint.subtractRectangles(windows, 0, windows.length / 4);
+
+        long area = area(repaint);
+        repaint.destroy();
+        return area;
+    }
+
+    static int[] randomRects(Random random, int count, int maxSize)
+    {
+        int[] rects = new int[count * 4];
+        for (int i = 0; i < rects.length; i += 4) {
+            rects[i] = random.nextInt(1920);
+            rects[i + 1] = random.nextInt(1080);
+            rects[i + 2] = 1 + random.nextInt(maxSize);
+            rects[i + 3] = 1 + random.nextInt(maxSize);
+        }
+        return rects;
+    }
+
+    static void time(String name, int iterations, boolean naive)
+    {
+        long area = 0;
+        long start = System.nanoTime();
+        for (int i = 0; i < iterations; ++i)
+            area = naive ? naive() : banded();
+        long elapsed = System.nanoTime() - start;
+
+        System.out.printf("%-8s %10.1f us/frame  (repaint area %d)%n", name,
+                elapsed / 1000.0 / iterations, area);
+    }
+
+    public static void main(String[] args)
+    {
+        Random random = new Random(42);
+
+        for (int n : new int[] { 16, 64, 256 }) {
+            damage = randomRects(random, n, 200);
+            windows = randomRects(random, n / 4, 600);
+
+            System.out.println(n + " damage rectangles, " + n / 4
+                    + " windows:");
+            for (int warmup = 0; warmup < 5; ++warmup) {
+                naive();
+                banded();
+            }
+            time("naive", 20, true);
+            time("banded", 200, false);
+        }
+    }
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+import org.junit.*;
+
+public class RegionTest
+{
+    public RegionTest()
+    { }
+
+    private static int area(Region region)
+    {
+        int[] rects = region.getRectangles();
+        int area = 0;
+        for (int i = 0; i < rects.length; i += 4)
+            area += rects[i + 2] * rects[i + 3];
+        return area;
+    }
+
+    @Test
+    public void setOperations()
+    {
+        Region region = new Region(0, 0, 10, 10);
+        region.unionRect(5, 5, 10, 10);
+        Assert.assertEquals(175, area(region));
+
+        Region hole = new Region(2, 2, 4, 4);
+        region.subtract(hole);
+        Assert.assertEquals(159, area(region));
+
+        region.intersectRect(0, 0, 4, 4);
+        Assert.assertEquals(12, area(region));
+
+        region.subtractRect(0, 0, 100, 100);
+        Assert.assertTrue(region.isEmpty());
+
+        region.destroy();
+        hole.destroy();
+    }
+
+    @Test
+    public void clampsAtIntegerRange()
+    {
+        Region region = new Region(Integer.MAX_VALUE - 5, 0, 10, 10);
+        Assert.assertArrayEquals(new int[] { Integer.MAX_VALUE - 5, 0, 5, 10 },
+                region.getRectangles());
+
+        region.destroy();
+    }
+
+    @Test
+    public void translateClampsAtIntegerRange()
+    {
+        Region region = new Region(10, 0, 10, 5);
+        region.unionRect(10, 5, 20, 5);
+
+        /* Both bands end at INT32_MAX and merge into one rectangle */
+        region.translate(Integer.MAX_VALUE - 15, 0);
+        Assert.assertArrayEquals(new int[] { Integer.MAX_VALUE - 5, 0, 5, 10 },
+                region.getRectangles());
+
+        /* Pushed entirely past the edge, nothing is left */
+        region.translate(10, 0);
+        Assert.assertEquals(0, region.getRectangleCount());
+
+        region.unionRect(-10, 0, 10, 10);
+        region.unionRect(-30, 20, 40, 10);
+        region.translate(Integer.MIN_VALUE, 0);
+        Assert.assertArrayEquals(new int[] { Integer.MIN_VALUE, 20, 10, 10 },
+                region.getRectangles());
+
+        region.destroy();
+    }
+
+    @Test
+    public void rectangleLists()
+    {
+        Region region = new Region();
+
+        /* Two halves of one rectangle merge back into it */
+        region.unionRectangles(new int[] { 0, 0, 5, 10, 5, 0, 5, 10 }, 0, 2);
+        Assert.assertArrayEquals(new int[] { 0, 0, 10, 10 },
+                region.getRectangles());
+
+        ByteBuffer hole = ByteBuffer.allocateDirect(16)
+                .order(ByteOrder.nativeOrder());
+        hole.asIntBuffer().put(new int[] { 2, 2, 2, 2 });
+        region.subtractRectangles(hole, 0, 1);
+
+        int[] rects = new int[region.getRectangleCount() * 4 + 1];
+        Assert.assertEquals(4, region.getRectangles(rects, 1));
+        Assert.assertArrayEquals(new int[] { 0, 0, 10, 10 },
+                region.getExtents());
+        Assert.assertFalse(region.containsPoint(3, 3));
+        Assert.assertTrue(region.containsPoint(4, 3));
+        Assert.assertFalse(region.intersectsRect(2, 2, 2, 2));
+        Assert.assertEquals(96, area(region));
+
+        region.destroy();
+    }
+
+    @Test
+    public void copyRegion() throws IOException
+    {
+        ShmPool pool = new ShmPool(2 * 16 * 16 * 4);
+        ByteBuffer pixels = pool.asByteBuffer();
+        int back = 16 * 16 * 4;
+
+        PixelOps.fillRect(pixels, 0, 16 * 4, 0, 0, 16, 16, 0xff00ff00);
+        PixelOps.fillRect(pixels, back, 16 * 4, 0, 0, 16, 16, 0xffff0000);
+
+        Region damage = new Region(1, 1, 2, 2);
+        damage.unionRect(10, 12, 3, 1);
+        PixelOps.copyRegion(pixels, 0, pixels, back, 16 * 4, damage);
+
+        Assert.assertEquals(0xff00ff00, pixels.getInt(back + (16 + 1) * 4));
+        Assert.assertEquals(0xff00ff00, pixels.getInt(back + (16 * 12 + 12) * 4));
+        Assert.assertEquals(0xffff0000, pixels.getInt(back + (16 * 12 + 13) * 4));
+        Assert.assertEquals(0xffff0000, pixels.getInt(back));
+
+        damage.unionRect(15, 15, 2, 1);
+        try {
+            PixelOps.copyRegion(pixels, 0, pixels, back, 16 * 4, damage);
+            Assert.fail("Region outside of buffer was copied");
+        } catch (IndexOutOfBoundsException e) {
+        }
+
+        damage.destroy();
+        pool.close();
+    }
+}
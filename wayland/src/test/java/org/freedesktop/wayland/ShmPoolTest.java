@@ -21,6 +21,7 @@
  */
 package org.freedesktop.wayland;
 
+import java.io.File;
 import java.io.IOException;
 
 import org.junit.*;
@@ -60,6 +61,90 @@ public class ShmPoolTest
         Assert.assertTrue(i == 42);
     }
 
+    @Test
+    public void sealShrink() throws IOException
+    {
+        ShmPool pool = new ShmPool(4096, ShmPool.SEAL_SHRINK);
+        try {
+            /* Sealing is best-effort, but growing must always work */
+            if (pool.isShrinkSealed()) {
+                try {
+                    pool.resize(1024);
+                    Assert.fail("Shrinking a sealed pool succeeded");
+                } catch (IOException e) {
+                }
+            }
+            pool.resize(8192);
+            Assert.assertEquals(8192, pool.size());
+        } finally {
+            pool.close();
+        }
+    }
+
+    @Test
+    public void hugeTlbFallsBack() throws IOException
+    {
+        /* Never a multiple of the huge page size, so normal pages it is */
+        ShmPool pool = new ShmPool(4096 + 4, ShmPool.HUGETLB);
+        try {
+            pool.asByteBuffer().putInt(4096, 42);
+            Assert.assertEquals(42, pool.asByteBuffer().getInt(4096));
+
+            pool.resize(8192);
+            Assert.assertEquals(8192, pool.size());
+        } finally {
+            pool.close();
+        }
+    }
+
+    @Test
+    public void populateAndAdvise() throws IOException
+    {
+        ShmPool pool = new ShmPool(1 << 20, ShmPool.POPULATE | ShmPool.HUGEPAGE);
+        try {
+            pool.asByteBuffer().putInt(4096, 42);
+            pool.adviseDontNeed(4096, 100);
+            pool.adviseWillNeed(0, pool.size());
+            Assert.assertEquals(42, pool.asByteBuffer().getInt(4096));
+        } finally {
+            pool.close();
+        }
+    }
+
+    @Test
+    public void growKeepsViews() throws IOException
+    {
+        ShmPool pool = new ShmPool(4096, 1 << 20, 0);
+        try {
+            java.nio.ByteBuffer old = pool.asByteBuffer();
+            int generation = pool.getGeneration();
+
+            old.putInt(0, 42);
+            pool.resize(1 << 20);
+            pool.resize(1 << 21);
+
+            Assert.assertTrue(pool.getGeneration() != generation);
+            Assert.assertEquals(1 << 21, pool.asByteBuffer().capacity());
+            old.putInt(4, 7);
+            Assert.assertEquals(42, pool.asByteBuffer().getInt(0));
+            Assert.assertEquals(7, pool.asByteBuffer().getInt(4));
+        } finally {
+            pool.close();
+        }
+    }
+
+    @Test
+    public void closeClosesFileDescriptor() throws IOException
+    {
+        int fd = outPool.getFileDescriptor();
+        Assert.assertTrue(fd != inPool.getFileDescriptor());
+        Assert.assertTrue(new File("/proc/self/fd/" + fd).exists());
+
+        outPool.close();
+        Assert.assertEquals(-1, outPool.getFileDescriptor());
+        Assert.assertFalse(new File("/proc/self/fd/" + fd).exists());
+    }
+
     @After
     public void destroyPools() throws IOException
     {
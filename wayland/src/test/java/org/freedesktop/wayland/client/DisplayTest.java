@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.client;
+
+import org.freedesktop.wayland.protocol.wl_callback;
+import org.freedesktop.wayland.server.Loopback;
+
+import org.junit.*;
+
+public class DisplayTest
+{
+    Loopback loopback;
+    Display display;
+    int done;
+
+    public DisplayTest()
+    { }
+
+    @Before
+    public void createLoopback()
+    {
+        loopback = new Loopback();
+        display = loopback.clientDisplay;
+    }
+
+    /* Sends a wl_display.sync and lets the server answer it */
+    private void sync()
+    {
+        wl_callback.Proxy callback = display.sync();
+        callback.addListener(new wl_callback.Events() {
+            public void done(wl_callback.Proxy proxy, int data)
+            {
+                ++done;
+            }
+        }, null);
+
+        display.flush();
+        loopback.loop.dispatch(0);
+        loopback.display.flushClients();
+    }
+
+    @Test
+    public void readEventsQueuesWithoutDispatching()
+    {
+        sync();
+
+        Assert.assertTrue(display.prepareRead());
+        display.readEvents();
+        Assert.assertEquals(0, done);
+
+        /* Queued events have to be dispatched before the next read */
+        Assert.assertFalse(display.prepareRead());
+        display.dispatchPending();
+        Assert.assertEquals(1, done);
+        Assert.assertTrue(display.prepareRead());
+        display.cancelRead();
+    }
+
+    @Test
+    public void cancelReadAllowsAnotherRead()
+    {
+        Assert.assertTrue(display.prepareRead());
+        display.cancelRead();
+
+        /* Nothing was read, so the answer is still waiting on the socket */
+        sync();
+        Assert.assertTrue(display.prepareRead());
+        display.cancelRead();
+        Assert.assertEquals(0, done);
+
+        Assert.assertTrue(display.prepareRead());
+        display.readEvents();
+        display.dispatchPending();
+        Assert.assertEquals(1, done);
+    }
+
+    @After
+    public void destroyLoopback()
+    {
+        loopback.destroy();
+    }
+}
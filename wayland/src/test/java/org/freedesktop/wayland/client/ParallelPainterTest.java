@@ -0,0 +1,71 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.client;
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.concurrent.atomic.AtomicInteger;
+
+import org.junit.*;
+
+public class ParallelPainterTest
+{
+    public ParallelPainterTest()
+    { }
+
+    @Test
+    public void paintsEveryPixelOnce()
+    {
+        final int width = 100;
+        final int height = 70;
+        final int stride = 128 * 4;
+        final ByteBuffer image = ByteBuffer.allocateDirect(stride * height)
+                .order(ByteOrder.nativeOrder());
+        final AtomicInteger tiles = new AtomicInteger();
+
+        ParallelPainter painter = new ParallelPainter(null, 20, 16);
+        painter.paint(image, 0, stride, width, height,
+                new ParallelPainter.Painter() {
+            @Override
+            public void paintTile(ByteBuffer tile, int x, int y, int w, int h,
+                    int s)
+            {
+                tiles.incrementAndGet();
+                for (int j = 0; j < h; ++j)
+                    for (int i = 0; i < w; ++i)
+                        tile.putInt(j * s + i * 4,
+                                tile.getInt(j * s + i * 4) + (y + j) * width
+                                + x + i + 1);
+            }
+        });
+        painter.destroy();
+
+        /* Tile width is rounded up to 32 */
+        Assert.assertEquals(4 * 5, tiles.get());
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < 128; ++x) {
+                int expected = x < width ? y * width + x + 1 : 0;
+                Assert.assertEquals(expected, image.getInt(y * stride + x * 4));
+            }
+        }
+    }
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.client;
+
+import java.io.IOException;
+
+import org.freedesktop.wayland.protocol.wl_compositor;
+import org.freedesktop.wayland.protocol.wl_shm;
+import org.freedesktop.wayland.protocol.wl_surface;
+import org.freedesktop.wayland.server.Loopback;
+import org.freedesktop.wayland.server.TestCompositor;
+
+import org.junit.*;
+
+public class ShmBufferAllocatorTest
+{
+    static final int PAGE = 4096;
+    static final int FORMAT = wl_shm.FORMAT_ARGB8888;
+
+    Loopback loopback;
+    TestCompositor compositor;
+    wl_shm.Proxy shm;
+    ShmBufferAllocator allocator;
+
+    public ShmBufferAllocatorTest()
+    { }
+
+    @Before
+    public void createLoopback()
+    {
+        loopback = new Loopback();
+        loopback.display.initShm();
+        compositor = new TestCompositor(loopback.display);
+        shm = (wl_shm.Proxy)loopback.bind(wl_shm.WAYLAND_INTERFACE, 1);
+    }
+
+    /* Pools start at four pages */
+    private void createAllocator(int maxPages)
+    {
+        allocator = new ShmBufferAllocator(shm, 4 * PAGE, maxPages * PAGE);
+    }
+
+    /* A tightly packed buffer of the given number of pages */
+    private ShmBufferAllocator.Buffer allocatePages(int pages)
+            throws IOException
+    {
+        return allocator.allocate(PAGE / 4, pages, FORMAT);
+    }
+
+    @Test
+    public void splitAndMerge() throws IOException
+    {
+        /* Without room to grow, a failed merge would add a pool */
+        createAllocator(4);
+
+        ShmBufferAllocator.Buffer[] buffers = new ShmBufferAllocator.Buffer[4];
+        for (int i = 0; i < buffers.length; ++i) {
+            buffers[i] = allocatePages(1);
+            buffers[i].getByteBuffer().putInt(0, i);
+        }
+        Assert.assertEquals(1, allocator.getPoolCount());
+
+        /* Each page-sized block is split off without overlapping */
+        for (int i = 0; i < buffers.length; ++i)
+            Assert.assertEquals(i, buffers[i].getByteBuffer().getInt(0));
+
+        /* Freed in an order that needs merging across both levels */
+        buffers[1].free();
+        buffers[2].free();
+        buffers[0].free();
+        buffers[3].free();
+
+        ShmBufferAllocator.Buffer whole = allocatePages(4);
+        Assert.assertEquals(1, allocator.getPoolCount());
+        Assert.assertEquals(4 * PAGE, whole.getByteBuffer().capacity());
+
+        /* The server accepted every buffer */
+        loopback.roundtrip();
+    }
+
+    @Test
+    public void poolGrowsThenAddsPools() throws IOException
+    {
+        createAllocator(8);
+
+        ShmBufferAllocator.Buffer first = allocatePages(4);
+        first.getByteBuffer().putInt(0, 42);
+
+        /* Doubles the pool in place */
+        ShmBufferAllocator.Buffer second = allocatePages(4);
+        Assert.assertEquals(1, allocator.getPoolCount());
+        second.getByteBuffer().putInt(4 * PAGE - 4, 7);
+        Assert.assertEquals(42, first.getByteBuffer().getInt(0));
+
+        /* The pool is at its maximum size */
+        ShmBufferAllocator.Buffer third = allocatePages(4);
+        Assert.assertEquals(2, allocator.getPoolCount());
+        loopback.roundtrip();
+
+        /* Pools other than the first go once they are empty */
+        third.free();
+        Assert.assertEquals(1, allocator.getPoolCount());
+        second.free();
+        first.free();
+        Assert.assertEquals(1, allocator.getPoolCount());
+
+        loopback.roundtrip();
+    }
+
+    @Test
+    public void busyBufferRecycledOnRelease() throws IOException
+    {
+        createAllocator(4);
+
+        wl_compositor.Proxy compositorProxy = (wl_compositor.Proxy)
+                loopback.bind(wl_compositor.WAYLAND_INTERFACE, 1);
+        wl_surface.Proxy surface = compositorProxy.createSurface();
+
+        ShmBufferAllocator.Buffer buffer = allocatePages(4);
+        buffer.attach(surface, 0, 0);
+        surface.commit();
+        loopback.roundtrip();
+        Assert.assertTrue(buffer.isBusy());
+
+        /* Its memory stays reserved while the compositor holds it */
+        buffer.free();
+        ShmBufferAllocator.Buffer other = allocatePages(4);
+        Assert.assertEquals(2, allocator.getPoolCount());
+        other.free();
+        Assert.assertEquals(1, allocator.getPoolCount());
+
+        compositor.release(compositor.committed.get(0));
+        loopback.roundtrip();
+        Assert.assertFalse(buffer.isBusy());
+
+        other = allocatePages(4);
+        Assert.assertEquals(1, allocator.getPoolCount());
+    }
+
+    @After
+    public void destroyLoopback()
+    {
+        if (allocator != null)
+            allocator.destroy();
+        loopback.destroy();
+    }
+}
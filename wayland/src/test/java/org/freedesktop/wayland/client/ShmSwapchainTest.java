@@ -0,0 +1,179 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.client;
+
+import java.io.IOException;
+import java.util.ArrayList;
+
+import org.freedesktop.wayland.protocol.wl_compositor;
+import org.freedesktop.wayland.protocol.wl_shm;
+import org.freedesktop.wayland.protocol.wl_surface;
+import org.freedesktop.wayland.server.Loopback;
+import org.freedesktop.wayland.server.TestCompositor;
+
+import org.junit.*;
+
+public class ShmSwapchainTest
+{
+    Loopback loopback;
+    TestCompositor compositor;
+    ShmBufferAllocator allocator;
+    wl_surface.Proxy surface;
+
+    public ShmSwapchainTest()
+    { }
+
+    @Before
+    public void createSurface()
+    {
+        loopback = new Loopback();
+        loopback.display.initShm();
+        compositor = new TestCompositor(loopback.display);
+
+        wl_shm.Proxy shm = (wl_shm.Proxy)loopback.bind(
+                wl_shm.WAYLAND_INTERFACE, 1);
+        allocator = new ShmBufferAllocator(shm);
+
+        wl_compositor.Proxy compositorProxy = (wl_compositor.Proxy)
+                loopback.bind(wl_compositor.WAYLAND_INTERFACE, 1);
+        surface = compositorProxy.createSurface();
+    }
+
+    /* Attaches and commits the acquired buffer, as a client frame would */
+    private void present(ShmSwapchain swapchain)
+    {
+        swapchain.attach(surface, 0, 0);
+        surface.commit();
+        loopback.roundtrip();
+    }
+
+    /* Releases the buffer of the given commit */
+    private void release(int commit)
+    {
+        compositor.release(compositor.committed.get(commit));
+        loopback.roundtrip();
+    }
+
+    @Test
+    public void reusesReleasedBuffer() throws IOException
+    {
+        ShmSwapchain swapchain = new ShmSwapchain(allocator, 3, 16, 16,
+                wl_shm.FORMAT_ARGB8888);
+
+        ShmBufferAllocator.Buffer first = swapchain.acquire();
+        Assert.assertEquals(0, swapchain.getBufferAge());
+        present(swapchain);
+        Assert.assertTrue(first.isBusy());
+        release(0);
+        Assert.assertFalse(first.isBusy());
+
+        /* A released buffer is reused before the chain grows */
+        Assert.assertSame(first, swapchain.acquire());
+        Assert.assertEquals(1, swapchain.getBufferAge());
+        present(swapchain);
+
+        swapchain.destroy();
+    }
+
+    @Test
+    public void growsWhileBuffersAreBusy() throws IOException
+    {
+        ShmSwapchain swapchain = new ShmSwapchain(allocator, 2, 16, 16,
+                wl_shm.FORMAT_ARGB8888);
+
+        ShmBufferAllocator.Buffer first = swapchain.acquire();
+        present(swapchain);
+        ShmBufferAllocator.Buffer second = swapchain.acquire();
+        Assert.assertNotSame(first, second);
+        Assert.assertEquals(0, swapchain.getBufferAge());
+        present(swapchain);
+
+        /* Both buffers are held by the compositor */
+        Assert.assertNull(swapchain.acquire());
+
+        /* The first one holds the frame before last */
+        release(0);
+        Assert.assertSame(first, swapchain.acquire());
+        Assert.assertEquals(2, swapchain.getBufferAge());
+        present(swapchain);
+
+        swapchain.destroy();
+    }
+
+    @Test
+    public void notifiesRelease() throws IOException
+    {
+        final ArrayList<ShmBufferAllocator.Buffer> released =
+                new ArrayList<ShmBufferAllocator.Buffer>();
+        ShmSwapchain swapchain = new ShmSwapchain(allocator, 2, 16, 16,
+                wl_shm.FORMAT_ARGB8888);
+
+        ShmBufferAllocator.Buffer first = swapchain.acquire();
+        present(swapchain);
+
+        /* Set after the first buffer exists, before the second does */
+        swapchain.setReleaseListener(new ShmBufferAllocator.ReleaseListener() {
+            public void released(ShmBufferAllocator.Buffer buffer)
+            {
+                released.add(buffer);
+            }
+        });
+
+        ShmBufferAllocator.Buffer second = swapchain.acquire();
+        present(swapchain);
+        Assert.assertNull(swapchain.acquire());
+
+        release(1);
+        release(0);
+        Assert.assertEquals(2, released.size());
+        Assert.assertSame(second, released.get(0));
+        Assert.assertSame(first, released.get(1));
+
+        swapchain.destroy();
+    }
+
+    @Test
+    public void resizeDropsContents() throws IOException
+    {
+        ShmSwapchain swapchain = new ShmSwapchain(allocator, 2, 16, 16,
+                wl_shm.FORMAT_ARGB8888);
+
+        swapchain.acquire();
+        present(swapchain);
+        release(0);
+
+        swapchain.resize(32, 8);
+        ShmBufferAllocator.Buffer buffer = swapchain.acquire();
+        Assert.assertEquals(32, buffer.getWidth());
+        Assert.assertEquals(8, buffer.getHeight());
+        Assert.assertEquals(0, swapchain.getBufferAge());
+
+        swapchain.destroy();
+    }
+
+    @After
+    public void destroyLoopback()
+    {
+        allocator.destroy();
+        loopback.destroy();
+    }
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.util.ArrayList;
+
+import org.freedesktop.wayland.Fixed;
+import org.freedesktop.wayland.protocol.wl_data_device;
+import org.freedesktop.wayland.protocol.wl_pointer;
+import org.freedesktop.wayland.protocol.wl_seat;
+import org.freedesktop.wayland.protocol.wl_surface;
+
+import org.junit.*;
+
+public class BroadcastTest
+{
+    Loopback loopback;
+    ArrayList<String> received;
+
+    public BroadcastTest()
+    { }
+
+    @Before
+    public void createLoopback()
+    {
+        loopback = new Loopback();
+        received = new ArrayList<String>();
+    }
+
+    private wl_pointer.Resource createPointer(final String tag)
+    {
+        wl_pointer.Proxy proxy = new wl_pointer.Proxy(loopback.clientDisplay);
+        proxy.addListener(new wl_pointer.Events() {
+            public void enter(wl_pointer.Proxy proxy, int serial,
+                    org.freedesktop.wayland.client.Proxy surface,
+                    Fixed x, Fixed y)
+            {
+                received.add(tag + " enter " + serial);
+            }
+
+            public void leave(wl_pointer.Proxy proxy, int serial,
+                    org.freedesktop.wayland.client.Proxy surface)
+            { }
+
+            public void motion(wl_pointer.Proxy proxy, int time,
+                    Fixed x, Fixed y)
+            {
+                received.add(tag + " motion " + x.asInt());
+            }
+
+            public void button(wl_pointer.Proxy proxy, int serial, int time,
+                    int button, int state)
+            { }
+
+            public void axis(wl_pointer.Proxy proxy, int time, int axis,
+                    Fixed value)
+            { }
+        }, null);
+
+        return new wl_pointer.Resource(loopback.client, 1, proxy.getID());
+    }
+
+    private wl_seat.Resource createSeat(final String tag, int version)
+    {
+        wl_seat.Proxy proxy = new wl_seat.Proxy(loopback.clientDisplay);
+        proxy.addListener(new wl_seat.Events2() {
+            public void capabilities(wl_seat.Proxy proxy, int capabilities)
+            { }
+
+            public void name(wl_seat.Proxy proxy, String name)
+            {
+                received.add(tag + " name " + name);
+            }
+        }, null);
+
+        return new wl_seat.Resource(loopback.client, version, proxy.getID());
+    }
+
+    @Test
+    public void reachesEveryTarget()
+    {
+        wl_pointer.Resource a = createPointer("a");
+        wl_pointer.Resource b = createPointer("b");
+
+        wl_pointer.Resource.broadcastMotion(new wl_pointer.Resource[] { a, b },
+                0, new Fixed(7.0f), new Fixed(0.0f));
+        loopback.roundtrip();
+
+        Assert.assertEquals(2, received.size());
+        Assert.assertEquals("a motion 7", received.get(0));
+        Assert.assertEquals("b motion 7", received.get(1));
+    }
+
+    @Test
+    public void skipsTargetsBoundTooOld()
+    {
+        wl_seat.Resource old = createSeat("old", 1);
+        wl_seat.Resource current = createSeat("current", 2);
+
+        wl_seat.Resource.broadcastName(new wl_seat.Resource[] { old, current },
+                "seat0");
+        loopback.roundtrip();
+
+        Assert.assertEquals(1, received.size());
+        Assert.assertEquals("current name seat0", received.get(0));
+    }
+
+    @Test(expected = IllegalArgumentException.class)
+    public void rejectsMixedInterfaces()
+    {
+        Resource.broadcast(new Resource[] {
+            createPointer("a"), createSeat("b", 2)
+        }, 0, 0);
+    }
+
+    @Test(expected = IllegalArgumentException.class)
+    public void rejectsNewIdEvents()
+    {
+        wl_data_device.Proxy proxy =
+                new wl_data_device.Proxy(loopback.clientDisplay);
+        wl_data_device.Resource device = new wl_data_device.Resource(
+                loopback.client, 1, proxy.getID());
+
+        /* wl_data_device.data_offer */
+        Resource.broadcast(new Resource[] { device }, 0, (Object)null);
+    }
+
+    @Test
+    public void rejectsObjectsOfOtherClients()
+    {
+        int[] fds = new int[2];
+        Client.createSocketPair(fds);
+        Client other = new Client(loopback.display, fds[0]);
+        org.freedesktop.wayland.client.Display otherDisplay =
+                org.freedesktop.wayland.client.Display.connect(fds[1]);
+
+        try {
+            wl_pointer.Resource pointer = createPointer("a");
+            wl_pointer.Proxy otherProxy = new wl_pointer.Proxy(otherDisplay);
+            wl_pointer.Resource otherPointer = new wl_pointer.Resource(other, 1,
+                    otherProxy.getID());
+            wl_surface.Proxy surfaceProxy = new wl_surface.Proxy(
+                    loopback.clientDisplay);
+            wl_surface.Resource surface = new wl_surface.Resource(
+                    loopback.client, 1, surfaceProxy.getID());
+
+            try {
+                wl_pointer.Resource.broadcastEnter(new wl_pointer.Resource[] {
+                    pointer, otherPointer
+                }, 1, surface, new Fixed(0.0f), new Fixed(0.0f));
+                Assert.fail("Sent a surface to a client that doesn't own it");
+            } catch (IllegalArgumentException e) {
+            }
+
+            /* Checked up front, so the owner didn't get it either */
+            loopback.roundtrip();
+            Assert.assertTrue(received.isEmpty());
+        } finally {
+            otherDisplay.disconnect();
+            other.destroy();
+        }
+    }
+
+    @Test
+    public void sendsNothingOnInvalidTarget()
+    {
+        wl_pointer.Resource pointer = createPointer("a");
+
+        try {
+            Resource.broadcast(new Resource[] { pointer, null }, 2, 0,
+                    new Fixed(0.0f), new Fixed(0.0f));
+            Assert.fail("Broadcast to a null target");
+        } catch (NullPointerException e) {
+        }
+
+        loopback.roundtrip();
+        Assert.assertTrue(received.isEmpty());
+    }
+
+    @After
+    public void destroyLoopback()
+    {
+        loopback.destroy();
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import org.freedesktop.wayland.protocol.wl_compositor;
+import org.freedesktop.wayland.protocol.wl_region;
+
+import org.junit.*;
+
+public class ClientStatisticsTest
+{
+    Loopback loopback;
+
+    public ClientStatisticsTest()
+    { }
+
+    @Before
+    public void createLoopback()
+    {
+        loopback = new Loopback();
+
+        final wl_region.Requests region = new wl_region.Requests() {
+            public void destroy(wl_region.Resource resource)
+            {
+                resource.destroy();
+            }
+
+            public void add(wl_region.Resource resource, int x, int y,
+                    int width, int height)
+            { }
+
+            public void subtract(wl_region.Resource resource, int x, int y,
+                    int width, int height)
+            { }
+        };
+
+        final wl_compositor.Requests compositor = new wl_compositor.Requests() {
+            public void createSurface(wl_compositor.Resource resource, int id)
+            { }
+
+            public void createRegion(wl_compositor.Resource resource, int id)
+            {
+                wl_region.Resource res = new wl_region.Resource(
+                        resource.getClient(), 1, id);
+                res.setImplementation(region);
+            }
+        };
+
+        new Global(loopback.display, wl_compositor.WAYLAND_INTERFACE, 1,
+                new Global.BindHandler() {
+            public void bindClient(Client client, int version, int id)
+            {
+                wl_compositor.Resource res = new wl_compositor.Resource(
+                        client, version, id);
+                res.setImplementation(compositor);
+            }
+        });
+    }
+
+    @Test
+    public void requestsAreCounted()
+    {
+        wl_compositor.Proxy compositor = (wl_compositor.Proxy)loopback.bind(
+                wl_compositor.WAYLAND_INTERFACE, 1);
+        wl_region.Proxy region = compositor.createRegion();
+        for (int i = 0; i < 10; ++i)
+            region.add(i, 0, 1, 1);
+        region.subtract(0, 0, 1, 1);
+        loopback.roundtrip();
+
+        ClientStatistics stats = loopback.client.getStatistics();
+        long resources = stats.getResourceCount();
+        Assert.assertEquals(1, stats.getRequestCount("wl_compositor", 1));
+        Assert.assertEquals(10, stats.getRequestCount("wl_region", 1));
+        Assert.assertEquals(11, stats.getRequestCount("wl_region"));
+        Assert.assertTrue(stats.getInterfaces().contains("wl_region"));
+
+        /* The handler frees the resource the request was counted against */
+        region.destroy();
+        loopback.roundtrip();
+
+        stats = loopback.client.getStatistics();
+        Assert.assertEquals(1, stats.getRequestCount("wl_region", 0));
+        Assert.assertEquals(resources - 1, stats.getResourceCount());
+        Assert.assertTrue(stats.getRequestCount() >= 13);
+        Assert.assertTrue(stats.getHandlerNanos() > 0);
+    }
+
+    @Test
+    public void displayKeepsTotalsOfDisconnectedClients()
+    {
+        wl_compositor.Proxy compositor = (wl_compositor.Proxy)loopback.bind(
+                wl_compositor.WAYLAND_INTERFACE, 1);
+        wl_region.Proxy region = compositor.createRegion();
+        region.add(0, 0, 1, 1);
+        loopback.roundtrip();
+
+        loopback.client.destroy();
+
+        ClientStatistics stats = loopback.display.getClientStatistics();
+        Assert.assertEquals(1, stats.getRequestCount("wl_region", 1));
+    }
+
+    @After
+    public void destroyLoopback()
+    {
+        loopback.destroy();
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.io.File;
+import java.util.concurrent.Executor;
+
+import org.freedesktop.wayland.protocol.wl_compositor;
+import org.junit.*;
+
+public class ClientTest
+{
+    private static final int MAX_ITERATIONS = 100;
+
+    Display display;
+
+    public ClientTest()
+    { }
+
+    @Before
+    public void createDisplay()
+    {
+        display = new Display();
+    }
+
+    @After
+    public void destroyDisplay()
+    {
+        display.destroy();
+    }
+
+    /* Dispatches until the process on the other end hangs up */
+    private void awaitDestroy(Client client)
+    {
+        final boolean[] destroyed = new boolean[1];
+        client.addDestroyListener(new DestroyListener() {
+            public void onDestroy()
+            {
+                destroyed[0] = true;
+            }
+        });
+
+        for (int i = 0; i < MAX_ITERATIONS && !destroyed[0]; ++i)
+            display.getEventLoop().dispatch(50);
+
+        Assert.assertTrue(destroyed[0]);
+    }
+
+    @Test
+    public void startClient()
+    {
+        Client client = Client.startClient(display, new File("/bin/true"),
+                new String[0]);
+
+        awaitDestroy(client);
+    }
+
+    @Test
+    public void startClientAsync()
+    {
+        Client client = Client.startClientAsync(display, new File("/bin/true"),
+                new String[0], false, new Executor() {
+                    public void execute(Runnable command)
+                    {
+                        command.run();
+                    }
+                });
+
+        awaitDestroy(client);
+    }
+
+    @Test
+    public void failedBindEndsClient()
+    {
+        Loopback loopback = new Loopback();
+        final Throwable[] reported = new Throwable[1];
+        final boolean[] destroyed = new boolean[1];
+
+        loopback.display.setUncaughtCallbackHandler(
+                new UncaughtCallbackHandler() {
+            public void uncaughtCallbackException(Object source, Throwable t)
+            {
+                reported[0] = t;
+            }
+        });
+        new Global(loopback.display, wl_compositor.WAYLAND_INTERFACE, 1,
+                new Global.BindHandler() {
+            public void bindClient(Client client, int version, int id)
+            {
+                throw new IllegalStateException("No compositor here");
+            }
+        });
+        loopback.client.addDestroyListener(new DestroyListener() {
+            public void onDestroy()
+            {
+                destroyed[0] = true;
+            }
+        });
+
+        /* The client would fail on the error, so only run the server */
+        loopback.bind(wl_compositor.WAYLAND_INTERFACE, 1);
+        loopback.clientDisplay.flush();
+        for (int i = 0; i < MAX_ITERATIONS && !destroyed[0]; ++i) {
+            loopback.loop.dispatch(0);
+            loopback.display.flushClients();
+        }
+
+        Assert.assertTrue(destroyed[0]);
+        Assert.assertTrue(reported[0] instanceof IllegalStateException);
+
+        loopback.destroy();
+    }
+}
@@ -21,6 +21,15 @@
  */
 package org.freedesktop.wayland.server;
 
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.util.ArrayList;
+
+import org.freedesktop.wayland.ShmPool;
+import org.freedesktop.wayland.protocol.wl_registry;
+import org.freedesktop.wayland.protocol.wl_shm;
+
 import org.junit.*;
 
 public class EventLoopTest
@@ -54,6 +63,206 @@ public class EventLoopTest
         Assert.assertTrue(called);
     }
 
+    @Test
+    public void testRemoveIdle()
+    {
+        final EventLoop.EventSource[] source = new EventLoop.EventSource[1];
+
+        source[0] = loop.addIdle(new EventLoop.IdleHandler() {
+            public void handleIdle()
+            {
+                loop.remove(source[0]);
+            }
+        });
+        loop.dispatchIdle();
+
+        /* libwayland has already freed it */
+        Assert.assertEquals(0, loop.remove(source[0]));
+    }
+
+    @Test
+    public void testPost() throws InterruptedException
+    {
+        called = false;
+
+        Thread poster = new Thread() {
+            public void run()
+            {
+                loop.post(new Runnable() {
+                    public void run()
+                    {
+                        called = true;
+                    }
+                });
+            }
+        };
+        poster.start();
+        poster.join();
+
+        loop.dispatch(1000);
+
+        Assert.assertTrue(called);
+    }
+
+    @Test
+    public void testDispatchReady()
+    {
+        called = false;
+
+        Assert.assertTrue(loop.getFd() >= 0);
+
+        loop.post(new Runnable() {
+            public void run()
+            {
+                called = true;
+            }
+        });
+
+        Assert.assertTrue(loop.dispatchReady() >= 0);
+        Assert.assertTrue(called);
+    }
+
+    @Test
+    public void testDeferCoalesces()
+    {
+        final int[] count = new int[1];
+        Object key = new Object();
+
+        for (int i = 0; i < 10; ++i) {
+            loop.defer(key, new Runnable() {
+                public void run()
+                {
+                    ++count[0];
+                }
+            });
+        }
+
+        loop.dispatch(0);
+
+        Assert.assertEquals(1, count[0]);
+    }
+
+    @Test
+    public void testDeferRunsOneBatchPerDispatch()
+    {
+        final int[] count = new int[1];
+
+        loop.defer(new Runnable() {
+            public void run()
+            {
+                ++count[0];
+                loop.defer(this);
+            }
+        });
+
+        loop.dispatch(0);
+        Assert.assertEquals(1, count[0]);
+
+        loop.dispatch(0);
+        Assert.assertEquals(2, count[0]);
+    }
+
+    @Test
+    public void testUncaughtCallbackHandler()
+    {
+        called = false;
+
+        loop.setUncaughtCallbackHandler(new UncaughtCallbackHandler() {
+            public void uncaughtCallbackException(Object source, Throwable t)
+            {
+                called = t instanceof IllegalStateException;
+            }
+        });
+
+        EventLoop.EventSource source = loop.addIdle(new EventLoop.IdleHandler() {
+            public void handleIdle()
+            {
+                throw new IllegalStateException();
+            }
+        });
+
+        loop.dispatchIdle();
+
+        Assert.assertTrue(called);
+        Assert.assertEquals(1, loop.getCallbackFailureCount());
+        Assert.assertEquals(1, source.getFailureCount());
+    }
+
+    @Test
+    public void testBufferedReader() throws IOException
+    {
+        final ArrayList<Integer> messages = new ArrayList<Integer>();
+        final ArrayList<Integer> fds = new ArrayList<Integer>();
+        final boolean[] retained = new boolean[1];
+        final boolean[] hangup = new boolean[1];
+        final EventLoop.EventSource[] source = new EventLoop.EventSource[1];
+
+        int[] sockets = new int[2];
+        Client.createSocketPair(sockets);
+
+        /* Small enough that the messages arrive split across reads */
+        ByteBuffer buffer = ByteBuffer.allocateDirect(40)
+                .order(ByteOrder.nativeOrder());
+
+        source[0] = loop.addBufferedReader(sockets[0], buffer,
+                new EventLoop.BufferedReadHandler() {
+            public int handleRead(int fd, int mask, ByteBuffer data,
+                    int length, int[] received)
+            {
+                int offset = 0;
+                while (length - offset >= 8) {
+                    int size = data.getInt(offset + 4) >>> 16;
+                    if (length - offset < size)
+                        break;
+                    messages.add(data.getInt(offset) << 16
+                            | data.getInt(offset + 4) & 0xffff);
+                    offset += size;
+                }
+
+                if (received != null)
+                    for (int i = 0; i < received.length; ++i)
+                        fds.add(received[i]);
+
+                if ((mask & EventLoop.EVENT_HANGUP) != 0) {
+                    hangup[0] = true;
+                    /* Removing the source from its own callback is fine */
+                    loop.remove(source[0]);
+                    return 0;
+                }
+
+                if (offset < length)
+                    retained[0] = true;
+                return length - offset;
+            }
+        });
+
+        ShmPool pool = new ShmPool(4096);
+        org.freedesktop.wayland.client.Display display =
+                org.freedesktop.wayland.client.Display.connect(sockets[1]);
+        wl_registry.Proxy registry = display.getRegistry();
+        wl_shm.Proxy shm = (wl_shm.Proxy)registry.bind(1,
+                wl_shm.WAYLAND_INTERFACE, 1);
+        shm.createPool(pool.getFileDescriptor(), 4096);
+        display.flush();
+        display.disconnect();
+        pool.close();
+
+        for (int i = 0; i < 100 && ! hangup[0]; ++i)
+            loop.dispatch(0);
+
+        Assert.assertTrue(hangup[0]);
+        Assert.assertTrue(retained[0]);
+
+        /* get_registry, bind and create_pool, on objects 1, 2 and 3 */
+        Assert.assertEquals(3, messages.size());
+        Assert.assertEquals(1 << 16 | 1, (int)messages.get(0));
+        Assert.assertEquals(2 << 16 | 0, (int)messages.get(1));
+        Assert.assertEquals(3 << 16 | 0, (int)messages.get(2));
+
+        Assert.assertEquals(1, fds.size());
+        ShmPool.fromFileDescriptor(fds.get(0), 4096, false, true).close();
+    }
+
     @After
     public void destroyDisplay()
     {
@@ -0,0 +1,162 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.util.ArrayList;
+
+import org.freedesktop.wayland.Fixed;
+import org.freedesktop.wayland.protocol.wl_pointer;
+
+import org.junit.*;
+
+public class FlowControlTest
+{
+    Loopback loopback;
+    wl_pointer.Resource pointer;
+    ArrayList<String> received;
+
+    public FlowControlTest()
+    { }
+
+    @Before
+    public void createPointer()
+    {
+        loopback = new Loopback();
+        received = new ArrayList<String>();
+
+        /* The client allocates the id; no seat is needed to send events */
+        wl_pointer.Proxy proxy = new wl_pointer.Proxy(loopback.clientDisplay);
+        proxy.addListener(new wl_pointer.Events() {
+            public void enter(wl_pointer.Proxy proxy, int serial,
+                    org.freedesktop.wayland.client.Proxy surface,
+                    Fixed x, Fixed y)
+            { }
+
+            public void leave(wl_pointer.Proxy proxy, int serial,
+                    org.freedesktop.wayland.client.Proxy surface)
+            { }
+
+            public void motion(wl_pointer.Proxy proxy, int time,
+                    Fixed x, Fixed y)
+            {
+                received.add("motion " + x.asInt());
+            }
+
+            public void button(wl_pointer.Proxy proxy, int serial, int time,
+                    int button, int state)
+            {
+                received.add("button " + serial);
+            }
+
+            public void axis(wl_pointer.Proxy proxy, int time, int axis,
+                    Fixed value)
+            { }
+        }, null);
+
+        pointer = new wl_pointer.Resource(loopback.client, 1, proxy.getID());
+    }
+
+    /* Leaves the client with unread data, which makes it congested */
+    private void congest()
+    {
+        loopback.display.setOutgoingLimits(1, 0);
+        pointer.button(0, 0, 0, 0);
+        loopback.display.flushClients();
+    }
+
+    @Test
+    public void motionIsCoalesced()
+    {
+        congest();
+        for (int i = 1; i <= 10; ++i)
+            pointer.motion(i, (float)i, 0.0f);
+
+        loopback.dispatchClient();
+        Assert.assertEquals(1, received.size());
+
+        /* The client has caught up; only the newest motion is sent */
+        loopback.display.flushClients();
+        loopback.dispatchClient();
+
+        Assert.assertEquals(2, received.size());
+        Assert.assertEquals("motion 10", received.get(1));
+        Assert.assertEquals(10, loopback.client.getStatistics()
+                .getCoalescedEventCount());
+    }
+
+    @Test
+    public void coalescedMotionKeepsOrder()
+    {
+        congest();
+        pointer.motion(1, 1.0f, 0.0f);
+        pointer.motion(2, 2.0f, 0.0f);
+        /* Must not overtake the motion held back for the same pointer */
+        pointer.button(1, 3, 0, 0);
+
+        loopback.dispatchClient();
+        loopback.display.flushClients();
+        loopback.dispatchClient();
+
+        Assert.assertEquals(3, received.size());
+        Assert.assertEquals("button 0", received.get(0));
+        Assert.assertEquals("motion 2", received.get(1));
+        Assert.assertEquals("button 1", received.get(2));
+    }
+
+    @Test
+    public void destroyedResourceDropsCoalescedEvents()
+    {
+        congest();
+        pointer.motion(1, 1.0f, 0.0f);
+        pointer.destroy();
+
+        loopback.dispatchClient();
+        loopback.display.flushClients();
+        loopback.dispatchClient();
+
+        Assert.assertEquals(1, received.size());
+    }
+
+    @Test
+    public void runFlushesClients()
+    {
+        loopback.display.setOutgoingLimits(1 << 20, 0);
+        pointer.button(0, 0, 0, 0);
+
+        loopback.loop.post(new Runnable() {
+            public void run()
+            {
+                loopback.display.terminate();
+            }
+        });
+        loopback.display.run();
+
+        loopback.dispatchClient();
+        Assert.assertEquals(1, received.size());
+    }
+
+    @After
+    public void destroyLoopback()
+    {
+        loopback.destroy();
+    }
+}
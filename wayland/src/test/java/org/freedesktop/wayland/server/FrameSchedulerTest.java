@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import org.freedesktop.wayland.protocol.wl_callback;
+
+import org.junit.*;
+
+public class FrameSchedulerTest
+{
+    Loopback loopback;
+    FrameScheduler scheduler;
+    int done;
+
+    public FrameSchedulerTest()
+    { }
+
+    @Before
+    public void createScheduler()
+    {
+        loopback = new Loopback();
+        scheduler = new FrameScheduler(loopback.loop);
+        done = 0;
+    }
+
+    /* Requests a callback as wl_surface.frame would */
+    private void requestFrame()
+    {
+        wl_callback.Proxy callback = new wl_callback.Proxy(
+                loopback.clientDisplay);
+        callback.addListener(new wl_callback.Events() {
+            public void done(wl_callback.Proxy proxy, int data)
+            {
+                ++done;
+                proxy.destroy();
+            }
+        }, null);
+
+        scheduler.addFrameCallback(loopback.client, callback.getID());
+    }
+
+    @Test
+    public void manualTick()
+    {
+        Assert.assertNull(scheduler.getClientTiming(loopback.client));
+
+        for (int i = 0; i < 3; ++i)
+            requestFrame();
+        Assert.assertEquals(3, scheduler.getPendingCount());
+
+        FrameScheduler.ClientTiming timing =
+                scheduler.getClientTiming(loopback.client);
+        Assert.assertEquals(3, timing.pending);
+        Assert.assertEquals(0, timing.frames);
+
+        /* Without a refresh rate nothing fires on its own */
+        loopback.roundtrip();
+        Assert.assertEquals(0, done);
+
+        Assert.assertEquals(3, scheduler.tick());
+        Assert.assertEquals(0, scheduler.getPendingCount());
+        loopback.roundtrip();
+        Assert.assertEquals(3, done);
+
+        timing = scheduler.getClientTiming(loopback.client);
+        Assert.assertEquals(0, timing.pending);
+        Assert.assertEquals(3, timing.frames);
+
+        Assert.assertEquals(0, scheduler.tick());
+    }
+
+    @Test
+    public void phaseInTheFuture()
+    {
+        /* Aligned to a refresh a second from now, at 60Hz */
+        scheduler.setRefreshRate(60000, System.nanoTime() + 1000000000L);
+        requestFrame();
+
+        for (int i = 0; i < 20 && done == 0; ++i) {
+            loopback.loop.dispatch(50);
+            loopback.display.flushClients();
+            loopback.dispatchClient();
+        }
+
+        Assert.assertEquals(1, done);
+    }
+
+    @After
+    public void destroyScheduler()
+    {
+        scheduler.destroy();
+        loopback.destroy();
+    }
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import org.freedesktop.wayland.Interface;
+import org.freedesktop.wayland.protocol.wl_callback;
+import org.freedesktop.wayland.protocol.wl_registry;
+
+/**
+ * A server Display with a client connected to it over a socket pair, both
+ * driven from the calling thread.  Used by tests that need real protocol
+ * traffic.
+ */
+public class Loopback
+{
+    private static final int MAX_ITERATIONS = 1000;
+
+    public final Display display;
+    public final EventLoop loop;
+    public final Client client;
+    public final org.freedesktop.wayland.client.Display clientDisplay;
+
+    public Loopback()
+    {
+        display = new Display();
+        loop = display.getEventLoop();
+
+        int[] fds = new int[2];
+        Client.createSocketPair(fds);
+        client = new Client(display, fds[0]);
+        clientDisplay = org.freedesktop.wayland.client.Display.connect(fds[1]);
+    }
+
+    /**
+     * Sends what the client has queued, runs one server loop iteration and
+     * dispatches whatever the server sent back.
+     */
+    public void iterate()
+    {
+        clientDisplay.flush();
+        loop.dispatch(0);
+        display.flushClients();
+        dispatchClient();
+    }
+
+    public void dispatchClient()
+    {
+        clientDisplay.dispatchPending();
+        if (clientDisplay.prepareRead())
+            clientDisplay.readEvents();
+        clientDisplay.dispatchPending();
+    }
+
+    /* Iterates until the server has answered a wl_display.sync */
+    public void roundtrip()
+    {
+        final boolean[] done = new boolean[1];
+
+        wl_callback.Proxy callback = clientDisplay.sync();
+        callback.addListener(new wl_callback.Events() {
+            public void done(wl_callback.Proxy proxy, int data)
+            {
+                done[0] = true;
+            }
+        }, null);
+
+        for (int i = 0; ! done[0]; ++i) {
+            if (i == MAX_ITERATIONS)
+                throw new AssertionError("Roundtrip did not complete");
+            iterate();
+        }
+        callback.destroy();
+    }
+
+    /* Iterates until the condition holds */
+    public void iterateUntil(Condition condition)
+    {
+        for (int i = 0; ! condition.holds(); ++i) {
+            if (i == MAX_ITERATIONS)
+                throw new AssertionError("Condition never became true");
+            iterate();
+        }
+    }
+
+    public static interface Condition
+    {
+        public abstract boolean holds();
+    }
+
+    /* Binds the client to the server global implementing iface */
+    public org.freedesktop.wayland.client.Proxy bind(final Interface iface,
+            int version)
+    {
+        final int[] name = new int[] { -1 };
+
+        wl_registry.Proxy registry = clientDisplay.getRegistry();
+        registry.addListener(new wl_registry.Events() {
+            public void global(wl_registry.Proxy proxy, int global,
+                    String ifaceName, int globalVersion)
+            {
+                if (ifaceName.equals(iface.getName()))
+                    name[0] = global;
+            }
+
+            public void globalRemove(wl_registry.Proxy proxy, int global)
+            { }
+        }, null);
+        roundtrip();
+
+        if (name[0] < 0)
+            throw new AssertionError(iface.getName() + " not advertised");
+
+        return registry.bind(name[0], iface, version);
+    }
+
+    public void destroy()
+    {
+        clientDisplay.disconnect();
+        display.destroy();
+    }
+}
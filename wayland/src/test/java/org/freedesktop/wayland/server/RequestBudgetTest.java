@@ -0,0 +1,176 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.util.ArrayList;
+
+import org.freedesktop.wayland.protocol.wl_compositor;
+import org.freedesktop.wayland.protocol.wl_region;
+
+import org.junit.*;
+
+public class RequestBudgetTest
+{
+    static final int BUDGET = 4;
+
+    Loopback loopback;
+    ArrayList<wl_region.Resource> regions;
+    ArrayList<Integer> added;
+    int destroyed;
+
+    public RequestBudgetTest()
+    { }
+
+    @Before
+    public void createLoopback()
+    {
+        loopback = new Loopback();
+        regions = new ArrayList<wl_region.Resource>();
+        added = new ArrayList<Integer>();
+        destroyed = 0;
+
+        final wl_region.Requests region = new wl_region.Requests() {
+            public void destroy(wl_region.Resource resource)
+            {
+                ++destroyed;
+                resource.destroy();
+            }
+
+            public void add(wl_region.Resource resource, int x, int y,
+                    int width, int height)
+            {
+                added.add(x);
+            }
+
+            public void subtract(wl_region.Resource resource, int x, int y,
+                    int width, int height)
+            { }
+        };
+
+        final wl_compositor.Requests compositor = new wl_compositor.Requests() {
+            public void createSurface(wl_compositor.Resource resource, int id)
+            { }
+
+            public void createRegion(wl_compositor.Resource resource, int id)
+            {
+                wl_region.Resource res = new wl_region.Resource(
+                        resource.getClient(), 1, id);
+                res.setImplementation(region);
+                regions.add(res);
+            }
+        };
+
+        new Global(loopback.display, wl_compositor.WAYLAND_INTERFACE, 1,
+                new Global.BindHandler() {
+            public void bindClient(Client client, int version, int id)
+            {
+                wl_compositor.Resource res = new wl_compositor.Resource(
+                        client, version, id);
+                res.setImplementation(compositor);
+            }
+        });
+
+        loopback.display.setRequestBudget(BUDGET);
+    }
+
+    private wl_compositor.Proxy bindCompositor()
+    {
+        return (wl_compositor.Proxy)loopback.bind(
+                wl_compositor.WAYLAND_INTERFACE, 1);
+    }
+
+    @Test
+    public void queuedRequestsRunInOrder()
+    {
+        wl_region.Proxy region = bindCompositor().createRegion();
+        for (int i = 0; i < 100; ++i)
+            region.add(i, 0, 1, 1);
+        /* Its handler destroys the resource the queue entry refers to */
+        region.destroy();
+
+        loopback.iterate();
+        Assert.assertTrue(added.size() <= BUDGET);
+
+        loopback.iterateUntil(new Loopback.Condition() {
+            public boolean holds()
+            {
+                return destroyed == 1;
+            }
+        });
+
+        Assert.assertEquals(100, added.size());
+        for (int i = 0; i < 100; ++i)
+            Assert.assertEquals(i, (int)added.get(i));
+        Assert.assertTrue(loopback.client.getStatistics()
+                .getDeferredRequestCount() > 0);
+    }
+
+    @Test
+    public void roundtripWaitsForQueuedRequests()
+    {
+        wl_region.Proxy region = bindCompositor().createRegion();
+        for (int i = 0; i < 100; ++i)
+            region.add(i, 0, 1, 1);
+
+        /* wl_display.sync is answered by libwayland, not the dispatcher */
+        loopback.roundtrip();
+        Assert.assertEquals(100, added.size());
+    }
+
+    @Test
+    public void destroyedResourceDropsItsQueue()
+    {
+        wl_compositor.Proxy compositor = bindCompositor();
+        wl_region.Proxy first = compositor.createRegion();
+        for (int i = 0; i < 100; ++i)
+            first.add(i, 0, 1, 1);
+        loopback.iterate();
+
+        /* Drops what is still queued for it */
+        int handled = added.size();
+        regions.get(0).destroy();
+        loopback.roundtrip();
+        loopback.roundtrip();
+        Assert.assertEquals(handled, added.size());
+
+        /* The dropped requests must no longer count against the queue */
+        added.clear();
+        wl_region.Proxy second = compositor.createRegion();
+        for (int i = 0; i < 20; ++i)
+            second.add(i, 0, 1, 1);
+        loopback.iterate();
+        Assert.assertTrue(added.size() <= BUDGET);
+
+        loopback.iterateUntil(new Loopback.Condition() {
+            public boolean holds()
+            {
+                return added.size() == 20;
+            }
+        });
+    }
+
+    @After
+    public void destroyLoopback()
+    {
+        loopback.destroy();
+    }
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+import org.freedesktop.wayland.ShmPool;
+import org.freedesktop.wayland.protocol.wl_buffer;
+import org.freedesktop.wayland.protocol.wl_compositor;
+import org.freedesktop.wayland.protocol.wl_region;
+import org.freedesktop.wayland.protocol.wl_shm;
+import org.freedesktop.wayland.protocol.wl_shm_pool;
+import org.freedesktop.wayland.protocol.wl_surface;
+
+import org.junit.*;
+
+public class ShmBufferTest
+{
+    Loopback loopback;
+    TestCompositor compositor;
+
+    public ShmBufferTest()
+    { }
+
+    @Before
+    public void createLoopback()
+    {
+        loopback = new Loopback();
+        loopback.display.initShm();
+        compositor = new TestCompositor(loopback.display);
+    }
+
+    @Test
+    public void notAnShmBuffer()
+    {
+        wl_region.Resource region = new wl_region.Resource(loopback.client, 1);
+
+        Assert.assertNull(ShmBuffer.get(region));
+    }
+
+    @Test
+    public void clientBuffer() throws IOException
+    {
+        ShmPool pool = new ShmPool(4096);
+        pool.asByteBuffer().putInt(4 * 17, 0x12345678);
+
+        wl_shm.Proxy shm = (wl_shm.Proxy)loopback.bind(
+                wl_shm.WAYLAND_INTERFACE, 1);
+        wl_shm_pool.Proxy shmPool = shm.createPool(pool.getFileDescriptor(),
+                4096);
+        wl_buffer.Proxy buffer = shmPool.createBuffer(0, 16, 16, 64,
+                wl_shm.FORMAT_ARGB8888);
+
+        wl_compositor.Proxy compositorProxy = (wl_compositor.Proxy)
+                loopback.bind(wl_compositor.WAYLAND_INTERFACE, 1);
+        wl_surface.Proxy surface = compositorProxy.createSurface();
+        surface.attach(buffer, 0, 0);
+        surface.commit();
+        surface.attach(buffer, 0, 0);
+        surface.commit();
+        loopback.roundtrip();
+
+        Assert.assertEquals(2, compositor.committed.size());
+        Resource resource = compositor.committed.get(0);
+        /* A natively implemented resource keeps its Java wrapper */
+        Assert.assertSame(resource, compositor.committed.get(1));
+
+        ShmBuffer shmBuffer = ShmBuffer.get(resource);
+        Assert.assertNotNull(shmBuffer);
+        Assert.assertEquals(16, shmBuffer.getWidth());
+        Assert.assertEquals(16, shmBuffer.getHeight());
+        Assert.assertEquals(64, shmBuffer.getStride());
+        Assert.assertEquals(wl_shm.FORMAT_ARGB8888, shmBuffer.getFormat());
+
+        shmBuffer.beginAccess();
+        ByteBuffer data = shmBuffer.getByteBuffer();
+        Assert.assertTrue(data.isReadOnly());
+        Assert.assertEquals(0x12345678, data.getInt(4 * 17));
+        shmBuffer.endAccess();
+
+        buffer.destroy();
+        loopback.roundtrip();
+        Assert.assertNull(ShmBuffer.get(resource));
+
+        pool.close();
+    }
+
+    @After
+    public void destroyLoopback()
+    {
+        loopback.destroy();
+    }
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+import org.freedesktop.wayland.PixelOps;
+import org.freedesktop.wayland.Region;
+import org.freedesktop.wayland.ShmPool;
+import org.freedesktop.wayland.protocol.wl_buffer;
+import org.freedesktop.wayland.protocol.wl_compositor;
+import org.freedesktop.wayland.protocol.wl_shm;
+import org.freedesktop.wayland.protocol.wl_shm_pool;
+import org.freedesktop.wayland.protocol.wl_surface;
+import org.junit.*;
+
+public class SoftwareCompositorTest
+{
+    ShmPool output;
+    ByteBuffer pixels;
+    SoftwareCompositor compositor;
+
+    public SoftwareCompositorTest()
+    { }
+
+    @Before
+    public void createCompositor() throws IOException
+    {
+        output = new ShmPool(200 * 100 * 4);
+        pixels = output.asByteBuffer();
+        compositor = new SoftwareCompositor(output, 200, 100);
+    }
+
+    @After
+    public void destroyCompositor() throws IOException
+    {
+        compositor.destroy();
+        output.close();
+    }
+
+    private static ByteBuffer solid(int width, int height, int color)
+    {
+        ByteBuffer data = ByteBuffer.allocateDirect(width * height * 4)
+                .order(ByteOrder.nativeOrder());
+        PixelOps.fillRect(data, 0, width * 4, 0, 0, width, height, color);
+        return data;
+    }
+
+    private int pixel(int x, int y)
+    {
+        return pixels.getInt((y * 200 + x) * 4);
+    }
+
+    @Test
+    public void composeAndDamage()
+    {
+        SoftwareCompositor.Surface bottom = compositor.createSurface();
+        bottom.attach(solid(200, 100, 0x000000ff), 200, 100, 200 * 4,
+                SoftwareCompositor.FORMAT_XRGB8888);
+
+        SoftwareCompositor.Surface top = compositor.createSurface();
+        top.attach(solid(10, 10, 0x80800000), 10, 10, 10 * 4,
+                SoftwareCompositor.FORMAT_ARGB8888);
+        top.setPosition(70, 5);
+
+        Region repainted = compositor.compose();
+        Assert.assertEquals(200 * 100, area(repainted));
+        repainted.destroy();
+
+        Assert.assertEquals(0xff0000ff, pixel(0, 0));
+        Assert.assertEquals(0xff80007f, pixel(75, 10));
+
+        /* Only the tile under the damage is repainted */
+        top.setOpacity(0);
+        repainted = compositor.compose();
+        Assert.assertArrayEquals(new int[] { 64, 0, 64, 64 },
+                repainted.getRectangles());
+        repainted.destroy();
+
+        Assert.assertEquals(0xff0000ff, pixel(75, 10));
+    }
+
+    @Test
+    public void occludedTile()
+    {
+        SoftwareCompositor.Surface bottom = compositor.createSurface();
+        bottom.attach(solid(200, 100, 0xff0000ff), 200, 100, 200 * 4,
+                SoftwareCompositor.FORMAT_ARGB8888);
+
+        /* Covers tile (1, 0) exactly, so nothing below it is drawn there */
+        SoftwareCompositor.Surface cover = compositor.createSurface();
+        cover.attach(solid(64, 64, 0x80ff0000), 64, 64, 64 * 4,
+                SoftwareCompositor.FORMAT_ARGB8888);
+        cover.setOpaque(true);
+        cover.setPosition(64, 0);
+
+        /* One column short of tile (0, 0), which still shows the bottom */
+        SoftwareCompositor.Surface partial = compositor.createSurface();
+        partial.attach(solid(63, 64, 0x0000ff00), 63, 64, 63 * 4,
+                SoftwareCompositor.FORMAT_XRGB8888);
+
+        /* Far edges past INT32_MAX must not wrap onto the output */
+        SoftwareCompositor.Surface far = compositor.createSurface();
+        far.attach(solid(100, 100, 0xffffffff), 100, 100, 100 * 4,
+                SoftwareCompositor.FORMAT_XRGB8888);
+        far.setPosition(Integer.MAX_VALUE - 10, Integer.MAX_VALUE - 10);
+
+        compositor.compose().destroy();
+
+        Assert.assertEquals(0xff00ff00, pixel(62, 63));
+        Assert.assertEquals(0xff0000ff, pixel(63, 0));
+        Assert.assertEquals(0xffff0000, pixel(64, 0));
+        Assert.assertEquals(0xffff0000, pixel(127, 63));
+        Assert.assertEquals(0xff0000ff, pixel(128, 0));
+        Assert.assertEquals(0xff0000ff, pixel(64, 64));
+    }
+
+    @Test
+    public void shmBufferSource() throws IOException
+    {
+        Loopback loopback = new Loopback();
+        loopback.display.initShm();
+        TestCompositor testCompositor = new TestCompositor(loopback.display);
+        ShmPool pool = new ShmPool(200 * 100 * 4);
+
+        try {
+            PixelOps.fillRect(pool.asByteBuffer(), 0, 200 * 4, 0, 0, 200, 100,
+                    0x0000ff00);
+
+            wl_shm.Proxy shm = (wl_shm.Proxy)loopback.bind(
+                    wl_shm.WAYLAND_INTERFACE, 1);
+            wl_shm_pool.Proxy shmPool = shm.createPool(
+                    pool.getFileDescriptor(), 200 * 100 * 4);
+            wl_buffer.Proxy buffer = shmPool.createBuffer(0, 200, 100,
+                    200 * 4, wl_shm.FORMAT_XRGB8888);
+            wl_compositor.Proxy compositorProxy = (wl_compositor.Proxy)
+                    loopback.bind(wl_compositor.WAYLAND_INTERFACE, 1);
+            wl_surface.Proxy surface = compositorProxy.createSurface();
+            surface.attach(buffer, 0, 0);
+            surface.commit();
+            loopback.roundtrip();
+
+            ShmBuffer shmBuffer = ShmBuffer.get(
+                    testCompositor.committed.get(0));
+            Assert.assertNotNull(shmBuffer);
+
+            /* Every tile, each opening access on its own worker thread */
+            SoftwareCompositor.Surface top = compositor.createSurface();
+            top.attach(shmBuffer);
+            compositor.compose().destroy();
+
+            Assert.assertEquals(0xff00ff00, pixel(0, 0));
+            Assert.assertEquals(0xff00ff00, pixel(100, 70));
+            Assert.assertEquals(0xff00ff00, pixel(199, 99));
+
+            /* And blended, through the other kernel */
+            top.setOpacity(128);
+            compositor.compose().destroy();
+
+            Assert.assertEquals(0xff008000, pixel(0, 0));
+            Assert.assertEquals(0xff008000, pixel(199, 99));
+
+            top.detach();
+        } finally {
+            loopback.destroy();
+            pool.close();
+        }
+    }
+
+    private static int area(Region region)
+    {
+        int[] rects = region.getRectangles();
+        int area = 0;
+        for (int i = 0; i < rects.length; i += 4)
+            area += rects[i + 2] * rects[i + 3];
+        return area;
+    }
+}
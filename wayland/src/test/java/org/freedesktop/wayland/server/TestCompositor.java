@@ -0,0 +1,107 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import java.util.ArrayList;
+import java.util.HashMap;
+
+import org.freedesktop.wayland.protocol.wl_compositor;
+import org.freedesktop.wayland.protocol.wl_surface;
+
+/**
+ * A wl_compositor global for tests that records the buffer of every
+ * surface commit and lets the test release buffers again.
+ */
+public class TestCompositor
+{
+    /* Buffers in the order they were committed, or null for none */
+    public final ArrayList<Resource> committed = new ArrayList<Resource>();
+
+    private final HashMap<Resource, Resource> attached =
+            new HashMap<Resource, Resource>();
+
+    private final wl_surface.Requests surface = new wl_surface.Requests() {
+        public void destroy(wl_surface.Resource resource)
+        {
+            attached.remove(resource);
+            resource.destroy();
+        }
+
+        public void attach(wl_surface.Resource resource, Resource buffer,
+                int x, int y)
+        {
+            attached.put(resource, buffer);
+        }
+
+        public void damage(wl_surface.Resource resource, int x, int y,
+                int width, int height)
+        { }
+
+        public void frame(wl_surface.Resource resource, int callback)
+        { }
+
+        public void setOpaqueRegion(wl_surface.Resource resource,
+                Resource region)
+        { }
+
+        public void setInputRegion(wl_surface.Resource resource,
+                Resource region)
+        { }
+
+        public void commit(wl_surface.Resource resource)
+        {
+            committed.add(attached.remove(resource));
+        }
+    };
+
+    private final wl_compositor.Requests compositor =
+            new wl_compositor.Requests() {
+        public void createSurface(wl_compositor.Resource resource, int id)
+        {
+            wl_surface.Resource res = new wl_surface.Resource(
+                    resource.getClient(), 1, id);
+            res.setImplementation(surface);
+        }
+
+        public void createRegion(wl_compositor.Resource resource, int id)
+        { }
+    };
+
+    public TestCompositor(Display display)
+    {
+        new Global(display, wl_compositor.WAYLAND_INTERFACE, 1,
+                new Global.BindHandler() {
+            public void bindClient(Client client, int version, int id)
+            {
+                wl_compositor.Resource res = new wl_compositor.Resource(
+                        client, version, id);
+                res.setImplementation(compositor);
+            }
+        });
+    }
+
+    /* Sends wl_buffer.release */
+    public void release(Resource buffer)
+    {
+        buffer.postEvent(0);
+    }
+}
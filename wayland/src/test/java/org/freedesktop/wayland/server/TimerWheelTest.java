@@ -0,0 +1,168 @@
+/*
+ * Copyright © 2012-2013 Jason Ekstrand.
+ *  
+ * Permission to use, copy, modify, distribute, and sell this software and its
+ * documentation for any purpose is hereby granted without fee, provided that
+ * the above copyright notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting documentation, and
+ * that the name of the copyright holders not be used in advertising or
+ * publicity pertaining to distribution of the software without specific,
+ * written prior permission.  The copyright holders make no representations
+ * about the suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ * 
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN NO
+ * EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE,
+ * DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER
+ * TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE
+ * OF THIS SOFTWARE.
+ */
+package org.freedesktop.wayland.server;
+
+import org.junit.*;
+
+public class TimerWheelTest
+{
+    EventLoop loop;
+    TimerWheel wheel;
+    int fired;
+
+    public TimerWheelTest()
+    { }
+
+    @Before
+    public void createWheel()
+    {
+        loop = new EventLoop();
+        wheel = new TimerWheel(loop);
+        fired = 0;
+    }
+
+    @Test
+    public void testBatchedExpiry()
+    {
+        TimerWheel.TimeoutHandler handler = new TimerWheel.TimeoutHandler() {
+            public void handleTimeout(TimerWheel.Timer timer)
+            {
+                ++fired;
+            }
+        };
+
+        for (int i = 0; i < 100; ++i)
+            wheel.addTimer(handler).schedule(1000000);
+
+        /* The deadlines may straddle a tick boundary */
+        for (int i = 0; i < 10 && fired < 100; ++i)
+            loop.dispatch(1000);
+
+        Assert.assertEquals(100, fired);
+    }
+
+    @Test
+    public void testCancel()
+    {
+        TimerWheel.Timer timer = wheel.addTimer(new TimerWheel.TimeoutHandler() {
+            public void handleTimeout(TimerWheel.Timer timer)
+            {
+                ++fired;
+            }
+        });
+
+        timer.schedule(1000000);
+        Assert.assertTrue(timer.isPending());
+        timer.cancel();
+        Assert.assertFalse(timer.isPending());
+
+        loop.dispatch(10);
+
+        Assert.assertEquals(0, fired);
+    }
+
+    @Test
+    public void testCascadingLevels()
+    {
+        /* With 1us ticks these land on levels 1, 2 and 3 */
+        final long[] delays = { 100000, 5000000, 300000000 };
+        final long[] firedAt = new long[delays.length];
+
+        wheel.destroy();
+        wheel = new TimerWheel(loop, 1000);
+
+        long start = System.nanoTime();
+        for (int i = 0; i < delays.length; ++i) {
+            final int index = i;
+            wheel.addTimer(new TimerWheel.TimeoutHandler() {
+                public void handleTimeout(TimerWheel.Timer timer)
+                {
+                    firedAt[index] = System.nanoTime();
+                    ++fired;
+                }
+            }).schedule(delays[i]);
+        }
+
+        for (int i = 0; i < 100 && fired < delays.length; ++i)
+            loop.dispatch(100);
+
+        Assert.assertEquals(delays.length, fired);
+        for (int i = 0; i < delays.length; ++i)
+            Assert.assertTrue(firedAt[i] - start >= delays[i]);
+    }
+
+    @Test
+    public void testRescheduleFromHandler()
+    {
+        wheel.addTimer(new TimerWheel.TimeoutHandler() {
+            public void handleTimeout(TimerWheel.Timer timer)
+            {
+                if (++fired < 3)
+                    timer.schedule(1000000);
+            }
+        }).schedule(1000000);
+
+        for (int i = 0; i < 100 && fired < 3; ++i)
+            loop.dispatch(100);
+
+        Assert.assertEquals(3, fired);
+    }
+
+    @Test
+    public void testDestroyInHandler()
+    {
+        final Throwable[] reported = new Throwable[1];
+
+        loop.setUncaughtCallbackHandler(new UncaughtCallbackHandler() {
+            public void uncaughtCallbackException(Object source, Throwable t)
+            {
+                reported[0] = t;
+            }
+        });
+
+        TimerWheel.TimeoutHandler handler = new TimerWheel.TimeoutHandler() {
+            public void handleTimeout(TimerWheel.Timer timer)
+            {
+                ++fired;
+                wheel.destroy();
+                /* Errors get past dispatchExpired to the native side */
+                throw new AssertionError("destroyed");
+            }
+        };
+
+        wheel.addTimer(handler).schedule(1000000);
+        wheel.addTimer(handler).schedule(1000000);
+
+        for (int i = 0; i < 100 && reported[0] == null; ++i)
+            loop.dispatch(100);
+        loop.dispatch(10);
+
+        Assert.assertEquals(1, fired);
+        Assert.assertTrue(reported[0] instanceof AssertionError);
+    }
+
+    @After
+    public void destroyWheel()
+    {
+        wheel.destroy();
+    }
+}